@@ -19,12 +19,12 @@
 #include "adapter.hpp"
 
 #include "device.hpp"
+#include "timer_wheel.hpp"
 
 #include <dlib/logger.h>
 
 #include <algorithm>
 #include <chrono>
-#include <thread>
 #include <utility>
 
 using namespace std;
@@ -65,7 +65,11 @@ namespace mtconnect
   void Adapter::stop()
   {
     // Will stop threaded object gracefully Adapter::thread()
-    m_running = false;
+    {
+      std::lock_guard<std::mutex> lock(m_reconnectLock);
+      m_running = false;
+      m_reconnectCond.notify_all();
+    }
     close();
     wait();
   }
@@ -576,10 +580,22 @@ namespace mtconnect
       if (!m_running)
         break;
 
-      // Try to reconnect every 10 seconds
+      // Try to reconnect every 10 seconds. The wait is a timer on the timer wheel and
+      // stop() wakes the thread early.
       g_logger << LINFO << "Will try to reconnect in " << m_reconnectInterval.count()
                << " milliseconds";
-      this_thread::sleep_for(m_reconnectInterval);
+      auto &wheel = TimerWheel::instance();
+      std::unique_lock<std::mutex> lock(m_reconnectLock);
+      bool due = false;
+      auto timer = wheel.schedule(chrono::steady_clock::now() + m_reconnectInterval,
+                                  [this, &due]() {
+                                    std::lock_guard<std::mutex> lock(m_reconnectLock);
+                                    due = true;
+                                    m_reconnectCond.notify_all();
+                                  });
+      m_reconnectCond.wait(lock, [this, &due]() { return due || !m_running; });
+      lock.unlock();
+      wheel.cancel(timer);
     }
     g_logger << LINFO << "Adapter thread stopped";
   }
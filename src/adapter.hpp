@@ -26,6 +26,8 @@
 #include <dlib/threads.h>
 
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <stdexcept>
@@ -221,6 +223,8 @@ namespace mtconnect
 
     // Timeout for reconnection attempts, given in milliseconds
     std::chrono::milliseconds m_reconnectInterval;
+    std::mutex m_reconnectLock;
+    std::condition_variable m_reconnectCond;
 
    private:
     // Inherited and is run as part of the threaded_object
@@ -18,6 +18,7 @@
 #include "agent.hpp"
 
 #include "json_printer.hpp"
+#include "timer_wheel.hpp"
 #include "xml_printer.hpp"
 #include <sys/stat.h>
 
@@ -30,6 +31,9 @@
 
 #include <algorithm>
 #include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
 #include <fcntl.h>
 #include <functional>
 #include <sstream>
@@ -46,6 +50,16 @@ namespace mtconnect
   static const string g_available("AVAILABLE");
   static dlib::logger g_logger("agent");
 
+  // The value of a data item before any data is received
+  static const string &initialValue(const DataItem *dataItem)
+  {
+    if (dataItem->isCondition())
+      return g_conditionUnavailable;
+    else if (dataItem->hasConstantValue())
+      return dataItem->getConstrainedValues()[0];
+    return g_unavailable;
+  }
+
   // Agent public methods
   Agent::Agent(const string &configXmlPath, int bufferSize, int maxAssets,
                const std::string &version, std::chrono::milliseconds checkpointFreq, bool pretty)
@@ -107,13 +121,13 @@ namespace mtconnect
     // Sequence number and sliding buffer for data
     m_sequence = 1ull;
     m_slidingBufferSize = 1 << bufferSize;
-    m_slidingBuffer = make_unique<sliding_buffer_kernel_1<ObservationPtr>>();
-    m_slidingBuffer->set_size(bufferSize);
+    m_slidingBuffer = make_unique<RingBuffer<ObservationPtr>>(m_slidingBufferSize);
     m_checkpointFreq = checkpointFreq.count();
     m_checkpointCount = (m_slidingBufferSize / checkpointFreq.count()) + 1;
 
     // Asset sliding buffer
     m_maxAssets = maxAssets;
+    m_assetStore = make_unique<AssetStore>(m_maxAssets);
 
     // Create the checkpoints at a regular frequency
     m_checkpoints.reserve(m_checkpointCount);
@@ -183,9 +197,12 @@ namespace mtconnect
       }
     }
 
+    // Number the data items again to include the ones added above
+    orderDataItems(m_devices);
+
     // Reload the document for path resolution
     m_xmlParser->loadDocument(xmlPrinter->printProbe(m_instanceId, m_slidingBufferSize, m_maxAssets,
-                                                     m_assets.size(), m_sequence, m_devices));
+                                                     m_assetStore->size(), m_sequence, m_devices));
 
     // Initialize the id mapping for the devices and set all data items to UNAVAILABLE
     for (const auto device : m_devices)
@@ -196,13 +213,7 @@ namespace mtconnect
       {
         // Check for single valued constrained data items.
         auto d = item.second;
-        const string *value = &g_unavailable;
-        if (d->isCondition())
-          value = &g_conditionUnavailable;
-        else if (d->hasConstantValue())
-          value = &(d->getConstrainedValues()[0]);
-
-        addToBuffer(d, *value, time);
+        addToBuffer(d, initialValue(d), time);
         if (!m_dataItemMap.count(d->getId()))
           m_dataItemMap[d->getId()] = d;
         else
@@ -253,14 +264,32 @@ namespace mtconnect
 
   Agent::~Agent()
   {
+    m_journal.reset();
+    m_coldStore.reset();
     m_slidingBuffer.reset();
     m_xmlParser.reset();
     m_checkpoints.clear();
 
+    // Delete the retired observations while their data items still exist
+    if (m_reclaimer)
+    {
+      Observation::setReclaimer(nullptr);
+      m_reclaimer.reset();
+    }
+
     for (auto &i : m_devices)
       delete i;
     m_devices.clear();
-    m_assets.clear();
+    m_assetStore->clear();
+  }
+
+  void Agent::enableEpochReclamation()
+  {
+    if (!m_reclaimer)
+    {
+      m_reclaimer = std::make_unique<EpochReclaimer>();
+      Observation::setReclaimer(m_reclaimer.get());
+    }
   }
 
   void Agent::start()
@@ -370,7 +399,7 @@ namespace mtconnect
 
   void Agent::on_connect(std::istream &in, std::ostream &out, const std::string &foreign_ip,
                          const std::string &local_ip, unsigned short foreign_port,
-                         unsigned short local_port, uint64)
+                         unsigned short local_port, uint64 connectionId)
   {
     try
     {
@@ -380,6 +409,8 @@ namespace mtconnect
       parse_http_request(in, incoming, get_max_content_length());
       read_body(in, incoming);
       outgoing.m_out = &out;
+      outgoing.m_in = &in;
+      outgoing.m_shutdown = [this, connectionId]() { shutdown_connection(connectionId); };
       const std::string &result = httpRequest(incoming, outgoing);
       if (out.good())
       {
@@ -475,7 +506,9 @@ namespace mtconnect
       string first = path.substr(1, loc1 - 1);
       string call, device;
 
-      if (first == "assets" || first == "asset")
+      if (first == "buffer" && incoming.request_type != "GET")
+        result = handleBuffer(printer, incoming.queries);
+      else if (first == "assets" || first == "asset")
       {
         string list;
         if (loc1 != string::npos)
@@ -512,8 +545,12 @@ namespace mtconnect
           call = first;
         }
 
-        if (incoming.request_type == "GET")
-          result = handleCall(printer, *outgoing.m_out, path, incoming.queries, call, device);
+        if (incoming.request_type == "GET" && (call == "sample" || call == "current") &&
+            WebSocket::requestsUpgrade(incoming.headers))
+          result = handleWebSocket(printer, incoming, outgoing, path, call, device);
+        else if (incoming.request_type == "GET")
+          result = handleCall(printer, *outgoing.m_out, path, incoming.queries, call, device,
+                              nullptr, outgoing.m_shutdown);
         else
           result = handlePut(printer, *outgoing.m_out, path, incoming.queries, call, device);
       }
@@ -563,16 +600,43 @@ namespace mtconnect
       m_sequence++;
     }
 
-    (*m_slidingBuffer)[seqNum] = event;
+    auto received = getCurrentTimeInMicros();
+    if (m_journal)
+      m_journal->append({seqNum, received, dataItem->getId(), time, value},
+                        accumulates(dataItem, value));
+
+    storeObservation(event, received);
+
+    dataItem->signalObservers(seqNum);
+
+    return seqNum;
+  }
+
+  void Agent::storeObservation(Observation *event, uint64_t received)
+  {
+    auto seqNum = event->getSequence();
+
+    // Keep the sequence index in step with the buffer, the observation in this slot
+    // is being evicted.
+    auto &slot = (*m_slidingBuffer)[seqNum];
+    if (slot)
+      evictObservation(slot);
+    // The buffer takes the reference the observation was created with
+    slot.setObject(event, true);
+    auto bytes = event->getMemorySize();
+    m_bufferBytes += bytes;
+    m_bufferBytesByType[event->getDataItem()->getType()] += bytes;
+    m_sequenceIndex.add(event->getDataItem(), seqNum);
+    m_timeIndex.add(seqNum, received);
+    m_timeIndex.trim(getFirstSequence());
     m_latest.addObservation(event);
-    event->unrefer();
 
     // Special case for the first event in the series to prime the first checkpoint.
     if (seqNum == 1)
       m_first.addObservation(event);
 
     // Checkpoint management
-    const auto index = m_slidingBuffer->get_element_id(seqNum);
+    const auto index = m_slidingBuffer->getIndex(seqNum);
     if (m_checkpointCount > 0 && !(index % m_checkpointFreq))
     {
       // Copy the checkpoint from the current into the slot
@@ -587,9 +651,362 @@ namespace mtconnect
       m_first.addObservation((*m_slidingBuffer)[m_sequence]);
     }
 
-    dataItem->signalObservers(seqNum);
+    enforceMemoryLimit();
+  }
 
-    return seqNum;
+  void Agent::evictObservation(const ObservationPtr &event)
+  {
+    m_sequenceIndex.remove(event->getDataItem(), event->getSequence());
+    if (m_coldStore)
+      m_coldStore->add(event, m_timeIndex.time(event->getSequence()));
+
+    auto bytes = event->getMemorySize();
+    m_bufferBytes -= bytes;
+    m_bufferBytesByType[event->getDataItem()->getType()] -= bytes;
+  }
+
+  void Agent::enforceMemoryLimit()
+  {
+    if (!m_bufferMemoryLimit || m_bufferBytes <= m_bufferMemoryLimit)
+      return;
+
+    // Evict the oldest observations before the buffer wraps, always keeping the newest.
+    // First moves forward with them and includes the new first observation.
+    auto first = getFirstSequence();
+    while (m_bufferBytes > m_bufferMemoryLimit && first + 1 < m_sequence)
+    {
+      auto &slot = (*m_slidingBuffer)[first];
+      evictObservation(slot);
+      slot = nullptr;
+      first++;
+      m_first.addObservation((*m_slidingBuffer)[first]);
+    }
+
+    m_firstSequence = first;
+    m_timeIndex.trim(first);
+  }
+
+  void Agent::setBufferMemoryLimit(uint64_t bytes)
+  {
+    std::lock_guard<std::mutex> lock(m_sequenceLock);
+    m_bufferMemoryLimit = bytes;
+    enforceMemoryLimit();
+  }
+
+  std::map<string, uint64_t> Agent::getBufferBytesByType()
+  {
+    std::lock_guard<std::mutex> lock(m_sequenceLock);
+    return m_bufferBytesByType;
+  }
+
+  bool Agent::accumulates(const DataItem *dataItem, const string &value) const
+  {
+    if (value.compare(0, g_unavailable.size(), g_unavailable) == 0)
+      return false;
+
+    // A data set is replaced when it is reset
+    if (dataItem->isDataSet())
+      return value.empty() || value[0] != ':';
+
+    // Conditions are replaced by a normal without a native code
+    if (dataItem->isCondition())
+    {
+      auto level = value.find('|');
+      bool hasCode = level != string::npos && level + 1 < value.size() && value[level + 1] != '|';
+      auto name = value.substr(0, level);
+      return hasCode || toUpperCase(name) != "NORMAL";
+    }
+
+    return false;
+  }
+
+  void Agent::openJournal(const string &directory, size_t segmentSize,
+                          std::chrono::milliseconds syncInterval, const string &coldStorage,
+                          uint64_t coldStorageBudget)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_sequenceLock);
+      m_journal =
+          make_unique<Journal>(directory, m_slidingBufferSize, segmentSize, syncInterval);
+
+      // Find where the journal ends and the last observation that can no longer be
+      // restored because its data item is gone
+      uint64_t instanceId = 0, sequence = 0, first = 0, unknown = 0;
+      bool recovered = m_journal->recover(
+          instanceId, sequence, [&](const Journal::Record &record, bool snapshot) {
+            if (snapshot)
+              return;
+            if (!first)
+              first = record.m_sequence;
+            if (!m_dataItemMap.count(record.m_dataItemId))
+              unknown = record.m_sequence;
+          });
+
+      // Everything evicted from here on, also while the journal is replayed, follows the
+      // segments of the restored instance
+      if (!coldStorage.empty())
+        createColdStore(coldStorage, recovered ? instanceId : m_instanceId, coldStorageBudget);
+
+      // The buffer is rebuilt from the journal or started again so all observations are
+      // journaled
+      for (auto seq = getFirstSequence(); seq < m_sequence; seq++)
+        (*m_slidingBuffer)[seq] = nullptr;
+      m_latest.clear();
+      m_first.clear();
+      for (auto &checkpoint : m_checkpoints)
+        checkpoint.clear();
+      m_sequenceIndex.clear();
+      m_timeIndex.clear();
+      m_bufferBytes = 0;
+      m_bufferBytesByType.clear();
+      m_sequence = 1;
+      m_firstSequence = 1;
+
+      if (recovered && first)
+      {
+        // Observations before the start only restore the state at the start of the buffer
+        auto begin = chrono::steady_clock::now();
+        auto start = max({first, unknown + 1,
+                          sequence > m_slidingBufferSize ? sequence - m_slidingBufferSize : 1});
+        m_instanceId = instanceId;
+        m_sequence = start;
+        m_firstSequence = start;
+
+        m_journal->recover(
+            instanceId, sequence, [&](const Journal::Record &record, bool snapshot) {
+              auto item = m_dataItemMap.find(record.m_dataItemId);
+              if (item == m_dataItemMap.end())
+                return;
+
+              auto dataItem = item->second;
+              m_journal->track(record, accumulates(dataItem, record.m_value));
+              auto event =
+                  new Observation(*dataItem, record.m_sequence, record.m_time, record.m_value);
+              if (snapshot || record.m_sequence < start)
+              {
+                m_latest.addObservation(event);
+                m_first.addObservation(event);
+                event->unrefer();
+              }
+              else
+              {
+                if (dataItem->isDataSet())
+                  m_latest.dataSetDifference(event);
+                m_sequence = record.m_sequence + 1;
+                storeObservation(event, record.m_received);
+              }
+            });
+
+        auto elapsed = chrono::steady_clock::now() - begin;
+        g_logger << LINFO << "Restored " << (m_sequence - start)
+                 << " observations from the journal in "
+                 << chrono::duration_cast<chrono::milliseconds>(elapsed).count() << "ms";
+      }
+      else if (recovered)
+      {
+        m_instanceId = instanceId;
+        m_sequence = m_firstSequence = sequence;
+      }
+
+      m_journal->start(m_instanceId, m_sequence);
+    }
+
+    // The adapters are not connected yet, everything is unavailable like on a cold start
+    string time = getCurrentTime(GMT_UV_SEC);
+    for (const auto &item : m_dataItemMap)
+      addToBuffer(item.second, initialValue(item.second), time);
+  }
+
+  void Agent::openColdStore(const string &directory, uint64_t budget)
+  {
+    std::lock_guard<std::mutex> lock(m_sequenceLock);
+    createColdStore(directory, m_instanceId, budget);
+  }
+
+  void Agent::createColdStore(const string &directory, uint64_t instanceId, uint64_t budget)
+  {
+    // Close the previous store first so its pending block is written
+    m_coldStore.reset();
+    m_coldStore = make_unique<ColdStore>(directory, instanceId, budget, [this](const string &id) {
+      auto item = m_dataItemMap.find(id);
+      return item != m_dataItemMap.end() ? item->second : nullptr;
+    });
+  }
+
+  void Agent::openAssetLog(const string &directory)
+  {
+    std::lock_guard<std::mutex> lock(m_assetLock);
+    auto start = std::chrono::steady_clock::now();
+
+    m_assetLog = make_unique<AssetLog>(directory);
+    auto logged = m_assetLog->recover([this](const AssetLog::Record &record) {
+      if (record.m_kind == AssetLog::REMOVE)
+      {
+        auto asset = m_assetStore->get(record.m_assetId);
+        if (asset.getObject())
+        {
+          m_assetStore->remove(record.m_assetId);
+          asset->setTimestamp(record.m_timestamp);
+        }
+        return;
+      }
+
+      AssetPtr asset;
+      try
+      {
+        asset = m_xmlParser->parseAsset(record.m_assetId, record.m_type, record.m_content);
+      }
+      catch (runtime_error &e)
+      {
+        g_logger << LERROR << "openAssetLog: Error parsing asset " << record.m_assetId << ": "
+                 << e.what();
+        return;
+      }
+      if (!asset.getObject())
+        return;
+
+      asset->setAssetId(record.m_assetId);
+      asset->setTimestamp(record.m_timestamp);
+      asset->setDeviceUuid(record.m_deviceUuid);
+      asset->setRemoved(record.m_removed);
+      insertAsset(asset);
+    });
+
+    // Start from a snapshot of the restored assets so the next start only reads it
+    if (logged > 0)
+      compactAssetLog();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    g_logger << LINFO << "Restored " << m_assetStore->size() << " assets from " << directory
+             << " in " << elapsed.count() << "ms";
+  }
+
+  XmlPrinter *Agent::assetPrinter()
+  {
+    return dynamic_cast<XmlPrinter *>(m_printers["xml"].get());
+  }
+
+  void Agent::logAsset(AssetPtr &asset)
+  {
+    if (!m_assetLog)
+      return;
+
+    AssetLog::Record record;
+    record.m_kind = AssetLog::PUT;
+    record.m_assetId = asset->getAssetId();
+    record.m_type = asset->getType();
+    record.m_deviceUuid = asset->getDeviceUuid();
+    record.m_timestamp = asset->getTimestamp();
+    record.m_content = assetPrinter()->printAsset(asset);
+    record.m_removed = asset->isRemoved();
+    m_assetLog->append(record);
+
+    if (m_assetLog->needsCompaction())
+      compactAssetLog();
+  }
+
+  void Agent::logAssetRemoved(const string &id, const string &time)
+  {
+    if (!m_assetLog)
+      return;
+
+    AssetLog::Record record;
+    record.m_kind = AssetLog::REMOVE;
+    record.m_assetId = id;
+    record.m_timestamp = time;
+    m_assetLog->append(record);
+
+    if (m_assetLog->needsCompaction())
+      compactAssetLog();
+  }
+
+  void Agent::compactAssetLog()
+  {
+    auto printer = assetPrinter();
+    auto assets = m_assetStore->getAll();
+    vector<AssetLog::Record> records(assets.size());
+    for (size_t i = 0; i < assets.size(); i++)
+    {
+      auto &asset = assets[i];
+      auto &record = records[i];
+      record.m_assetId = asset->getAssetId();
+      record.m_type = asset->getType();
+      record.m_deviceUuid = asset->getDeviceUuid();
+      record.m_timestamp = asset->getTimestamp();
+      record.m_content = printer->printAsset(asset);
+      record.m_removed = asset->isRemoved();
+    }
+
+    m_assetLog->compact(records);
+  }
+
+  void Agent::resizeBuffer(unsigned int size)
+  {
+    std::lock_guard<std::mutex> lock(m_sequenceLock);
+    if (size == m_slidingBufferSize)
+      return;
+
+    // Keep the newest observations that fit. The ones that do not are evicted the same
+    // way as when the buffer wraps and first moves forward to the new first sequence.
+    auto firstSeq = getFirstSequence();
+    auto newFirst = m_sequence - firstSeq > size ? m_sequence - size : firstSeq;
+    for (auto seq = firstSeq; seq < newFirst; seq++)
+    {
+      evictObservation((*m_slidingBuffer)[seq]);
+      m_first.addObservation((*m_slidingBuffer)[seq + 1]);
+    }
+
+    auto buffer = make_unique<RingBuffer<ObservationPtr>>(size);
+    for (auto seq = newFirst; seq < m_sequence; seq++)
+      (*buffer)[seq] = std::move((*m_slidingBuffer)[seq]);
+    m_slidingBuffer = move(buffer);
+    m_slidingBufferSize = size;
+    m_firstSequence = newFirst;
+    m_timeIndex.trim(newFirst);
+
+    // The checkpoints are at different slots now, replay the buffer from first to
+    // rebuild them
+    m_checkpointCount = (m_slidingBufferSize / m_checkpointFreq) + 1;
+    m_checkpoints.clear();
+    m_checkpoints.reserve(m_checkpointCount);
+    for (auto i = 0; i < m_checkpointCount; i++)
+      m_checkpoints.emplace_back();
+
+    Checkpoint checkpoint(m_first);
+    for (auto seq = newFirst; seq < m_sequence; seq++)
+    {
+      if (seq > newFirst)
+        checkpoint.addObservation((*m_slidingBuffer)[seq]);
+
+      const auto index = m_slidingBuffer->getIndex(seq);
+      if (!(index % m_checkpointFreq))
+        m_checkpoints[index / m_checkpointFreq].copy(checkpoint);
+    }
+
+    if (m_journal)
+      m_journal->setBufferSize(size);
+
+    g_logger << LINFO << "Resized the sliding buffer to " << size << " observations, first sequence "
+             << newFirst;
+  }
+
+  string Agent::handleBuffer(const Printer *printer, const key_value_map &queries)
+  {
+    try
+    {
+      auto size = checkAndGetParam(queries, "size", NO_VALUE32, 1, true, MAX_BUFFER_SIZE);
+      if (size == NO_VALUE32)
+        throw ParameterError("QUERY_ERROR", "'size' must be given.");
+
+      resizeBuffer(size);
+    }
+    catch (ParameterError &aError)
+    {
+      return printError(printer, aError.m_code, aError.m_message);
+    }
+
+    return "<success/>";
   }
 
   bool Agent::addAsset(Device *device, const string &id, const string &asset, const string &type,
@@ -632,63 +1049,18 @@ namespace mtconnect
         return false;
       }
 
-      auto old = &m_assetMap[id];
-      if (!ptr->isRemoved())
-      {
-        if (old->getObject())
-          m_assets.remove(old);
-        else
-          m_assetCounts[type] += 1;
-      }
-      else if (!old->getObject())
+      if (ptr->isRemoved() && !m_assetStore->get(id).getObject())
       {
         g_logger << LWARN << "Cannot remove non-existent asset";
         return false;
       }
 
-      if (!ptr.getObject())
-      {
-        g_logger << LWARN << "Asset could not be created";
-        return false;
-      }
-      else
-      {
-        ptr->setAssetId(id);
-        ptr->setTimestamp(time);
-        ptr->setDeviceUuid(device->getUuid());
-      }
-
-      // Check for overflow
-      if (m_assets.size() >= m_maxAssets)
-      {
-        AssetPtr oldref(*m_assets.front());
-        m_assetCounts[oldref->getType()] -= 1;
-        m_assets.pop_front();
-        m_assetMap.erase(oldref->getAssetId());
-
-        // Remove secondary keys
-        const auto &keys = oldref->getKeys();
-        for (const auto &key : keys)
-        {
-          auto &index = m_assetIndices[key.first];
-          index.erase(key.second);
-        }
-      }
-
-      m_assetMap[id] = ptr;
-      if (!ptr->isRemoved())
-      {
-        AssetPtr &newPtr = m_assetMap[id];
-        m_assets.emplace_back(&newPtr);
-      }
+      ptr->setAssetId(id);
+      ptr->setTimestamp(time);
+      ptr->setDeviceUuid(device->getUuid());
 
-      // Add secondary keys
-      const auto &keys = ptr->getKeys();
-      for (const auto &key : keys)
-      {
-        auto &index = m_assetIndices[key.first];
-        index[key.second] = ptr;
-      }
+      insertAsset(ptr);
+      logAsset(ptr);
     }
 
     // Generate an asset changed event.
@@ -700,6 +1072,30 @@ namespace mtconnect
     return true;
   }
 
+  void Agent::insertAsset(const AssetPtr &asset)
+  {
+    // The least recently used asset is evicted when the store is full
+    AssetPtr oldref = m_assetStore->add(asset);
+    if (oldref.getObject())
+    {
+      // Remove secondary keys
+      const auto &keys = oldref->getKeys();
+      for (const auto &key : keys)
+      {
+        auto &index = m_assetIndices[key.first];
+        index.erase(key.second);
+      }
+    }
+
+    // Add secondary keys
+    const auto &keys = asset->getKeys();
+    for (const auto &key : keys)
+    {
+      auto &index = m_assetIndices[key.first];
+      index[key.second] = asset.getObject();
+    }
+  }
+
   bool Agent::updateAsset(Device *device, const std::string &id, AssetChangeList &assetChangeList,
                           const string &inputTime)
   {
@@ -713,7 +1109,7 @@ namespace mtconnect
     {
       std::lock_guard<std::mutex> lock(m_assetLock);
 
-      asset = m_assetMap[id];
+      asset = m_assetStore->get(id);
       if (!asset.getObject())
         return false;
 
@@ -738,13 +1134,13 @@ namespace mtconnect
         return false;
       }
 
-      // Move it to the front of the queue
-      m_assets.remove(&asset);
-      m_assets.emplace_back(&asset);
-
       tool->setTimestamp(time);
       tool->setDeviceUuid(device->getUuid());
       tool->changed();
+
+      // Move it to the front of the queue
+      m_assetStore->touch(id);
+      logAsset(asset);
     }
 
     addToBuffer(device->getAssetChanged(), asset->getType() + "|" + id, time);
@@ -765,12 +1161,13 @@ namespace mtconnect
     {
       std::lock_guard<std::mutex> lock(m_assetLock);
 
-      asset = m_assetMap[id];
+      asset = m_assetStore->get(id);
       if (!asset.getObject())
         return false;
 
-      asset->setRemoved(true);
+      m_assetStore->remove(id);
       asset->setTimestamp(time);
+      logAssetRemoved(id, time);
 
       // Check if the asset changed id is the same as this asset.
       auto ptr = m_latest.getEventPtr(device->getAssetChanged()->getId());
@@ -799,21 +1196,18 @@ namespace mtconnect
       if (ptr)
         changedId = (*ptr)->getValue();
 
-      list<AssetPtr *>::reverse_iterator iter;
-      for (iter = m_assets.rbegin(); iter != m_assets.rend(); ++iter)
+      auto assets = m_assetStore->find(type, "", false, m_assetStore->size());
+      for (auto &asset : assets)
       {
-        AssetPtr asset = (**iter);
-        if (type == asset->getType() && !asset->isRemoved())
-        {
-          asset->setRemoved(true);
-          asset->setTimestamp(time);
+        m_assetStore->remove(asset->getAssetId());
+        asset->setTimestamp(time);
+        logAssetRemoved(asset->getAssetId(), time);
 
-          addToBuffer(device->getAssetRemoved(), asset->getType() + "|" + asset->getAssetId(),
-                      time);
+        addToBuffer(device->getAssetRemoved(), asset->getType() + "|" + asset->getAssetId(),
+                    time);
 
-          if (changedId == asset->getAssetId())
-            addToBuffer(device->getAssetChanged(), asset->getType() + "|UNAVAILABLE", time);
-        }
+        if (changedId == asset->getAssetId())
+          addToBuffer(device->getAssetChanged(), asset->getType() + "|UNAVAILABLE", time);
       }
     }
 
@@ -888,7 +1282,8 @@ namespace mtconnect
 
   // Agent protected methods
   string Agent::handleCall(const Printer *printer, ostream &out, const string &path,
-                           const key_value_map &queries, const string &call, const string &device)
+                           const key_value_map &queries, const string &call, const string &device,
+                           WebSocket *webSocket, const std::function<void()> &shutdown)
   {
     try
     {
@@ -917,8 +1312,17 @@ namespace mtconnect
               printer, "INVALID_REQUEST",
               "You cannot specify both the at and frequency arguments to a current request");
 
+        // A WebSocket always streams, send the current state every heartbeat by default
+        if (webSocket && freq == NO_FREQ)
+        {
+          if (at != NO_START)
+            return printError(printer, "INVALID_REQUEST",
+                              "You cannot specify the at argument on a WebSocket");
+          freq = heartbeat.count();
+        }
+
         return handleStream(printer, out, devicesAndPath(path, deviceName), true, freq, at, 0,
-                            heartbeat);
+                            heartbeat, webSocket, shutdown);
       }
       else if (call == "probe" || call.empty())
         return handleProbe(printer, deviceName);
@@ -942,17 +1346,65 @@ namespace mtconnect
           throw ParameterError("OUT_OF_RANGE", "'count' must not be used with an 'interval'.");
 
         auto start =
-            checkAndGetParam64(queries, "from", NO_START, getFirstSequence(), true, m_sequence);
+            checkAndGetParam64(queries, "from", NO_START, getLowestSequence(), true, m_sequence);
 
         if (start == NO_START)  // If there was no data in queries
           start =
-              checkAndGetParam64(queries, "start", NO_START, getFirstSequence(), true, m_sequence);
+              checkAndGetParam64(queries, "start", NO_START, getLowestSequence(), true, m_sequence);
+
+        auto fromTime = checkAndGetTime(queries, "fromTime");
+        auto toTime = checkAndGetTime(queries, "toTime");
+        if (fromTime && start != NO_START)
+          throw ParameterError("INVALID_REQUEST", "'fromTime' must not be used with 'from'.");
+        if (toTime && (freq != NO_FREQ || webSocket))
+          throw ParameterError("INVALID_REQUEST", "'toTime' must not be used with an 'interval'.");
+        if (fromTime && toTime && fromTime > toTime)
+          throw ParameterError("OUT_OF_RANGE", "'fromTime' must not be after 'toTime'.");
+
+        // Resolve the times to the range of sequences [from, to)
+        uint64_t stop = 0;
+        if (fromTime || toTime)
+        {
+          std::lock_guard<std::mutex> lock(m_sequenceLock);
+          auto firstSeq = getFirstSequence();
+          auto from = fromTime ? max(m_timeIndex.from(fromTime, m_sequence), firstSeq) : firstSeq;
+          auto to = toTime ? m_timeIndex.to(toTime, m_sequence) : m_sequence;
+
+          // Times before the buffer resolve to the segments in cold storage
+          if (m_coldStore)
+          {
+            if (from == firstSeq)
+              from = fromTime ? m_coldStore->from(fromTime, firstSeq) : getLowestSequence();
+            if (toTime && to <= firstSeq)
+              to = m_coldStore->to(toTime, firstSeq);
+          }
+
+          // Going backward the range is walked from the end
+          if (count >= 0)
+          {
+            start = from;
+            stop = toTime ? to : 0;
+          }
+          else
+          {
+            start = toTime ? to - 1 : NO_START;
+            stop = fromTime ? from - 1 : 0;
+          }
+        }
 
         auto heartbeat = std::chrono::milliseconds{
             checkAndGetParam(queries, "heartbeat", 10000, 10, true, 600000)};
 
+        // A WebSocket always streams, send data as soon as it arrives by default
+        if (webSocket && freq == NO_FREQ)
+        {
+          if (count < 0)
+            throw ParameterError("OUT_OF_RANGE", "'count' must not be negative on a WebSocket.");
+          freq = 0;
+        }
+
         return handleStream(printer, out, devicesAndPath(path, deviceName), false, freq, start,
-                            count, heartbeat);
+                            count, heartbeat, webSocket, shutdown, stop);
       }
       else if (findDeviceByUUIDorName(call) && device.empty())
         return handleProbe(printer, call);
@@ -1033,12 +1485,13 @@ namespace mtconnect
       deviceList = m_devices;
 
     return printer->printProbe(m_instanceId, m_slidingBufferSize, m_sequence, m_maxAssets,
-                               m_assets.size(), deviceList, &m_assetCounts);
+                               m_assetStore->size(), deviceList, &m_assetStore->getCounts());
   }
 
   string Agent::handleStream(const Printer *printer, ostream &out, const string &path, bool current,
                              unsigned int frequency, uint64_t start, int count,
-                             std::chrono::milliseconds heartbeat)
+                             std::chrono::milliseconds heartbeat, WebSocket *webSocket,
+                             const std::function<void()> &shutdown, uint64_t stop)
   {
     std::set<string> filter;
     try
@@ -1057,7 +1510,8 @@ namespace mtconnect
     // Check if there is a frequency to stream data or not
     if (frequency != (unsigned)NO_FREQ)
     {
-      streamData(printer, out, filter, current, frequency, start, count, heartbeat);
+      streamData(printer, out, filter, current, frequency, start, count, heartbeat, webSocket,
+                 shutdown);
       return "";
     }
     else
@@ -1067,8 +1521,44 @@ namespace mtconnect
       if (current)
         return fetchCurrentData(printer, filter, start);
       else
-        return fetchSampleData(printer, filter, start, count, end, endOfBuffer);
+        return fetchSampleData(printer, filter, start, count, stop, end, endOfBuffer);
+    }
+  }
+
+  string Agent::handleWebSocket(const Printer *printer, const IncomingThings &incoming,
+                                OutgoingThings &outgoing, const string &path, const string &call,
+                                const string &device)
+  {
+    if (!outgoing.m_in)
+      return printError(printer, "UNSUPPORTED", "WebSocket is not supported on this connection");
+
+    if (!WebSocket::isUpgrade(incoming.headers))
+    {
+      // Tell the client which version is supported (RFC 6455 4.4)
+      outgoing.http_return = 400;
+      outgoing.http_return_status = "Bad Request";
+      outgoing.headers["Sec-WebSocket-Version"] = "13";
+      return printError(printer, "INVALID_REQUEST",
+                        "WebSocket upgrade requires Connection: Upgrade, a Sec-WebSocket-Key "
+                        "and Sec-WebSocket-Version: 13");
     }
+
+    WebSocket webSocket(*outgoing.m_in, *outgoing.m_out, outgoing.m_shutdown);
+    webSocket.setDevice(device);
+    webSocket.accept(incoming.headers.find("Sec-WebSocket-Key")->second);
+    g_logger << LDEBUG << "WebSocket " << call << " stream for " << incoming.foreign_ip;
+
+    // Errors and documents that are not streamed are sent as a single frame
+    auto result =
+        handleCall(printer, *outgoing.m_out, path, incoming.queries, call, device, &webSocket,
+                   outgoing.m_shutdown);
+    if (!result.empty())
+      webSocket.write(WebSocket::frame(WebSocket::TEXT, result));
+
+    webSocket.close();
+    outgoing.m_out->setstate(ios::badbit);
+
+    return "";
   }
 
   std::string Agent::handleAssets(const Printer *printer, std::ostream &aOut,
@@ -1093,7 +1583,7 @@ namespace mtconnect
       {
         if (type == tok.IDENTIFIER)
         {
-          AssetPtr ptr = m_assetMap[token];
+          AssetPtr ptr = m_assetStore->get(token);
           if (!ptr.getObject())
             return printer->printError(m_instanceId, 0, 0, "ASSET_NOT_FOUND",
                                        (string) "Could not find asset: " + token);
@@ -1107,20 +1597,23 @@ namespace mtconnect
       // Return all asssets, first check if there is a type attribute
 
       string type = queries["type"];
-      auto removed = (queries.count("removed") > 0 && queries["removed"] == "true");
-      auto count = checkAndGetParam(queries, "count", m_assets.size(), 1, false, NO_VALUE32);
-
-      std::list<AssetPtr *>::reverse_iterator iter;
-      for (iter = m_assets.rbegin(); iter != m_assets.rend() && count > 0; ++iter, --count)
+      string device;
+      if (queries.count("device"))
       {
-        if ((type.empty() || type == (**iter)->getType()) && (removed || !(**iter)->isRemoved()))
-        {
-          assets.emplace_back(**iter);
-        }
+        auto dev = findDeviceByUUIDorName(queries["device"]);
+        if (!dev)
+          return printError(printer, "NO_DEVICE",
+                            "Could not find the device '" + queries["device"] + "'");
+        device = dev->getUuid();
       }
+      auto removed = (queries.count("removed") > 0 && queries["removed"] == "true");
+      auto count =
+          checkAndGetParam(queries, "count", m_assetStore->size(), 1, false, NO_VALUE32);
+
+      assets = m_assetStore->find(type, device, removed, count);
     }
 
-    return printer->printAssets(m_instanceId, m_maxAssets, m_assets.size(), assets);
+    return printer->printAssets(m_instanceId, m_maxAssets, m_assetStore->size(), assets);
   }
 
   // Store an asset in the map by asset # and use the circular buffer as
@@ -1253,12 +1746,66 @@ namespace mtconnect
     return "";
   }
 
+  // Frame the content and the line break after it as a part of the multipart stream inside
+  // an HTTP chunk. The chunk is written into one string of its final size.
+  static string frameChunk(const string &boundary, const Printer *printer, const string &content)
+  {
+    const auto mimeType = printer->mimeType();
+    char length[NumberBufferSize];
+    auto lengthEnd = formatInteger(length, content.length() + 2);
+
+    const char contentType[] = "\r\nContent-type: ";
+    const char contentLength[] = "\r\nContent-length: ";
+    size_t partLength = 2 + boundary.length() + sizeof(contentType) - 1 + mimeType.length() +
+                        sizeof(contentLength) - 1 + (lengthEnd - length) + 4 + content.length() + 2;
+
+    char hex[NumberBufferSize];
+    auto hexEnd = hex + snprintf(hex, NumberBufferSize, "%zx", partLength);
+
+    string chunk;
+    chunk.reserve((hexEnd - hex) + 2 + partLength + 2);
+    chunk.append(hex, hexEnd).append("\r\n--").append(boundary);
+    chunk.append(contentType).append(mimeType);
+    chunk.append(contentLength).append(length, lengthEnd).append("\r\n\r\n");
+    chunk.append(content).append("\r\n\r\n");
+    return chunk;
+  }
+
+  std::shared_ptr<StreamGroup> Agent::getStreamGroup(const StreamGroup::Key &key)
+  {
+    std::lock_guard<std::mutex> lock(m_streamGroupLock);
+
+    // Clean up the groups where all the sessions have gone away
+    for (auto it = m_streamGroups.begin(); it != m_streamGroups.end();)
+    {
+      if (it->second.expired())
+        it = m_streamGroups.erase(it);
+      else
+        ++it;
+    }
+
+    auto group = m_streamGroups[key].lock();
+    if (!group)
+    {
+      group = make_shared<StreamGroup>(key, md5(intToString(time(nullptr))));
+      for (const auto &item : key.m_filter)
+        m_dataItemMap[item]->addObserver(&group->getObserver());
+      m_streamGroups[key] = group;
+    }
+
+    return group;
+  }
+
   void Agent::streamData(const Printer *printer, ostream &out, std::set<string> &filterSet,
                          bool current, unsigned int interval, uint64_t start, unsigned int count,
-                         std::chrono::milliseconds heartbeat)
+                         std::chrono::milliseconds heartbeat, WebSocket *webSocket,
+                         const std::function<void()> &shutdown)
   {
-    // Create header
-    string boundary = md5(intToString(time(nullptr)));
+    // Sessions making the same request share a group so each chunk is only fetched and
+    // printed once per interval. All sessions in the group must use the same boundary.
+    auto group = getStreamGroup(
+        {printer, filterSet, interval, current, (int)count, heartbeat, webSocket != nullptr});
+    const string &boundary = group->getBoundary();
 
     ofstream log;
     if (m_logStreamData)
@@ -1268,162 +1815,376 @@ namespace mtconnect
       log.open(filename.c_str());
     }
 
-    out << "HTTP/1.1 200 OK\r\n"
-           "Date: "
-        << getCurrentTime(HUM_READ)
-        << "\r\n"
-           "Server: MTConnectAgent\r\n"
-           "Expires: -1\r\n"
-           "Connection: close\r\n"
-           "Cache-Control: private, max-age=0\r\n"
-           "Content-Type: multipart/x-mixed-replace;boundary="
-        << boundary
-        << "\r\n"
-           "Transfer-Encoding: chunked\r\n\r\n";
+    // A WebSocket has already responded to the upgrade request
+    if (!webSocket)
+    {
+      out << "HTTP/1.1 200 OK\r\n"
+             "Date: "
+          << getCurrentTime(HUM_READ)
+          << "\r\n"
+             "Server: MTConnectAgent\r\n"
+             "Expires: -1\r\n"
+             "Connection: close\r\n"
+             "Cache-Control: private, max-age=0\r\n"
+             "Content-Type: multipart/x-mixed-replace;boundary="
+          << boundary
+          << "\r\n"
+             "Transfer-Encoding: chunked\r\n\r\n";
+    }
+
+    // Each document is a part of the multipart stream or a single WebSocket text frame
+    auto frameDocument = [&](const string &content) {
+      if (webSocket)
+        return WebSocket::frame(WebSocket::TEXT, content);
+      else
+        return frameChunk(boundary, printer, content);
+    };
+
+    // With a limit on the queued bytes, a writer thread sends the chunks so a slow
+    // client cannot block the session. When the queue is full, the slow consumer
+    // policy decides what happens to the stream.
+    unique_ptr<StreamWriter> writer;
+    if (m_maxQueuedBytes > 0)
+    {
+      writer = make_unique<StreamWriter>(
+          [&out, webSocket](const string &data) {
+            if (webSocket)
+            {
+              webSocket->write(data);
+              return webSocket->isOpen();
+            }
+
+            out << data;
+            out.flush();
+            return out.good();
+          },
+          shutdown);
+    }
+
+    auto write = [&](const string &data) {
+      if (writer)
+        writer->push(make_shared<string>(data), 0, 0, SIZE_MAX);
+      else if (webSocket)
+        webSocket->write(data);
+      else
+      {
+        out << data;
+        out.flush();
+      }
+    };
+
+    // Set when the client fell behind and the stream must resynchronize from
+    // resyncFrom according to the policy
+    bool resync = false;
+    bool coalesce = false;
+    uint64_t resyncFrom = 0;
+    bool slowConsumer = false;
+
+    // Returns false if the client must be disconnected
+    auto deliver = [&](const StreamGroup::Chunk &chunk) {
+      if (!writer || chunk.m_closed)
+      {
+        write(*chunk.m_data);
+        return true;
+      }
+
+      if (writer->push(chunk.m_data, chunk.m_start, chunk.m_observations, m_maxQueuedBytes))
+        return true;
+
+      if (m_slowConsumerPolicy == DISCONNECT)
+      {
+        auto disconnects = ++m_slowConsumerDisconnects;
+        g_logger << LWARN << "Client is not reading the stream, disconnecting ("
+                 << disconnects << " slow consumers disconnected)";
+        slowConsumer = true;
+        return false;
+      }
+
+      // Drop everything the client has not received
+      resyncFrom = chunk.m_start;
+      auto dropped = writer->clear(resyncFrom);
+
+      // Only the latest document of a current stream matters
+      if (current)
+      {
+        g_logger << LDEBUG << "Client is not reading the stream, dropping old documents";
+        writer->push(chunk.m_data, chunk.m_start, chunk.m_observations, SIZE_MAX);
+        return true;
+      }
+
+      if (m_slowConsumerPolicy == SKIP_TO_CURRENT)
+      {
+        auto total = m_droppedObservations += dropped + chunk.m_observations;
+        g_logger << LINFO << "Client is not reading the stream, skipping to current ("
+                 << total << " observations dropped)";
+      }
+      else
+        g_logger << LDEBUG << "Client is not reading the stream, coalescing from " << resyncFrom;
+
+      resync = true;
+      return true;
+    };
 
     // This object will automatically clean up all the observer from the
     // signalers in an exception proof manor.
-    ChangeObserver observer;
+    auto observer = make_unique<ChangeObserver>();
 
     // Add observers
     for (const auto &item : filterSet)
-      m_dataItemMap[item]->addObserver(&observer);
+      m_dataItemMap[item]->addObserver(observer.get());
 
     chrono::milliseconds interMilli{interval};
-    uint64_t firstSeq = getFirstSequence();
+    uint64_t firstSeq = getLowestSequence();
     if (start == NO_START || start < firstSeq)
       start = firstSeq;
 
-    try
-    {
-      // Loop until the user closes the connection
-      while (out.good())
-      {
-        // Remember when we started this grab...
-        auto last = chrono::system_clock::now();
-
-        // Fetch sample data now resets the observer while holding the sequence
-        // mutex to make sure that a new event will be recorded in the observer
-        // when it returns.
-        string content;
-        uint64_t end(0ull);
-        bool endOfBuffer = true;
-        if (current)
-          content = fetchCurrentData(printer, filterSet, NO_START);
+    // Set when the heartbeat expired without any new data
+    bool timedOut = false;
+
+    // Wait for up to frequency ms for something to arrive... Don't wait if
+    // we are not at the end of the buffer. Just put the next set after aInterval
+    // has elapsed.
+
+    // Even if we are at the end of the buffer, or within range. If we are filtering,
+    // we will need to make sure we are not spinning when there are no valid events
+    // to be reported. we will waste cycles spinning on the end of the buffer when
+    // we should be in a heartbeat wait as well.
+    auto waitForData = [&](ChangeObserver &obs, const StreamGroup::Chunk &last) -> uint64_t {
+      timedOut = false;
+
+      // When replaying, write the chunks back to back until we catch up
+      if (!last.m_endOfBuffer)
+        return last.m_end;
+
+      // The next chunk is due at the interval, or at the heartbeat if nothing arrives
+      auto intervalDeadline = last.m_last + interMilli;
+      if (current)
+      {
+        TimerWheel::instance().sleepUntil(intervalDeadline);
+        return last.m_end;
+      }
+
+      uint64_t next = last.m_end;
+      obs.waitUntil(intervalDeadline, max(intervalDeadline, last.m_last + heartbeat));
+
+      {
+        std::lock_guard<std::mutex> lock(m_sequenceLock);
+
+        // Make sure the observer was signaled!
+        if (!obs.wasSignaled())
+        {
+          // If nothing came out during the last wait, we may have still have advanced
+          // the sequence number. We should reset the start to something closer to the
+          // current sequence. If we lock the sequence lock, we can check if the observer
+          // was signaled between the time the wait timed out and the mutex was locked.
+          // Otherwise, nothing has arrived and we set to the next sequence number to
+          // the next sequence number to be allocated and continue.
+          next = m_sequence;
+          timedOut = true;
+        }
         else
         {
-          // Check if we're falling too far behind. If we are, generate an
-          // MTConnectError and return.
-          if (start < getFirstSequence())
-          {
-            g_logger << LWARN << "Client fell too far behind, disconnecting";
-            throw ParameterError("OUT_OF_RANGE",
-                                 "Client can't keep up with event stream, disconnecting");
-          }
-          else
-          {
-            // end and endOfBuffer are set during the fetch sample data while the
-            // mutex is held. This removed the race to check if we are at the end of
-            // the bufffer and setting the next start to the last sequence number
-            // sent.
-            content =
-                fetchSampleData(printer, filterSet, start, count, end, endOfBuffer, &observer);
-          }
-
-          if (m_logStreamData)
-            log << content << endl;
+          // Get the sequence # signaled in the observer when the earliest event arrived.
+          // This will allow the next set of data to be pulled. Any later events will have
+          // greater sequence numbers, so this should not cause a problem. Also, signaled
+          // sequence numbers can only decrease, never increase. A group observer may
+          // have been signaled by events already sent, so never go back before the end.
+          next = max(obs.getSequence(), last.m_end);
         }
+      }
 
-        ostringstream str;
+      return next;
+    };
 
-        // Make sure we're terminated with a <cr><nl>
-        content.append("\r\n");
-        out.setf(ios::dec, ios::basefield);
-        str << "--" << boundary
-            << "\r\n"
-               "Content-type: "
-            << printer->mimeType()
-            << "\r\n"
-               "Content-length: "
-            << content.length() << "\r\n\r\n"
-            << content;
+    // Fetch the next set of data and frame it as a chunk.
+    auto fetchChunk = [&](ChangeObserver &obs, uint64_t from) -> StreamGroup::Chunk {
+      StreamGroup::Chunk chunk;
 
-        string chunk = str.str();
-        out.setf(ios::hex, ios::basefield);
-        out << chunk.length() << "\r\n";
-        out << chunk << "\r\n";
-        out.flush();
+      // Remember when we started this grab...
+      chunk.m_last = chrono::steady_clock::now();
 
-        // Wait for up to frequency ms for something to arrive... Don't wait if
-        // we are not at the end of the buffer. Just put the next set after aInterval
-        // has elapsed. Check also if in the intervening time between the last fetch
-        // and now. If so, we just spin through and wait the next interval.
+      // On a WebSocket the heartbeat is a ping instead of an empty document
+      if (webSocket && timedOut)
+      {
+        timedOut = false;
+        chunk.m_start = chunk.m_end = from;
+        chunk.m_heartbeat = true;
+        chunk.m_data = make_shared<string>(WebSocket::frame(WebSocket::PING, ""));
+        return chunk;
+      }
 
-        // Even if we are at the end of the buffer, or within range. If we are filtering,
-        // we will need to make sure we are not spinning when there are no valid events
-        // to be reported. we will waste cycles spinning on the end of the buffer when
-        // we should be in a heartbeat wait as well.
-        if (!endOfBuffer)
+      // Fetch sample data now resets the observer while holding the sequence
+      // mutex to make sure that a new event will be recorded in the observer
+      // when it returns.
+      string content;
+      chunk.m_start = from;
+      if (current)
+        content = fetchCurrentData(printer, filterSet, NO_START);
+      else
+      {
+        // Check if we're falling too far behind. If we are, generate an
+        // MTConnectError and return.
+        if (coalesce)
         {
-          // If we're not at the end of the buffer, move to the end of the previous set and
-          // begin filtering from where we left off.
-          start = end;
-
-          // For replaying of events, we will stream as fast as we can with a 1ms sleep
-          // to allow other threads to run.
-          this_thread::sleep_for(1ms);
+          // Catch up with the latest value of each data item after the client fell behind
+          coalesce = false;
+          size_t coalesced = 0;
+          content = fetchSampleData(printer, filterSet, from, count, 0, chunk.m_end,
+                                    chunk.m_endOfBuffer, &obs, &chunk.m_observations, &coalesced);
+          auto total = m_coalescedObservations += coalesced;
+          g_logger << LINFO << "Coalesced " << coalesced << " observations for a slow client ("
+                   << total << " observations coalesced)";
+        }
+        else if (from < getLowestSequence())
+        {
+          g_logger << LWARN << "Client fell too far behind, disconnecting";
+          throw ParameterError("OUT_OF_RANGE",
+                               "Client can't keep up with event stream, disconnecting");
         }
         else
         {
-          chrono::milliseconds delta;
+          // end and endOfBuffer are set during the fetch sample data while the
+          // mutex is held. This removed the race to check if we are at the end of
+          // the bufffer and setting the next start to the last sequence number
+          // sent.
+          content = fetchSampleData(printer, filterSet, from, count, 0, chunk.m_end,
+                                    chunk.m_endOfBuffer, &obs, &chunk.m_observations);
+        }
+
+        if (m_logStreamData)
+          log << content << endl;
+      }
+
+      chunk.m_data = make_shared<string>(frameDocument(content));
 
-          if (!current)
+      return chunk;
+    };
+
+    // The group fetches with its own observer. If the group falls behind the buffer,
+    // every member gets the error and the stream is closed.
+    auto groupWaiter = [&](const StreamGroup::Chunk &last) {
+      return waitForData(group->getObserver(), last);
+    };
+    auto groupFetcher = [&](uint64_t from) {
+      try
+      {
+        return fetchChunk(group->getObserver(), from);
+      }
+      catch (ParameterError &aError)
+      {
+        StreamGroup::Chunk chunk;
+        chunk.m_closed = true;
+        chunk.m_data =
+            make_shared<string>(frameDocument(printError(printer, aError.m_code, aError.m_message)));
+        return chunk;
+      }
+    };
+
+    // The position of this session in the stream
+    StreamGroup::Chunk position;
+    bool member = false;
+
+    try
+    {
+      // Loop until the user closes the connection
+      while (out.good() && (!webSocket || webSocket->isOpen()) && (!writer || writer->isOpen()))
+      {
+        // A WebSocket client can change the interval, heartbeat, and path without
+        // reconnecting. The change takes effect with the next document.
+        dlib::key_value_map request;
+        if (webSocket && webSocket->takeRequest(request))
+        {
+          try
           {
-            // Busy wait to make sure the signal was actually signaled. We have observed that
-            // a signal can occur in rare conditions where there are multiple threads listening
-            // on separate condition variables and this pops out too soon. This will make sure
-            // observer was actually signaled and instead of throwing an error will wait again
-            // for the remaining hartbeat interval.
-            delta = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - last);
-            while (delta < heartbeat && observer.wait((heartbeat - delta).count()) &&
-                   !observer.wasSignaled())
-            {
-              delta =
-                  chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - last);
-            }
+            updateStream(request, webSocket->getDevice(), filterSet, interval, heartbeat);
+          }
+          catch (ParameterError &aError)
+          {
+            write(frameDocument(printError(printer, aError.m_code, aError.m_message)));
+            continue;
+          }
+
+          interMilli = chrono::milliseconds{interval};
+          if (member)
+          {
+            group->leave();
+            member = false;
+          }
+          if (position.m_data)
+            start = position.m_end;
+          timedOut = false;
+
+          observer = make_unique<ChangeObserver>();
+          for (const auto &item : filterSet)
+            m_dataItemMap[item]->addObserver(observer.get());
+          group = getStreamGroup(
+              {printer, filterSet, interval, current, (int)count, heartbeat, true});
+        }
+
+        // After the queue was dropped, continue individually from where the policy says
+        if (resync)
+        {
+          resync = false;
+          timedOut = false;
+          if (member)
+          {
+            group->leave();
+            member = false;
+          }
 
+          if (m_slowConsumerPolicy == SKIP_TO_CURRENT)
+          {
             {
               std::lock_guard<std::mutex> lock(m_sequenceLock);
-
-              // Make sure the observer was signaled!
-              if (!observer.wasSignaled())
-              {
-                // If nothing came out during the last wait, we may have still have advanced
-                // the sequence number. We should reset the start to something closer to the
-                // current sequence. If we lock the sequence lock, we can check if the observer
-                // was signaled between the time the wait timed out and the mutex was locked.
-                // Otherwise, nothing has arrived and we set to the next sequence number to
-                // the next sequence number to be allocated and continue.
-                start = m_sequence;
-              }
-              else
-              {
-                // Get the sequence # signaled in the observer when the earliest event arrived.
-                // This will allow the next set of data to be pulled. Any later events will have
-                // greater sequence numbers, so this should not cause a problem. Also, signaled
-                // sequence numbers can only decrease, never increase.
-                start = observer.getSequence();
-              }
+              start = m_sequence;
             }
+            write(frameDocument(fetchCurrentData(printer, filterSet, NO_START)));
+          }
+          else
+          {
+            start = resyncFrom;
+            coalesce = true;
           }
+        }
 
-          // Now wait the remainder if we triggered before the timer was up.
-          delta = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - last);
-          if (delta < interMilli)
+        if (member)
+        {
+          auto chunk = group->next(position.m_generation, groupWaiter, groupFetcher);
+          if (!current && chunk.m_generation > position.m_generation + 1)
           {
-            // Sleep the remainder
-            this_thread::sleep_for(interMilli - delta);
+            // This session missed a chunk while writing to a slow client. Leave the
+            // group and continue individually from where the session left off.
+            g_logger << LDEBUG << "Client fell behind stream group, continuing individually";
+            group->leave();
+            member = false;
+            start = position.m_end;
+            continue;
           }
+
+          // If the last ping was never answered, the client is gone
+          if (webSocket && chunk.m_heartbeat && !webSocket->expectPong())
+            break;
+
+          position = chunk;
+          if (!deliver(chunk) || chunk.m_closed)
+            break;
+        }
+        else
+        {
+          position = fetchChunk(*observer, start);
+          if (webSocket && position.m_heartbeat && !webSocket->expectPong())
+            break;
+          if (!deliver(position))
+            break;
+          if (resync)
+            continue;
+
+          // Once this session has caught up, share the stream with any other sessions
+          // making the same request.
+          if (position.m_endOfBuffer && group->join(position))
+            member = true;
+          else
+            start = waitForData(*observer, position);
         }
       }
     }
@@ -1432,28 +2193,19 @@ namespace mtconnect
       g_logger << LINFO << "Caught a parameter error.";
       if (out.good())
       {
-        ostringstream str;
         string content = printError(printer, aError.m_code, aError.m_message);
-        str << "--" << boundary
-            << "\r\n"
-               "Content-type: "
-            << printer->mimeType()
-            << "\r\n"
-               "Content-length: "
-            << content.length() << "\r\n\r\n"
-            << content;
-
-        string chunk = str.str();
-        out.setf(ios::hex, ios::basefield);
-        out << chunk.length() << "\r\n";
-        out << chunk << "\r\n";
-        out.flush();
+        write(frameDocument(content));
       }
     }
     catch (...)
     {
       g_logger << LWARN << "Error occurred during streaming data";
-      if (out.good())
+      if (out.good() && webSocket)
+      {
+        write(frameDocument(
+            printError(printer, "INTERNAL_ERROR", "Unknown error occurred during streaming")));
+      }
+      else if (out.good())
       {
         ostringstream str;
         string content =
@@ -1468,119 +2220,341 @@ namespace mtconnect
             << content;
 
         string chunk = str.str();
-        out.setf(ios::hex, ios::basefield);
-        out << chunk.length() << "\r\n";
-        out << chunk;
-        out.flush();
+        ostringstream length;
+        length << hex << chunk.length() << "\r\n";
+        write(length.str() + chunk);
       }
     }
 
-    out.setstate(ios::badbit);
+    if (member)
+      group->leave();
+
+    // Give the client a chance to read what is queued unless it is being dropped
+    if (writer)
+      writer->close(slowConsumer ? chrono::milliseconds{0} : heartbeat);
+
+    // The WebSocket is closed by the caller
+    if (!webSocket)
+      out.setstate(ios::badbit);
     // Observer is auto removed from signalers
   }
 
+  void Agent::updateStream(const key_value_map &request, const string &device,
+                           std::set<string> &filter, unsigned int &interval,
+                           chrono::milliseconds &heartbeat)
+  {
+    auto freq =
+        checkAndGetParam(request, "interval", NO_FREQ, FASTEST_FREQ, false, SLOWEST_FREQ);
+    if (freq == NO_FREQ)
+      freq = checkAndGetParam(request, "frequency", NO_FREQ, FASTEST_FREQ, false, SLOWEST_FREQ);
+    auto beat = checkAndGetParam(request, "heartbeat", NO_HB, 10, true, 600000);
+
+    // Resolve the path first so nothing changes if it is invalid
+    if (request.count("path") > 0)
+    {
+      std::set<string> items;
+      auto path = devicesAndPath(request["path"], device);
+      try
+      {
+        m_xmlParser->getDataItems(items, path);
+      }
+      catch (exception &e)
+      {
+        throw ParameterError("INVALID_XPATH", e.what());
+      }
+
+      if (items.empty())
+        throw ParameterError("INVALID_XPATH",
+                             "The path could not be parsed. Invalid syntax: " + path);
+      filter.swap(items);
+    }
+
+    if (freq != NO_FREQ)
+      interval = freq;
+    if (beat != NO_HB)
+      heartbeat = chrono::milliseconds{beat};
+
+    g_logger << LDEBUG << "WebSocket stream changed: interval " << interval << ", heartbeat "
+             << heartbeat.count() << ", " << filter.size() << " data items";
+  }
+
   string Agent::fetchCurrentData(const Printer *printer, std::set<string> &filterSet, uint64_t at)
   {
-    ObservationPtrArray events;
+    // With epoch reclamation the observations are borrowed until the document is printed,
+    // otherwise references are held in owned.
+    EpochReclaimer::Guard guard(m_reclaimer.get());
+    ObservationList events;
+    ObservationPtrArray owned;
+    auto collect = [&](const Checkpoint &checkpoint, std::set<string> const *filter) {
+      if (m_reclaimer)
+        checkpoint.getObservations(events, filter);
+      else
+        checkpoint.getObservations(owned, filter);
+    };
+
     uint64_t firstSeq, seq;
     {
       std::lock_guard<std::mutex> lock(m_sequenceLock);
       firstSeq = getFirstSequence();
       seq = m_sequence;
       if (at == NO_START)
-        m_latest.getObservations(events, &filterSet);
+        collect(m_latest, &filterSet);
       else
       {
-        long pos = (long)m_slidingBuffer->get_element_id(at);
-        long first = (long)m_slidingBuffer->get_element_id(firstSeq);
-        long checkIndex = pos / m_checkpointFreq;
-        long closestCp = checkIndex * m_checkpointFreq;
-        unsigned long index;
+        // The checkpoint is taken at the last slot before the observation that is a
+        // multiple of the frequency. Sequences are used so it does not matter where the
+        // buffer wraps.
+        auto pos = m_slidingBuffer->getIndex(at);
+        uint64_t closest = at - pos % m_checkpointFreq;
+        uint64_t index;
 
         Checkpoint *ref(nullptr);
 
-        // Compute the closest checkpoint. If the checkpoint is after the
-        // first checkpoint and before the next incremental checkpoint,
-        // use first.
-        if (first > closestCp && pos >= first)
+        // If the checkpoint's observation is no longer in the buffer use first.
+        if (closest < firstSeq)
         {
           ref = &m_first;
           // The checkpoint is inclusive of the "first" event. So we add one
           // so we don't duplicate effort.
-          index = first + 1;
+          index = firstSeq + 1;
         }
         else
         {
-          index = closestCp + 1;
-          ref = &m_checkpoints[checkIndex];
+          index = closest + 1;
+          ref = &m_checkpoints[pos / m_checkpointFreq];
         }
 
         Checkpoint check(*ref, &filterSet);
 
         // Roll forward from the checkpoint.
-        for (; index <= (unsigned long)pos; index++)
-          check.addObservation(((*m_slidingBuffer)[(unsigned long)index]).getObject());
+        for (; index <= at; index++)
+          check.addObservation(((*m_slidingBuffer)[index]).getObject());
 
-        check.getObservations(events);
+        collect(check, nullptr);
       }
     }
 
+    if (!m_reclaimer)
+      events.assign(owned.begin(), owned.end());
+
     return printer->printSample(m_instanceId, m_slidingBufferSize, seq, firstSeq, m_sequence - 1,
                                 events);
   }
 
   string Agent::fetchSampleData(const Printer *printer, std::set<string> &filterSet, uint64_t start,
-                                int count, uint64_t &end, bool &endOfBuffer,
-                                ChangeObserver *observer)
+                                int count, uint64_t stop, uint64_t &end, bool &endOfBuffer,
+                                ChangeObserver *observer, size_t *observations, size_t *coalesced)
   {
-    ObservationPtrArray results;
-    uint64_t firstSeq;
+    // With epoch reclamation the observations, including the ones decoded from cold
+    // storage, are borrowed until the document is printed, otherwise references are held
+    // in owned.
+    EpochReclaimer::Guard guard(m_reclaimer.get());
+    ObservationList results;
+    ObservationPtrArray owned;
+    uint64_t firstSeq, lowestSeq;
+    int limit = count >= 0 ? count : -count;
+
+    // When coalescing, only the latest observation of each data item is kept up to
+    // the end of the buffer. Conditions keep the latest of each native code so no active
+    // condition is lost, a condition without a code clears all of them and replaces them.
+    using CoalesceKey = std::pair<const DataItem *, std::string>;
+    std::map<CoalesceKey, unsigned long> latest;
+    if (coalesced)
+    {
+      limit = INT_MAX;
+      *coalesced = 0;
+    }
+
+    // Add an observation, returns false once the limit is reached
+    auto add = [&](ObservationPtr &event) {
+      if (coalesced)
+      {
+        auto dataItem = event->getDataItem();
+        if (dataItem->isCondition() && event->getCode().empty())
+        {
+          // Removed entries are left empty and dropped before printing
+          auto item = latest.lower_bound({dataItem, string()});
+          while (item != latest.end() && item->first.first == dataItem)
+          {
+            results[item->second] = nullptr;
+            if (!m_reclaimer)
+              owned[item->second] = nullptr;
+            (*coalesced)++;
+            item = latest.erase(item);
+          }
+        }
+        else
+        {
+          auto item = latest.find({dataItem, event->getCode()});
+          if (item != latest.end())
+          {
+            results[item->second] = event;
+            if (!m_reclaimer)
+              owned[item->second] = event;
+            (*coalesced)++;
+            return results.size() < (unsigned long)limit;
+          }
+        }
+        latest[{dataItem, event->getCode()}] = results.size();
+      }
+      results.push_back(event);
+      if (!m_reclaimer)
+        owned.push_back(event);
+      return results.size() < (unsigned long)limit;
+    };
+
+    // Going forward, the observations evicted from the buffer are read from cold
+    // storage first without holding the lock
+    if (m_coldStore && count >= 0 && start != NO_START)
+    {
+      uint64_t bound;
+      {
+        std::lock_guard<std::mutex> lock(m_sequenceLock);
+        bound = stop ? min(stop, getFirstSequence()) : getFirstSequence();
+      }
+      if (start < bound)
+        start = m_coldStore->fetch(start, bound, true, filterSet, add);
+    }
+
+    uint64_t i;
     {
       std::lock_guard<std::mutex> lock(m_sequenceLock);
 
-      firstSeq = (m_sequence > m_slidingBufferSize) ? m_sequence - m_slidingBufferSize : 1;
-      int limit;
+      firstSeq = getFirstSequence();
+      lowestSeq = getLowestSequence();
+
+      // Observations evicted since cold storage was read are still in cold storage
+      if (m_coldStore && count >= 0 && start != NO_START && start < firstSeq &&
+          results.size() < (unsigned long)limit)
+      {
+        auto bound = stop ? min(stop, firstSeq) : firstSeq;
+        if (start < bound)
+          start = m_coldStore->fetch(start, bound, true, filterSet, add);
+      }
 
       // START SHOULD BE BETWEEN 0 AND SEQUENCE NUMBER
       if (count >= 0)
-      {
         start = (start == NO_START || start <= firstSeq) ? firstSeq : start;
-        limit = count;
-      }
       else
-      {
         start = (start == NO_START || start >= m_sequence) ? m_sequence - 1 : start;
-        limit = -count;
-      }
 
-      uint64_t i;
-      for (i = start; results.size() < limit && i < m_sequence && i >= firstSeq;
-           count >= 0 ? i++ : i--)
+      // The sequences the request may visit, a stop sequence excludes everything from
+      // it onward going forward and everything up to it going backward
+      uint64_t lower = firstSeq, upper = m_sequence;
+      if (stop && count >= 0)
+        upper = min(stop, m_sequence);
+      else if (stop)
+        lower = max(stop + 1, firstSeq);
+
+      // Add the observation at a sequence in the buffer
+      auto visit = [&](uint64_t seq) { return add((*m_slidingBuffer)[seq]); };
+
+      std::vector<const SequenceIndex::Postings *> postings;
+      if (results.size() >= (unsigned long)limit)
+      {
+        // Cold storage filled the request
+        i = start;
+      }
+      else if (useSequenceIndex(filterSet, start, count >= 0, limit, firstSeq, postings))
+      {
+        // Merge the postings of the filtered data items, stopping where the scan
+        // below would have stopped.
+        uint64_t last = 0;
+        bool full = false;
+        SequenceIndex::merge(postings, start, count >= 0, [&](uint64_t seq) {
+          if (seq < lower || seq >= upper)
+            return false;
+          last = seq;
+          full = !visit(seq);
+          return !full;
+        });
+
+        if (full)
+          i = count >= 0 ? last + 1 : last - 1;
+        else if (count >= 0)
+          i = max(start, upper);
+        else
+          i = start >= lower ? lower - 1 : start;
+      }
+      else
       {
-        // Filter out according to if it exists in the list
-        const string &dataId = (*m_slidingBuffer)[i]->getDataItem()->getId();
-        if (filterSet.count(dataId) > 0)
+        for (i = start; results.size() < limit && i < upper && i >= lower;
+             count >= 0 ? i++ : i--)
         {
-          ObservationPtr event = (*m_slidingBuffer)[i];
-          results.push_back(event);
+          // Filter out according to if it exists in the list
+          const string &dataId = (*m_slidingBuffer)[i]->getDataItem()->getId();
+          if (filterSet.count(dataId) > 0)
+            visit(i);
         }
       }
 
-      end = i;
-
       if (count >= 0)
         endOfBuffer = i >= m_sequence;
-      else
-        endOfBuffer = i <= firstSeq;
 
       if (observer)
         observer->reset();
     }
 
-    return printer->printSample(m_instanceId, m_slidingBufferSize, end, firstSeq, m_sequence - 1,
+    // Going backward, continue into cold storage past the start of the buffer
+    if (count < 0)
+    {
+      auto bound = stop ? stop + 1 : 1;
+      if (m_coldStore && results.size() < (unsigned long)limit && i < firstSeq && i >= bound)
+        i = m_coldStore->fetch(i, bound, false, filterSet, add);
+      endOfBuffer = i <= lowestSeq;
+    }
+
+    end = i;
+
+    if (coalesced && *coalesced > 0)
+      results.erase(std::remove(results.begin(), results.end(), nullptr), results.end());
+
+    if (observations)
+      *observations = results.size();
+
+    return printer->printSample(m_instanceId, m_slidingBufferSize, end, lowestSeq, m_sequence - 1,
                                 results);
   }
 
+  bool Agent::useSequenceIndex(const std::set<string> &filterSet, uint64_t start, bool forward,
+                               int limit, uint64_t firstSeq,
+                               std::vector<const SequenceIndex::Postings *> &postings)
+  {
+    // Slots between the start and the end of the buffer in the direction of the request
+    uint64_t range;
+    if (forward)
+      range = start < m_sequence ? m_sequence - start : 0;
+    else
+      range = start >= firstSeq ? start - firstSeq + 1 : 0;
+
+    // Merging costs at least one lookup per data item
+    if (range == 0 || filterSet.size() >= range)
+      return false;
+
+    size_t total = 0;
+    for (const auto &id : filterSet)
+    {
+      auto item = m_dataItemMap.find(id);
+      if (item == m_dataItemMap.end())
+        continue;
+
+      auto list = m_sequenceIndex.postings(item->second);
+      if (list)
+      {
+        postings.push_back(list);
+        total += list->size();
+      }
+    }
+
+    // Estimate the slots the scan visits to find limit matches, assuming the matches
+    // are spread evenly over the buffer, and compare it to the cost of the merge.
+    double available = double(m_sequence - firstSeq);
+    double scan = total > 0 ? min(double(range), double(limit) * available / total) : range;
+    double merge = postings.size() * log2(available + 2.0) + min(double(limit), double(total));
+
+    return merge < scan;
+  }
+
   string Agent::printError(const Printer *printer, const string &errorCode, const string &text)
   {
     g_logger << LDEBUG << "Returning error " << errorCode << ": " << text;
@@ -1684,6 +2658,22 @@ namespace mtconnect
     return value;
   }
 
+  uint64_t Agent::checkAndGetTime(const key_value_map &queries, const string &param)
+  {
+    if (!queries.count(param))
+      return 0;
+
+    if (queries[param].empty())
+      throw ParameterError("QUERY_ERROR", "'" + param + "' cannot be empty.");
+
+    auto time = parseTimeMicro(queries[param]);
+    if (time == 0)
+      throw ParameterError("OUT_OF_RANGE",
+                           "'" + param + "' must be a timestamp, e.g. 2020-01-01T00:00:00Z.");
+
+    return time;
+  }
+
   DataItem *Agent::getDataItemByName(const string &deviceName, const string &dataItemName)
   {
     auto dev = getDeviceByName(deviceName);
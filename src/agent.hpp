@@ -19,15 +19,27 @@
 
 #include "adapter.hpp"
 #include "asset.hpp"
+#include "asset_log.hpp"
+#include "asset_store.hpp"
 #include "checkpoint.hpp"
+#include "cold_store.hpp"
+#include "epoch_reclaimer.hpp"
+#include "journal.hpp"
+#include "ring_buffer.hpp"
+#include "sequence_index.hpp"
 #include "service.hpp"
+#include "stream_group.hpp"
+#include "stream_writer.hpp"
+#include "time_index.hpp"
+#include "web_socket.hpp"
 #include "xml_parser.hpp"
 
 #include <dlib/md5.h>
 #include <dlib/server.h>
-#include <dlib/sliding_buffer.h>
 
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <list>
 #include <map>
 #include <memory>
@@ -43,6 +55,7 @@ namespace mtconnect
   class Observation;
   class DataItem;
   class Device;
+  class XmlPrinter;
 
   using AssetChangeList = std::vector<std::pair<std::string, std::string>>;
 
@@ -51,6 +64,10 @@ namespace mtconnect
     OutgoingThings() = default;
     std::ostream *m_out = nullptr;
     const Printer *m_printer = nullptr;
+
+    // Input from the client and a way to shut down the connection, used by WebSockets
+    std::istream *m_in = nullptr;
+    std::function<void()> m_shutdown;
   };
   using IncomingThings = struct dlib::incoming_things;
 
@@ -87,6 +104,9 @@ namespace mtconnect
     // Default count for sample query
     static const unsigned int DEFAULT_COUNT = 100;
 
+    // Largest sliding buffer allowed
+    static const int MAX_BUFFER_SIZE = 1 << 30;
+
     // Code to return when a parameter has no value
     static const int NO_VALUE32 = -1;
     static const uint64_t NO_VALUE64 = UINT64_MAX;
@@ -141,6 +161,64 @@ namespace mtconnect
     // Add component events to the sliding buffer
     unsigned int addToBuffer(DataItem *dataItem, const std::string &value, std::string time = "");
 
+    // Journal the observations in the directory and rebuild the sliding buffer from an
+    // existing journal, keeping the instance id and the sequence numbers. A cold store in
+    // coldStorage is opened with the restored instance id before the journal is replayed
+    // so the observations evicted while restoring continue the previous cold segments.
+    void openJournal(const std::string &directory, size_t segmentSize = 64 * 1024 * 1024,
+                     std::chrono::milliseconds syncInterval = std::chrono::milliseconds{100},
+                     const std::string &coldStorage = "", uint64_t coldStorageBudget = 0);
+    Journal *getJournal() const
+    {
+      return m_journal.get();
+    }
+
+    // Keep the observations evicted from the sliding buffer in compressed segments in the
+    // directory, using at most budget bytes of disk
+    void openColdStore(const std::string &directory, uint64_t budget);
+    ColdStore *getColdStore() const
+    {
+      return m_coldStore.get();
+    }
+
+    // Keep the assets in a change log and snapshots in the directory and restore the
+    // assets from them. No observations are generated for the restored assets.
+    void openAssetLog(const std::string &directory);
+    AssetLog *getAssetLog() const
+    {
+      return m_assetLog.get();
+    }
+
+    // Readers borrow the observations instead of taking references. An observation whose
+    // last reference is dropped is deleted once the requests that could see it finish.
+    void enableEpochReclamation();
+    EpochReclaimer *getReclaimer() const
+    {
+      return m_reclaimer.get();
+    }
+
+    // Limit the memory used by the observations in the sliding buffer to bytes, 0 only
+    // limits the number of observations. The oldest are evicted when the limit is exceeded
+    // and the first sequence moves forward.
+    void setBufferMemoryLimit(uint64_t bytes);
+    uint64_t getBufferMemoryLimit() const
+    {
+      return m_bufferMemoryLimit;
+    }
+
+    // The approximate memory used by the observations in the buffer, in total and by
+    // the type of their data item
+    uint64_t getBufferBytes() const
+    {
+      return m_bufferBytes;
+    }
+    std::map<std::string, uint64_t> getBufferBytesByType();
+
+    // Change the number of observations in the sliding buffer while the agent is running.
+    // The newest observations are kept, sequence numbers do not change, and the
+    // checkpoints are rebuilt. Any size is allowed.
+    void resizeBuffer(unsigned int size);
+
     // Asset management
     bool addAsset(Device *device, const std::string &id, const std::string &asset,
                   const std::string &type, const std::string &time = "");
@@ -161,6 +239,10 @@ namespace mtconnect
     {
       return (*m_slidingBuffer)[seq];
     }
+    uint64_t getInstanceId() const
+    {
+      return m_instanceId;
+    }
     uint64_t getSequence() const
     {
       return m_sequence;
@@ -175,23 +257,33 @@ namespace mtconnect
     }
     unsigned int getAssetCount() const
     {
-      return m_assets.size();
+      return m_assetStore->size();
     }
 
     int getAssetCount(const std::string &type) const
     {
-      const auto assetPos = m_assetCounts.find(type);
-      if (assetPos != m_assetCounts.end())
-        return assetPos->second;
-      return 0;
+      return m_assetStore->getCount(type);
     }
 
     uint64_t getFirstSequence() const
     {
-      if (m_sequence > m_slidingBufferSize)
+      if (m_sequence > m_slidingBufferSize + m_firstSequence - 1)
         return m_sequence - m_slidingBufferSize;
       else
-        return 1;
+        return m_firstSequence;
+    }
+
+    // The first sequence in the buffer or in cold storage
+    uint64_t getLowestSequence() const
+    {
+      auto first = getFirstSequence();
+      if (m_coldStore)
+      {
+        auto cold = m_coldStore->getFirstSequence();
+        if (cold && cold < first)
+          return cold;
+      }
+      return first;
     }
 
     // For testing...
@@ -199,9 +291,9 @@ namespace mtconnect
     {
       m_sequence = seq;
     }
-    std::list<AssetPtr *> *getAssets()
+    AssetStore *getAssetStore()
     {
-      return &m_assets;
+      return m_assetStore.get();
     }
 
     // Starting
@@ -240,6 +332,36 @@ namespace mtconnect
       m_logStreamData = log;
     }
 
+    // Limit the bytes queued for a streaming client and what to do when a client
+    // exceeds it. A limit of 0 writes directly to the client.
+    void setSlowConsumerPolicy(size_t maxQueuedBytes, SlowConsumerPolicy policy)
+    {
+      m_maxQueuedBytes = maxQueuedBytes;
+      m_slowConsumerPolicy = policy;
+    }
+    size_t getMaxQueuedBytes() const
+    {
+      return m_maxQueuedBytes;
+    }
+    SlowConsumerPolicy getSlowConsumerPolicy() const
+    {
+      return m_slowConsumerPolicy;
+    }
+
+    // Slow consumer metrics
+    uint64_t getDroppedObservations() const
+    {
+      return m_droppedObservations;
+    }
+    uint64_t getCoalescedObservations() const
+    {
+      return m_coalescedObservations;
+    }
+    uint64_t getSlowConsumerDisconnects() const
+    {
+      return m_slowConsumerDisconnects;
+    }
+
     // Handle probe calls
     std::string handleProbe(const Printer *printer, const std::string &device);
 
@@ -257,19 +379,29 @@ namespace mtconnect
     // HTTP methods to handle the 3 basic calls
     std::string handleCall(const Printer *printer, std::ostream &out, const std::string &path,
                            const dlib::key_value_map &queries, const std::string &call,
-                           const std::string &device);
+                           const std::string &device, WebSocket *webSocket = nullptr,
+                           const std::function<void()> &shutdown = nullptr);
+
+    // Upgrade a sample or current request to a WebSocket stream
+    std::string handleWebSocket(const Printer *printer, const IncomingThings &incoming,
+                                OutgoingThings &outgoing, const std::string &path,
+                                const std::string &call, const std::string &device);
 
     // HTTP methods to handle the 3 basic calls
     std::string handlePut(const Printer *printer, std::ostream &out, const std::string &path,
                           const dlib::key_value_map &queries, const std::string &call,
                           const std::string &device);
 
+    // Admin request to resize the sliding buffer
+    std::string handleBuffer(const Printer *printer, const dlib::key_value_map &queries);
+
     // Handle stream calls, which includes both current and sample
     std::string handleStream(const Printer *printer, std::ostream &out, const std::string &path,
                              bool current, unsigned int frequency, uint64_t start = 0,
                              int count = 0,
-                             std::chrono::milliseconds heartbeat = std::chrono::milliseconds{
-                                 10000});
+                             std::chrono::milliseconds heartbeat = std::chrono::milliseconds{10000},
+                             WebSocket *webSocket = nullptr,
+                             const std::function<void()> &shutdown = nullptr, uint64_t stop = 0);
 
     // Asset related methods
     std::string handleAssets(const Printer *printer, std::ostream &out,
@@ -279,18 +411,62 @@ namespace mtconnect
                            const std::string &command, const std::string &asset,
                            const std::string &body);
 
+    // Add a parsed asset to the store and the secondary keys, called with the asset lock
+    void insertAsset(const AssetPtr &asset);
+
+    // Record a new version or the removal of an asset in the asset log and compact the
+    // log when it grows larger than the snapshot, called with the asset lock
+    void logAsset(AssetPtr &asset);
+    void logAssetRemoved(const std::string &id, const std::string &time);
+    void compactAssetLog();
+    XmlPrinter *assetPrinter();
+
     // Stream the data to the user
     void streamData(const Printer *printer, std::ostream &out, std::set<std::string> &filterSet,
                     bool current, unsigned int frequency, uint64_t start = 1,
                     unsigned int count = 0,
-                    std::chrono::milliseconds heartbeat = std::chrono::milliseconds{10000});
+                    std::chrono::milliseconds heartbeat = std::chrono::milliseconds{10000},
+                    WebSocket *webSocket = nullptr, const std::function<void()> &shutdown = nullptr);
+
+    // Change the interval, heartbeat or path of a stream at the request of a WebSocket client
+    void updateStream(const dlib::key_value_map &request, const std::string &device,
+                      std::set<std::string> &filter, unsigned int &interval,
+                      std::chrono::milliseconds &heartbeat);
+
+    // Find or create the group shared by streams with the same request
+    std::shared_ptr<StreamGroup> getStreamGroup(const StreamGroup::Key &key);
 
     // Fetch the current/sample data and return the XML in a std::string
     std::string fetchCurrentData(const Printer *printer, std::set<std::string> &filterSet,
                                  uint64_t at);
     std::string fetchSampleData(const Printer *printer, std::set<std::string> &filterSet,
-                                uint64_t start, int count, uint64_t &end, bool &endOfBuffer,
-                                ChangeObserver *observer = nullptr);
+                                uint64_t start, int count, uint64_t stop, uint64_t &end,
+                                bool &endOfBuffer,
+                                ChangeObserver *observer = nullptr, size_t *observations = nullptr,
+                                size_t *coalesced = nullptr);
+
+    // Put an observation in the sliding buffer and update the indexes and checkpoints.
+    // Must be called with the sequence lock held after the sequence is advanced.
+    void storeObservation(Observation *event, uint64_t received);
+
+    // Remove an observation leaving the buffer from the indexes and its memory from the
+    // totals, and keep it in cold storage
+    void evictObservation(const ObservationPtr &event);
+
+    // Evict the oldest observations while the buffer uses more than the memory limit
+    void enforceMemoryLimit();
+
+    // Open the cold store for an instance, must be called with the sequence lock held
+    void createColdStore(const std::string &directory, uint64_t instanceId, uint64_t budget);
+
+    // If an observation adds to the state of the data item instead of replacing it
+    bool accumulates(const DataItem *dataItem, const std::string &value) const;
+
+    // Decide if a sample request should merge the postings of the filtered data items
+    // instead of scanning the buffer. Must be called with the sequence lock held.
+    bool useSequenceIndex(const std::set<std::string> &filterSet, uint64_t start, bool forward,
+                          int limit, uint64_t firstSeq,
+                          std::vector<const SequenceIndex::Postings *> &postings);
 
     // Output an XML Error
     std::string printError(const Printer *printer, const std::string &errorCode,
@@ -318,6 +494,9 @@ namespace mtconnect
                                 const uint64_t defaultValue, const uint64_t minValue = NO_VALUE64,
                                 bool minError = false, const uint64_t maxValue = NO_VALUE64);
 
+    // Perform a check on a timestamp parameter and return it in microseconds, 0 if absent
+    uint64_t checkAndGetTime(const dlib::key_value_map &queries, const std::string &param);
+
     // Find data items by name/id
     DataItem *getDataItemById(const std::string &id) const
     {
@@ -345,17 +524,44 @@ namespace mtconnect
     uint64_t m_sequence;
 
     // The sliding/circular buffer to hold all of the events/sample data
-    std::unique_ptr<dlib::sliding_buffer_kernel_1<ObservationPtr>> m_slidingBuffer;
+    std::unique_ptr<RingBuffer<ObservationPtr>> m_slidingBuffer;
     unsigned int m_slidingBufferSize;
 
-    // Asset storage, circ buffer stores ids
-    std::list<AssetPtr *> m_assets;
-    AssetIndex m_assetMap;
+    // The lowest sequence in the buffer until it wraps, after it is restored from a
+    // journal that does not fill it
+    uint64_t m_firstSequence = 1;
+
+    // The approximate memory used by the observations in the buffer, in total and by data
+    // item type. When there is a limit the oldest observations are evicted to stay below it.
+    uint64_t m_bufferMemoryLimit = 0;
+    uint64_t m_bufferBytes = 0;
+    std::map<std::string, uint64_t> m_bufferBytesByType;
+
+    // Write-ahead journal of the observations
+    std::unique_ptr<Journal> m_journal;
+
+    // The observations evicted from the sliding buffer
+    std::unique_ptr<ColdStore> m_coldStore;
+
+    // Defers deleting observations while requests borrow them
+    std::unique_ptr<EpochReclaimer> m_reclaimer;
+
+    // Sequence numbers of each data item in the sliding buffer
+    SequenceIndex m_sequenceIndex;
+
+    // When the observations in the sliding buffer were added
+    TimeIndex m_timeIndex;
+
+    // Asset storage by id in least recently used order
+    std::unique_ptr<AssetStore> m_assetStore;
 
     // Natural key indices for assets
     std::map<std::string, AssetIndex> m_assetIndices;
     unsigned int m_maxAssets;
 
+    // Change log and snapshots of the assets
+    std::unique_ptr<AssetLog> m_assetLog;
+
     // Checkpoints
     Checkpoint m_latest;
     Checkpoint m_first;
@@ -370,7 +576,6 @@ namespace mtconnect
     std::map<std::string, Device *> m_deviceNameMap;
     std::map<std::string, Device *> m_deviceUuidMap;
     std::map<std::string, DataItem *> m_dataItemMap;
-    std::map<std::string, int> m_assetCounts;
 
     struct CachedFile : public RefCounted
     {
@@ -420,6 +625,10 @@ namespace mtconnect
       }
     };
 
+    // Streaming sessions with identical requests share a group
+    std::mutex m_streamGroupLock;
+    std::map<StreamGroup::Key, std::weak_ptr<StreamGroup>> m_streamGroups;
+
     // For file handling, small files will be cached
     std::map<std::string, std::string> m_fileMap;
     std::map<std::string, RefCountedPtr<CachedFile>> m_fileCache;
@@ -432,5 +641,12 @@ namespace mtconnect
     // For debugging
     bool m_logStreamData;
     bool m_pretty;
+
+    // Slow consumers
+    size_t m_maxQueuedBytes = 0;
+    SlowConsumerPolicy m_slowConsumerPolicy = DISCONNECT;
+    std::atomic<uint64_t> m_droppedObservations{0};
+    std::atomic<uint64_t> m_coalescedObservations{0};
+    std::atomic<uint64_t> m_slowConsumerDisconnects{0};
   };
 }  // namespace mtconnect
@@ -47,4 +47,14 @@ namespace mtconnect
     else
       m_identity[key] = value;
   }
+
+  std::shared_ptr<const std::string> Asset::getFragment(const Printer *printer)
+  {
+    std::lock_guard<std::recursive_mutex> lock(m_fragmentLock);
+    auto &fragment = m_fragments[printer];
+    if (!fragment)
+      fragment = std::make_shared<const std::string>(printer->printAssetFragment(this));
+
+    return fragment;
+  }
 }  // namespace mtconnect
@@ -22,6 +22,8 @@
 #include "ref_counted.hpp"
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 
 namespace mtconnect
@@ -48,6 +50,11 @@ namespace mtconnect
     AssetKeys m_keys;
     AssetKeys m_identity;
 
+    // The asset as each printer printed it. The lock is held while the asset is printed
+    // and while it changes, changing it drops what was printed so the lock is recursive.
+    std::recursive_mutex m_fragmentLock;
+    std::map<const Printer *, std::shared_ptr<const std::string>> m_fragments;
+
    public:
     Asset(const Asset &another) : RefCounted(another)
     {
@@ -111,30 +118,48 @@ namespace mtconnect
     void setAssetId(const std::string &id)
     {
       m_assetId = id;
+      changed();
     }
     void setDeviceUuid(const std::string &uuid)
     {
       m_deviceUuid = uuid;
+      changed();
     }
     void setTimestamp(const std::string &timestamp)
     {
       m_timestamp = timestamp;
+      changed();
     }
     void setRemoved(bool removed)
     {
       m_removed = removed;
+      changed();
     }
     void setDescription(const std::string &desc)
     {
       m_description = desc;
+      changed();
     }
     void setArchetype(const XmlAttributes &arch)
     {
       m_archetype = arch;
+      changed();
+    }
+
+    // The asset as the printer prints it in an assets document. It is printed once by
+    // each printer and kept until the asset changes.
+    std::shared_ptr<const std::string> getFragment(const Printer *printer);
+
+    // Hold to print or change the asset outside of getFragment
+    std::recursive_mutex &getFragmentLock()
+    {
+      return m_fragmentLock;
     }
 
     virtual void changed()
     {
+      std::lock_guard<std::recursive_mutex> lock(m_fragmentLock);
+      m_fragments.clear();
     }
     virtual void addIdentity(const std::string &key, const std::string &value);
   };
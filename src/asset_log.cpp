@@ -0,0 +1,368 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#include "asset_log.hpp"
+
+#include <dlib/dir_nav.h>
+#include <dlib/logger.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+#ifdef _WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace mtconnect
+{
+  static dlib::logger g_logger("asset.log");
+
+  // Snapshot: magic and the number of records. Log: magic. Both are followed by records
+  // of the payload size and checksum, and the payload of the kind, the removed flag and
+  // the lengths and bytes of the id, type, device uuid, timestamp and content.
+  static const char g_snapshotMagic[8] = {'M', 'T', 'C', 'A', 'S', 'N', 'P', '1'};
+  static const char g_logMagic[8] = {'M', 'T', 'C', 'A', 'L', 'O', 'G', '1'};
+
+  static uint32_t checksum(const char *data, size_t len)
+  {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+      hash ^= (unsigned char)data[i];
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  template <typename T>
+  static inline void put(string &buffer, T value)
+  {
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  static inline void putString(string &buffer, const string &value)
+  {
+    put(buffer, uint32_t(value.size()));
+    buffer.append(value);
+  }
+
+  template <typename T>
+  static inline bool get(const char *&pos, const char *end, T &value)
+  {
+    if (size_t(end - pos) < sizeof(T))
+      return false;
+    memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
+
+  static inline bool getString(const char *&pos, const char *end, string &value)
+  {
+    uint32_t size;
+    if (!get(pos, end, size) || size_t(end - pos) < size)
+      return false;
+    value.assign(pos, size);
+    pos += size;
+    return true;
+  }
+
+  static void encode(string &buffer, const AssetLog::Record &record)
+  {
+    string payload;
+    put(payload, uint8_t(record.m_kind));
+    put(payload, uint8_t(record.m_removed));
+    putString(payload, record.m_assetId);
+    putString(payload, record.m_type);
+    putString(payload, record.m_deviceUuid);
+    putString(payload, record.m_timestamp);
+    putString(payload, record.m_content);
+
+    put(buffer, uint32_t(payload.size()));
+    put(buffer, checksum(payload.data(), payload.size()));
+    buffer.append(payload);
+  }
+
+  // Decode the record at pos, returns false if it is incomplete or corrupt
+  static bool decode(const char *&pos, const char *end, AssetLog::Record &record)
+  {
+    uint32_t size, sum;
+    const char *start = pos;
+    if (!get(start, end, size) || !get(start, end, sum) || size_t(end - start) < size ||
+        checksum(start, size) != sum)
+      return false;
+
+    const char *payloadEnd = start + size;
+    uint8_t kind, removed;
+    if (!get(start, payloadEnd, kind) || !get(start, payloadEnd, removed) ||
+        (kind != AssetLog::PUT && kind != AssetLog::REMOVE) ||
+        !getString(start, payloadEnd, record.m_assetId) ||
+        !getString(start, payloadEnd, record.m_type) ||
+        !getString(start, payloadEnd, record.m_deviceUuid) ||
+        !getString(start, payloadEnd, record.m_timestamp) ||
+        !getString(start, payloadEnd, record.m_content))
+      return false;
+
+    record.m_kind = AssetLog::Kind(kind);
+    record.m_removed = removed != 0;
+    pos = payloadEnd;
+    return true;
+  }
+
+  static bool readFile(const string &path, string &data)
+  {
+    ifstream in(path, ios::binary);
+    if (!in)
+      return false;
+    data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    return true;
+  }
+
+  static bool syncFile(FILE *file)
+  {
+    if (fflush(file) != 0)
+      return false;
+#ifdef _WINDOWS
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+  }
+
+  AssetLog::AssetLog(string directory, uint64_t minimumLogSize)
+    : m_directory(move(directory)), m_minimumLogSize(minimumLogSize)
+  {
+  }
+
+  AssetLog::~AssetLog()
+  {
+    if (m_log)
+    {
+      syncFile(m_log);
+      fclose(m_log);
+    }
+  }
+
+  string AssetLog::path(uint64_t generation, const char *suffix) const
+  {
+    char name[64];
+    snprintf(name, sizeof(name), "/assets-%020llu%s", (unsigned long long)generation, suffix);
+    return m_directory + name;
+  }
+
+  size_t AssetLog::recover(const Visitor &visitor)
+  {
+    try
+    {
+      dlib::create_directory(m_directory);
+    }
+    catch (exception &e)
+    {
+      g_logger << dlib::LERROR << "Cannot create asset directory " << m_directory << ": "
+               << e.what();
+    }
+
+    // The snapshot generations, newest first
+    vector<uint64_t> generations;
+    try
+    {
+      vector<dlib::file> files;
+      dlib::directory(m_directory).get_files(files);
+      static const string prefix("assets-"), suffix(".snap");
+      for (const auto &file : files)
+      {
+        const auto name = file.name();
+        if (name.size() > prefix.size() + suffix.size() &&
+            name.compare(0, prefix.size(), prefix) == 0 &&
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+          generations.push_back(strtoull(name.c_str() + prefix.size(), nullptr, 10));
+      }
+    }
+    catch (dlib::directory::dir_not_found &)
+    {
+    }
+    sort(generations.rbegin(), generations.rend());
+
+    // Use the newest snapshot that is complete
+    m_generation = 0;
+    m_snapshotSize = 0;
+    string data;
+    vector<Record> records;
+    for (auto generation : generations)
+    {
+      records.clear();
+      uint64_t count = 0;
+      const char *pos = nullptr, *end = nullptr;
+      if (readFile(path(generation, ".snap"), data) &&
+          data.size() >= sizeof(g_snapshotMagic) + sizeof(count) &&
+          memcmp(data.data(), g_snapshotMagic, sizeof(g_snapshotMagic)) == 0)
+      {
+        pos = data.data() + sizeof(g_snapshotMagic);
+        end = data.data() + data.size();
+        get(pos, end, count);
+        Record record;
+        while (records.size() < count && decode(pos, end, record))
+          records.push_back(record);
+      }
+
+      if (pos && records.size() == count && pos == end)
+      {
+        m_generation = generation;
+        m_snapshotSize = data.size();
+        break;
+      }
+
+      g_logger << dlib::LWARN << "Skipping invalid asset snapshot " << path(generation, ".snap");
+      records.clear();
+    }
+
+    for (const auto &record : records)
+      visitor(record);
+
+    // Replay the log up to the first record that is not complete and drop the rest
+    size_t count = 0;
+    bool valid = readFile(path(m_generation, ".log"), data) &&
+                 data.size() >= sizeof(g_logMagic) &&
+                 memcmp(data.data(), g_logMagic, sizeof(g_logMagic)) == 0;
+    if (valid)
+    {
+      const char *pos = data.data() + sizeof(g_logMagic), *end = data.data() + data.size();
+      Record record;
+      while (pos < end && decode(pos, end, record))
+      {
+        visitor(record);
+        count++;
+      }
+
+      if (pos < end)
+      {
+        g_logger << dlib::LWARN << "Dropping " << (end - pos) << " bytes at the end of "
+                 << path(m_generation, ".log");
+        data.resize(pos - data.data());
+      }
+    }
+
+    // Rewrite the valid part of the log so appends follow it
+    if (openLog(true) && valid && data.size() > sizeof(g_logMagic))
+    {
+      fwrite(data.data() + sizeof(g_logMagic), 1, data.size() - sizeof(g_logMagic), m_log);
+      syncFile(m_log);
+      m_logSize = data.size();
+    }
+
+    removeOtherGenerations();
+    return count;
+  }
+
+  bool AssetLog::openLog(bool truncate)
+  {
+    if (m_log)
+      fclose(m_log);
+
+    auto name = path(m_generation, ".log");
+    m_log = fopen(name.c_str(), truncate ? "wb" : "ab");
+    if (!m_log)
+    {
+      g_logger << dlib::LERROR << "Cannot open asset log " << name;
+      return false;
+    }
+
+    m_logSize = sizeof(g_logMagic);
+    if (fwrite(g_logMagic, 1, sizeof(g_logMagic), m_log) != sizeof(g_logMagic) ||
+        !syncFile(m_log))
+    {
+      g_logger << dlib::LERROR << "Cannot write asset log " << name;
+      return false;
+    }
+    return true;
+  }
+
+  void AssetLog::append(const Record &record)
+  {
+    if (!m_log)
+      return;
+
+    string buffer;
+    encode(buffer, record);
+    if (fwrite(buffer.data(), 1, buffer.size(), m_log) != buffer.size() || fflush(m_log) != 0)
+      g_logger << dlib::LERROR << "Cannot append to asset log " << path(m_generation, ".log");
+    m_logSize += buffer.size();
+  }
+
+  bool AssetLog::compact(const vector<Record> &records)
+  {
+    auto generation = m_generation + 1;
+    auto name = path(generation, ".snap");
+    auto temp = name + ".tmp";
+
+    string buffer(g_snapshotMagic, sizeof(g_snapshotMagic));
+    put(buffer, uint64_t(records.size()));
+    for (const auto &record : records)
+      encode(buffer, record);
+
+    // The snapshot is complete on disk before it replaces the old generation
+    FILE *file = fopen(temp.c_str(), "wb");
+    bool written = file && fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() &&
+                   syncFile(file);
+    if (file)
+      fclose(file);
+    remove(name.c_str());
+    if (!written || rename(temp.c_str(), name.c_str()) != 0)
+    {
+      g_logger << dlib::LERROR << "Cannot write asset snapshot " << name;
+      remove(temp.c_str());
+      return false;
+    }
+
+    m_generation = generation;
+    m_snapshotSize = buffer.size();
+    openLog(true);
+    removeOtherGenerations();
+    return true;
+  }
+
+  void AssetLog::removeOtherGenerations()
+  {
+    try
+    {
+      vector<dlib::file> files;
+      dlib::directory(m_directory).get_files(files);
+      auto keep = path(m_generation, "");
+      keep = keep.substr(m_directory.size() + 1);
+      static const string prefix("assets-");
+      for (const auto &file : files)
+      {
+        const auto name = file.name();
+        if (name.compare(0, prefix.size(), prefix) == 0 &&
+            name != keep + ".snap" && name != keep + ".log")
+          remove(file.full_name().c_str());
+      }
+    }
+    catch (exception &e)
+    {
+      g_logger << dlib::LWARN << "Cannot remove old asset files: " << e.what();
+    }
+  }
+}  // namespace mtconnect
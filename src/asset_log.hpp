@@ -0,0 +1,108 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mtconnect
+{
+  // Keeps the assets across restarts. Every change is appended to a log and flushed
+  // before the agent acknowledges it. When the log grows larger than the last snapshot,
+  // the agent writes a new snapshot of all assets in least recently used order and a new
+  // log is started.
+  //
+  // Snapshots and logs are numbered by generation. A snapshot is written to a temporary
+  // file, synced and renamed so a crash leaves either the old or the new generation.
+  // Records carry a checksum and a torn record at the end of the log is dropped.
+  //
+  // The log is not synchronized, the agent holds the asset lock.
+  class AssetLog
+  {
+   public:
+    enum Kind : uint8_t
+    {
+      PUT = 1,
+      REMOVE = 2
+    };
+
+    // A new version of an asset, or the removal of an asset which only has the id and
+    // the time it was removed
+    struct Record
+    {
+      Kind m_kind = PUT;
+      std::string m_assetId;
+      std::string m_type;
+      std::string m_deviceUuid;
+      std::string m_timestamp;
+      std::string m_content;
+      bool m_removed = false;
+    };
+
+    // Called with the records of the snapshot followed by the records of the log
+    using Visitor = std::function<void(const Record &record)>;
+
+    explicit AssetLog(std::string directory, uint64_t minimumLogSize = 1024 * 1024);
+    ~AssetLog();
+
+    // Read the newest complete snapshot and its log and open the log for appending.
+    // Returns the number of records read from the log.
+    size_t recover(const Visitor &visitor);
+
+    // Append a change and flush it
+    void append(const Record &record);
+
+    // The log is larger than the snapshot and the minimum log size
+    bool needsCompaction() const
+    {
+      return m_logSize > m_snapshotSize && m_logSize > m_minimumLogSize;
+    }
+
+    // Write a snapshot of the records and start a new log
+    bool compact(const std::vector<Record> &records);
+
+    uint64_t getGeneration() const
+    {
+      return m_generation;
+    }
+    uint64_t getLogSize() const
+    {
+      return m_logSize;
+    }
+    uint64_t getSnapshotSize() const
+    {
+      return m_snapshotSize;
+    }
+
+   protected:
+    std::string path(uint64_t generation, const char *suffix) const;
+    bool openLog(bool truncate);
+    void removeOtherGenerations();
+
+   protected:
+    std::string m_directory;
+    uint64_t m_minimumLogSize;
+    uint64_t m_generation = 0;
+    uint64_t m_logSize = 0;
+    uint64_t m_snapshotSize = 0;
+    FILE *m_log = nullptr;
+  };
+}  // namespace mtconnect
@@ -0,0 +1,212 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#include "asset_store.hpp"
+
+using namespace std;
+
+namespace mtconnect
+{
+  AssetPtr AssetStore::get(const string &id) const
+  {
+    auto entry = m_entries.find(id);
+    if (entry == m_entries.end())
+      return AssetPtr();
+    return entry->second->m_asset;
+  }
+
+  AssetPtr AssetStore::add(const AssetPtr &asset)
+  {
+    AssetPtr evicted;
+    auto &entry = m_entries[asset->getAssetId()];
+    if (entry)
+    {
+      unindex(entry.get());
+      entry->m_asset = asset.getObject();
+      if (!asset->isRemoved())
+      {
+        unlink(entry.get());
+        link(entry.get());
+      }
+      index(entry.get());
+      return evicted;
+    }
+
+    entry = make_unique<Entry>();
+    entry->m_asset = asset.getObject();
+    link(entry.get());
+    index(entry.get());
+    m_counts[asset->getType()] += 1;
+
+    if (m_entries.size() > m_maxAssets)
+    {
+      auto oldest = m_oldest;
+      evicted = oldest->m_asset.getObject();
+      unindex(oldest);
+      unlink(oldest);
+      m_counts[oldest->m_type] -= 1;
+      m_entries.erase(evicted->getAssetId());
+    }
+
+    return evicted;
+  }
+
+  void AssetStore::touch(const string &id)
+  {
+    auto entry = m_entries.find(id);
+    if (entry == m_entries.end())
+      return;
+
+    unindex(entry->second.get());
+    unlink(entry->second.get());
+    link(entry->second.get());
+    index(entry->second.get());
+  }
+
+  void AssetStore::remove(const string &id)
+  {
+    auto entry = m_entries.find(id);
+    if (entry == m_entries.end())
+      return;
+
+    unindex(entry->second.get());
+    entry->second->m_asset->setRemoved(true);
+    index(entry->second.get());
+  }
+
+  vector<AssetPtr> AssetStore::find(const string &type, const string &device, bool removed,
+                                    size_t count) const
+  {
+    vector<AssetPtr> assets;
+
+    // Use the narrowest index, the device is checked when both are given
+    const Index *index = &m_all;
+    if (!type.empty())
+    {
+      auto pos = m_types.find(type);
+      if (pos == m_types.end())
+        return assets;
+      index = &pos->second;
+    }
+    else if (!device.empty())
+    {
+      auto pos = m_devices.find(device);
+      if (pos == m_devices.end())
+        return assets;
+      index = &pos->second;
+    }
+    bool checkDevice = !type.empty() && !device.empty();
+
+    // Merge the active and removed assets newest first
+    auto active = index->m_active.rbegin(), activeEnd = index->m_active.rend();
+    auto gone = index->m_removed.rbegin(), goneEnd = index->m_removed.rend();
+    if (!removed)
+      gone = goneEnd;
+
+    while (assets.size() < count && (active != activeEnd || gone != goneEnd))
+    {
+      const Entry *entry;
+      if (gone == goneEnd || (active != activeEnd && active->first > gone->first))
+        entry = (active++)->second;
+      else
+        entry = (gone++)->second;
+
+      if (!checkDevice || entry->m_device == device)
+        assets.emplace_back(entry->m_asset);
+    }
+
+    return assets;
+  }
+
+  vector<AssetPtr> AssetStore::getAll() const
+  {
+    vector<AssetPtr> assets;
+    assets.reserve(m_entries.size());
+    for (auto entry = m_oldest; entry; entry = entry->m_newer)
+      assets.push_back(entry->m_asset);
+    return assets;
+  }
+
+  void AssetStore::clear()
+  {
+    m_entries.clear();
+    m_newest = m_oldest = nullptr;
+    m_all = Index();
+    m_types.clear();
+    m_devices.clear();
+    m_counts.clear();
+  }
+
+  void AssetStore::link(Entry *entry)
+  {
+    entry->m_stamp = ++m_stamp;
+    entry->m_older = m_newest;
+    entry->m_newer = nullptr;
+    if (m_newest)
+      m_newest->m_newer = entry;
+    else
+      m_oldest = entry;
+    m_newest = entry;
+  }
+
+  void AssetStore::unlink(Entry *entry)
+  {
+    if (entry->m_newer)
+      entry->m_newer->m_older = entry->m_older;
+    else
+      m_newest = entry->m_older;
+
+    if (entry->m_older)
+      entry->m_older->m_newer = entry->m_newer;
+    else
+      m_oldest = entry->m_newer;
+
+    entry->m_newer = entry->m_older = nullptr;
+  }
+
+  void AssetStore::index(Entry *entry)
+  {
+    const auto &asset = entry->m_asset;
+    if (entry->m_type != asset->getType())
+    {
+      // A new version of an asset can have a different type
+      if (!entry->m_type.empty())
+      {
+        m_counts[entry->m_type] -= 1;
+        m_counts[asset->getType()] += 1;
+      }
+      entry->m_type = asset->getType();
+    }
+    entry->m_device = asset->getDeviceUuid();
+    entry->m_removed = asset->isRemoved();
+
+    for (auto index : {&m_all, &m_types[entry->m_type], &m_devices[entry->m_device]})
+    {
+      auto &list = entry->m_removed ? index->m_removed : index->m_active;
+      list.emplace(entry->m_stamp, entry);
+    }
+  }
+
+  void AssetStore::unindex(Entry *entry)
+  {
+    for (auto index : {&m_all, &m_types[entry->m_type], &m_devices[entry->m_device]})
+    {
+      auto &list = entry->m_removed ? index->m_removed : index->m_active;
+      list.erase(entry->m_stamp);
+    }
+  }
+}  // namespace mtconnect
@@ -0,0 +1,136 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include "asset.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mtconnect
+{
+  // The assets by id in least recently used order. The order is an intrusive list so
+  // an asset moves to the front or is evicted in constant time. Secondary indexes by
+  // type and device UUID, split by the removed flag, keep the assets in the same order
+  // so a request for the newest N assets of a type only visits N assets.
+  //
+  // The store is not synchronized, the agent holds the asset lock.
+  class AssetStore
+  {
+   public:
+    explicit AssetStore(unsigned int maxAssets) : m_maxAssets(maxAssets)
+    {
+    }
+
+    // The asset with the id, the pointer is empty if there is none
+    AssetPtr get(const std::string &id) const;
+
+    // Store the asset under its id. A new asset, or a new version of an asset, becomes
+    // the most recent. A removed version takes the place of the asset it replaces.
+    // When the store is full the least recently used asset is evicted and returned.
+    AssetPtr add(const AssetPtr &asset);
+
+    // Make the asset the most recent after it changed
+    void touch(const std::string &id);
+
+    // Mark the asset removed, it keeps its place
+    void remove(const std::string &id);
+
+    // The newest assets first, at most count. The type and device match all assets
+    // when they are empty, removed assets are only included when removed is true.
+    std::vector<AssetPtr> find(const std::string &type, const std::string &device, bool removed,
+                               size_t count) const;
+
+    // All assets, the least recently used first, so adding them in this order restores
+    // the order of the store
+    std::vector<AssetPtr> getAll() const;
+
+    void clear();
+
+    // The asset that would be evicted next
+    AssetPtr getOldest() const
+    {
+      return m_oldest ? m_oldest->m_asset : AssetPtr();
+    }
+
+    size_t size() const
+    {
+      return m_entries.size();
+    }
+    unsigned int getMaxAssets() const
+    {
+      return m_maxAssets;
+    }
+
+    // The number of assets of each type, including removed assets
+    const std::map<std::string, int> &getCounts() const
+    {
+      return m_counts;
+    }
+    int getCount(const std::string &type) const
+    {
+      auto count = m_counts.find(type);
+      return count != m_counts.end() ? count->second : 0;
+    }
+
+   protected:
+    struct Entry
+    {
+      AssetPtr m_asset;
+      uint64_t m_stamp = 0;
+
+      // What the asset was indexed by
+      std::string m_type;
+      std::string m_device;
+      bool m_removed = false;
+
+      // The least recently used list
+      Entry *m_newer = nullptr;
+      Entry *m_older = nullptr;
+    };
+
+    // Entries of an index by the stamp of their last use
+    struct Index
+    {
+      std::map<uint64_t, Entry *> m_active;
+      std::map<uint64_t, Entry *> m_removed;
+    };
+
+    void link(Entry *entry);
+    void unlink(Entry *entry);
+    void index(Entry *entry);
+    void unindex(Entry *entry);
+
+   protected:
+    unsigned int m_maxAssets;
+    uint64_t m_stamp = 0;
+
+    std::unordered_map<std::string, std::unique_ptr<Entry>> m_entries;
+    Entry *m_newest = nullptr;
+    Entry *m_oldest = nullptr;
+
+    Index m_all;
+    std::unordered_map<std::string, Index> m_types;
+    std::unordered_map<std::string, Index> m_devices;
+    std::map<std::string, int> m_counts;
+  };
+}  // namespace mtconnect
@@ -17,8 +17,9 @@
 
 #include "change_observer.hpp"
 
+#include "timer_wheel.hpp"
+
 #include <algorithm>
-#include <thread>
 
 namespace mtconnect
 {
@@ -28,6 +29,41 @@ namespace mtconnect
       signaler->removeObserver(this);
   }
 
+  bool ChangeObserver::waitUntil(std::chrono::steady_clock::time_point earliest,
+                                 std::chrono::steady_clock::time_point latest) const
+  {
+    auto &wheel = TimerWheel::instance();
+
+    if (!wasSignaled())
+    {
+      // Register as a waiter before checking the sequence again under the lock so
+      // a signal cannot be missed between the check and the wait. The latest
+      // deadline is a timer on the shared wheel so sessions with the same deadline
+      // are woken together.
+      std::unique_lock<std::mutex> lock(m_mutex);
+      bool expired = false;
+      m_waiters++;
+      auto timer = wheel.schedule(latest, [this, &expired]() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        expired = true;
+        m_cv.notify_all();
+      });
+      m_cv.wait(lock, [this, &expired]() { return expired || wasSignaled(); });
+      m_waiters--;
+      lock.unlock();
+
+      // Make sure the timer is no longer referencing expired
+      wheel.cancel(timer);
+      if (!wasSignaled())
+        return false;
+    }
+
+    // Data has arrived, but hold it until the earliest time we may respond
+    wheel.sleepUntil(earliest);
+
+    return true;
+  }
+
   void ChangeObserver::addSignaler(ChangeSignaler *sig)
   {
     m_signalers.emplace_back(sig);
@@ -18,8 +18,10 @@
 #pragma once
 
 #include "globals.hpp"
-#include <condition_variable>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <vector>
 
@@ -34,25 +36,36 @@ namespace mtconnect
 
     virtual ~ChangeObserver();
 
+    // Wait until signaled or the deadline has passed. Only returns true if the
+    // observer was signaled, there are no spurious early returns.
     bool wait(unsigned long timeout) const
     {
-      std::unique_lock<std::recursive_mutex> lock(m_mutex);
-
-      if (m_sequence != UINT64_MAX)
-        return true;
-
-      return m_cv.wait_for(m_mutex, std::chrono::milliseconds{timeout},
-                           [this]() { return m_sequence != UINT64_MAX; });
+      auto now = std::chrono::steady_clock::now();
+      return waitUntil(now, now + std::chrono::milliseconds{timeout});
     }
 
+    // Wait until signaled, but do not return before earliest. If nothing is signaled
+    // before latest, returns false at latest. Used to wait for both the arrival of data
+    // and the stream interval with exact deadlines.
+    bool waitUntil(std::chrono::steady_clock::time_point earliest,
+                   std::chrono::steady_clock::time_point latest) const;
+
     void signal(uint64_t sequence)
     {
-      std::lock_guard<std::recursive_mutex> scopedLock(m_mutex);
-
-      if (m_sequence > sequence && sequence)
-        m_sequence = sequence;
-
-      m_cv.notify_one();
+      if (!sequence)
+        return;
+
+      // Keep the earliest sequence signaled
+      auto current = m_sequence.load();
+      while (sequence < current && !m_sequence.compare_exchange_weak(current, sequence))
+        ;
+
+      // Only take the lock if someone is parked on the observer
+      if (m_waiters.load() > 0)
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cv.notify_all();
+      }
     }
 
     uint64_t getSequence() const
@@ -67,16 +80,16 @@ namespace mtconnect
 
     void reset()
     {
-      std::lock_guard<std::recursive_mutex> scopedLock(m_mutex);
       m_sequence = UINT64_MAX;
     }
 
    private:
-    mutable std::recursive_mutex m_mutex;
-    mutable std::condition_variable_any m_cv;
+    mutable std::mutex m_mutex;
+    mutable std::condition_variable m_cv;
+    mutable std::atomic_int m_waiters{0};
 
     std::vector<ChangeSignaler *> m_signalers;
-    volatile uint64_t m_sequence = UINT64_MAX;
+    std::atomic<uint64_t> m_sequence{UINT64_MAX};
 
    protected:
     friend class ChangeSignaler;
@@ -23,6 +23,36 @@ using namespace std;
 
 namespace mtconnect
 {
+  void ActiveConditions::add(Observation *event)
+  {
+    auto code = m_codes.find(event->getCode());
+    if (code != m_codes.end())
+      m_observations[code->second] = event;
+    else
+    {
+      m_codes.emplace(event->getCode(), m_observations.size());
+      m_observations.emplace_back(event);
+    }
+  }
+
+  bool ActiveConditions::remove(const std::string &code)
+  {
+    auto pos = m_codes.find(code);
+    if (pos == m_codes.end())
+      return false;
+
+    auto index = pos->second;
+    m_codes.erase(pos);
+    if (index + 1 < m_observations.size())
+    {
+      m_observations[index] = std::move(m_observations.back());
+      m_codes[m_observations[index]->getCode()] = index;
+    }
+    m_observations.pop_back();
+
+    return true;
+  }
+
   Checkpoint::Checkpoint() = default;
 
   Checkpoint::Checkpoint(const Checkpoint &checkpoint, const std::set<std::string> *filterSet)
@@ -41,6 +71,7 @@ namespace mtconnect
       delete event.second;
 
     m_events.clear();
+    m_conditions.clear();
   }
 
   Checkpoint::~Checkpoint()
@@ -48,6 +79,17 @@ namespace mtconnect
     clear();
   }
 
+  ActiveConditions &Checkpoint::activeConditions(const std::string &id)
+  {
+    auto &conditions = m_conditions[id];
+    if (!conditions)
+      conditions = make_shared<ActiveConditions>();
+    else if (conditions.use_count() > 1)
+      conditions = make_shared<ActiveConditions>(*conditions);
+
+    return *conditions;
+  }
+
   void Checkpoint::addObservation(Observation *event)
   {
     if (m_hasFilter && !m_filter.count(event->getDataItem()->getId()))
@@ -58,71 +100,60 @@ namespace mtconnect
     auto item = event->getDataItem();
     const auto &id = item->getId();
     auto ptr = m_events[id];
+    auto level = event->getLevel();
+    bool active =
+        item->isCondition() && level != Observation::NORMAL && level != Observation::UNAVAILABLE;
 
     if (ptr)
     {
       bool assigned = false;
 
-      if (item->isCondition())
+      if (active)
       {
-        // Chain event only if it is normal or unavailable and the
-        // previous condition was not normal or unavailable
-        if ((*ptr)->getLevel() != Observation::NORMAL && event->getLevel() != Observation::NORMAL &&
-            (*ptr)->getLevel() != Observation::UNAVAILABLE &&
-            event->getLevel() != Observation::UNAVAILABLE)
-        {
-          // Check to see if the native code matches an existing
-          // active condition
-          auto e = (*ptr)->find(event->getCode());
-
-          if (e)
-          {
-            // Replace in chain.
-            auto n = (*ptr)->deepCopyAndRemove(e);
-            // Check if this is the only event...
-            (*ptr) = n;
-            if (n)
-              n->unrefer();
-          }
-
-          // Chain the event
-          if (ptr->getObject())
-            event->appendTo(*ptr);
-        }
-        else if (event->getLevel() == Observation::NORMAL)
+        // Replaces the active condition with the same native code
+        activeConditions(id).add(event);
+      }
+      else if (item->isCondition())
+      {
+        auto conditions = getActiveConditions(id);
+        if (level == Observation::NORMAL && !event->getCode().empty())
         {
           // Check for a normal that clears an active condition by code
-          if (event->getCode()[0] != '\0')
+          if (conditions && conditions->hasCode(event->getCode()))
           {
-            auto e = (*ptr)->find(event->getCode());
+            auto &remaining = activeConditions(id);
+            remaining.remove(event->getCode());
 
-            if (e)
+            if (remaining.empty())
             {
-              // Clear the one condition by removing it from the chain
-              auto n = (*ptr)->deepCopyAndRemove(e);
+              // Need to put a normal event in with no code since this
+              // is the last one.
+              auto n = new Observation(*event);
+              n->normal();
               (*ptr) = n;
-
-              if (n)
-                n->unrefer();
-              else
-              {
-                // Need to put a normal event in with no code since this
-                // is the last one.
-                n = new Observation(*event);
-                n->normal();
-                (*ptr) = n;
-                n->unrefer();
-              }
-            }
-            else
-            {
-              // Not sure if we should register code specific normals if
-              // previous normal was not found
-              // (*ptr) = event;
+              n->unrefer();
             }
-
-            assigned = true;
+            else if ((*ptr)->getCode() == event->getCode())
+              (*ptr) = remaining.getObservations().back();
+          }
+          else
+          {
+            // Not sure if we should register code specific normals if
+            // previous normal was not found
+            // (*ptr) = event;
           }
+
+          assigned = true;
+        }
+        else if (conditions)
+        {
+          // A normal without a code or unavailable clears all active conditions, the
+          // table is kept for reuse unless a copy of the checkpoint shares it
+          auto pos = m_conditions.find(id);
+          if (pos->second.use_count() > 1)
+            m_conditions.erase(pos);
+          else
+            pos->second->clear();
         }
       }
       else if (item->isDataSet())
@@ -156,7 +187,11 @@ namespace mtconnect
         (*ptr) = event;
     }
     else
+    {
       m_events[id] = new ObservationPtr(event);
+      if (active)
+        activeConditions(id).add(event);
+    }
   }
 
   void Checkpoint::copy(Checkpoint const &checkpoint, const std::set<std::string> *filterSet)
@@ -176,27 +211,53 @@ namespace mtconnect
       if (!filterSet || filterSet->count(event.first) > 0)
         m_events[event.first] = new ObservationPtr(event.second->getObject());
     }
+
+    // The tables are shared until one of the checkpoints changes them
+    for (const auto &conditions : checkpoint.m_conditions)
+    {
+      if (!conditions.second->empty() && (!filterSet || filterSet->count(conditions.first) > 0))
+        m_conditions.emplace(conditions.first, conditions.second);
+    }
   }
 
-  void Checkpoint::getObservations(ObservationPtrArray &list,
-                                   std::set<string> const *filterSet) const
+  // The latest observation of each data item, or all of its active conditions
+  template <typename List>
+  static void collectObservations(const Checkpoint &checkpoint, List &list,
+                                  std::set<string> const *filterSet)
   {
-    for (const auto &event : m_events)
+    for (const auto &event : checkpoint.getEvents())
     {
-      auto e = *(event.second);
+      auto e = event.second->getObject();
 
-      if (!filterSet || (e.getObject() && filterSet->count(e->getDataItem()->getId()) > 0))
+      if (e && (!filterSet || filterSet->count(e->getDataItem()->getId()) > 0))
       {
-        while (e.getObject())
+        const ActiveConditions *conditions = nullptr;
+        if (e->getDataItem()->isCondition())
+          conditions = checkpoint.getActiveConditions(event.first);
+
+        if (conditions)
         {
-          auto p = e->getPrev();
-          list.push_back(e);
-          e = p;
+          for (const auto &condition : conditions->getObservations())
+            list.emplace_back(condition.getObject());
         }
+        else
+          list.emplace_back(e);
       }
     }
   }
 
+  void Checkpoint::getObservations(ObservationPtrArray &list,
+                                   std::set<string> const *filterSet) const
+  {
+    collectObservations(*this, list, filterSet);
+  }
+
+  void Checkpoint::getObservations(ObservationList &list,
+                                   std::set<string> const *filterSet) const
+  {
+    collectObservations(*this, list, filterSet);
+  }
+
   void Checkpoint::filter(std::set<std::string> const &filterSet)
   {
     m_filter = filterSet;
@@ -204,6 +265,14 @@ namespace mtconnect
     if (filterSet.empty())
       return;
 
+    for (auto it = m_conditions.begin(); it != m_conditions.end();)
+    {
+      if (!m_filter.count(it->first))
+        it = m_conditions.erase(it);
+      else
+        ++it;
+    }
+
     auto it = m_events.begin();
     while (it != m_events.end())
     {
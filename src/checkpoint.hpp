@@ -21,12 +21,50 @@
 #include "observation.hpp"
 
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace mtconnect
 {
+  // The active conditions of a condition data item by native code. A condition with a
+  // code that is already active replaces it, and it is cleared by removing it and moving
+  // the last one into its place.
+  class ActiveConditions
+  {
+   public:
+    void add(Observation *event);
+    bool remove(const std::string &code);
+    bool hasCode(const std::string &code) const
+    {
+      return m_codes.count(code) > 0;
+    }
+    void clear()
+    {
+      m_observations.clear();
+      m_codes.clear();
+    }
+
+    bool empty() const
+    {
+      return m_observations.empty();
+    }
+    size_t size() const
+    {
+      return m_observations.size();
+    }
+    const ObservationPtrArray &getObservations() const
+    {
+      return m_observations;
+    }
+
+   protected:
+    ObservationPtrArray m_observations;
+    std::unordered_map<std::string, size_t> m_codes;
+  };
+
   class Checkpoint
   {
    public:
@@ -48,6 +86,10 @@ namespace mtconnect
     void getObservations(ObservationPtrArray &list,
                          std::set<std::string> const *filterSet = nullptr) const;
 
+    // Borrow the observations, the caller keeps them alive
+    void getObservations(ObservationList &list,
+                         std::set<std::string> const *filterSet = nullptr) const;
+
     ObservationPtr *getEventPtr(const std::string &id)
     {
       auto pos = m_events.find(id);
@@ -56,8 +98,25 @@ namespace mtconnect
       return nullptr;
     }
 
+    // The active conditions of a condition data item, nullptr if it is normal or unavailable
+    const ActiveConditions *getActiveConditions(const std::string &id) const
+    {
+      auto pos = m_conditions.find(id);
+      if (pos != m_conditions.end() && !pos->second->empty())
+        return pos->second.get();
+      return nullptr;
+    }
+
    protected:
+    ActiveConditions &activeConditions(const std::string &id);
+
+   protected:
+    // The latest observation of each data item
     std::map<std::string, ObservationPtr *> m_events;
+
+    // The active conditions of the condition data items. Copies of a checkpoint share the
+    // tables, a shared table is copied before it is changed.
+    std::map<std::string, std::shared_ptr<ActiveConditions>> m_conditions;
     std::set<std::string> m_filter;
     bool m_hasFilter = false;
   };
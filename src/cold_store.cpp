@@ -0,0 +1,648 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#include "cold_store.hpp"
+
+#include "globals.hpp"
+
+#include <dlib/compress_stream.h>
+#include <dlib/dir_nav.h>
+#include <dlib/logger.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+namespace mtconnect
+{
+  static dlib::logger g_logger("cold.store");
+
+  // Segment header: magic, instance id, first and last sequence, first and last received
+  // time, the data item ids, and the size of the uncompressed payload
+  static const char g_magic[8] = {'M', 'T', 'C', 'C', 'O', 'L', 'D', '2'};
+
+  // Payload: the number of series, then for each the position of the data item in the
+  // segment, the digits of the timestamp fractions, the number of samples and the size of
+  // the encoded samples. The records of the other observations follow.
+  static const size_t SERIES_HEADER_SIZE = 4 + 1 + 4 + 4;
+
+  // Record: sequence, position of the data item in the segment, and the size of the
+  // serialized observation that follows
+  static const size_t RECORD_HEADER_SIZE = 8 + 4 + 4;
+
+  using Compressor = dlib::compress_stream::kernel_1ec;
+
+  template <typename T>
+  static inline void put(string &buffer, T value)
+  {
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  template <typename T>
+  static inline bool get(istream &in, T &value)
+  {
+    return bool(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+  }
+
+  template <typename T>
+  static inline T get(const char *pos)
+  {
+    T value;
+    memcpy(&value, pos, sizeof(T));
+    return value;
+  }
+
+  static bool readHeader(istream &in, uint64_t &instanceId, uint64_t &first, uint64_t &last,
+                         uint64_t &minTime, uint64_t &maxTime, vector<string> &ids,
+                         uint64_t &size)
+  {
+    char magic[sizeof(g_magic)];
+    uint32_t count;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, g_magic, sizeof(g_magic)) != 0 ||
+        !get(in, instanceId) || !get(in, first) || !get(in, last) || !get(in, minTime) ||
+        !get(in, maxTime) || !get(in, count))
+      return false;
+
+    ids.resize(count);
+    for (auto &id : ids)
+    {
+      uint32_t len;
+      if (!get(in, len))
+        return false;
+      id.resize(len);
+      if (!in.read(&id[0], len))
+        return false;
+    }
+
+    return bool(get(in, size));
+  }
+
+  ColdStore::ColdStore(string directory, uint64_t instanceId, uint64_t budget,
+                       Resolver resolver, size_t blockSize)
+    : m_directory(move(directory)),
+      m_instanceId(instanceId),
+      m_budget(budget),
+      m_resolver(move(resolver)),
+      m_blockSize(blockSize)
+  {
+    dlib::create_directory(m_directory);
+    load();
+    m_thread = thread(&ColdStore::run, this);
+  }
+
+  ColdStore::~ColdStore()
+  {
+    {
+      lock_guard<mutex> lock(m_mutex);
+      seal();
+      m_running = false;
+    }
+    m_cond.notify_all();
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+  void ColdStore::load()
+  {
+    vector<dlib::file> files;
+    try
+    {
+      dlib::directory(m_directory).get_files(files);
+    }
+    catch (dlib::directory::dir_not_found &)
+    {
+      return;
+    }
+
+    static const string prefix("cold-"), suffix(".seg");
+    vector<pair<uint64_t, string>> paths;
+    for (const auto &file : files)
+    {
+      const auto name = file.name();
+      if (name.size() > prefix.size() + suffix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+          name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+      {
+        paths.emplace_back(strtoull(name.c_str() + prefix.size(), nullptr, 10), file.full_name());
+      }
+    }
+    sort(paths.begin(), paths.end());
+
+    // Only the headers are read, the records are read when a request needs them
+    for (const auto &path : paths)
+    {
+      ifstream in(path.second, ios::binary | ios::ate);
+      auto segment = make_shared<Segment>();
+      segment->m_path = path.second;
+      segment->m_size = uint64_t(in.tellg());
+      in.seekg(0);
+
+      uint64_t instanceId, size;
+      if (!readHeader(in, instanceId, segment->m_first, segment->m_last, segment->m_minTime,
+                      segment->m_maxTime, segment->m_ids, size) ||
+          instanceId != m_instanceId || segment->m_first <= m_last)
+      {
+        // Segments of another instance have sequences that do not follow this one
+        g_logger << dlib::LDEBUG << "Removing cold segment " << path.second;
+        remove(path.second.c_str());
+        continue;
+      }
+
+      for (const auto &id : segment->m_ids)
+      {
+        auto number = itemNumber(id);
+        if (segment->m_bitmap.size() <= number / 64)
+          segment->m_bitmap.resize(number / 64 + 1);
+        segment->m_bitmap[number / 64] |= uint64_t(1) << (number % 64);
+      }
+
+      m_last = segment->m_last;
+      m_diskSize += segment->m_size;
+      m_segments.push_back(segment);
+    }
+
+    removeOldest();
+    if (!m_segments.empty())
+      g_logger << dlib::LINFO << "Cold storage has " << m_segments.size()
+               << " segments from sequence " << m_segments.front()->m_first << " to " << m_last;
+  }
+
+  size_t ColdStore::itemNumber(const string &id)
+  {
+    return m_itemNumbers.emplace(id, m_itemNumbers.size()).first->second;
+  }
+
+  void ColdStore::add(const Observation *observation, uint64_t received)
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    auto sequence = observation->getSequence();
+    if (sequence <= m_last)
+      return;
+
+    if (!m_pending)
+    {
+      m_pending = make_shared<Segment>();
+      m_pending->m_first = sequence;
+    }
+
+    const auto &id = observation->getDataItem()->getId();
+    auto local = m_pendingIds.find(id);
+    uint32_t index;
+    if (local == m_pendingIds.end())
+    {
+      index = uint32_t(m_pending->m_ids.size());
+      m_pendingIds.emplace(id, index);
+      m_pending->m_ids.push_back(id);
+
+      auto number = itemNumber(id);
+      auto &bitmap = m_pending->m_bitmap;
+      if (bitmap.size() <= number / 64)
+        bitmap.resize(number / 64 + 1);
+      bitmap[number / 64] |= uint64_t(1) << (number % 64);
+    }
+    else
+      index = local->second;
+
+    if (!encodeSample(index, observation))
+    {
+      put(m_pendingRecords, sequence);
+      put(m_pendingRecords, index);
+      auto sizePos = m_pendingRecords.size();
+      put(m_pendingRecords, uint32_t(0));
+      observation->serialize(m_pendingRecords);
+      uint32_t size = uint32_t(m_pendingRecords.size() - sizePos - 4);
+      memcpy(&m_pendingRecords[sizePos], &size, sizeof(size));
+    }
+
+    m_pending->m_last = sequence;
+    m_pending->m_minTime = min(m_pending->m_minTime, received);
+    m_pending->m_maxTime = max(m_pending->m_maxTime, received);
+    m_last = sequence;
+
+    if (m_pendingRecords.size() + m_pendingSeriesSize >= m_blockSize)
+      seal();
+  }
+
+  bool ColdStore::encodeSample(uint32_t index, const Observation *observation)
+  {
+    // Only samples that print back exactly from their value and time are encoded
+    if (!observation->getDataItem()->isSample() || observation->isTimeSeries() ||
+        !observation->getDuration().empty() || !observation->getResetTriggered().empty())
+      return false;
+
+    double value;
+    int64_t time;
+    int digits;
+    if (!parseSampleValue(observation->getValue(), value) ||
+        !parseTimestamp(observation->getTime(), time, digits))
+      return false;
+
+    auto series = m_pendingSeries.find(index);
+    if (series == m_pendingSeries.end())
+      series = m_pendingSeries.emplace(index, Series{digits, {}}).first;
+    else if (series->second.m_digits != digits)
+      return false;
+
+    auto &encoder = series->second.m_encoder;
+    auto before = encoder.getData().size();
+    encoder.add(observation->getSequence(), time, value);
+    m_pendingSeriesSize += encoder.getData().size() - before;
+    return true;
+  }
+
+  string ColdStore::payload() const
+  {
+    string payload;
+    payload.reserve(4 + m_pendingSeries.size() * SERIES_HEADER_SIZE + m_pendingSeriesSize +
+                    m_pendingRecords.size());
+    put(payload, uint32_t(m_pendingSeries.size()));
+    for (const auto &series : m_pendingSeries)
+    {
+      const auto &encoder = series.second.m_encoder;
+      put(payload, series.first);
+      put(payload, uint8_t(series.second.m_digits));
+      put(payload, uint32_t(encoder.getCount()));
+      put(payload, uint32_t(encoder.getData().size()));
+      payload.append(encoder.getData());
+    }
+    payload.append(m_pendingRecords);
+
+    return payload;
+  }
+
+  void ColdStore::seal()
+  {
+    if (!m_pending)
+      return;
+
+    m_pending->m_records = make_shared<const string>(payload());
+    m_pendingSeries.clear();
+    m_pendingSeriesSize = 0;
+    m_pendingRecords.clear();
+    m_pendingIds.clear();
+    m_segments.push_back(m_pending);
+    m_queue.push_back(m_pending);
+    m_pending.reset();
+    m_cond.notify_all();
+  }
+
+  void ColdStore::flush()
+  {
+    unique_lock<mutex> lock(m_mutex);
+    seal();
+    m_cond.wait(lock, [this]() { return m_queue.empty() && !m_writing; });
+  }
+
+  void ColdStore::run()
+  {
+    unique_lock<mutex> lock(m_mutex);
+    while (true)
+    {
+      m_cond.wait(lock, [this]() { return !m_queue.empty() || !m_running; });
+      if (m_queue.empty())
+        break;
+
+      auto segment = m_queue.front();
+      m_queue.pop_front();
+      m_writing = true;
+
+      // Compress and write without holding the lock, the records stay readable from
+      // memory until the file is complete
+      Segment written(*segment);
+      lock.unlock();
+      bool ok = write(written, *segment->m_records);
+      lock.lock();
+
+      if (ok)
+      {
+        segment->m_path = written.m_path;
+        segment->m_size = written.m_size;
+        segment->m_records.reset();
+        m_diskSize += written.m_size;
+        removeOldest();
+      }
+      else
+      {
+        m_segments.erase(find(m_segments.begin(), m_segments.end(), segment));
+      }
+
+      m_writing = false;
+      m_cond.notify_all();
+    }
+  }
+
+  bool ColdStore::write(Segment &segment, const string &records)
+  {
+    string header(g_magic, sizeof(g_magic));
+    put(header, m_instanceId);
+    put(header, segment.m_first);
+    put(header, segment.m_last);
+    put(header, segment.m_minTime);
+    put(header, segment.m_maxTime);
+    put(header, uint32_t(segment.m_ids.size()));
+    for (const auto &id : segment.m_ids)
+    {
+      put(header, uint32_t(id.size()));
+      header.append(id);
+    }
+    put(header, uint64_t(records.size()));
+
+    char name[64];
+    snprintf(name, sizeof(name), "/cold-%020llu.seg", (unsigned long long)segment.m_first);
+    auto path = m_directory + name;
+    auto temp = path + ".tmp";
+
+    // Write to a temporary file first so a segment file is always complete
+    {
+      ofstream out(temp, ios::binary | ios::trunc);
+      out.write(header.data(), header.size());
+      istringstream in(records);
+      Compressor compressor;
+      compressor.compress(in, out);
+      if (!out.good())
+      {
+        g_logger << dlib::LERROR << "Cannot write cold segment " << temp;
+        remove(temp.c_str());
+        return false;
+      }
+      segment.m_size = uint64_t(out.tellp());
+    }
+
+    remove(path.c_str());
+    if (rename(temp.c_str(), path.c_str()) != 0)
+    {
+      g_logger << dlib::LERROR << "Cannot rename cold segment to " << path;
+      remove(temp.c_str());
+      return false;
+    }
+
+    segment.m_path = path;
+    return true;
+  }
+
+  void ColdStore::removeOldest()
+  {
+    while (m_diskSize > m_budget && m_segments.size() > 1 && !m_segments.front()->m_records)
+    {
+      auto &segment = m_segments.front();
+      remove(segment->m_path.c_str());
+      m_diskSize -= segment->m_size;
+      if (m_cachedSegment == segment)
+      {
+        m_cachedSegment.reset();
+        m_cachedRecords.reset();
+      }
+      m_segments.pop_front();
+    }
+  }
+
+  shared_ptr<const string> ColdStore::read(const SegmentPtr &segment)
+  {
+    string path;
+    {
+      lock_guard<mutex> lock(m_mutex);
+      if (segment->m_records)
+        return segment->m_records;
+      if (m_cachedSegment == segment)
+        return m_cachedRecords;
+      path = segment->m_path;
+    }
+
+    // The segment may have been removed for the budget since the request started
+    ifstream in(path, ios::binary);
+    if (!in.is_open())
+      return nullptr;
+
+    uint64_t instanceId, first, last, minTime, maxTime, size;
+    vector<string> ids;
+    if (!readHeader(in, instanceId, first, last, minTime, maxTime, ids, size))
+      return nullptr;
+
+    ostringstream out;
+    try
+    {
+      Compressor compressor;
+      compressor.decompress(in, out);
+    }
+    catch (std::exception &e)
+    {
+      g_logger << dlib::LERROR << "Cannot decompress cold segment " << path << ": " << e.what();
+      return nullptr;
+    }
+
+    auto records = make_shared<const string>(out.str());
+    if (records->size() != size)
+    {
+      g_logger << dlib::LERROR << "Cold segment " << path << " is truncated";
+      return nullptr;
+    }
+
+    lock_guard<mutex> lock(m_mutex);
+    m_cachedSegment = segment;
+    m_cachedRecords = records;
+    return records;
+  }
+
+  uint64_t ColdStore::fetch(uint64_t start, uint64_t bound, bool forward,
+                            const set<string> &filter, const Visitor &visitor)
+  {
+    // Find the segments in the range holding any of the data items
+    vector<SegmentPtr> segments;
+    {
+      lock_guard<mutex> lock(m_mutex);
+
+      vector<size_t> numbers;
+      for (const auto &id : filter)
+      {
+        auto number = m_itemNumbers.find(id);
+        if (number != m_itemNumbers.end())
+          numbers.push_back(number->second);
+      }
+
+      auto matches = [&](const Segment &segment) {
+        if (forward ? segment.m_last < start || segment.m_first >= bound
+                    : segment.m_first > start || segment.m_last < bound)
+          return false;
+        for (auto number : numbers)
+        {
+          if (number / 64 < segment.m_bitmap.size() &&
+              segment.m_bitmap[number / 64] & (uint64_t(1) << (number % 64)))
+            return true;
+        }
+        return false;
+      };
+
+      for (const auto &segment : m_segments)
+      {
+        if (matches(*segment))
+          segments.push_back(segment);
+      }
+
+      // The block being collected is copied since it keeps changing
+      if (m_pending && matches(*m_pending))
+      {
+        auto pending = make_shared<Segment>(*m_pending);
+        pending->m_records = make_shared<const string>(payload());
+        segments.push_back(pending);
+      }
+    }
+
+    if (!forward)
+      reverse(segments.begin(), segments.end());
+
+    for (const auto &segment : segments)
+    {
+      auto records = read(segment);
+      if (!records)
+        continue;
+
+      vector<DataItem *> items(segment->m_ids.size(), nullptr);
+      for (size_t i = 0; i < items.size(); i++)
+      {
+        if (filter.count(segment->m_ids[i]) > 0)
+          items[i] = m_resolver(segment->m_ids[i]);
+      }
+
+      // The samples and records in the range, in the order of the request
+      struct Entry
+      {
+        uint64_t m_sequence;
+        uint32_t m_index;
+        const char *m_record;
+        uint32_t m_size;
+        int64_t m_time;
+        double m_value;
+        int m_digits;
+      };
+      vector<Entry> entries;
+      auto inRange = [&](uint64_t sequence) {
+        return forward ? sequence >= start && sequence < bound
+                       : sequence <= start && sequence >= bound;
+      };
+
+      const char *pos = records->data(), *end = pos + records->size();
+      uint32_t seriesCount = records->size() >= 4 ? get<uint32_t>(pos) : 0;
+      pos += 4;
+      for (uint32_t s = 0; s < seriesCount && size_t(end - pos) >= SERIES_HEADER_SIZE; s++)
+      {
+        auto index = get<uint32_t>(pos);
+        int digits = uint8_t(pos[4]);
+        auto count = get<uint32_t>(pos + 5);
+        auto size = get<uint32_t>(pos + 9);
+        pos += SERIES_HEADER_SIZE;
+        if (size_t(end - pos) < size || index >= items.size())
+        {
+          g_logger << dlib::LERROR << "Cold segment " << segment->m_first << " is damaged";
+          pos = end;
+          break;
+        }
+
+        // Only the series of the requested data items are decoded
+        if (items[index])
+        {
+          SeriesDecoder decoder(pos, size, count);
+          uint64_t sequence;
+          int64_t time;
+          double value;
+          while (decoder.next(sequence, time, value))
+          {
+            if (inRange(sequence))
+              entries.push_back({sequence, index, nullptr, 0, time, value, digits});
+          }
+        }
+        pos += size;
+      }
+
+      while (size_t(end - pos) >= RECORD_HEADER_SIZE)
+      {
+        auto sequence = get<uint64_t>(pos);
+        auto index = get<uint32_t>(pos + 8);
+        auto size = get<uint32_t>(pos + 12);
+        if (size_t(end - pos) - RECORD_HEADER_SIZE < size || index >= items.size())
+        {
+          g_logger << dlib::LERROR << "Cold segment " << segment->m_first << " is damaged";
+          break;
+        }
+
+        if (items[index] && inRange(sequence))
+          entries.push_back({sequence, index, pos + RECORD_HEADER_SIZE, size, 0, 0.0, 0});
+        pos += RECORD_HEADER_SIZE + size;
+      }
+
+      sort(entries.begin(), entries.end(), [forward](const Entry &a, const Entry &b) {
+        return forward ? a.m_sequence < b.m_sequence : a.m_sequence > b.m_sequence;
+      });
+
+      for (const auto &entry : entries)
+      {
+        auto &item = *items[entry.m_index];
+        ObservationPtr observation;
+        if (entry.m_record)
+        {
+          const char *data = entry.m_record;
+          observation.setObject(
+              Observation::deserialize(item, entry.m_sequence, data, data + entry.m_size), true);
+        }
+        else
+        {
+          observation.setObject(Observation::restore(item, entry.m_sequence,
+                                                     formatTimestamp(entry.m_time, entry.m_digits),
+                                                     floatToString(entry.m_value)),
+                                true);
+        }
+
+        if (!observation)
+          continue;
+        if (!visitor(observation))
+          return forward ? entry.m_sequence + 1 : entry.m_sequence - 1;
+      }
+    }
+
+    return forward ? bound : bound - 1;
+  }
+
+  uint64_t ColdStore::from(uint64_t time, uint64_t end) const
+  {
+    lock_guard<mutex> lock(m_mutex);
+    for (const auto &segment : m_segments)
+    {
+      if (segment->m_maxTime >= time)
+        return segment->m_first;
+    }
+    if (m_pending && m_pending->m_maxTime >= time)
+      return m_pending->m_first;
+    return end;
+  }
+
+  uint64_t ColdStore::to(uint64_t time, uint64_t end) const
+  {
+    lock_guard<mutex> lock(m_mutex);
+    for (const auto &segment : m_segments)
+    {
+      if (segment->m_minTime > time)
+        return segment->m_first;
+    }
+    if (m_pending && m_pending->m_minTime > time)
+      return m_pending->m_first;
+    return end;
+  }
+}  // namespace mtconnect
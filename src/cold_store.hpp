@@ -0,0 +1,178 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include "observation.hpp"
+#include "series_codec.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mtconnect
+{
+  // Keeps the observations evicted from the sliding buffer in immutable compressed
+  // segment files so sample requests can reach further back than the buffer. Evicted
+  // observations are collected in a block in memory. A full block is sealed and a
+  // background thread compresses it and writes it to its own segment file.
+  //
+  // Numeric samples are encoded as one column per data item with a SeriesEncoder, the
+  // other observations are kept serialized.
+  //
+  // Each segment header holds the range of sequences, the range of times the agent
+  // received the observations, and the data items in the segment so requests only read
+  // the segments that can match. When the segments exceed the disk budget the oldest
+  // are removed.
+  class ColdStore
+  {
+   public:
+    // Finds the data item of a stored observation, returns nullptr if it is gone
+    using Resolver = std::function<DataItem *(const std::string &id)>;
+
+    // Called with each observation in the order of the request, return false to stop
+    using Visitor = std::function<bool(ObservationPtr &observation)>;
+
+    ColdStore(std::string directory, uint64_t instanceId, uint64_t budget, Resolver resolver,
+              size_t blockSize = 256 * 1024);
+    ~ColdStore();
+
+    // Add an observation evicted from the buffer. Observations must be added in sequence
+    // order, an observation that is already stored is ignored. The received time is in
+    // microseconds.
+    void add(const Observation *observation, uint64_t received);
+
+    // Visit the observations of the data items in the filter. Going forward the
+    // sequences from start up to but not including bound are visited, going backward
+    // the sequences from start down to and including bound. Returns the next sequence
+    // that would have been visited.
+    uint64_t fetch(uint64_t start, uint64_t bound, bool forward,
+                   const std::set<std::string> &filter, const Visitor &visitor);
+
+    // The first sequence in a segment that may have been received at or after time.
+    // Returns end if everything was received before it.
+    uint64_t from(uint64_t time, uint64_t end) const;
+
+    // The first sequence of a segment received after time. Returns end if there is none.
+    uint64_t to(uint64_t time, uint64_t end) const;
+
+    // Seal the block being collected and write all sealed blocks
+    void flush();
+
+    // The first sequence stored, 0 if nothing is stored
+    uint64_t getFirstSequence() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_segments.empty())
+        return m_segments.front()->m_first;
+      return m_pending ? m_pending->m_first : 0;
+    }
+    uint64_t getLastSequence() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_last;
+    }
+    size_t getSegmentCount() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_segments.size();
+    }
+    uint64_t getDiskSize() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_diskSize;
+    }
+
+   protected:
+    struct Segment
+    {
+      uint64_t m_first = 0;
+      uint64_t m_last = 0;
+      uint64_t m_minTime = UINT64_MAX;
+      uint64_t m_maxTime = 0;
+
+      // The data items in the segment, records refer to them by position, and a bit for
+      // each of them by their number in the store
+      std::vector<std::string> m_ids;
+      std::vector<uint64_t> m_bitmap;
+
+      // The file once it is written and the records until then
+      std::string m_path;
+      uint64_t m_size = 0;
+      std::shared_ptr<const std::string> m_records;
+    };
+    using SegmentPtr = std::shared_ptr<Segment>;
+
+    void load();
+    bool encodeSample(uint32_t index, const Observation *observation);
+    std::string payload() const;
+    void seal();
+    void run();
+    bool write(Segment &segment, const std::string &records);
+    std::shared_ptr<const std::string> read(const SegmentPtr &segment);
+    void removeOldest();
+    size_t itemNumber(const std::string &id);
+
+   protected:
+    std::string m_directory;
+    uint64_t m_instanceId;
+    uint64_t m_budget;
+    Resolver m_resolver;
+    size_t m_blockSize;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    // Sealed segments, oldest first, and the ones still to be written
+    std::deque<SegmentPtr> m_segments;
+    std::deque<SegmentPtr> m_queue;
+    bool m_writing = false;
+
+    // The block being collected, the samples of each data item by its position in the
+    // segment and the serialized observations
+    struct Series
+    {
+      int m_digits;
+      SeriesEncoder m_encoder;
+    };
+    SegmentPtr m_pending;
+    std::map<uint32_t, Series> m_pendingSeries;
+    size_t m_pendingSeriesSize = 0;
+    std::string m_pendingRecords;
+    std::unordered_map<std::string, uint32_t> m_pendingIds;
+
+    std::unordered_map<std::string, size_t> m_itemNumbers;
+    uint64_t m_last = 0;
+    uint64_t m_diskSize = 0;
+
+    // The last segment read from disk
+    SegmentPtr m_cachedSegment;
+    std::shared_ptr<const std::string> m_cachedRecords;
+
+    bool m_running = true;
+    std::thread m_thread;
+  };
+}  // namespace mtconnect
@@ -67,6 +67,7 @@ namespace mtconnect
     m_prefix = prefix;
     m_prefixedClass = prefix + ":" + className;
     m_attributes = buildAttributes();
+    buildStreamAttributes();
   }
 
   Component::~Component()
@@ -82,6 +83,18 @@ namespace mtconnect
     m_compositions.clear();
   }
 
+  void Component::buildStreamAttributes()
+  {
+    m_componentStreamAttributes.clear();
+    appendXmlAttribute(m_componentStreamAttributes, "component", m_class);
+    appendXmlAttribute(m_componentStreamAttributes, "name", m_name);
+    appendXmlAttribute(m_componentStreamAttributes, "componentId", m_id);
+
+    m_deviceStreamAttributes.clear();
+    appendXmlAttribute(m_deviceStreamAttributes, "name", m_name);
+    appendXmlAttribute(m_deviceStreamAttributes, "uuid", m_uuid);
+  }
+
   std::map<string, string> Component::buildAttributes() const
   {
     std::map<string, string> attributes;
@@ -75,6 +75,17 @@ namespace mtconnect
       return m_attributes;
     }
 
+    // The escaped attributes of the ComponentStream element of this component and of the
+    // DeviceStream element when it is a device
+    const std::string &getComponentStreamAttributes() const
+    {
+      return m_componentStreamAttributes;
+    }
+    const std::string &getDeviceStreamAttributes() const
+    {
+      return m_deviceStreamAttributes;
+    }
+
     // Return what part of the component it is
     const std::string &getClass() const
     {
@@ -219,7 +230,9 @@ namespace mtconnect
     void reBuildAttributes()
     {
       m_attributes = buildAttributes();
+      buildStreamAttributes();
     }
+    void buildStreamAttributes();
 
    protected:
     // Unique ID for each component
@@ -261,6 +274,8 @@ namespace mtconnect
 
     // The set of attribtues
     std::map<std::string, std::string> m_attributes;
+    std::string m_componentStreamAttributes;
+    std::string m_deviceStreamAttributes;
 
     // References
     std::vector<Reference> m_references;
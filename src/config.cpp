@@ -628,6 +628,48 @@ namespace mtconnect
     m_agent->set_listening_ip(serverIp);
     m_agent->setLogStreamData(get_bool_with_default(reader, "LogStreams", false));
 
+    string policy = get_with_default(reader, "SlowConsumerPolicy", "Disconnect");
+    SlowConsumerPolicy slowConsumerPolicy = DISCONNECT;
+    if (policy == "Coalesce")
+      slowConsumerPolicy = COALESCE;
+    else if (policy == "SkipToCurrent")
+      slowConsumerPolicy = SKIP_TO_CURRENT;
+    else if (policy != "Disconnect")
+      g_logger << LWARN << "Unknown SlowConsumerPolicy " << policy << ", using Disconnect";
+    m_agent->setSlowConsumerPolicy(max(get_with_default(reader, "MaxQueuedBytes", 0), 0),
+                                   slowConsumerPolicy);
+
+    // Any number of slots, BufferSize is a power of two
+    auto bufferSlots = get_with_default(reader, "BufferSlots", 0);
+    if (bufferSlots > 0)
+      m_agent->resizeBuffer(min(bufferSlots, Agent::MAX_BUFFER_SIZE));
+
+    auto bufferMemory = get_with_default(reader, "BufferMemory", 0);
+    if (bufferMemory > 0)
+      m_agent->setBufferMemoryLimit(uint64_t(bufferMemory) * 1024 * 1024);
+
+    // The journal opens the cold store before it is replayed
+    string coldStorage = get_with_default(reader, "ColdStorage", "");
+    auto coldStorageBudget =
+        uint64_t(max(get_with_default(reader, "ColdStorageSize", 1024), 1)) * 1024 * 1024;
+    string journal = get_with_default(reader, "Journal", "");
+    if (!journal.empty())
+    {
+      auto segmentSize = size_t(max(get_with_default(reader, "JournalSegmentSize", 64), 1));
+      m_agent->openJournal(journal, segmentSize * 1024 * 1024,
+                           get_with_default(reader, "JournalSyncInterval", 100ms), coldStorage,
+                           coldStorageBudget);
+    }
+    else if (!coldStorage.empty())
+      m_agent->openColdStore(coldStorage, coldStorageBudget);
+
+    string assetStorage = get_with_default(reader, "AssetStorage", "");
+    if (!assetStorage.empty())
+      m_agent->openAssetLog(assetStorage);
+
+    if (get_bool_with_default(reader, "EpochReclamation", false))
+      m_agent->enableEpochReclamation();
+
     for (auto device : m_agent->getDevices())
       device->m_preserveUuid = defaultPreserve;
 
@@ -17,8 +17,11 @@
 
 #include "connector.hpp"
 
+#include "timer_wheel.hpp"
+
 #include <dlib/logger.h>
 
+#include <algorithm>
 #include <chrono>
 #include <utility>
 
@@ -29,6 +32,8 @@ namespace mtconnect
 {
   static dlib::logger g_logger("input.connector");
 
+  static const char *g_ping = "* PING\n";
+
   // Connector public methods
   Connector::Connector(string server, unsigned int port, seconds legacyTimeout)
       : m_server(std::move(server)),
@@ -77,7 +82,6 @@ namespace mtconnect
   void Connector::connect()
   {
     m_connected = false;
-    const char *ping = "* PING\n";
 
     AutoSignal sig(m_connectionMutex, m_connectionClosed, &m_connectActive);
 
@@ -94,7 +98,7 @@ namespace mtconnect
       m_heartbeats = false;
       g_logger << LDEBUG << "(Port:" << m_localPort << ")"
                << "Sending initial PING";
-      auto status = m_connection->write(ping, strlen(ping));
+      auto status = m_connection->write(g_ping, strlen(g_ping));
       if (status < 0)
       {
         g_logger << LWARN << "(Port:" << m_localPort << ")"
@@ -106,7 +110,10 @@ namespace mtconnect
       connected();
 
       // If we have heartbeats, make sure we receive something every freq milliseconds.
-      m_lastSent = m_lastHeartbeat = system_clock::now();
+      auto now = steady_clock::now();
+      m_lastSent = now;
+      m_lastHeartbeat = now;
+      m_lastReceived = now;
 
       // Make sure connection buffer is clear
       m_buffer.clear();
@@ -133,39 +140,22 @@ namespace mtconnect
 #endif
       }
       g_logger << LTRACE << "(Port:" << m_localPort << ")"
-               << "Heartbeat : " << m_heartbeats;
+               << "Heartbeat : " << m_heartbeats.load();
       g_logger << LTRACE << "(Port:" << m_localPort << ")"
                << "Heartbeat Freq: " << m_heartbeatFrequency.count();
+
+      // Heartbeats and the legacy timeout are checked by a timer on the shared timer
+      // wheel. When a timeout expires the timer shuts the connection down, so the read
+      // can block until data arrives.
+      m_timedOut = false;
+      bool heartbeats = false;
+      scheduleTimeouts(now + m_legacyTimeout);
+
       // Read from the socket, read is a blocking call
       while (m_connected)
       {
-        auto now = system_clock::now();
-        milliseconds timeout(0);
-        if (m_heartbeats)
-        {
-          timeout = m_heartbeatFrequency - duration_cast<milliseconds>(now - m_lastSent);
-          g_logger << LTRACE << "(Port:" << m_localPort << ")"
-                   << "Heartbeat Send Countdown: " << timeout.count();
-        }
-        else
-        {
-          timeout = m_legacyTimeout;
-          g_logger << LTRACE << "(Port:" << m_localPort << ")"
-                   << "Legacy Timeout: " << timeout.count();
-        }
-
-        if (timeout < milliseconds{0})
-          timeout = milliseconds{1};
         sockBuf[0] = 0;
-
-        if (m_connected)
-          status = m_connection->read(sockBuf, SOCKET_BUFFER_SIZE, timeout.count());
-        else
-        {
-          g_logger << LDEBUG << "(Port:" << m_localPort << ")"
-                   << "Connection was closed, exiting adapter connect";
-          break;
-        }
+        status = m_connection->read(sockBuf, SOCKET_BUFFER_SIZE);
 
         if (!m_connected)
         {
@@ -176,52 +166,36 @@ namespace mtconnect
 
         if (status > 0)
         {
+          m_lastReceived = steady_clock::now();
+
           // Give a null terminator for the end of buffer
           sockBuf[status] = '\0';
           parseBuffer(sockBuf);
+
+          // Start sending pings once the adapter has answered the first one
+          if (m_heartbeats && !heartbeats)
+          {
+            heartbeats = true;
+            startPings();
+            scheduleTimeouts(steady_clock::now() + m_heartbeatFrequency);
+          }
         }
-        else if (status == TIMEOUT && !m_heartbeats && (system_clock::now() - now) >= timeout)
+        else if (m_timedOut)
         {
-          // We don't stop on heartbeats, but if we have a legacy timeout, then we stop.
-          g_logger << LERROR << "(Port:" << m_localPort << ")"
-                   << "connect: Did not receive data for over: "
-                   << duration_cast<seconds>(timeout).count() << " seconds";
+          // The timer has already logged the reason
           break;
         }
-        else if (status != TIMEOUT)  // Something other than timeout occurred
+        else
         {
           g_logger << LERROR << "(Port:" << m_localPort << ")"
                    << "connect: Socket error, disconnecting";
           break;
         }
-
-        if (m_heartbeats)
-        {
-          now = system_clock::now();
-          if ((now - m_lastHeartbeat) > (m_heartbeatFrequency * 2))
-          {
-            g_logger << LERROR << "(Port:" << m_localPort << ")"
-                     << "connect: Did not receive heartbeat for over: "
-                     << (m_heartbeatFrequency * 2).count();
-            break;
-          }
-          else if ((now - m_lastSent) >= m_heartbeatFrequency)
-          {
-            std::lock_guard<std::mutex> lock(m_commandLock);
-            g_logger << LDEBUG << "(Port:" << m_localPort << ")"
-                     << "Sending a PING for " << m_server << " on port " << m_port;
-            status = m_connection->write(ping, strlen(ping));
-            if (status <= 0)
-            {
-              g_logger << LERROR << "(Port:" << m_localPort << ")"
-                       << "connect: Could not write heartbeat: " << status;
-              break;
-            }
-            m_lastSent = now;
-          }
-        }
       }
 
+      stopTimeouts();
+      stopPings();
+
       g_logger << LERROR << "(Port:" << m_localPort << ")"
                << "connect: Connection exited with status: " << status;
       m_connectActive = false;
@@ -229,16 +203,171 @@ namespace mtconnect
     }
     catch (dlib::socket_error &e)
     {
+      stopTimeouts();
+      stopPings();
       g_logger << LWARN << "(Port:" << m_localPort << ")"
                << "connect: Socket exception: " << e.what();
     }
     catch (exception &e)
     {
+      stopTimeouts();
+      stopPings();
       g_logger << LERROR << "(Port:" << m_localPort << ")"
                << "connect: Exception in connect: " << e.what();
     }
   }
 
+  void Connector::scheduleTimeouts(steady_clock::time_point deadline)
+  {
+    auto &wheel = TimerWheel::instance();
+    TimerWheel::TimerId previous;
+
+    {
+      std::lock_guard<std::mutex> lock(m_timerLock);
+      previous = m_timer;
+      auto generation = ++m_timerGeneration;
+      m_timersActive = true;
+      m_timer = wheel.schedule(deadline, [this, generation]() { checkTimeouts(generation); });
+    }
+
+    // A previous timer that already fired will see the generation has changed
+    if (previous)
+      wheel.cancel(previous);
+  }
+
+  void Connector::stopTimeouts()
+  {
+    TimerWheel::TimerId timer;
+
+    {
+      std::lock_guard<std::mutex> lock(m_timerLock);
+      m_timersActive = false;
+      timer = m_timer;
+      m_timer = 0;
+    }
+
+    // Waits for a running check so it cannot touch the connection after we return
+    if (timer)
+      TimerWheel::instance().cancel(timer);
+  }
+
+  // Shut the connection down so the blocking read returns, the timer lock must be held
+  void Connector::timeout()
+  {
+    m_timedOut = true;
+    m_timersActive = false;
+    m_connection->shutdown();
+  }
+
+  // Runs on the timer wheel thread
+  void Connector::checkTimeouts(uint64_t generation)
+  {
+    std::lock_guard<std::mutex> lock(m_timerLock);
+    if (!m_timersActive || generation != m_timerGeneration)
+      return;
+
+    auto now = steady_clock::now();
+    steady_clock::time_point next;
+    if (m_heartbeats)
+    {
+      auto lastHeartbeat = m_lastHeartbeat.load();
+      if ((now - lastHeartbeat) > (m_heartbeatFrequency * 2))
+      {
+        g_logger << LERROR << "(Port:" << m_localPort << ")"
+                 << "connect: Did not receive heartbeat for over: "
+                 << (m_heartbeatFrequency * 2).count();
+        timeout();
+        return;
+      }
+      else if ((now - m_lastSent) >= m_heartbeatFrequency)
+      {
+        // A ping that stalls is caught by the heartbeat timeout, which shuts the
+        // connection down and releases the write
+        m_pingDue = true;
+        m_pingCond.notify_one();
+        m_lastSent = now;
+      }
+
+      next = min(m_lastSent + m_heartbeatFrequency, lastHeartbeat + m_heartbeatFrequency * 2);
+    }
+    else
+    {
+      // We don't stop on heartbeats, but if we have a legacy timeout, then we stop.
+      auto lastReceived = m_lastReceived.load();
+      if ((now - lastReceived) >= m_legacyTimeout)
+      {
+        g_logger << LERROR << "(Port:" << m_localPort << ")"
+                 << "connect: Did not receive data for over: "
+                 << duration_cast<seconds>(m_legacyTimeout).count() << " seconds";
+        timeout();
+        return;
+      }
+
+      next = lastReceived + m_legacyTimeout;
+    }
+
+    m_timer = TimerWheel::instance().schedule(
+        next, [this, generation]() { checkTimeouts(generation); });
+  }
+
+  void Connector::startPings()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_timerLock);
+      m_pinging = true;
+      m_pingDue = false;
+    }
+    m_pingThread = thread(&Connector::sendPings, this);
+  }
+
+  // The timeouts must be stopped first so the timer no longer signals
+  void Connector::stopPings()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_timerLock);
+      m_pinging = false;
+      m_pingCond.notify_one();
+    }
+
+    // The connection is going away, shutting it down releases a ping stuck in the write
+    if (m_pingThread.joinable())
+    {
+      m_connection->shutdown();
+      m_pingThread.join();
+    }
+  }
+
+  void Connector::sendPings()
+  {
+    std::unique_lock<std::mutex> lock(m_timerLock);
+    while (true)
+    {
+      m_pingCond.wait(lock, [this]() { return m_pingDue || !m_pinging; });
+      if (!m_pinging)
+        break;
+      m_pingDue = false;
+      lock.unlock();
+
+      long status;
+      {
+        std::lock_guard<std::mutex> command(m_commandLock);
+        g_logger << LDEBUG << "(Port:" << m_localPort << ")"
+                 << "Sending a PING for " << m_server << " on port " << m_port;
+        status = m_connection->write(g_ping, strlen(g_ping));
+      }
+
+      lock.lock();
+      if (status <= 0)
+      {
+        g_logger << LERROR << "(Port:" << m_localPort << ")"
+                 << "connect: Could not write heartbeat: " << status;
+        if (m_timersActive)
+          timeout();
+        break;
+      }
+    }
+  }
+
   void Connector::parseBuffer(const char *buffer)
   {
     // Append the temporary buffer to the socket buffer
@@ -280,7 +409,7 @@ namespace mtconnect
             {
               g_logger << LDEBUG << "(Port:" << m_localPort << ")"
                        << "Received a PONG for " << m_server << " on port " << m_port;
-              auto delta = date::floor<milliseconds>(system_clock::now() - m_lastHeartbeat);
+              auto delta = date::floor<milliseconds>(steady_clock::now() - m_lastHeartbeat.load());
               g_logger << LDEBUG << "(Port:" << m_localPort << ")"
                        << "    Time since last heartbeat: " << delta.count() << "ms";
             }
@@ -288,7 +417,7 @@ namespace mtconnect
               startHeartbeats(line);
             else
             {
-              m_lastHeartbeat = system_clock::now();
+              m_lastHeartbeat = steady_clock::now();
             }
           }
           else
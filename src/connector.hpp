@@ -22,8 +22,11 @@
 #include <dlib/server.h>
 #include <dlib/sockets.h>
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
 
 #define HEARTBEAT_FREQ 60000
 
@@ -99,6 +102,18 @@ namespace mtconnect
     void startHeartbeats(const std::string &buf);
     void close();
 
+    // Heartbeats and the legacy timeout are checked by a timer on the timer wheel
+    void scheduleTimeouts(std::chrono::steady_clock::time_point deadline);
+    void stopTimeouts();
+    void checkTimeouts(uint64_t generation);
+    void timeout();
+
+    // Pings are written by the connector's own thread, the timer only signals it, so an
+    // adapter that stops reading cannot stall the timer wheel
+    void startPings();
+    void stopPings();
+    void sendPings();
+
    protected:
     // Name of the server to connect to
     std::string m_server;
@@ -120,11 +135,25 @@ namespace mtconnect
     bool m_realTime;
 
     // Heartbeats
-    bool m_heartbeats = false;
+    std::atomic_bool m_heartbeats{false};
     std::chrono::milliseconds m_heartbeatFrequency = std::chrono::milliseconds{HEARTBEAT_FREQ};
     std::chrono::milliseconds m_legacyTimeout = std::chrono::milliseconds{600000};
-    std::chrono::time_point<std::chrono::system_clock> m_lastHeartbeat;
-    std::chrono::time_point<std::chrono::system_clock> m_lastSent;
+    std::atomic<std::chrono::steady_clock::time_point> m_lastHeartbeat;
+    std::atomic<std::chrono::steady_clock::time_point> m_lastReceived;
+    std::chrono::steady_clock::time_point m_lastSent;
+
+    // The timeout timer, a new generation invalidates a timer that already fired
+    std::mutex m_timerLock;
+    uint64_t m_timer = 0;
+    uint64_t m_timerGeneration = 0;
+    bool m_timersActive = false;
+    std::atomic_bool m_timedOut{false};
+
+    // Signalled by the timer under the timer lock when a ping is due
+    std::condition_variable m_pingCond;
+    std::thread m_pingThread;
+    bool m_pingDue = false;
+    bool m_pinging = false;
 
     std::mutex m_commandLock;
 
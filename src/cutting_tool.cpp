@@ -29,7 +29,8 @@ namespace mtconnect
 
   void CuttingTool::addValue(const CuttingToolValuePtr value)
   {
-    m_content.clear();
+    std::lock_guard<std::recursive_mutex> lock(m_fragmentLock);
+    changed();
 
     // Check for keys...
     if (value->m_key == "Location")
@@ -63,7 +64,8 @@ namespace mtconnect
 
   void CuttingTool::updateValue(const std::string &inputKey, const std::string &value)
   {
-    m_content.clear();
+    std::lock_guard<std::recursive_mutex> lock(m_fragmentLock);
+    changed();
 
     if (inputKey == "Location")
       m_keys[inputKey] = value;
@@ -79,7 +81,7 @@ namespace mtconnect
         {
           if (life->m_properties.count(sel) > 0 && life->m_properties[sel] == val)
           {
-            life->m_value = value;
+            life->setValue(value);
             break;
           }
         }
@@ -91,9 +93,9 @@ namespace mtconnect
           if (item->m_identity.count(sel) > 0 && val == item->m_identity[sel])
           {
             if (item->m_values.count(key) > 0)
-              item->m_values[key]->m_value = value;
+              item->m_values[key]->setValue(value);
             else if (item->m_measurements.count(key) > 0)
-              item->m_measurements[key]->m_value = value;
+              item->m_measurements[key]->setValue(value);
 
             break;
           }
@@ -116,16 +118,17 @@ namespace mtconnect
       else
       {
         if (m_values.count(inputKey) > 0)
-          m_values[inputKey]->m_value = value;
+          m_values[inputKey]->setValue(value);
         else if (m_measurements.count(inputKey) > 0)
-          m_measurements[inputKey]->m_value = value;
+          m_measurements[inputKey]->setValue(value);
       }
     }
   }
 
   void CuttingTool::addIdentity(const std::string &key, const std::string &value)
   {
-    m_content.clear();
+    std::lock_guard<std::recursive_mutex> lock(m_fragmentLock);
+    changed();
 
     Asset::addIdentity(key, value);
 
@@ -133,22 +136,6 @@ namespace mtconnect
       m_keys[key] = value;
   }
 
-  std::string &CuttingTool::getContent(const Printer *aPrinter)
-  {
-    if (m_content.empty())
-    {
-      const auto serialNumberPos = m_identity.find("serialNumber");
-      if (serialNumberPos == m_identity.end())
-        Asset::addIdentity("serialNumber", m_assetId);
-      else if (serialNumberPos->second.empty())
-        Asset::addIdentity("serialNumber", m_assetId);
-
-      m_content = aPrinter->printCuttingTool(this);
-    }
-
-    return m_content;
-  }
-
   CuttingToolValue::~CuttingToolValue() = default;
 
   CuttingItem::~CuttingItem() = default;
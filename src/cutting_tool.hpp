@@ -50,10 +50,21 @@ namespace mtconnect
 
     ~CuttingToolValue() override;
 
+    // Change the value and drop the elements printed for the old value
+    void setValue(const std::string &value)
+    {
+      m_value = value;
+      m_fragments.clear();
+    }
+
    public:
     std::map<std::string, std::string> m_properties;
     std::string m_key;
     std::string m_value;
+
+    // The element as each printer printed it, so a tool that changed only prints the
+    // values that changed
+    std::map<const Printer *, std::string> m_fragments;
   };
 
   class CuttingItem : public RefCounted
@@ -82,12 +93,6 @@ namespace mtconnect
     void addValue(const CuttingToolValuePtr value);
     void updateValue(const std::string &key, const std::string &value);
 
-    std::string &getContent(const Printer *aPrinter) override;
-    void changed() override
-    {
-      m_content.clear();
-    }
-
    public:
     std::vector<std::string> m_status;
     std::map<std::string, CuttingToolValuePtr> m_values;
@@ -174,6 +174,15 @@ namespace mtconnect
 
     m_component = nullptr;
     m_attributes = buildAttributes();
+
+    // The attributes every observation prints first, in the order of Observation
+    appendXmlAttribute(m_xmlAttributes, "dataItemId", m_id);
+    appendXmlAttribute(m_xmlAttributes, "name", m_name);
+    appendXmlAttribute(m_xmlAttributes, "compositionId", m_compositionId);
+    appendXmlAttribute(m_xmlAttributes, "subType", m_subType);
+    appendXmlAttribute(m_xmlAttributes, "statistic", m_statistic);
+    if (m_category == CONDITION)
+      appendXmlAttribute(m_xmlAttributes, "type", m_type);
   }
 
   DataItem::~DataItem() = default;
@@ -345,6 +354,36 @@ namespace mtconnect
     }
   }
 
+  uint32_t DataItem::internValue(const string &value)
+  {
+    if (value == "UNAVAILABLE")
+      return StringPool::UNAVAILABLE;
+
+    for (size_t i = 0; i < m_values.size(); i++)
+    {
+      if (m_values[i] == value)
+        return m_valueIds[i];
+    }
+
+    // Only events with a value from a vocabulary, like EXECUTION or PROGRAM
+    if (m_category != EVENT || m_isMessage || m_isAlarm || m_isAssetChanged ||
+        m_isAssetRemoved || (m_representation != VALUE && m_representation != DISCRETE))
+      return StringPool::NONE;
+
+    // Strings already in the pool do not count against the data item
+    auto id = StringPool::find(value);
+    if (id != StringPool::NONE ||
+        m_internedValues.load(std::memory_order_relaxed) >= MaxInternedValues)
+      return id;
+
+    bool added;
+    id = StringPool::intern(value, &added);
+    if (added)
+      m_internedValues.fetch_add(1, std::memory_order_relaxed);
+
+    return id;
+  }
+
   string DataItem::convertValue(const string &value)
   {
     // Check if the type is an alarm or if it doesn't have units
@@ -357,23 +396,23 @@ namespace mtconnect
     {
       if (m_threeD)
       {
-        ostringstream result;
+        string result;
         string::size_type start = 0ul;
 
         for (int i = 0; i < 3; i++)
         {
           auto pos = value.find(' ', start);
-          result << floatToString((atof(value.substr(start, pos).c_str()) + m_conversionOffset) *
+          appendFloat(result, (atof(value.substr(start, pos).c_str()) + m_conversionOffset) *
                                   m_conversionFactor);
 
           if (pos != string::npos)
           {
             start = value.find_first_not_of(' ', pos);
-            result << " ";
+            result += ' ';
           }
         }
 
-        return result.str();
+        return result;
       }
       else
       {
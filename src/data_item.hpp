@@ -20,9 +20,11 @@
 #include "component.hpp"
 #include "definitions.hpp"
 #include "globals.hpp"
+#include "string_pool.hpp"
 
 #include <dlib/threads.h>
 
+#include <atomic>
 #include <map>
 
 #ifdef PASCAL
@@ -73,6 +75,23 @@ namespace mtconnect
       return m_attributes;
     }
 
+    // The position of the data item when all data items are sorted the way they are
+    // printed, 0 until the data items are ordered
+    unsigned int getOrdinal() const
+    {
+      return m_ordinal;
+    }
+    void setOrdinal(unsigned int ordinal)
+    {
+      m_ordinal = ordinal;
+    }
+
+    // The escaped attributes of this data item's observation elements
+    const std::string &getXmlAttributes() const
+    {
+      return m_xmlAttributes;
+    }
+
     // Getter methods for data item specs
     const std::string &getId() const
     {
@@ -402,10 +421,18 @@ namespace mtconnect
     }
     void addConstrainedValue(std::string value)
     {
+      m_valueIds.emplace_back(StringPool::intern(value));
       m_values.emplace_back(value);
       m_hasConstraints = true;
     }
 
+    // The id of the value in the StringPool, StringPool::NONE if observations keep their own
+    // copy. UNAVAILABLE, the constrained values and the values of events with a controlled
+    // vocabulary are interned, a data item adds at most MaxInternedValues strings so
+    // counters and free text do not fill the pool.
+    uint32_t internValue(const std::string &value);
+    static constexpr unsigned int MaxInternedValues = 64;
+
     void setMinmumDelta(double value)
     {
       m_filterValue = value;
@@ -523,8 +550,12 @@ namespace mtconnect
     std::string m_maximum;
     std::string m_minimum;
     std::vector<std::string> m_values;
+    std::vector<uint32_t> m_valueIds;
     bool m_hasConstraints;
 
+    // The strings this data item added to the StringPool
+    std::atomic<unsigned int> m_internedValues{0};
+
     double m_filterValue;
     // Period filter, in seconds
     double m_filterPeriod;
@@ -533,6 +564,7 @@ namespace mtconnect
 
     // Component that data item is associated with
     Component *m_component;
+    unsigned int m_ordinal = 0;
 
     // Duplicate and filter checking
     std::string m_lastValue;
@@ -541,6 +573,7 @@ namespace mtconnect
 
     // Attrubutes
     std::map<std::string, std::string> m_attributes;
+    std::string m_xmlAttributes;
 
     // The data source for this data item
     Adapter *m_dataSource;
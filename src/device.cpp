@@ -20,6 +20,8 @@
 #include <dlib/logger.h>
 #include <dlib/misc_api.h>
 
+#include <algorithm>
+
 using namespace std;
 
 namespace mtconnect
@@ -90,4 +92,20 @@ namespace mtconnect
 
     return nullptr;
   }
+
+  void orderDataItems(const std::vector<Device *> &devices)
+  {
+    vector<DataItem *> items;
+    for (const auto device : devices)
+    {
+      for (const auto &item : device->getDeviceDataItems())
+        items.emplace_back(item.second);
+    }
+
+    sort(items.begin(), items.end(), [](DataItem *a, DataItem *b) { return *a < *b; });
+
+    unsigned int ordinal = 1;
+    for (auto item : items)
+      item->setOrdinal(ordinal++);
+  }
 }  // namespace mtconnect
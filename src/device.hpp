@@ -95,4 +95,8 @@ namespace mtconnect
     std::map<std::string, DataItem *> m_deviceDataItemsBySource;
     std::map<std::string, Component *> m_componentsById;
   };
+
+  // Number the data items of the devices in the order observations are printed: by device,
+  // component, category and id. Call again after data items are added.
+  void orderDataItems(const std::vector<Device *> &devices);
 }  // namespace mtconnect
@@ -0,0 +1,127 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+
+#include "epoch_reclaimer.hpp"
+
+#include <thread>
+
+using namespace std;
+
+namespace mtconnect
+{
+  EpochReclaimer::EpochReclaimer(size_t slots, size_t batch)
+    : m_slots(new Slot[slots > 0 ? slots : 1]), m_slotCount(slots > 0 ? slots : 1), m_batch(batch)
+  {
+  }
+
+  EpochReclaimer::~EpochReclaimer()
+  {
+    // Deleting an object can retire the objects it referenced
+    while (true)
+    {
+      decltype(m_retired) retired;
+      {
+        lock_guard<mutex> lock(m_mutex);
+        retired.swap(m_retired);
+      }
+      if (retired.empty())
+        break;
+
+      for (auto &object : retired)
+        delete object.second;
+    }
+  }
+
+  size_t EpochReclaimer::pin()
+  {
+    // Each thread starts looking at its own slot so readers rarely compete for one
+    static atomic<size_t> s_threads{0};
+    thread_local size_t t_slot = s_threads.fetch_add(1);
+
+    while (true)
+    {
+      // An epoch that is already old when it is published only keeps objects longer
+      auto epoch = m_epoch.load();
+      for (size_t i = 0; i < m_slotCount; i++)
+      {
+        auto slot = (t_slot + i) % m_slotCount;
+        uint64_t free = 0;
+        if (m_slots[slot].m_epoch.load(memory_order_relaxed) == 0 &&
+            m_slots[slot].m_epoch.compare_exchange_strong(free, epoch))
+          return slot;
+      }
+
+      this_thread::yield();
+    }
+  }
+
+  void EpochReclaimer::unpin(size_t slot)
+  {
+    m_slots[slot].m_epoch.store(0, memory_order_release);
+  }
+
+  void EpochReclaimer::retire(RefCounted *object)
+  {
+    bool full;
+    {
+      lock_guard<mutex> lock(m_mutex);
+      m_retired.emplace_back(m_epoch.load(), object);
+      full = m_retired.size() >= m_batch;
+    }
+
+    // Deleting retires the objects the deleted ones referenced, they wait for the next batch
+    thread_local bool t_reclaiming = false;
+    if (full && !t_reclaiming)
+    {
+      t_reclaiming = true;
+      reclaim();
+      t_reclaiming = false;
+    }
+  }
+
+  void EpochReclaimer::reclaim()
+  {
+    // Readers that pin from now on cannot see anything retired so far
+    m_epoch.fetch_add(1);
+
+    auto oldest = UINT64_MAX;
+    for (size_t i = 0; i < m_slotCount; i++)
+    {
+      auto epoch = m_slots[i].m_epoch.load();
+      if (epoch != 0 && epoch < oldest)
+        oldest = epoch;
+    }
+
+    vector<RefCounted *> expired;
+    {
+      lock_guard<mutex> lock(m_mutex);
+      auto keep = m_retired.begin();
+      for (auto &object : m_retired)
+      {
+        if (object.first < oldest)
+          expired.emplace_back(object.second);
+        else
+          *keep++ = object;
+      }
+      m_retired.erase(keep, m_retired.end());
+    }
+
+    for (auto object : expired)
+      delete object;
+  }
+}  // namespace mtconnect
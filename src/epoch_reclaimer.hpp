@@ -0,0 +1,106 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+
+#pragma once
+
+#include "ref_counted.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace mtconnect
+{
+  // Epoch based reclamation of reference counted objects. Readers pin the current epoch
+  // with a Guard and can then use raw pointers to objects they read from shared structures
+  // without taking references. An object whose last reference is dropped is retired
+  // instead of deleted, it is deleted once every reader that pinned an epoch at or before
+  // its retirement has released its guard.
+  class EpochReclaimer
+  {
+   public:
+    // Readers that can pin at the same time and the retired objects collected before an
+    // attempt to delete them
+    EpochReclaimer(size_t slots = 128, size_t batch = 256);
+
+    // Deletes all retired objects, there must be no readers left
+    ~EpochReclaimer();
+
+    // Pins an epoch for the lifetime of the guard. A guard without a reclaimer does nothing
+    // so readers can use one whether or not reclamation is enabled.
+    class Guard
+    {
+     public:
+      explicit Guard(EpochReclaimer *reclaimer) : m_reclaimer(reclaimer)
+      {
+        if (m_reclaimer)
+          m_slot = m_reclaimer->pin();
+      }
+      ~Guard()
+      {
+        if (m_reclaimer)
+          m_reclaimer->unpin(m_slot);
+      }
+      Guard(const Guard &) = delete;
+      Guard &operator=(const Guard &) = delete;
+
+     protected:
+      EpochReclaimer *m_reclaimer;
+      size_t m_slot = 0;
+    };
+
+    // Delete the object once no reader can be using it
+    void retire(RefCounted *object);
+
+    // Advance the epoch and delete the retired objects no pinned reader can see
+    void reclaim();
+
+    size_t getRetiredCount() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_retired.size();
+    }
+    uint64_t getEpoch() const
+    {
+      return m_epoch.load();
+    }
+
+   protected:
+    size_t pin();
+    void unpin(size_t slot);
+
+   protected:
+    // The epoch a reader pinned, 0 when the slot is free. Each slot has its own cache line
+    // so readers on different cores do not share one.
+    struct alignas(64) Slot
+    {
+      std::atomic<uint64_t> m_epoch{0};
+    };
+
+    std::atomic<uint64_t> m_epoch{1};
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_slotCount;
+    size_t m_batch;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::pair<uint64_t, RefCounted *>> m_retired;
+  };
+}  // namespace mtconnect
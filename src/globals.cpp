@@ -25,7 +25,6 @@
 #include <map>
 #include <mutex>
 #include <set>
-#include <sstream>
 #include <string>
 #include <vector>
 
@@ -92,30 +91,43 @@ namespace mtconnect
 
   string int64ToString(uint64_t i)
   {
-    ostringstream stm;
-    stm << i;
-    return stm.str();
+    char buffer[NumberBufferSize];
+    return string(buffer, formatInteger(buffer, i));
   }
 
   string int32ToString(int i)
   {
-    ostringstream stm;
-    stm << i;
-    return stm.str();
+    char buffer[NumberBufferSize];
+    return string(buffer, formatInteger(buffer, i));
   }
 
   string intToString(unsigned int i)
   {
-    ostringstream stm;
-    stm << i;
-    return stm.str();
+    char buffer[NumberBufferSize];
+    return string(buffer, formatInteger(buffer, i));
   }
 
   string floatToString(double f)
   {
-    char s[32] = {0};
-    sprintf(s, "%.7g", f);
-    return (string)s;
+    char buffer[NumberBufferSize];
+    return string(buffer, formatFloat(buffer, f));
+  }
+
+  char *formatFloat(char *buffer, double value, int precision)
+  {
+#if defined(__cpp_lib_to_chars)
+    // The general format with a precision is specified to match printf's %g
+    return to_chars(buffer, buffer + NumberBufferSize, value, chars_format::general, precision)
+        .ptr;
+#else
+    return buffer + snprintf(buffer, NumberBufferSize, "%.*g", precision, value);
+#endif
+  }
+
+  void appendFloat(string &out, double value, int precision)
+  {
+    char buffer[NumberBufferSize];
+    out.append(buffer, formatFloat(buffer, value, precision));
   }
 
   string toUpperCase(string &text)
@@ -236,6 +248,54 @@ namespace mtconnect
     }
   }
 
+  void appendXmlAttribute(string &out, const char *name, const string &value)
+  {
+    if (value.empty())
+      return;
+
+    out += ' ';
+    out += name;
+    out += "=\"";
+    for (auto c : value)
+    {
+      switch (c)
+      {
+        case '&':
+          out += "&amp;";
+          break;
+
+        case '<':
+          out += "&lt;";
+          break;
+
+        case '>':
+          out += "&gt;";
+          break;
+
+        case '"':
+          out += "&quot;";
+          break;
+
+        case '\t':
+          out += "&#9;";
+          break;
+
+        case '\n':
+          out += "&#10;";
+          break;
+
+        case '\r':
+          out += "&#13;";
+          break;
+
+        default:
+          out += c;
+          break;
+      }
+    }
+    out += '"';
+  }
+
   uint64_t parseTimeMicro(const std::string &aTime)
   {
     struct tm timeinfo;
@@ -40,6 +40,15 @@
 #include <map>
 #include <sstream>
 #include <string>
+#include <type_traits>
+
+// Floating point to_chars needs libstdc++ 11 or a recent libc++, older libraries fall back
+// to snprintf
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
 
 #ifdef _WINDOWS
 #define ISNAN(x) _isnan(x)
@@ -100,6 +109,46 @@ namespace mtconnect
   // Convert a float to string
   std::string floatToString(double f);
 
+  // Write a number into a buffer of at least NumberBufferSize characters without streams or
+  // locales and return the end of the text. Floats are written like printf's %.<precision>g.
+  const size_t NumberBufferSize = 32;
+  template <typename T>
+  inline char *formatInteger(char *buffer, T value)
+  {
+    using Unsigned = typename std::make_unsigned<T>::type;
+    auto magnitude = Unsigned(value);
+    if constexpr (std::is_signed<T>::value)
+    {
+      if (value < 0)
+      {
+        *buffer++ = '-';
+        magnitude = Unsigned(0) - magnitude;
+      }
+    }
+
+    char digits[NumberBufferSize];
+    char *start = digits + NumberBufferSize;
+    do
+    {
+      *--start = char('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+
+    auto length = digits + NumberBufferSize - start;
+    std::char_traits<char>::copy(buffer, start, size_t(length));
+    return buffer + length;
+  }
+  char *formatFloat(char *buffer, double value, int precision = 7);
+
+  // Append a number to a string
+  template <typename T>
+  inline void appendInteger(std::string &out, T value)
+  {
+    char buffer[NumberBufferSize];
+    out.append(buffer, formatInteger(buffer, value));
+  }
+  void appendFloat(std::string &out, double value, int precision = 7);
+
   // Convert a string to the same string with all upper case letters
   std::string toUpperCase(std::string &text);
 
@@ -128,6 +177,10 @@ namespace mtconnect
   // Replace illegal XML characters with the correct corresponding characters
   void replaceIllegalCharacters(std::string &data);
 
+  // Append name="value" with a leading space, escaping the value the way libxml2 escapes
+  // attribute values. Nothing is appended for an empty value.
+  void appendXmlAttribute(std::string &out, const char *name, const std::string &value);
+
   std::string addNamespace(const std::string aPath, const std::string aPrefix);
 
   bool isMTConnectUrn(const char *aUrn);
@@ -0,0 +1,579 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#include "journal.hpp"
+
+#include <dlib/dir_nav.h>
+#include <dlib/logger.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Don't include WinSock.h when processing <windows.h>
+#ifdef _WINDOWS
+#define _WINSOCKAPI_
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace mtconnect
+{
+  static dlib::logger g_logger("journal");
+
+  // Segment header: magic, instance id, first sequence and a reserved word
+  static const char g_magic[8] = {'M', 'T', 'C', 'J', 'R', 'N', 'L', '1'};
+  static const size_t HEADER_SIZE = 32;
+
+  // Record: payload size and checksum followed by the payload of the kind, sequence,
+  // received time, and the lengths and bytes of the data item id, time and value.
+  static const size_t RECORD_HEADER_SIZE = 8;
+  static const size_t PAYLOAD_FIXED_SIZE = 1 + 8 + 8 + 4 * 3;
+
+  enum RecordKind : uint8_t
+  {
+    SNAPSHOT = 1,
+    OBSERVATION = 2
+  };
+
+  // Limit the records kept for the state of a data item that accumulates, like a data
+  // set that is never reset.
+  static const size_t MAX_STATE_RECORDS = 256;
+
+  static size_t recordSize(const Journal::Record &record)
+  {
+    return RECORD_HEADER_SIZE + PAYLOAD_FIXED_SIZE + record.m_dataItemId.size() +
+           record.m_time.size() + record.m_value.size();
+  }
+
+  static uint32_t checksum(const char *data, size_t len)
+  {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+      hash ^= (unsigned char)data[i];
+      hash *= 16777619u;
+    }
+    return hash;
+  }
+
+  template <typename T>
+  static inline void put(char *&pos, T value)
+  {
+    memcpy(pos, &value, sizeof(T));
+    pos += sizeof(T);
+  }
+
+  static inline void put(char *&pos, const string &value)
+  {
+    memcpy(pos, value.data(), value.size());
+    pos += value.size();
+  }
+
+  template <typename T>
+  static inline T get(const char *&pos)
+  {
+    T value;
+    memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+  }
+
+  struct Journal::MappedFile
+  {
+    ~MappedFile()
+    {
+      unmap();
+    }
+
+    // Map a new file of size for writing, or an existing file for reading
+    bool open(const string &path, size_t size, bool writable)
+    {
+      m_path = path;
+      m_writable = writable;
+
+#ifdef _WINDOWS
+      m_file = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                           writable ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                           nullptr);
+      if (m_file == INVALID_HANDLE_VALUE)
+        return false;
+
+      if (writable)
+        m_size = size;
+      else
+      {
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(m_file, &fileSize))
+          return false;
+        m_size = size_t(fileSize.QuadPart);
+        if (m_size == 0)
+          return true;
+      }
+
+      m_mapping = CreateFileMappingA(m_file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                     DWORD(uint64_t(m_size) >> 32), DWORD(m_size & 0xFFFFFFFF),
+                                     nullptr);
+      if (!m_mapping)
+        return false;
+
+      m_data = (char *)MapViewOfFile(m_mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0,
+                                     m_size);
+      return m_data != nullptr;
+#else
+      m_fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+      if (m_fd < 0)
+        return false;
+
+      if (writable)
+      {
+        if (ftruncate(m_fd, off_t(size)) != 0)
+          return false;
+        m_size = size;
+      }
+      else
+      {
+        struct stat fileStat;
+        if (fstat(m_fd, &fileStat) != 0)
+          return false;
+        m_size = size_t(fileStat.st_size);
+        if (m_size == 0)
+          return true;
+      }
+
+      auto data = mmap(nullptr, m_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+                       m_fd, 0);
+      if (data == MAP_FAILED)
+        return false;
+      m_data = (char *)data;
+      return true;
+#endif
+    }
+
+    void sync(size_t from, size_t to)
+    {
+      if (!m_data || to <= from)
+        return;
+
+#ifdef _WINDOWS
+      FlushViewOfFile(m_data + from, to - from);
+      FlushFileBuffers(m_file);
+#else
+      // msync requires a page aligned address
+      static const size_t page = size_t(sysconf(_SC_PAGESIZE));
+      auto start = from / page * page;
+      if (msync(m_data + start, to - start, MS_SYNC) != 0)
+        g_logger << dlib::LERROR << "Cannot sync journal segment " << m_path;
+#endif
+    }
+
+    // Unmap the file, a written file is truncated to the data appended to it
+    void unmap()
+    {
+#ifdef _WINDOWS
+      if (m_data)
+        UnmapViewOfFile(m_data);
+      if (m_mapping)
+        CloseHandle(m_mapping);
+      if (m_file != INVALID_HANDLE_VALUE)
+      {
+        if (m_writable)
+        {
+          LARGE_INTEGER end;
+          end.QuadPart = m_used;
+          SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN);
+          SetEndOfFile(m_file);
+        }
+        CloseHandle(m_file);
+      }
+      m_mapping = nullptr;
+      m_file = INVALID_HANDLE_VALUE;
+#else
+      if (m_data)
+        munmap(m_data, m_size);
+      if (m_fd >= 0)
+      {
+        if (m_writable && ftruncate(m_fd, off_t(m_used)) != 0)
+          g_logger << dlib::LERROR << "Cannot truncate journal segment " << m_path;
+        ::close(m_fd);
+      }
+      m_fd = -1;
+#endif
+      m_data = nullptr;
+    }
+
+    string m_path;
+    bool m_writable = false;
+    char *m_data = nullptr;
+    size_t m_size = 0;
+    // Bytes appended and bytes synced to disk
+    size_t m_used = 0;
+    size_t m_synced = 0;
+
+#ifdef _WINDOWS
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+  };
+
+  Journal::Journal(string directory, uint64_t bufferSize, size_t segmentSize,
+                   std::chrono::milliseconds syncInterval)
+      : m_directory(std::move(directory)),
+        m_bufferSize(bufferSize),
+        m_segmentSize(segmentSize),
+        m_syncInterval(syncInterval)
+  {
+  }
+
+  Journal::~Journal()
+  {
+    close();
+  }
+
+  vector<pair<uint64_t, string>> Journal::listSegments() const
+  {
+    vector<pair<uint64_t, string>> segments;
+    vector<dlib::file> files;
+    try
+    {
+      dlib::directory(m_directory).get_files(files);
+    }
+    catch (dlib::directory::dir_not_found &)
+    {
+      return segments;
+    }
+
+    static const string prefix("journal-"), suffix(".seg");
+    for (const auto &file : files)
+    {
+      const auto name = file.name();
+      if (name.size() > prefix.size() + suffix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+          name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+      {
+        segments.emplace_back(strtoull(name.c_str() + prefix.size(), nullptr, 10),
+                              file.full_name());
+      }
+    }
+    sort(segments.begin(), segments.end());
+
+    return segments;
+  }
+
+  bool Journal::recover(uint64_t &instanceId, uint64_t &sequence, const Visitor &visitor) const
+  {
+    bool found = false;
+    uint64_t next = 0;
+    Record record;
+
+    for (const auto &segment : listSegments())
+    {
+      MappedFile file;
+      if (!file.open(segment.second, 0, false) || file.m_size < HEADER_SIZE ||
+          memcmp(file.m_data, g_magic, sizeof(g_magic)) != 0)
+      {
+        g_logger << dlib::LWARN << "Skipping invalid journal segment " << segment.second;
+        continue;
+      }
+
+      const char *pos = file.m_data + sizeof(g_magic);
+      auto id = get<uint64_t>(pos);
+      auto first = get<uint64_t>(pos);
+      if (found && (id != instanceId || first != next))
+      {
+        // Only the segments continuing the sequence can be restored
+        g_logger << dlib::LWARN << "Journal segment " << segment.second
+                 << " does not continue at sequence " << next << ", stopping recovery";
+        break;
+      }
+
+      bool snapshot = !found;
+      if (!found)
+      {
+        found = true;
+        instanceId = id;
+        next = first;
+      }
+
+      size_t offset = HEADER_SIZE;
+      while (offset + RECORD_HEADER_SIZE <= file.m_size)
+      {
+        pos = file.m_data + offset;
+        auto size = get<uint32_t>(pos);
+        auto sum = get<uint32_t>(pos);
+        if (size == 0)
+          break;
+        if (size < PAYLOAD_FIXED_SIZE || offset + RECORD_HEADER_SIZE + size > file.m_size ||
+            checksum(pos, size) != sum)
+        {
+          g_logger << dlib::LWARN << "Journal segment " << segment.second
+                   << " has a damaged record at offset " << offset;
+          break;
+        }
+        offset += RECORD_HEADER_SIZE + size;
+
+        auto kind = get<uint8_t>(pos);
+        record.m_sequence = get<uint64_t>(pos);
+        record.m_received = get<uint64_t>(pos);
+        auto idLen = get<uint32_t>(pos);
+        auto timeLen = get<uint32_t>(pos);
+        auto valueLen = get<uint32_t>(pos);
+        if (PAYLOAD_FIXED_SIZE + size_t(idLen) + timeLen + valueLen != size)
+          break;
+        record.m_dataItemId.assign(pos, idLen);
+        record.m_time.assign(pos + idLen, timeLen);
+        record.m_value.assign(pos + idLen + timeLen, valueLen);
+
+        if (kind == SNAPSHOT)
+        {
+          // Only the state before the first restored segment is needed
+          if (snapshot)
+            visitor(record, true);
+        }
+        else if (record.m_sequence == next)
+        {
+          visitor(record, false);
+          next++;
+        }
+        else
+          break;
+      }
+    }
+
+    sequence = next;
+    return found;
+  }
+
+  void Journal::start(uint64_t instanceId, uint64_t sequence)
+  {
+    try
+    {
+      dlib::create_directory(m_directory);
+    }
+    catch (exception &e)
+    {
+      g_logger << dlib::LERROR << "Cannot create journal directory " << m_directory << ": "
+               << e.what();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_instanceId = instanceId;
+    // Segments past the sequence could not be recovered and are discarded
+    m_segments.clear();
+    for (const auto &segment : listSegments())
+    {
+      if (segment.first < sequence)
+        m_segments.push_back(segment);
+      else if (segment.first > sequence && std::remove(segment.second.c_str()) != 0)
+        g_logger << dlib::LWARN << "Cannot remove journal segment " << segment.second;
+    }
+    openSegment(sequence, 0);
+
+    if (!m_running)
+    {
+      m_running = true;
+      m_thread = std::thread(&Journal::run, this);
+    }
+  }
+
+  void Journal::openSegment(uint64_t sequence, size_t reserve)
+  {
+    // The snapshot holds the state of every data item before the segment starts
+    vector<const Record *> snapshot;
+    size_t size = HEADER_SIZE + reserve;
+    for (const auto &state : m_state)
+    {
+      for (const auto &record : state.second)
+      {
+        snapshot.push_back(&record);
+        size += recordSize(record);
+      }
+    }
+    sort(snapshot.begin(), snapshot.end(),
+         [](const Record *a, const Record *b) { return a->m_sequence < b->m_sequence; });
+
+    if (m_current)
+    {
+      m_retired.push_back(m_current);
+      m_dirty = true;
+      m_cond.notify_one();
+    }
+
+    char name[48];
+    snprintf(name, sizeof(name), "/journal-%020llu.seg", (unsigned long long)sequence);
+    string path = m_directory + name;
+
+    m_current = make_shared<MappedFile>();
+    if (!m_current->open(path, max(size, m_segmentSize), true))
+    {
+      g_logger << dlib::LERROR << "Cannot map journal segment " << path
+               << ", observations are not journaled";
+      m_current.reset();
+      return;
+    }
+
+    char *pos = m_current->m_data;
+    memcpy(pos, g_magic, sizeof(g_magic));
+    pos += sizeof(g_magic);
+    put<uint64_t>(pos, m_instanceId);
+    put<uint64_t>(pos, sequence);
+    put<uint64_t>(pos, 0);
+    m_current->m_used = HEADER_SIZE;
+
+    for (const auto record : snapshot)
+      write(*record, SNAPSHOT);
+
+    // A segment starting at the same sequence has no observations and is replaced
+    if (!m_segments.empty() && m_segments.back().first == sequence)
+      m_segments.back().second = path;
+    else
+      m_segments.emplace_back(sequence, path);
+
+    // Remove the oldest segments once the newer ones cover the sliding buffer
+    auto firstSequence = sequence > m_bufferSize ? sequence - m_bufferSize : 1;
+    while (m_segments.size() > 1 && m_segments[1].first <= firstSequence)
+    {
+      if (std::remove(m_segments.front().second.c_str()) != 0)
+      {
+        g_logger << dlib::LDEBUG << "Cannot remove journal segment " << m_segments.front().second;
+        break;
+      }
+      m_segments.pop_front();
+    }
+  }
+
+  void Journal::write(const Record &record, uint8_t kind)
+  {
+    auto size = recordSize(record);
+    char *start = m_current->m_data + m_current->m_used;
+    char *pos = start + RECORD_HEADER_SIZE;
+
+    put<uint8_t>(pos, kind);
+    put<uint64_t>(pos, record.m_sequence);
+    put<uint64_t>(pos, record.m_received);
+    put<uint32_t>(pos, uint32_t(record.m_dataItemId.size()));
+    put<uint32_t>(pos, uint32_t(record.m_time.size()));
+    put<uint32_t>(pos, uint32_t(record.m_value.size()));
+    put(pos, record.m_dataItemId);
+    put(pos, record.m_time);
+    put(pos, record.m_value);
+
+    auto payload = uint32_t(size - RECORD_HEADER_SIZE);
+    pos = start;
+    put<uint32_t>(pos, payload);
+    put<uint32_t>(pos, checksum(start + RECORD_HEADER_SIZE, payload));
+
+    m_current->m_used += size;
+  }
+
+  void Journal::append(const Record &record, bool accumulate)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_current)
+      return;
+
+    auto size = recordSize(record);
+    if (m_current->m_used + size > m_current->m_size)
+    {
+      openSegment(record.m_sequence, size);
+      if (!m_current)
+        return;
+    }
+
+    write(record, OBSERVATION);
+    track(record, accumulate);
+
+    if (!m_dirty)
+    {
+      m_dirty = true;
+      m_cond.notify_one();
+    }
+  }
+
+  void Journal::track(const Record &record, bool accumulate)
+  {
+    auto &state = m_state[record.m_dataItemId];
+    if (!accumulate)
+      state.clear();
+    else if (state.size() >= MAX_STATE_RECORDS)
+      state.erase(state.begin());
+    state.push_back(record);
+  }
+
+  void Journal::run()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto last = std::chrono::steady_clock::now() - m_syncInterval;
+
+    while (m_running || m_dirty)
+    {
+      m_cond.wait(lock, [this]() { return !m_running || m_dirty; });
+      if (!m_dirty)
+        continue;
+
+      // Let the appends accumulate for the interval so one sync covers all of them
+      m_cond.wait_until(lock, last + m_syncInterval, [this]() { return !m_running; });
+
+      vector<pair<shared_ptr<MappedFile>, size_t>> pending;
+      for (auto &file : m_retired)
+        pending.emplace_back(file, file->m_used);
+      m_retired.clear();
+      if (m_current)
+        pending.emplace_back(m_current, m_current->m_used);
+      m_dirty = false;
+      lock.unlock();
+
+      for (auto &file : pending)
+      {
+        file.first->sync(file.first->m_synced, file.second);
+        file.first->m_synced = file.second;
+      }
+
+      // Retired segments are unmapped here, outside of the lock
+      pending.clear();
+      m_syncs++;
+      last = std::chrono::steady_clock::now();
+      lock.lock();
+    }
+  }
+
+  void Journal::close()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running = false;
+      m_cond.notify_all();
+    }
+
+    if (m_thread.joinable())
+      m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_retired.clear();
+    m_current.reset();
+  }
+}  // namespace mtconnect
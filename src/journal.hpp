@@ -0,0 +1,132 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mtconnect
+{
+  // A write-ahead journal of the observations added to the agent so the sliding buffer
+  // can be rebuilt after a restart. Records are appended to memory mapped segment files
+  // and a background thread syncs them to disk in groups, one sync covers everything
+  // appended since the last one.
+  //
+  // Each segment starts with a snapshot of the records that make up the state of every
+  // data item when the segment was started. Once the newer segments cover the sliding
+  // buffer, older segments are removed.
+  class Journal
+  {
+   public:
+    struct Record
+    {
+      uint64_t m_sequence;
+      // When the agent received the observation in microseconds
+      uint64_t m_received;
+      std::string m_dataItemId;
+      std::string m_time;
+      std::string m_value;
+    };
+
+    // Called with each recovered record, the snapshot records come first
+    using Visitor = std::function<void(const Record &record, bool snapshot)>;
+
+    Journal(std::string directory, uint64_t bufferSize, size_t segmentSize = 64 * 1024 * 1024,
+            std::chrono::milliseconds syncInterval = std::chrono::milliseconds{100});
+    ~Journal();
+
+    // Read the segments in order. Returns false if there is nothing to recover, otherwise
+    // sets the instance id the segments were written with and the next sequence.
+    bool recover(uint64_t &instanceId, uint64_t &sequence, const Visitor &visitor) const;
+
+    // Start a new segment at the sequence, must be called before the first append
+    void start(uint64_t instanceId, uint64_t sequence);
+
+    // Append a record. An accumulating record adds to the state of its data item, like an
+    // active condition or a data set entry, instead of replacing it.
+    void append(const Record &record, bool accumulate);
+
+    // Track the state of a recovered record for the next snapshot without writing it,
+    // called before start
+    void track(const Record &record, bool accumulate);
+
+    // Sync everything that was appended and stop the sync thread
+    void close();
+
+    // The segments kept cover this many observations before the newest
+    void setBufferSize(uint64_t bufferSize)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_bufferSize = bufferSize;
+    }
+
+    size_t getSegmentCount() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_segments.size();
+    }
+    uint64_t getSyncs() const
+    {
+      return m_syncs;
+    }
+
+   protected:
+    struct MappedFile;
+
+    std::vector<std::pair<uint64_t, std::string>> listSegments() const;
+    void openSegment(uint64_t sequence, size_t reserve);
+    void write(const Record &record, uint8_t kind);
+    void run();
+
+   protected:
+    std::string m_directory;
+    uint64_t m_bufferSize;
+    size_t m_segmentSize;
+    std::chrono::milliseconds m_syncInterval;
+    uint64_t m_instanceId = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    // The segment being appended to and the ones that still need their last sync
+    std::shared_ptr<MappedFile> m_current;
+    std::vector<std::shared_ptr<MappedFile>> m_retired;
+
+    // First sequence and path of the segments on disk, oldest first
+    std::deque<std::pair<uint64_t, std::string>> m_segments;
+
+    // The records that make up the state of each data item
+    std::unordered_map<std::string, std::vector<Record>> m_state;
+
+    bool m_dirty = false;
+    bool m_running = false;
+    std::atomic<uint64_t> m_syncs{0};
+    std::thread m_thread;
+  };
+}  // namespace mtconnect
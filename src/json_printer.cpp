@@ -84,15 +84,24 @@ namespace mtconnect
     return m_hostname;
   }
 
+  // Documents are written into a stream kept by the thread so its buffer has already grown
+  // to the size of the earlier documents. A stream that grew too large is replaced.
   inline std::string print(json &doc, bool pretty)
   {
-    stringstream buffer;
+    static const size_t MaxBufferSize = 4 * 1024 * 1024;
+    thread_local ostringstream buffer;
+
+    buffer.str(string());
     if (pretty)
       buffer << std::setw(2);
     buffer << doc;
     if (pretty)
       buffer << "\n";
-    return buffer.str();
+
+    auto ret = buffer.str();
+    if (ret.size() > MaxBufferSize)
+      ostringstream().swap(buffer);
+    return ret;
   }
 
   static inline void addAttributes(json &doc, const map<string, string> &attrs)
@@ -543,7 +552,7 @@ namespace mtconnect
     return print(doc, m_pretty);
   }
 
-  inline json toJson(const ObservationPtr &observation)
+  inline json toJson(const Observation *observation)
   {
     auto dataItem = observation->getDataItem();
     string name;
@@ -571,8 +580,6 @@ namespace mtconnect
     }
     else if (observation->isTimeSeries())
     {
-      ostringstream ostr;
-      ostr.precision(6);
       const auto &v = observation->getTimeSeries();
 
       value = json::array();
@@ -653,22 +660,28 @@ namespace mtconnect
       value = observation->getValue();
     }
 
+    // The attributes of the data item are always strings
     json obj = json::object();
-    for (const auto &attr : observation->getAttributes())
+    const auto &attributes = observation->getAttributes();
+    auto constant = observation->getDataItemAttributeCount();
+    for (size_t i = 0; i < constant; i++)
+      obj[attributes[i].first] = attributes[i].second;
+
+    for (auto attr = attributes.begin() + constant; attr != attributes.end(); attr++)
     {
-      if (strcmp(attr.first, "sequence") == 0)
+      if (strcmp(attr->first, "sequence") == 0)
       {
         obj["sequence"] = observation->getSequence();
       }
-      else if (strcmp(attr.first, "sampleCount") == 0 or strcmp(attr.first, "sampleRate") == 0 or
-               strcmp(attr.first, "duration") == 0)
+      else if (strcmp(attr->first, "sampleCount") == 0 or strcmp(attr->first, "sampleRate") == 0 or
+               strcmp(attr->first, "duration") == 0)
       {
         char *ep;
-        obj[attr.first] = strtod(attr.second.c_str(), &ep);
+        obj[attr->first] = strtod(attr->second.c_str(), &ep);
       }
       else
       {
-        obj[attr.first] = attr.second;
+        obj[attr->first] = attr->second;
       }
     }
     obj["value"] = value;
@@ -684,7 +697,7 @@ namespace mtconnect
     }
     CategoryRef(const CategoryRef &other) = default;
 
-    bool addObservation(const ObservationPtr &observation)
+    bool addObservation(const Observation *observation)
     {
       m_events.emplace_back(observation);
       return true;
@@ -711,7 +724,7 @@ namespace mtconnect
 
    protected:
     string m_category;
-    vector<ObservationPtr> m_events;
+    vector<const Observation *> m_events;
   };
 
   class ComponentRef
@@ -730,7 +743,7 @@ namespace mtconnect
       return m_component == component;
     }
 
-    bool addObservation(const ObservationPtr &observation, const Component *component,
+    bool addObservation(const Observation *observation, const Component *component,
                         const DataItem *dataItem)
     {
       if (m_component == component)
@@ -792,7 +805,7 @@ namespace mtconnect
       return device == m_device;
     }
 
-    bool addObservation(const ObservationPtr &observation, const Device *device,
+    bool addObservation(const Observation *observation, const Device *device,
                         const Component *component, const DataItem *dataItem)
     {
       if (m_device == device)
@@ -833,14 +846,13 @@ namespace mtconnect
   std::string JsonPrinter::printSample(const unsigned int instanceId, const unsigned int bufferSize,
                                        const uint64_t nextSeq, const uint64_t firstSeq,
                                        const uint64_t lastSeq,
-                                       ObservationPtrArray &observations) const
+                                       ObservationList &observations) const
   {
     json streams = json::array();
 
     if (observations.size() > 0)
     {
-      dlib::qsort_array<ObservationPtrArray, ObservationComparer>(
-          observations, 0ul, observations.size() - 1ul, ObservationCompare);
+      groupObservations(observations);
 
       vector<DeviceRef> devices;
       DeviceRef *deviceRef = nullptr;
@@ -1064,21 +1076,71 @@ namespace mtconnect
     return doc;
   }
 
+  // Print a value nested in a document written by hand, pretty values are indented for the
+  // depth they are written at
+  static string printNested(const json &value, bool pretty, int depth)
+  {
+    if (!pretty)
+      return value.dump();
+
+    auto text = value.dump(2);
+    string nested;
+    nested.reserve(text.size() + text.size() / 4);
+    for (const auto c : text)
+    {
+      nested += c;
+      if (c == '\n')
+        nested.append(size_t(depth) * 2, ' ');
+    }
+
+    return nested;
+  }
+
+  // The document is written around the assets as they were last printed:
+  // {"MTConnectAssets": {"Header": {...}, "Assets": [...]}}
   std::string JsonPrinter::printAssets(const unsigned int instanceId, const unsigned int bufferSize,
                                        const unsigned int assetCount,
                                        std::vector<AssetPtr> const &assets) const
   {
-    json assetDoc = json::array();
+    json header = probeAssetHeader(m_version, hostname(), instanceId, 0, bufferSize, assetCount,
+                                   m_schemaVersion);
+    auto headerText = printNested(header, m_pretty, 2);
+
+    vector<shared_ptr<const string>> fragments;
+    fragments.reserve(assets.size());
+    size_t size = headerText.size() + 64;
     for (const auto asset : assets)
-      assetDoc.emplace_back(toJson(asset));
+    {
+      fragments.emplace_back(asset->getFragment(this));
+      size += fragments.back()->size() + 8;
+    }
 
-    json doc =
-        json::object({{"MTConnectAssets",
-                       {{"Header", probeAssetHeader(m_version, hostname(), instanceId, 0,
-                                                    bufferSize, assetCount, m_schemaVersion)},
-                        {"Assets", assetDoc}}}});
+    const char *open = m_pretty ? "{\n  \"MTConnectAssets\": {\n    \"Header\": "
+                                : "{\"MTConnectAssets\":{\"Header\":";
+    const char *separator = m_pretty ? "\n      " : "";
 
-    return print(doc, m_pretty);
+    string ret;
+    ret.reserve(size);
+    ret.append(open).append(headerText);
+    ret.append(m_pretty ? ",\n    \"Assets\": [" : ",\"Assets\":[");
+    for (const auto &fragment : fragments)
+    {
+      if (&fragment != &fragments.front())
+        ret += ',';
+      ret.append(separator).append(*fragment);
+    }
+    if (m_pretty && !fragments.empty())
+      ret += "\n    ";
+    ret.append(m_pretty ? "]\n  }\n}\n" : "]}}");
+
+    return ret;
+  }
+
+  std::string JsonPrinter::printAssetFragment(Asset *asset) const
+  {
+    // Indented for its place in the assets array
+    AssetPtr ptr(asset);
+    return printNested(toJson(ptr), m_pretty, 3);
   }
 
   std::string JsonPrinter::printCuttingTool(CuttingToolPtr const tool) const
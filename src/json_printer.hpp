@@ -38,14 +38,16 @@ namespace mtconnect
                            const unsigned int assetCount, const std::vector<Device *> &devices,
                            const std::map<std::string, int> *count = nullptr) const override;
 
+    using Printer::printSample;
     std::string printSample(const unsigned int instanceId, const unsigned int bufferSize,
                             const uint64_t nextSeq, const uint64_t firstSeq, const uint64_t lastSeq,
-                            ObservationPtrArray &results) const override;
+                            ObservationList &results) const override;
 
     std::string printAssets(const unsigned int anInstanceId, const unsigned int bufferSize,
                             const unsigned int assetCount,
                             std::vector<AssetPtr> const &assets) const override;
 
+    std::string printAssetFragment(Asset *asset) const override;
     std::string printCuttingTool(CuttingToolPtr const tool) const override;
 
     std::string mimeType() const override
@@ -18,12 +18,15 @@
 #include "observation.hpp"
 
 #include "data_item.hpp"
+#include "epoch_reclaimer.hpp"
 
 #include <dlib/logger.h>
 #include <dlib/threads.h>
 
-#include <mutex>
+#include <algorithm>
+#include <cstring>
 #include <regex>
+#include <vector>
 
 #ifdef _WINDOWS
 #define strcasecmp stricmp
@@ -35,7 +38,6 @@ using namespace std;
 
 namespace mtconnect
 {
-  static std::mutex g_attributeMutex;
   static dlib::logger g_logger("Observation");
 
   const string Observation::SLevels[NumLevels] = {"Normal", "Warning", "Fault", "Unavailable"};
@@ -78,7 +80,7 @@ namespace mtconnect
 
   Observation::Observation(DataItem &dataItem, uint64_t sequence, const string &time,
                            const string &value)
-      : m_level(ELevel::NORMAL), m_isFloat(false), m_sampleCount(0), m_hasAttributes(false)
+      : m_level(ELevel::NORMAL), m_isFloat(false), m_sampleCount(0)
   {
     m_dataItem = &dataItem;
     m_isTimeSeries = m_dataItem->isTimeSeries();
@@ -106,182 +108,187 @@ namespace mtconnect
     }
     else
       convertValue(value);
+
+    buildAttributes();
   }
 
   Observation::Observation(const Observation &observation)
       : RefCounted(observation),
         m_dataItem(observation.m_dataItem),
         m_sequence(observation.m_sequence),
+        m_sequenceStr(observation.m_sequenceStr),
         m_time(observation.m_time),
         m_duration(observation.m_duration),
         m_rest(observation.m_rest),
-        m_level(ELevel::NORMAL),
+        m_level(observation.m_level),
+        m_valueId(observation.m_valueId),
         m_value(observation.m_value),
         m_isFloat(false),
         m_isTimeSeries(observation.m_isTimeSeries),
-        m_hasAttributes(false),
+        m_sampleCount(observation.m_sampleCount),
+        m_attributes(observation.m_attributes),
+        m_dataItemAttributes(observation.m_dataItemAttributes),
         m_code(observation.m_code),
         m_resetTriggered(observation.m_resetTriggered)
   {
     if (m_isTimeSeries)
-    {
       m_timeSeries = observation.m_timeSeries;
-      m_sampleCount = observation.m_sampleCount;
-    }
     else if (observation.isDataSet())
-    {
       m_dataSet = observation.m_dataSet;
-      m_sampleCount = m_dataSet.size();
-    }
   }
 
-  Observation::~Observation() = default;
-
-  const AttributeList &Observation::getAttributes()
+  Observation::Observation(DataItem &dataItem, uint64_t sequence)
+      : m_dataItem(&dataItem),
+        m_sequence(sequence),
+        m_level(ELevel::NORMAL),
+        m_isFloat(false),
+        m_isTimeSeries(dataItem.isTimeSeries()),
+        m_sampleCount(0)
   {
-    if (!m_hasAttributes)
-    {
-      lock_guard<std::mutex> lock(g_attributeMutex);
+  }
 
-      // Double check in case of a race.
-      if (m_hasAttributes)
-        return m_attributes;
+  Observation::~Observation() = default;
 
-      m_attributes.emplace_back(AttributeItem("dataItemId", m_dataItem->getId()));
-      m_attributes.emplace_back(AttributeItem("timestamp", m_time));
+  static atomic<EpochReclaimer *> s_reclaimer{nullptr};
 
-      if (!m_dataItem->getName().empty())
-        m_attributes.emplace_back(AttributeItem("name", m_dataItem->getName()));
+  void Observation::setReclaimer(EpochReclaimer *reclaimer)
+  {
+    s_reclaimer.store(reclaimer);
+  }
 
-      if (!m_dataItem->getCompositionId().empty())
-        m_attributes.emplace_back(AttributeItem("compositionId", m_dataItem->getCompositionId()));
+  void Observation::release()
+  {
+    auto reclaimer = s_reclaimer.load(memory_order_acquire);
+    if (reclaimer)
+      reclaimer->retire(this);
+    else
+      delete this;
+  }
 
-      m_sequenceStr = int64ToString(m_sequence);
-      m_attributes.emplace_back(AttributeItem("sequence", m_sequenceStr));
+  // The next field of a | separated list, pos is npos after the last field
+  static inline string nextField(const string &text, size_t &pos)
+  {
+    if (pos == string::npos)
+      return string();
 
-      if (!m_dataItem->getSubType().empty())
-        m_attributes.emplace_back(AttributeItem("subType", m_dataItem->getSubType()));
+    auto end = text.find('|', pos);
+    string field = text.substr(pos, end == string::npos ? string::npos : end - pos);
+    pos = end == string::npos ? string::npos : end + 1;
+    return field;
+  }
 
-      if (!m_dataItem->getStatistic().empty())
-        m_attributes.emplace_back(AttributeItem("statistic", m_dataItem->getStatistic()));
+  void Observation::buildAttributes()
+  {
+    m_attributes.clear();
+    m_code.clear();
+    m_level = NORMAL;
 
-      if (!m_duration.empty())
-        m_attributes.emplace_back(AttributeItem("duration", m_duration));
+    // The attributes of the data item come first, printers copy them as one fragment
+    m_attributes.emplace_back(AttributeItem("dataItemId", m_dataItem->getId()));
 
-      if (!m_resetTriggered.empty())
-        m_attributes.emplace_back(AttributeItem("resetTriggered", m_resetTriggered));
+    if (!m_dataItem->getName().empty())
+      m_attributes.emplace_back(AttributeItem("name", m_dataItem->getName()));
 
-      if (m_dataItem->isCondition())
-      {
-        // Conditon data: LEVEL|NATIVE_CODE|NATIVE_SEVERITY|QUALIFIER
-        istringstream toParse(m_rest);
-        string token;
-
-        getline(toParse, token, '|');
-
-        if (!strcasecmp(token.c_str(), "normal"))
-          m_level = NORMAL;
-        else if (!strcasecmp(token.c_str(), "warning"))
-          m_level = WARNING;
-        else if (!strcasecmp(token.c_str(), "fault"))
-          m_level = FAULT;
-        else  // Assume unavailable
-          m_level = UNAVAILABLE;
-
-        if (!toParse.eof())
-        {
-          getline(toParse, token, '|');
+    if (!m_dataItem->getCompositionId().empty())
+      m_attributes.emplace_back(AttributeItem("compositionId", m_dataItem->getCompositionId()));
 
-          if (!token.empty())
-          {
-            m_code = token;
-            m_attributes.emplace_back(AttributeItem("nativeCode", token));
-          }
-        }
+    if (!m_dataItem->getSubType().empty())
+      m_attributes.emplace_back(AttributeItem("subType", m_dataItem->getSubType()));
 
-        if (!toParse.eof())
-        {
-          getline(toParse, token, '|');
+    if (!m_dataItem->getStatistic().empty())
+      m_attributes.emplace_back(AttributeItem("statistic", m_dataItem->getStatistic()));
 
-          if (!token.empty())
-            m_attributes.emplace_back(AttributeItem("nativeSeverity", token));
-        }
+    if (m_dataItem->isCondition() && !m_dataItem->getType().empty())
+      m_attributes.emplace_back(AttributeItem("type", m_dataItem->getType()));
 
-        if (!toParse.eof())
-        {
-          getline(toParse, token, '|');
+    m_dataItemAttributes = m_attributes.size();
 
-          if (!token.empty())
-            m_attributes.emplace_back(AttributeItem("qualifier", token));
-        }
+    m_attributes.emplace_back(AttributeItem("timestamp", m_time));
 
-        m_attributes.emplace_back(AttributeItem("type", m_dataItem->getType()));
-      }
-      else if (m_dataItem->isTimeSeries())
-      {
-        istringstream toParse(m_rest);
-        string token;
-
-        getline(toParse, token, '|');
-
-        if (token.empty())
-          token = "0";
+    m_sequenceStr = to_string(m_sequence);
+    m_attributes.emplace_back(AttributeItem("sequence", m_sequenceStr));
 
-        m_attributes.emplace_back(AttributeItem("sampleCount", token));
-        m_sampleCount = atoi(token.c_str());
+    if (!m_duration.empty())
+      m_attributes.emplace_back(AttributeItem("duration", m_duration));
 
-        getline(toParse, token, '|');
+    if (!m_resetTriggered.empty())
+      m_attributes.emplace_back(AttributeItem("resetTriggered", m_resetTriggered));
 
-        if (!token.empty())
-          m_attributes.emplace_back(AttributeItem("sampleRate", token));
-      }
-      else if (m_dataItem->isMessage())
+    if (m_dataItem->isCondition())
+    {
+      // Conditon data: LEVEL|NATIVE_CODE|NATIVE_SEVERITY|QUALIFIER
+      size_t pos = 0;
+      auto token = nextField(m_rest, pos);
+
+      if (!strcasecmp(token.c_str(), "normal"))
+        m_level = NORMAL;
+      else if (!strcasecmp(token.c_str(), "warning"))
+        m_level = WARNING;
+      else if (!strcasecmp(token.c_str(), "fault"))
+        m_level = FAULT;
+      else  // Assume unavailable
+        m_level = UNAVAILABLE;
+
+      token = nextField(m_rest, pos);
+      if (!token.empty())
       {
-        // Format to parse: NATIVECODE
-        if (!m_rest.empty())
-          m_attributes.emplace_back(AttributeItem("nativeCode", m_rest));
+        m_code = token;
+        m_attributes.emplace_back(AttributeItem("nativeCode", token));
       }
-      else if (m_dataItem->isAlarm())
-      {
-        // Format to parse: CODE|NATIVECODE|SEVERITY|STATE
-        istringstream toParse(m_rest);
-        string token;
 
-        getline(toParse, token, '|');
-        m_attributes.emplace_back(AttributeItem("code", token));
+      token = nextField(m_rest, pos);
+      if (!token.empty())
+        m_attributes.emplace_back(AttributeItem("nativeSeverity", token));
 
-        getline(toParse, token, '|');
-        m_attributes.emplace_back(AttributeItem("nativeCode", token));
+      token = nextField(m_rest, pos);
+      if (!token.empty())
+        m_attributes.emplace_back(AttributeItem("qualifier", token));
+    }
+    else if (m_dataItem->isTimeSeries())
+    {
+      size_t pos = 0;
+      auto token = nextField(m_rest, pos);
 
-        getline(toParse, token, '|');
-        m_attributes.emplace_back(AttributeItem("severity", token));
+      if (token.empty())
+        token = "0";
 
-        getline(toParse, token, '|');
-        m_attributes.emplace_back(AttributeItem("state", token));
-      }
-      else if (m_dataItem->isDataSet())
-      {
-        m_attributes.emplace_back(AttributeItem("count", intToString(m_dataSet.size())));
-        m_sampleCount = m_dataSet.size();
-      }
-      else if (m_dataItem->isAssetChanged() || m_dataItem->isAssetRemoved())
-        m_attributes.emplace_back(AttributeItem("assetType", m_rest, true));
+      m_attributes.emplace_back(AttributeItem("sampleCount", token));
+      m_sampleCount = atoi(token.c_str());
 
-      m_hasAttributes = true;
+      token = nextField(m_rest, pos);
+      if (!token.empty())
+        m_attributes.emplace_back(AttributeItem("sampleRate", token));
     }
-
-    return m_attributes;
+    else if (m_dataItem->isMessage())
+    {
+      // Format to parse: NATIVECODE
+      if (!m_rest.empty())
+        m_attributes.emplace_back(AttributeItem("nativeCode", m_rest));
+    }
+    else if (m_dataItem->isAlarm())
+    {
+      // Format to parse: CODE|NATIVECODE|SEVERITY|STATE
+      size_t pos = 0;
+      m_attributes.emplace_back(AttributeItem("code", nextField(m_rest, pos)));
+      m_attributes.emplace_back(AttributeItem("nativeCode", nextField(m_rest, pos)));
+      m_attributes.emplace_back(AttributeItem("severity", nextField(m_rest, pos)));
+      m_attributes.emplace_back(AttributeItem("state", nextField(m_rest, pos)));
+    }
+    else if (m_dataItem->isDataSet())
+    {
+      m_attributes.emplace_back(AttributeItem("count", intToString(m_dataSet.size())));
+      m_sampleCount = m_dataSet.size();
+    }
+    else if (m_dataItem->isAssetChanged() || m_dataItem->isAssetRemoved())
+      m_attributes.emplace_back(AttributeItem("assetType", m_rest, true));
   }
 
   void Observation::normal()
   {
     if (m_dataItem->isCondition())
     {
-      m_attributes.clear();
-      m_code.clear();
-      m_hasAttributes = false;
       m_rest = "normal|||";
-      getAttributes();
+      buildAttributes();
     }
   }
 
@@ -398,7 +405,7 @@ namespace mtconnect
   {
     // Check if the type is an alarm or if it doesn't have units
     if (value == "UNAVAILABLE")
-      m_value = value;
+      m_valueId = StringPool::UNAVAILABLE;
     else if (m_isTimeSeries || m_dataItem->isCondition() || m_dataItem->isAlarm() ||
              m_dataItem->isMessage() || m_dataItem->isAssetChanged() ||
              m_dataItem->isAssetRemoved())
@@ -434,7 +441,7 @@ namespace mtconnect
         }
       }
       else
-        m_value = value.substr(lastPipe + 1);
+        setValue(value.substr(lastPipe + 1));
     }
     else if (m_dataItem->isDataSet())
     {
@@ -461,88 +468,298 @@ namespace mtconnect
       parseDataSet(m_dataSet, set, m_dataItem->isTable());
     }
     else if (m_dataItem->conversionRequired())
-      m_value = m_dataItem->convertValue(value);
+      setValue(m_dataItem->convertValue(value));
     else
-      m_value = value;
+    {
+      m_valueId = m_dataItem->internValue(value);
+      if (m_valueId == StringPool::NONE)
+        m_value = value;
+    }
   }
 
-  Observation *Observation::getFirst()
+  void Observation::setValue(string value)
   {
-    if (m_prev.getObject())
-      return m_prev->getFirst();
-    else
-      return this;
+    m_valueId = m_dataItem->internValue(value);
+    if (m_valueId == StringPool::NONE)
+      m_value = move(value);
   }
 
-  void Observation::getList(std::list<ObservationPtr> &list)
+  // Binary encoding of the state, little endian lengths followed by the bytes
+  enum EDataSetType : uint8_t
   {
-    if (m_prev.getObject())
-      m_prev->getList(list);
-
-    list.emplace_back(this);
+    SET_TYPE,
+    STRING_TYPE,
+    INTEGER_TYPE,
+    DOUBLE_TYPE
+  };
+
+  template <typename T>
+  static inline void put(string &buffer, T value)
+  {
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
   }
 
-  Observation *Observation::find(const std::string &code)
+  static inline void putString(string &buffer, const string &value)
   {
-    if (m_code == code)
-      return this;
+    put(buffer, uint32_t(value.size()));
+    buffer.append(value);
+  }
 
-    if (m_prev.getObject())
-      return m_prev->find(code);
+  template <typename T>
+  static inline bool get(const char *&pos, const char *end, T &value)
+  {
+    if (size_t(end - pos) < sizeof(T))
+      return false;
+    memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
 
-    return nullptr;
+  static inline bool getString(const char *&pos, const char *end, string &value)
+  {
+    uint32_t size;
+    if (!get(pos, end, size) || size_t(end - pos) < size)
+      return false;
+    value.assign(pos, size);
+    pos += size;
+    return true;
   }
 
-  bool Observation::replace(Observation *oldObservation, Observation *newObservation)
+  static void encodeDataSet(string &buffer, const DataSet &set)
   {
-    auto obj = m_prev.getObject();
+    put(buffer, uint32_t(set.size()));
+    for (const auto &entry : set)
+    {
+      putString(buffer, entry.m_key);
+      put(buffer, uint8_t(entry.m_removed));
+      visit(overloaded{[&buffer](const DataSet &v) {
+                         put(buffer, uint8_t(SET_TYPE));
+                         encodeDataSet(buffer, v);
+                       },
+                       [&buffer](const string &v) {
+                         put(buffer, uint8_t(STRING_TYPE));
+                         putString(buffer, v);
+                       },
+                       [&buffer](const int64_t &v) {
+                         put(buffer, uint8_t(INTEGER_TYPE));
+                         put(buffer, v);
+                       },
+                       [&buffer](const double &v) {
+                         put(buffer, uint8_t(DOUBLE_TYPE));
+                         put(buffer, v);
+                       }},
+            entry.m_value);
+    }
+  }
 
-    if (!obj)
+  static bool decodeDataSet(const char *&pos, const char *end, DataSet &set)
+  {
+    uint32_t count;
+    if (!get(pos, end, count))
       return false;
 
-    if (obj == oldObservation)
+    for (uint32_t i = 0; i < count; i++)
     {
-      newObservation->m_prev = oldObservation->m_prev;
-      m_prev = newObservation;
-      return true;
+      string key;
+      uint8_t removed, type;
+      if (!getString(pos, end, key) || !get(pos, end, removed) || !get(pos, end, type))
+        return false;
+
+      DataSetValue value;
+      switch (type)
+      {
+        case SET_TYPE:
+        {
+          DataSet inner;
+          if (!decodeDataSet(pos, end, inner))
+            return false;
+          value = move(inner);
+          break;
+        }
+
+        case STRING_TYPE:
+        {
+          string s;
+          if (!getString(pos, end, s))
+            return false;
+          value = move(s);
+          break;
+        }
+
+        case INTEGER_TYPE:
+        {
+          int64_t v;
+          if (!get(pos, end, v))
+            return false;
+          value = v;
+          break;
+        }
+
+        case DOUBLE_TYPE:
+        {
+          double v;
+          if (!get(pos, end, v))
+            return false;
+          value = v;
+          break;
+        }
+
+        default:
+          return false;
+      }
+
+      set.emplace(move(key), move(value), removed != 0);
     }
 
-    return m_prev->replace(oldObservation, newObservation);
+    return true;
+  }
+
+  void Observation::serialize(string &buffer) const
+  {
+    putString(buffer, m_time);
+    putString(buffer, m_duration);
+    putString(buffer, m_rest);
+    putString(buffer, getValue());
+    putString(buffer, m_resetTriggered);
+
+    put(buffer, uint32_t(m_timeSeries.size()));
+    for (auto v : m_timeSeries)
+      put(buffer, v);
+
+    if (m_dataItem->isDataSet())
+      encodeDataSet(buffer, m_dataSet);
   }
 
-  Observation *Observation::deepCopy()
+  Observation *Observation::deserialize(DataItem &dataItem, uint64_t sequence, const char *&pos,
+                                        const char *end)
   {
-    auto n = new Observation(*this);
+    auto obs = new Observation(dataItem, sequence);
+
+    uint32_t count;
+    string value;
+    bool valid = getString(pos, end, obs->m_time) && getString(pos, end, obs->m_duration) &&
+                 getString(pos, end, obs->m_rest) && getString(pos, end, value) &&
+                 getString(pos, end, obs->m_resetTriggered) && get(pos, end, count) &&
+                 size_t(end - pos) >= count * sizeof(float);
+    if (valid)
+    {
+      obs->setValue(move(value));
+      obs->m_timeSeries.resize(count);
+      for (auto &v : obs->m_timeSeries)
+        get(pos, end, v);
+
+      if (dataItem.isDataSet())
+      {
+        valid = decodeDataSet(pos, end, obs->m_dataSet);
+        obs->m_sampleCount = obs->m_dataSet.size();
+      }
+    }
 
-    if (m_prev.getObject())
+    if (!valid)
     {
-      n->m_prev = m_prev->deepCopy();
-      n->m_prev->unrefer();
+      obs->unrefer();
+      return nullptr;
     }
 
-    return n;
+    obs->buildAttributes();
+    return obs;
   }
 
-  Observation *Observation::deepCopyAndRemove(Observation *old)
+  Observation *Observation::restore(DataItem &dataItem, uint64_t sequence, string time,
+                                    string value)
   {
-    if (this == old)
+    auto obs = new Observation(dataItem, sequence);
+    obs->m_time = move(time);
+    obs->setValue(move(value));
+    obs->buildAttributes();
+    return obs;
+  }
+
+  // The bytes a string allocates, nothing when the value fits in the string itself
+  static inline size_t heapSize(const string &value)
+  {
+    auto data = value.data();
+    auto self = reinterpret_cast<const char *>(&value);
+    return data >= self && data < self + sizeof(value) ? 0 : value.capacity() + 1;
+  }
+
+  static size_t dataSetSize(const DataSet &set)
+  {
+    size_t size = 0;
+    for (const auto &entry : set)
     {
-      if (m_prev.getObject())
-        return m_prev->deepCopy();
-      else
-        return nullptr;
+      // Each node of the set has the entry, its color, and three links
+      size += sizeof(DataSetEntry) + 4 * sizeof(void *) + heapSize(entry.m_key);
+      if (auto inner = get_if<DataSet>(&entry.m_value))
+        size += dataSetSize(*inner);
+      else if (auto text = get_if<string>(&entry.m_value))
+        size += heapSize(*text);
     }
+    return size;
+  }
+
+  size_t Observation::getMemorySize() const
+  {
+    if (!m_memorySize)
+    {
+      m_memorySize = sizeof(Observation) + heapSize(m_sequenceStr) + heapSize(m_time) +
+                     heapSize(m_duration) + heapSize(m_rest) + heapSize(m_value) +
+                     heapSize(m_code) + heapSize(m_resetTriggered) +
+                     m_timeSeries.capacity() * sizeof(float) + dataSetSize(m_dataSet) +
+                     m_attributes.capacity() * sizeof(AttributeItem);
+      for (const auto &attr : m_attributes)
+        m_memorySize += heapSize(attr.second);
+    }
+
+    return m_memorySize;
+  }
 
-    auto n = new Observation(*this);
+  void groupObservations(ObservationList &observations)
+  {
+    const auto count = observations.size();
+    if (count < 2)
+      return;
 
-    if (m_prev.getObject())
+    unsigned int largest = 0;
+    for (const auto observation : observations)
     {
-      n->m_prev = m_prev->deepCopyAndRemove(old);
+      auto ordinal = observation->getDataItem()->getOrdinal();
+      if (ordinal == 0)
+      {
+        sort(observations.begin(), observations.end(),
+             [](Observation *a, Observation *b) { return *a < *b; });
+        return;
+      }
+      if (ordinal > largest)
+        largest = ordinal;
+    }
 
-      if (n->m_prev.getObject())
-        n->m_prev->unrefer();
+    // The first position of each ordinal, observations of the same data item keep their
+    // order
+    vector<size_t> positions(largest + 1, 0);
+    for (const auto observation : observations)
+      positions[observation->getDataItem()->getOrdinal()]++;
+    size_t position = 0;
+    for (auto &p : positions)
+    {
+      auto items = p;
+      p = position;
+      position += items;
     }
 
-    return n;
+    ObservationList grouped(count);
+    for (const auto observation : observations)
+      grouped[positions[observation->getDataItem()->getOrdinal()]++] = observation;
+    observations.swap(grouped);
+
+    // Observations of a data item are usually already in sequence order
+    for (size_t i = 1; i < count; i++)
+    {
+      for (auto j = i; j > 0 &&
+                       observations[j - 1]->getDataItem() == observations[j]->getDataItem() &&
+                       observations[j - 1]->getSequence() > observations[j]->getSequence();
+           j--)
+        std::swap(observations[j - 1], observations[j]);
+    }
   }
 }  // namespace mtconnect
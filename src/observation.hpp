@@ -43,9 +43,14 @@ namespace mtconnect
 
   using AttributeList = std::vector<AttributeItem>;
 
+  class EpochReclaimer;
   class Observation;
   using ObservationPtr = RefCountedPtr<Observation>;
-  using ObservationPtrArray = dlib::array<ObservationPtr>;
+  using ObservationPtrArray = std::vector<ObservationPtr>;
+
+  // Observations borrowed for printing, kept alive by references held elsewhere or by an
+  // EpochReclaimer::Guard
+  using ObservationList = std::vector<Observation *>;
 
   template <class... Ts>
   struct overloaded : Ts...
@@ -137,11 +142,40 @@ namespace mtconnect
     // Copy constructor
     Observation(const Observation &observation);
 
-    Observation *deepCopy();
-    Observation *deepCopyAndRemove(Observation *old);
+    // Append the converted state of the observation to the buffer, everything except
+    // the data item and the sequence number
+    void serialize(std::string &buffer) const;
+
+    // Create an observation from the state written by serialize without converting
+    // the value again. Returns nullptr if the state is truncated.
+    static Observation *deserialize(DataItem &dataItem, uint64_t sequence, const char *&pos,
+                                    const char *end);
+
+    // Create an observation with a value that was already converted
+    static Observation *restore(DataItem &dataItem, uint64_t sequence, std::string time,
+                                std::string value);
+
+    // Once a reclaimer is set, observations whose last reference is dropped are retired to it
+    // instead of being deleted
+    static void setReclaimer(EpochReclaimer *reclaimer);
+
+    // The approximate number of bytes the observation uses. It is computed the first time
+    // so it does not change while the observation is in the buffer.
+    size_t getMemorySize() const;
+
+    // The attributes of the element, built when the observation is created so printers
+    // only read them
+    const AttributeList &getAttributes() const
+    {
+      return m_attributes;
+    }
 
-    // Extract the component event data into a map
-    const AttributeList &getAttributes();
+    // The number of attributes at the front of the list that come from the data item,
+    // DataItem::getXmlAttributes() holds them escaped
+    size_t getDataItemAttributeCount() const
+    {
+      return m_dataItemAttributes;
+    }
 
     // Get the data item associated with this event
     DataItem *getDataItem() const
@@ -152,16 +186,22 @@ namespace mtconnect
     // Get the value
     const std::string &getValue() const
     {
-      return m_value;
+      return m_valueId != StringPool::NONE ? StringPool::get(m_valueId) : m_value;
+    }
+    uint32_t getValueId() const
+    {
+      return m_valueId;
     }
-    ELevel getLevel();
-    const std::string &getLevelString()
+    ELevel getLevel() const
     {
-      return SLevels[getLevel()];
+      return m_level;
     }
-    const std::string &getCode()
+    const std::string &getLevelString() const
+    {
+      return SLevels[m_level];
+    }
+    const std::string &getCode() const
     {
-      getAttributes();
       return m_code;
     }
     void normal();
@@ -193,7 +233,7 @@ namespace mtconnect
     }
     bool isUnavailable() const
     {
-      return m_value == "UNAVAILABLE";
+      return m_valueId == StringPool::UNAVAILABLE;
     }
 
     uint64_t getSequence() const
@@ -204,22 +244,17 @@ namespace mtconnect
     void copySequence(const Observation *other)
     {
       m_sequence = other->m_sequence;
+      buildAttributes();
     }
 
-    const std::string &getDuration() const
+    const std::string &getTime() const
     {
-      return m_duration;
+      return m_time;
     }
-
-    Observation *getFirst();
-    Observation *getPrev()
+    const std::string &getDuration() const
     {
-      return m_prev;
+      return m_duration;
     }
-    void getList(std::list<ObservationPtr> &list);
-    void appendTo(Observation *event);
-    Observation *find(const std::string &nativeCode);
-    bool replace(Observation *oldObservation, Observation *newObservation);
 
     bool operator<(Observation &another) const
     {
@@ -235,23 +270,30 @@ namespace mtconnect
     {
       if (!m_resetTriggered.empty())
       {
-        m_hasAttributes = false;
-        m_attributes.clear();
         m_resetTriggered.clear();
+        buildAttributes();
       }
     }
 
     void setDataSet(DataSet &aSet)
     {
       m_dataSet = aSet;
-      m_hasAttributes = false;
-      m_attributes.clear();
+      buildAttributes();
     }
 
    protected:
+    // Initialize an empty observation to be deserialized
+    Observation(DataItem &dataItem, uint64_t sequence);
+
+    // Derive the attributes, level and code from the data item and the state. Only called
+    // before the observation is shared with other threads.
+    void buildAttributes();
+
     // Virtual destructor
     ~Observation() override;
 
+    void release() override;
+
    protected:
     // Holds the data item from the device
     DataItem *m_dataItem;
@@ -271,16 +313,18 @@ namespace mtconnect
     std::string m_rest;
     ELevel m_level;
 
-    // The value of the event, either as a float or a string
+    // The value of the event, either its id in the StringPool or the string. The id fits
+    // in the padding after the level.
+    uint32_t m_valueId = StringPool::NONE;
     std::string m_value;
     bool m_isFloat;
     bool m_isTimeSeries;
     std::vector<float> m_timeSeries;
     int m_sampleCount;
 
-    // The attributes, created on demand
-    bool m_hasAttributes;
+    // The attributes of the element
     AttributeList m_attributes;
+    size_t m_dataItemAttributes = 0;
 
     // For condition tracking
     std::string m_code;
@@ -288,36 +332,28 @@ namespace mtconnect
     // For reset triggered.
     std::string m_resetTriggered;
 
-    // For back linking of condition
-    ObservationPtr m_prev;
-
     // For data sets
     DataSet m_dataSet;
 
+    mutable size_t m_memorySize = 0;
+
    protected:
     // Convert the value to the agent unit standards
     void convertValue(const std::string &value);
+    void setValue(std::string value);
 
     void parseDataSet(DataSet &dataSet, const std::string &s, bool table);
   };
 
-  inline Observation::ELevel Observation::getLevel()
-  {
-    if (!m_hasAttributes)
-      getAttributes();
-
-    return m_level;
-  }
-
-  inline void Observation::appendTo(Observation *event)
-  {
-    m_prev = event;
-  }
-
   using ObservationComparer = bool (*)(ObservationPtr &, ObservationPtr &);
   inline bool ObservationCompare(ObservationPtr &aE1, ObservationPtr &aE2)
   {
     return aE1 < aE2;
   }
 
+  // Put the observations in the order of ObservationCompare. When the data items are ordered
+  // (see orderDataItems) the observations are placed by the ordinal of their data item in
+  // one counting pass, otherwise they are sorted.
+  void groupObservations(ObservationList &observations);
+
 }  // namespace mtconnect
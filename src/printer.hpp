@@ -35,14 +35,27 @@ namespace mtconnect
                                    const std::vector<Device *> &devices,
                                    const std::map<std::string, int> *count = nullptr) const = 0;
 
+    // The observations are borrowed, they are grouped in place
     virtual std::string printSample(const unsigned int instanceId, const unsigned int bufferSize,
                                     const uint64_t nextSeq, const uint64_t firstSeq,
-                                    const uint64_t lastSeq, ObservationPtrArray &results) const = 0;
+                                    const uint64_t lastSeq, ObservationList &results) const = 0;
+
+    // Print observations that are held by the array
+    std::string printSample(const unsigned int instanceId, const unsigned int bufferSize,
+                            const uint64_t nextSeq, const uint64_t firstSeq, const uint64_t lastSeq,
+                            ObservationPtrArray &results) const
+    {
+      ObservationList list(results.begin(), results.end());
+      return printSample(instanceId, bufferSize, nextSeq, firstSeq, lastSeq, list);
+    }
 
     virtual std::string printAssets(const unsigned int anInstanceId, const unsigned int bufferSize,
                                     const unsigned int assetCount,
                                     std::vector<AssetPtr> const &assets) const = 0;
 
+    // One asset as it appears in printAssets, the asset keeps it until it changes
+    virtual std::string printAssetFragment(Asset *asset) const = 0;
+
     virtual std::string printCuttingTool(CuttingToolPtr const tool) const = 0;
 
     virtual std::string mimeType() const = 0;
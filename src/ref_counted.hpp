@@ -37,6 +37,12 @@ namespace mtconnect
       setObject(ptr.getObject(), takeRef);
     }
 
+    // Moving takes the reference of the other pointer
+    RefCountedPtr(RefCountedPtr &&ptr) noexcept : m_object(ptr.m_object)
+    {
+      ptr.m_object = nullptr;
+    }
+
     RefCountedPtr(T &object, bool takeRef = false)
     {
       m_object = nullptr;
@@ -72,10 +78,21 @@ namespace mtconnect
     {
       return setObject(object);
     }
-    T *operator=(RefCountedPtr<T> &ptr)
+    T *operator=(const RefCountedPtr<T> &ptr)
     {
       return setObject(ptr.getObject());
     }
+    T *operator=(RefCountedPtr<T> &&ptr) noexcept
+    {
+      if (this != &ptr)
+      {
+        if (m_object)
+          m_object->unrefer();
+        m_object = ptr.m_object;
+        ptr.m_object = nullptr;
+      }
+      return m_object;
+    }
 
     bool operator==(const RefCountedPtr &another)
     {
@@ -84,6 +101,14 @@ namespace mtconnect
 
     bool operator<(const RefCountedPtr &another);
 
+    // Exchange the objects without changing their reference counts
+    void swap(RefCountedPtr &another)
+    {
+      T *object = m_object;
+      m_object = another.m_object;
+      another.m_object = object;
+    }
+
    protected:
     T *m_object;
   };
@@ -130,17 +155,18 @@ namespace mtconnect
 
     virtual ~RefCounted() = default;
 
-    // Reference count management
+    // Reference count management. A new reference is always made from an existing one so
+    // it needs no ordering, the release that drops the last reference must see all the
+    // writes made through the other references before deleting.
     void referTo()
     {
-      std::atomic_fetch_add(&m_refCount, 1);
+      m_refCount.fetch_add(1, std::memory_order_relaxed);
     }
 
     void unrefer()
     {
-      std::atomic_fetch_sub(&m_refCount, 1);
-      if (m_refCount <= 0)
-        delete this;
+      if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        release();
     }
 
     unsigned int refCount()
@@ -148,6 +174,13 @@ namespace mtconnect
       return m_refCount.load();
     }
 
+   protected:
+    // Called when the last reference is dropped
+    virtual void release()
+    {
+      delete this;
+    }
+
    protected:
     // Reference count
     std::atomic_int m_refCount;
@@ -0,0 +1,60 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace mtconnect
+{
+  // A fixed number of slots addressed by sequence number, a sequence is stored in the
+  // slot of its remainder. Any size is allowed, a power of two uses a mask instead of
+  // the division.
+  template <typename T>
+  class RingBuffer
+  {
+   public:
+    explicit RingBuffer(size_t size)
+      : m_slots(size), m_mask((size & (size - 1)) == 0 ? size - 1 : 0)
+    {
+    }
+
+    T &operator[](uint64_t sequence)
+    {
+      return m_slots[getIndex(sequence)];
+    }
+    const T &operator[](uint64_t sequence) const
+    {
+      return m_slots[getIndex(sequence)];
+    }
+
+    size_t getIndex(uint64_t sequence) const
+    {
+      return m_mask ? size_t(sequence & m_mask) : size_t(sequence % m_slots.size());
+    }
+
+    size_t size() const
+    {
+      return m_slots.size();
+    }
+
+   protected:
+    std::vector<T> m_slots;
+    uint64_t m_mask;
+  };
+}  // namespace mtconnect
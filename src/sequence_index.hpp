@@ -0,0 +1,128 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mtconnect
+{
+  class DataItem;
+
+  // The sequence numbers of the observations of each data item in the sliding
+  // buffer, in ascending order. Narrow sample requests merge the postings of the
+  // requested data items so the cost scales with the results instead of the buffer.
+  class SequenceIndex
+  {
+   public:
+    using Postings = std::deque<uint64_t>;
+
+    void add(const DataItem *item, uint64_t sequence)
+    {
+      m_postings[item].push_back(sequence);
+    }
+
+    // Called when an observation is evicted from the buffer. Everything up to and
+    // including its sequence is gone for the data item.
+    void remove(const DataItem *item, uint64_t sequence)
+    {
+      auto postings = m_postings.find(item);
+      if (postings == m_postings.end())
+        return;
+
+      auto &list = postings->second;
+      while (!list.empty() && list.front() <= sequence)
+        list.pop_front();
+    }
+
+    void clear()
+    {
+      m_postings.clear();
+    }
+
+    const Postings *postings(const DataItem *item) const
+    {
+      auto postings = m_postings.find(item);
+      if (postings == m_postings.end() || postings->second.empty())
+        return nullptr;
+      return &postings->second;
+    }
+
+    // Visit the sequences of all the postings in order, starting at start and going
+    // forward or backward. Stops when the visitor returns false.
+    template <typename Visitor>
+    static void merge(const std::vector<const Postings *> &lists, uint64_t start, bool forward,
+                      Visitor visitor)
+    {
+      // A heap of the next sequence in each list. Going forward the smallest sequence
+      // is on top, going backward the largest.
+      using Cursor = std::pair<uint64_t, size_t>;
+      std::vector<Cursor> heap;
+      heap.reserve(lists.size());
+      std::function<bool(const Cursor &, const Cursor &)> order;
+      if (forward)
+        order = std::greater<Cursor>();
+      else
+        order = std::less<Cursor>();
+
+      // Going backward, positions point one past the next sequence to visit
+      std::vector<Postings::const_iterator> positions(lists.size());
+      for (size_t i = 0; i < lists.size(); i++)
+      {
+        if (forward)
+        {
+          positions[i] = std::lower_bound(lists[i]->begin(), lists[i]->end(), start);
+          if (positions[i] != lists[i]->end())
+            heap.emplace_back(*positions[i], i);
+        }
+        else
+        {
+          positions[i] = std::upper_bound(lists[i]->begin(), lists[i]->end(), start);
+          if (positions[i] != lists[i]->begin())
+            heap.emplace_back(*(positions[i] - 1), i);
+        }
+      }
+      std::make_heap(heap.begin(), heap.end(), order);
+
+      while (!heap.empty())
+      {
+        std::pop_heap(heap.begin(), heap.end(), order);
+        auto cursor = heap.back();
+        heap.pop_back();
+        if (!visitor(cursor.first))
+          return;
+
+        auto &pos = positions[cursor.second];
+        const auto &list = *lists[cursor.second];
+        if (forward ? ++pos != list.end() : --pos != list.begin())
+        {
+          heap.emplace_back(forward ? *pos : *(pos - 1), cursor.second);
+          std::push_heap(heap.begin(), heap.end(), order);
+        }
+      }
+    }
+
+   protected:
+    std::unordered_map<const DataItem *, Postings> m_postings;
+  };
+}  // namespace mtconnect
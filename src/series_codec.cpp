@@ -0,0 +1,398 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#include "series_codec.hpp"
+
+#include "globals.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+namespace mtconnect
+{
+  // Delta of delta buckets: a 0 bit for no change, otherwise a prefix of 1 bits followed
+  // by a zig-zag encoded value of the bucket's width
+  static const int DELTA_WIDTHS[] = {7, 14, 20, 64};
+  static const int DELTA_BUCKETS = sizeof(DELTA_WIDTHS) / sizeof(int);
+
+  static inline uint64_t zigZag(int64_t value)
+  {
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+  }
+
+  static inline int64_t unZigZag(uint64_t value)
+  {
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+  }
+
+  static inline int leadingZeros(uint64_t value)
+  {
+    int count = 0;
+    for (uint64_t bit = uint64_t(1) << 63; bit && !(value & bit); bit >>= 1)
+      count++;
+    return count;
+  }
+
+  static inline int trailingZeros(uint64_t value)
+  {
+    int count = 0;
+    for (; count < 64 && !(value & 1); value >>= 1)
+      count++;
+    return count;
+  }
+
+  static inline uint64_t doubleBits(double value)
+  {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+
+  void SeriesEncoder::write(uint64_t bits, int count)
+  {
+    while (count > 0)
+    {
+      if (m_free == 0)
+      {
+        m_data.push_back(0);
+        m_free = 8;
+      }
+
+      int take = count < m_free ? count : m_free;
+      uint8_t chunk = uint8_t((bits >> (count - take)) & ((1u << take) - 1));
+      m_data.back() |= char(chunk << (m_free - take));
+      m_free -= take;
+      count -= take;
+    }
+  }
+
+  void SeriesEncoder::writeDelta(int64_t delta)
+  {
+    if (delta == 0)
+    {
+      write(0, 1);
+      return;
+    }
+
+    auto value = zigZag(delta);
+    for (int i = 0; i < DELTA_BUCKETS; i++)
+    {
+      auto width = DELTA_WIDTHS[i];
+      if (width == 64 || value < (uint64_t(1) << width))
+      {
+        // i + 1 one bits, terminated by a 0 unless it is the last bucket
+        if (i + 1 < DELTA_BUCKETS)
+          write(((uint64_t(1) << (i + 1)) - 1) << 1, i + 2);
+        else
+          write((uint64_t(1) << DELTA_BUCKETS) - 1, DELTA_BUCKETS);
+        write(value, width);
+        return;
+      }
+    }
+  }
+
+  void SeriesEncoder::writeValue(uint64_t bits)
+  {
+    auto x = bits ^ m_value;
+    m_value = bits;
+    if (x == 0)
+    {
+      write(0, 1);
+      return;
+    }
+
+    int leading = leadingZeros(x), trailing = trailingZeros(x);
+    if (leading > 31)
+      leading = 31;
+
+    // Reuse the previous window of meaningful bits if it covers this one
+    if (m_leading >= 0 && leading >= m_leading && trailing >= m_trailing)
+    {
+      write(2, 2);
+      write(x >> m_trailing, 64 - m_leading - m_trailing);
+    }
+    else
+    {
+      int length = 64 - leading - trailing;
+      write(3, 2);
+      write(leading, 5);
+      write(length - 1, 6);
+      write(x >> trailing, length);
+      m_leading = leading;
+      m_trailing = trailing;
+    }
+  }
+
+  void SeriesEncoder::add(uint64_t sequence, int64_t time, double value)
+  {
+    if (m_count == 0)
+    {
+      write(sequence, 64);
+      write(uint64_t(time), 64);
+      m_value = doubleBits(value);
+      write(m_value, 64);
+    }
+    else
+    {
+      int64_t sequenceDelta = int64_t(sequence - m_sequence);
+      writeDelta(sequenceDelta - m_sequenceDelta);
+      m_sequenceDelta = sequenceDelta;
+
+      int64_t timeDelta = time - m_time;
+      writeDelta(timeDelta - m_timeDelta);
+      m_timeDelta = timeDelta;
+
+      writeValue(doubleBits(value));
+    }
+
+    m_sequence = sequence;
+    m_time = time;
+    m_count++;
+  }
+
+  bool SeriesDecoder::read(int count, uint64_t &bits)
+  {
+    if (m_position + count > m_size * 8)
+      return false;
+
+    bits = 0;
+    while (count > 0)
+    {
+      int offset = int(m_position % 8);
+      int take = 8 - offset < count ? 8 - offset : count;
+      uint64_t chunk = (m_data[m_position / 8] >> (8 - offset - take)) & ((1u << take) - 1);
+      bits = (bits << take) | chunk;
+      m_position += take;
+      count -= take;
+    }
+    return true;
+  }
+
+  bool SeriesDecoder::readDelta(int64_t &delta)
+  {
+    uint64_t bit;
+    int bucket = 0;
+    while (bucket < DELTA_BUCKETS)
+    {
+      if (!read(1, bit))
+        return false;
+      if (!bit)
+        break;
+      bucket++;
+    }
+
+    if (bucket == 0)
+    {
+      delta = 0;
+      return true;
+    }
+
+    uint64_t value;
+    if (!read(DELTA_WIDTHS[bucket - 1], value))
+      return false;
+    delta = unZigZag(value);
+    return true;
+  }
+
+  bool SeriesDecoder::readValue(uint64_t &bits)
+  {
+    uint64_t control;
+    if (!read(1, control))
+      return false;
+    if (!control)
+    {
+      bits = m_value;
+      return true;
+    }
+
+    if (!read(1, control))
+      return false;
+    if (control)
+    {
+      uint64_t leading, length;
+      if (!read(5, leading) || !read(6, length))
+        return false;
+      m_leading = int(leading);
+      m_trailing = 64 - m_leading - int(length + 1);
+      if (m_trailing < 0)
+        return false;
+    }
+
+    uint64_t x;
+    if (!read(64 - m_leading - m_trailing, x))
+      return false;
+    m_value ^= x << m_trailing;
+    bits = m_value;
+    return true;
+  }
+
+  bool SeriesDecoder::next(uint64_t &sequence, int64_t &time, double &value)
+  {
+    if (m_remaining == 0)
+      return false;
+
+    uint64_t bits;
+    if (m_first)
+    {
+      uint64_t t;
+      if (!read(64, m_sequence) || !read(64, t) || !read(64, m_value))
+        return false;
+      m_time = int64_t(t);
+      bits = m_value;
+      m_first = false;
+    }
+    else
+    {
+      int64_t sequenceDod, timeDod;
+      if (!readDelta(sequenceDod))
+        return false;
+      m_sequenceDelta += sequenceDod;
+      if (!readDelta(timeDod) || !readValue(bits))
+        return false;
+      m_timeDelta += timeDod;
+      m_sequence += m_sequenceDelta;
+      m_time += m_timeDelta;
+    }
+
+    m_remaining--;
+    sequence = m_sequence;
+    time = m_time;
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+  }
+
+  // Days since the epoch of a proleptic Gregorian date
+  static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d)
+  {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = unsigned(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + int64_t(doe) - 719468;
+  }
+
+  static void civilFromDays(int64_t z, int64_t &y, unsigned &m, unsigned &d)
+  {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = unsigned(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp + (mp < 10 ? 3 : -9);
+    y = int64_t(yoe) + era * 400 + (m <= 2);
+  }
+
+  static inline bool digitsAt(const char *p, int count, int &value)
+  {
+    value = 0;
+    for (int i = 0; i < count; i++)
+    {
+      if (p[i] < '0' || p[i] > '9')
+        return false;
+      value = value * 10 + (p[i] - '0');
+    }
+    return true;
+  }
+
+  bool parseTimestamp(const string &text, int64_t &micros, int &digits)
+  {
+    // YYYY-MM-DDTHH:MM:SS[.ffffff]Z
+    const char *p = text.c_str();
+    int year, month, day, hour, minute, second;
+    if (text.size() < 20 || !digitsAt(p, 4, year) || p[4] != '-' || !digitsAt(p + 5, 2, month) ||
+        p[7] != '-' || !digitsAt(p + 8, 2, day) || p[10] != 'T' || !digitsAt(p + 11, 2, hour) ||
+        p[13] != ':' || !digitsAt(p + 14, 2, minute) || p[16] != ':' ||
+        !digitsAt(p + 17, 2, second) || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour > 23 || minute > 59 || second > 59)
+      return false;
+
+    int fraction = 0;
+    digits = 0;
+    p += 19;
+    if (*p == '.')
+    {
+      p++;
+      while (digits < 6 && *p >= '0' && *p <= '9')
+      {
+        fraction = fraction * 10 + (*p++ - '0');
+        digits++;
+      }
+      if (digits == 0)
+        return false;
+    }
+    if (p[0] != 'Z' || p[1] != '\0')
+      return false;
+
+    for (int i = digits; i < 6; i++)
+      fraction *= 10;
+
+    int64_t days = daysFromCivil(year, unsigned(month), unsigned(day));
+    micros = ((days * 24 + hour) * 60 + minute) * 60 + second;
+    micros = micros * 1000000 + fraction;
+
+    return formatTimestamp(micros, digits) == text;
+  }
+
+  string formatTimestamp(int64_t micros, int digits)
+  {
+    int64_t seconds = micros / 1000000, fraction = micros % 1000000;
+    if (fraction < 0)
+    {
+      fraction += 1000000;
+      seconds--;
+    }
+    int64_t days = seconds / 86400, rest = seconds % 86400;
+    if (rest < 0)
+    {
+      rest += 86400;
+      days--;
+    }
+
+    int64_t year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+
+    char buffer[40];
+    int len = snprintf(buffer, sizeof(buffer), "%04lld-%02u-%02uT%02d:%02d:%02d", (long long)year,
+                       month, day, int(rest / 3600), int(rest / 60 % 60), int(rest % 60));
+    if (digits > 0)
+    {
+      for (int i = digits; i < 6; i++)
+        fraction /= 10;
+      len += snprintf(buffer + len, sizeof(buffer) - len, ".%0*d", digits, int(fraction));
+    }
+    buffer[len++] = 'Z';
+
+    return string(buffer, len);
+  }
+
+  bool parseSampleValue(const string &text, double &value)
+  {
+    if (text.empty())
+      return false;
+
+    char *end;
+    value = strtod(text.c_str(), &end);
+    return *end == '\0' && floatToString(value) == text;
+  }
+}  // namespace mtconnect
@@ -0,0 +1,103 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace mtconnect
+{
+  // Encodes the samples of one data item as a column of bits, Gorilla style. Sequence
+  // numbers and timestamps are stored as the difference between consecutive deltas and
+  // values as the XOR with the previous value, so a series that changes slowly takes a
+  // few bits per sample.
+  class SeriesEncoder
+  {
+   public:
+    // Times are in microseconds
+    void add(uint64_t sequence, int64_t time, double value);
+
+    size_t getCount() const
+    {
+      return m_count;
+    }
+    const std::string &getData() const
+    {
+      return m_data;
+    }
+
+   protected:
+    void write(uint64_t bits, int count);
+    void writeDelta(int64_t delta);
+    void writeValue(uint64_t bits);
+
+   protected:
+    std::string m_data;
+    int m_free = 0;
+    size_t m_count = 0;
+
+    uint64_t m_sequence = 0;
+    int64_t m_sequenceDelta = 0;
+    int64_t m_time = 0;
+    int64_t m_timeDelta = 0;
+    uint64_t m_value = 0;
+    int m_leading = -1;
+    int m_trailing = 0;
+  };
+
+  // Reads the samples written by a SeriesEncoder in order
+  class SeriesDecoder
+  {
+   public:
+    SeriesDecoder(const char *data, size_t size, size_t count)
+      : m_data(reinterpret_cast<const uint8_t *>(data)), m_size(size), m_remaining(count)
+    {
+    }
+
+    // Returns false after the last sample or if the data is truncated
+    bool next(uint64_t &sequence, int64_t &time, double &value);
+
+   protected:
+    bool read(int count, uint64_t &bits);
+    bool readDelta(int64_t &delta);
+    bool readValue(uint64_t &bits);
+
+   protected:
+    const uint8_t *m_data;
+    size_t m_size;
+    size_t m_position = 0;
+    size_t m_remaining;
+    bool m_first = true;
+
+    uint64_t m_sequence = 0;
+    int64_t m_sequenceDelta = 0;
+    int64_t m_time = 0;
+    int64_t m_timeDelta = 0;
+    uint64_t m_value = 0;
+    int m_leading = 0;
+    int m_trailing = 0;
+  };
+
+  // Convert between a UTC timestamp, 2020-01-01T00:00:00.123456Z, and microseconds since
+  // the epoch. The number of fractional digits is kept so the text is restored exactly.
+  bool parseTimestamp(const std::string &text, int64_t &micros, int &digits);
+  std::string formatTimestamp(int64_t micros, int digits);
+
+  // The value of a sample if the agent prints it back exactly as the text
+  bool parseSampleValue(const std::string &text, double &value);
+}  // namespace mtconnect
@@ -0,0 +1,101 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#include "stream_group.hpp"
+
+#include <dlib/logger.h>
+
+namespace mtconnect
+{
+  static dlib::logger g_logger("stream.group");
+
+  bool StreamGroup::join(Chunk &position)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_members == 0)
+    {
+      // Nobody is streaming, take over the position of the new member
+      m_chunk.m_end = position.m_end;
+      m_chunk.m_endOfBuffer = position.m_endOfBuffer;
+      m_chunk.m_last = position.m_last;
+      m_chunk.m_closed = false;
+    }
+    else if (m_chunk.m_closed)
+      return false;
+    else if (!m_key.m_current &&
+             (!m_chunk.m_endOfBuffer || !position.m_endOfBuffer || m_chunk.m_end != position.m_end))
+      return false;
+
+    m_members++;
+    position.m_generation = m_chunk.m_generation;
+    g_logger << dlib::LDEBUG << "Session joined stream group, members: " << m_members;
+
+    return true;
+  }
+
+  void StreamGroup::leave()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_members--;
+    g_logger << dlib::LDEBUG << "Session left stream group, members: " << m_members;
+  }
+
+  StreamGroup::Chunk StreamGroup::next(uint64_t generation, const Waiter &waiter,
+                                       const Fetcher &fetcher)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_chunk.m_generation <= generation)
+    {
+      if (m_producing)
+      {
+        m_cond.wait(lock);
+        continue;
+      }
+
+      // This thread is the producer for the next generation. The wait is done without
+      // the lock so other sessions can join while the group waits for data.
+      m_producing = true;
+      auto last = m_chunk;
+      lock.unlock();
+
+      try
+      {
+        auto start = waiter(last);
+
+        lock.lock();
+        auto chunk = fetcher(start);
+        chunk.m_generation = m_chunk.m_generation + 1;
+        m_chunk = chunk;
+      }
+      catch (...)
+      {
+        if (!lock.owns_lock())
+          lock.lock();
+        m_producing = false;
+        m_cond.notify_all();
+        throw;
+      }
+
+      m_producing = false;
+      m_cond.notify_all();
+    }
+
+    return m_chunk;
+  }
+}  // namespace mtconnect
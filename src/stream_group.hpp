@@ -0,0 +1,125 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include "change_observer.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
+
+namespace mtconnect
+{
+  class Printer;
+
+  // A stream group allows streaming sessions with identical requests to share
+  // a single fetch and serialization per interval. The first member to ask for
+  // the next chunk becomes the producer, all others wait for it and write the
+  // same encoded chunk to their own connection.
+  class StreamGroup
+  {
+   public:
+    struct Key
+    {
+      const Printer *m_printer;
+      std::set<std::string> m_filter;
+      unsigned int m_interval;
+      bool m_current;
+      int m_count;
+      std::chrono::milliseconds m_heartbeat;
+      bool m_webSocket;
+
+      bool operator<(const Key &other) const
+      {
+        return std::tie(m_printer, m_interval, m_current, m_count, m_heartbeat, m_webSocket,
+                        m_filter) < std::tie(other.m_printer, other.m_interval, other.m_current,
+                                             other.m_count, other.m_heartbeat, other.m_webSocket,
+                                             other.m_filter);
+      }
+    };
+
+    // A framed chunk and the stream position after it was fetched
+    struct Chunk
+    {
+      uint64_t m_generation = 0;
+      std::shared_ptr<const std::string> m_data;
+      // The first sequence fetched and the number of observations in the chunk
+      uint64_t m_start = 0;
+      size_t m_observations = 0;
+      uint64_t m_end = 0;
+      bool m_endOfBuffer = true;
+      bool m_closed = false;
+      bool m_heartbeat = false;
+      std::chrono::steady_clock::time_point m_last;
+    };
+
+    // Waits for the next interval and returns the sequence to fetch from.
+    using Waiter = std::function<uint64_t(const Chunk &last)>;
+    // Fetches and frames the chunk starting at a sequence number.
+    using Fetcher = std::function<Chunk(uint64_t start)>;
+
+   public:
+    StreamGroup(const Key &key, const std::string &boundary) : m_key(key), m_boundary(boundary)
+    {
+    }
+
+    const Key &getKey() const
+    {
+      return m_key;
+    }
+    const std::string &getBoundary() const
+    {
+      return m_boundary;
+    }
+    ChangeObserver &getObserver()
+    {
+      return m_observer;
+    }
+    int getMemberCount() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_members;
+    }
+
+    // Join the group if the session is at the same position as the group. If the
+    // group has no members, it adopts the position of the session. On success, the
+    // generation of the position is set to the generation the session has seen.
+    bool join(Chunk &position);
+    void leave();
+
+    // Get the chunk following generation. If no one is producing it, the calling
+    // thread waits for the interval and fetches the chunk for the whole group.
+    Chunk next(uint64_t generation, const Waiter &waiter, const Fetcher &fetcher);
+
+   protected:
+    const Key m_key;
+    const std::string m_boundary;
+    ChangeObserver m_observer;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    Chunk m_chunk;
+    int m_members = 0;
+    bool m_producing = false;
+  };
+}  // namespace mtconnect
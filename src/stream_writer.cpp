@@ -0,0 +1,130 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#include "stream_writer.hpp"
+
+#include <dlib/logger.h>
+
+using namespace std;
+
+namespace mtconnect
+{
+  static dlib::logger g_logger("stream.writer");
+
+  StreamWriter::StreamWriter(Sink sink, std::function<void()> shutdown)
+      : m_sink(std::move(sink)), m_shutdown(std::move(shutdown))
+  {
+    m_thread = thread(&StreamWriter::run, this);
+  }
+
+  StreamWriter::~StreamWriter()
+  {
+    close(std::chrono::milliseconds{0});
+  }
+
+  bool StreamWriter::push(std::shared_ptr<const std::string> data, uint64_t start,
+                          size_t observations, size_t maxBytes)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Nothing more will be written once the client is gone
+    if (!m_open || m_closing)
+      return true;
+
+    if (!m_queue.empty() && m_queuedBytes + data->size() > maxBytes)
+      return false;
+
+    m_queuedBytes += data->size();
+    m_queue.push_back({std::move(data), start, observations});
+    m_cond.notify_all();
+
+    return true;
+  }
+
+  size_t StreamWriter::clear(uint64_t &start)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Documents that are not part of the sample stream have no start sequence
+    size_t observations = 0;
+    bool first = true;
+    for (const auto &entry : m_queue)
+    {
+      if (first && entry.m_start != 0)
+      {
+        start = entry.m_start;
+        first = false;
+      }
+      m_queuedBytes -= entry.m_data->size();
+      observations += entry.m_observations;
+    }
+    m_queue.clear();
+
+    return observations;
+  }
+
+  void StreamWriter::close(std::chrono::milliseconds timeout)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_closing = true;
+      m_cond.notify_all();
+
+      auto drained = m_cond.wait_for(lock, timeout, [this]() {
+        return !m_open || (m_queue.empty() && !m_writing);
+      });
+
+      if (!drained)
+      {
+        g_logger << dlib::LDEBUG << "Client is not reading, dropping " << m_queuedBytes
+                 << " bytes and closing the connection";
+        m_queue.clear();
+        if (m_writing && m_shutdown)
+          m_shutdown();
+      }
+    }
+
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+  void StreamWriter::run()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_open)
+    {
+      m_cond.wait(lock, [this]() { return m_closing || !m_queue.empty(); });
+      if (m_queue.empty())
+        break;
+
+      auto entry = std::move(m_queue.front());
+      m_queue.pop_front();
+      m_writing = true;
+
+      lock.unlock();
+      bool good = m_sink(*entry.m_data);
+      lock.lock();
+
+      m_writing = false;
+      m_queuedBytes -= entry.m_data->size();
+      if (!good)
+        m_open = false;
+      m_cond.notify_all();
+    }
+  }
+}  // namespace mtconnect
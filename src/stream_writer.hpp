@@ -0,0 +1,107 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace mtconnect
+{
+  // What a stream does when the client does not read fast enough to keep the
+  // queued output under the limit
+  enum SlowConsumerPolicy
+  {
+    // Drop the queued chunks and send the latest value of each data item since
+    // the first dropped chunk
+    COALESCE,
+    // Drop the queued chunks and send the current state
+    SKIP_TO_CURRENT,
+    // Close the stream
+    DISCONNECT
+  };
+
+  // Queues the chunks of a streaming session and writes them to the client from
+  // its own thread so a slow client never blocks the session. The bytes waiting
+  // to be written are accounted so the session can apply a SlowConsumerPolicy.
+  class StreamWriter
+  {
+   public:
+    // Writes data to the client, returns false when the client is gone
+    using Sink = std::function<bool(const std::string &)>;
+
+    StreamWriter(Sink sink, std::function<void()> shutdown = nullptr);
+    ~StreamWriter();
+
+    // Queue data unless it would take the queue over maxBytes. An empty queue always
+    // accepts the data so a document larger than the limit can still be sent. The
+    // start sequence and number of observations are kept for when it is dropped.
+    bool push(std::shared_ptr<const std::string> data, uint64_t start, size_t observations,
+              size_t maxBytes);
+
+    // Drop everything that has not been written. Returns the number of observations
+    // dropped and sets start to the first start sequence of the dropped chunks. Entries
+    // queued with a start of 0 are not part of the sample stream.
+    size_t clear(uint64_t &start);
+
+    // Wait up to timeout for the queue to be written, then stop the writer. If the
+    // client is still not reading, the connection is shut down.
+    void close(std::chrono::milliseconds timeout);
+
+    bool isOpen() const
+    {
+      return m_open;
+    }
+    size_t getQueuedBytes() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_queuedBytes;
+    }
+
+   protected:
+    void run();
+
+   protected:
+    struct Entry
+    {
+      std::shared_ptr<const std::string> m_data;
+      uint64_t m_start;
+      size_t m_observations;
+    };
+
+    Sink m_sink;
+    std::function<void()> m_shutdown;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Entry> m_queue;
+    // Bytes in the queue and in the write in progress
+    size_t m_queuedBytes = 0;
+    bool m_writing = false;
+    bool m_closing = false;
+    std::atomic_bool m_open{true};
+    std::thread m_thread;
+  };
+}  // namespace mtconnect
@@ -0,0 +1,148 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#include "string_pool.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+using namespace std;
+
+namespace mtconnect
+{
+  // Open addressing with linear probing over twice as many slots as ids so a probe always
+  // reaches a free slot. A slot holds the id of its string, NONE while it is free. The
+  // string of an id is published before the id is stored in a slot.
+  class StringTable
+  {
+   public:
+    static constexpr size_t SlotCount = StringPool::Capacity * 2;
+
+    StringTable()
+      : m_strings(new atomic<const string *>[StringPool::Capacity]),
+        m_slots(new atomic<uint32_t>[SlotCount])
+    {
+      for (size_t i = 0; i < StringPool::Capacity; i++)
+        m_strings[i].store(nullptr, memory_order_relaxed);
+      for (size_t i = 0; i < SlotCount; i++)
+        m_slots[i].store(StringPool::NONE, memory_order_relaxed);
+
+      intern("UNAVAILABLE", nullptr);
+    }
+
+    uint32_t intern(const string &text, bool *added)
+    {
+      if (added)
+        *added = false;
+      if (text.size() > StringPool::MaxLength)
+        return StringPool::NONE;
+
+      auto reserved = StringPool::NONE;
+      auto index = hash<string>()(text);
+      for (size_t i = 0; i < SlotCount; i++, index++)
+      {
+        auto &slot = m_slots[index & (SlotCount - 1)];
+        auto id = slot.load(memory_order_acquire);
+        if (id == StringPool::NONE)
+        {
+          if (reserved == StringPool::NONE)
+          {
+            // Checked first so a full table stops handing out ids
+            if (m_next.load(memory_order_relaxed) >= StringPool::Capacity)
+              return StringPool::NONE;
+            reserved = m_next.fetch_add(1);
+            if (reserved >= StringPool::Capacity)
+              return StringPool::NONE;
+            m_strings[reserved].store(new string(text), memory_order_release);
+          }
+
+          if (slot.compare_exchange_strong(id, reserved, memory_order_acq_rel))
+          {
+            if (added)
+              *added = true;
+            return reserved;
+          }
+        }
+
+        // Another thread may have added the same text, the id reserved for it is not used
+        if (*m_strings[id].load(memory_order_acquire) == text)
+          return id;
+      }
+
+      return StringPool::NONE;
+    }
+
+    uint32_t find(const string &text) const
+    {
+      auto index = hash<string>()(text);
+      for (size_t i = 0; i < SlotCount; i++, index++)
+      {
+        auto id = m_slots[index & (SlotCount - 1)].load(memory_order_acquire);
+        if (id == StringPool::NONE)
+          break;
+        if (*m_strings[id].load(memory_order_acquire) == text)
+          return id;
+      }
+
+      return StringPool::NONE;
+    }
+
+    const string &get(uint32_t id) const
+    {
+      return *m_strings[id].load(memory_order_acquire);
+    }
+
+    size_t getCount() const
+    {
+      auto next = m_next.load();
+      return (next < StringPool::Capacity ? next : StringPool::Capacity) - 1;
+    }
+
+   protected:
+    unique_ptr<atomic<const string *>[]> m_strings;
+    unique_ptr<atomic<uint32_t>[]> m_slots;
+    atomic<uint32_t> m_next {StringPool::NONE + 1};
+  };
+
+  // Never destroyed so observations can refer to it until the end
+  static StringTable &table()
+  {
+    static auto s_table = new StringTable;
+    return *s_table;
+  }
+
+  uint32_t StringPool::intern(const string &text, bool *added)
+  {
+    return table().intern(text, added);
+  }
+
+  uint32_t StringPool::find(const string &text)
+  {
+    return table().find(text);
+  }
+
+  const string &StringPool::get(uint32_t id)
+  {
+    return table().get(id);
+  }
+
+  size_t StringPool::getCount()
+  {
+    return table().getCount();
+  }
+}  // namespace mtconnect
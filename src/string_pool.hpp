@@ -0,0 +1,53 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mtconnect
+{
+  // A global table of strings that are stored once and never freed, addressed by a 32 bit
+  // id so observations can refer to a value without a copy of it. Lookups and inserts are
+  // lock free so the adapter threads intern values as they arrive. The table has a fixed
+  // capacity, once it is full new strings are not interned.
+  class StringPool
+  {
+   public:
+    // Id 0 is not a string, UNAVAILABLE is always interned
+    static constexpr uint32_t NONE = 0;
+    static constexpr uint32_t UNAVAILABLE = 1;
+
+    static constexpr size_t Capacity = 65536;
+    static constexpr size_t MaxLength = 256;
+
+    // The id of the text, adding it if there is room. Returns NONE when the table is full or
+    // the text is longer than MaxLength. added is set if the text was not in the table.
+    static uint32_t intern(const std::string &text, bool *added = nullptr);
+
+    // The id of the text if it is in the table, NONE otherwise
+    static uint32_t find(const std::string &text);
+
+    // The text of an id returned by intern or find
+    static const std::string &get(uint32_t id);
+
+    // The number of strings in the table
+    static size_t getCount();
+  };
+}  // namespace mtconnect
@@ -0,0 +1,130 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+
+namespace mtconnect
+{
+  // A sparse index of the time observations were added to the sliding buffer. The
+  // buffer is divided into blocks of consecutive sequences covering at most a
+  // resolution of time or a number of observations, and only the first sequence and
+  // the time span of each block is kept. Times resolve to sequences with a binary
+  // search over the blocks.
+  class TimeIndex
+  {
+   public:
+    // Times are in microseconds
+    TimeIndex(uint64_t resolution = 100000, uint64_t blockSize = 1024)
+      : m_resolution(resolution), m_blockSize(blockSize)
+    {
+    }
+
+    void add(uint64_t sequence, uint64_t time)
+    {
+      if (!m_blocks.empty())
+      {
+        auto &last = m_blocks.back();
+        if (sequence <= last.m_sequence)
+        {
+          // The sequence was reset, nothing indexed is valid
+          m_blocks.clear();
+        }
+        else
+        {
+          // Keep the times ordered if the clock steps back
+          time = std::max(time, last.m_last);
+          if (time - last.m_first < m_resolution && sequence - last.m_sequence < m_blockSize)
+          {
+            last.m_last = time;
+            return;
+          }
+        }
+      }
+
+      m_blocks.push_back({sequence, time, time});
+    }
+
+    // Drop the blocks that are completely before the first sequence in the buffer
+    void trim(uint64_t firstSequence)
+    {
+      while (m_blocks.size() > 1 && m_blocks[1].m_sequence <= firstSequence)
+        m_blocks.pop_front();
+    }
+
+    void clear()
+    {
+      m_blocks.clear();
+    }
+
+    // The first sequence that may have been added at or after time. Returns end if
+    // everything was added before it.
+    uint64_t from(uint64_t time, uint64_t end) const
+    {
+      auto block = std::lower_bound(
+          m_blocks.begin(), m_blocks.end(), time,
+          [](const Block &block, uint64_t time) { return block.m_last < time; });
+      if (block == m_blocks.end())
+        return end;
+      return block->m_sequence;
+    }
+
+    // The first sequence added after time, everything before it may have been added
+    // at or before time. Returns end if it follows everything in the index.
+    uint64_t to(uint64_t time, uint64_t end) const
+    {
+      auto block = std::upper_bound(
+          m_blocks.begin(), m_blocks.end(), time,
+          [](uint64_t time, const Block &block) { return time < block.m_first; });
+      if (block == m_blocks.end())
+        return end;
+      return block->m_sequence;
+    }
+
+    // The time the block holding the sequence was started. Returns 0 if the sequence is
+    // not indexed.
+    uint64_t time(uint64_t sequence) const
+    {
+      auto block = std::upper_bound(
+          m_blocks.begin(), m_blocks.end(), sequence,
+          [](uint64_t sequence, const Block &block) { return sequence < block.m_sequence; });
+      if (block == m_blocks.begin())
+        return 0;
+      return (block - 1)->m_first;
+    }
+
+    size_t size() const
+    {
+      return m_blocks.size();
+    }
+
+   protected:
+    struct Block
+    {
+      uint64_t m_sequence;
+      uint64_t m_first;
+      uint64_t m_last;
+    };
+
+    uint64_t m_resolution;
+    uint64_t m_blockSize;
+    std::deque<Block> m_blocks;
+  };
+}  // namespace mtconnect
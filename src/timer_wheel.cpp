@@ -0,0 +1,247 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#include "timer_wheel.hpp"
+
+#include <dlib/logger.h>
+
+#include <algorithm>
+
+using namespace std;
+
+namespace mtconnect
+{
+  static dlib::logger g_logger("timer.wheel");
+
+  static const uint64_t MASK = TimerWheel::SLOTS - 1;
+
+  TimerWheel::TimerWheel(std::chrono::milliseconds tick) : m_tick(tick), m_start(Clock::now())
+  {
+  }
+
+  TimerWheel::~TimerWheel()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_running = false;
+      m_wake.notify_one();
+    }
+
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+  TimerWheel &TimerWheel::instance()
+  {
+    static TimerWheel wheel;
+    return wheel;
+  }
+
+  TimerWheel::TimerId TimerWheel::schedule(Clock::time_point deadline, Callback callback)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // The service thread is only started when it is first needed
+    if (!m_thread.joinable())
+      m_thread = thread(&TimerWheel::run, this);
+
+    auto id = m_nextId++;
+    Bucket pending;
+    pending.push_back({id, max(toTick(deadline), m_current + 1), std::move(callback)});
+    auto tick = pending.front().m_tick;
+    place(pending, pending.begin());
+
+    // Wake the service thread if this timer is due before it would wake
+    if (tick < m_wakeup)
+      m_wake.notify_one();
+
+    return id;
+  }
+
+  bool TimerWheel::cancel(TimerId id)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto timer = m_timers.find(id);
+    if (timer != m_timers.end())
+    {
+      bucket(timer->second).erase(timer->second.m_timer);
+      m_timers.erase(timer);
+      return true;
+    }
+
+    if (this_thread::get_id() != m_thread.get_id())
+      m_fired.wait(lock, [this, id]() { return m_firing != id; });
+
+    return false;
+  }
+
+  void TimerWheel::sleepUntil(Clock::time_point deadline)
+  {
+    if (Clock::now() >= deadline)
+      return;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool fired = false;
+    schedule(deadline, [&]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      fired = true;
+      cond.notify_one();
+    });
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&fired]() { return fired; });
+  }
+
+  // Put a timer in the slot for its distance from the current tick. Timers less
+  // than SLOTS ticks away go in level 0 where each slot is a single tick.
+  void TimerWheel::place(Bucket &from, Bucket::iterator timer)
+  {
+    auto delta = timer->m_tick - m_current;
+    int level = 0;
+    while (level < LEVELS && delta >= (uint64_t(1) << (BITS * (level + 1))))
+      level++;
+
+    int slot = 0;
+    if (level < LEVELS)
+      slot = int((timer->m_tick >> (BITS * level)) & MASK);
+
+    Location location{level, slot, timer};
+    bucket(location).splice(bucket(location).end(), from, timer);
+    m_timers[timer->m_id] = location;
+  }
+
+  // The next tick that fires timers or moves them down a level
+  uint64_t TimerWheel::nextTick() const
+  {
+    uint64_t next = UINT64_MAX;
+
+    for (uint64_t tick = m_current + 1; tick < m_current + SLOTS; tick++)
+    {
+      if (!m_slots[0][tick & MASK].empty())
+      {
+        next = tick;
+        break;
+      }
+    }
+
+    for (int level = 1; level < LEVELS; level++)
+    {
+      auto shift = BITS * level;
+      auto base = m_current >> shift;
+      for (uint64_t i = 1; i <= SLOTS; i++)
+      {
+        if (!m_slots[level][(base + i) & MASK].empty())
+        {
+          next = min(next, (base + i) << shift);
+          break;
+        }
+      }
+    }
+
+    if (!m_overflow.empty())
+      next = min(next, ((m_current >> (BITS * LEVELS)) + 1) << (BITS * LEVELS));
+
+    return next;
+  }
+
+  // Move to the tick, cascading timers from the higher levels whose slot starts
+  // at this tick and making the level 0 slot due.
+  void TimerWheel::advance(uint64_t tick)
+  {
+    m_current = tick;
+
+    // Timers that are still too far away go back to the overflow list
+    if ((tick & ((uint64_t(1) << (BITS * LEVELS)) - 1)) == 0)
+    {
+      Bucket overflow;
+      overflow.splice(overflow.end(), m_overflow);
+      while (!overflow.empty())
+        place(overflow, overflow.begin());
+    }
+
+    for (int level = LEVELS - 1; level > 0; level--)
+    {
+      auto shift = BITS * level;
+      if ((tick & ((uint64_t(1) << shift) - 1)) == 0)
+      {
+        auto &slot = m_slots[level][(tick >> shift) & MASK];
+        while (!slot.empty())
+          place(slot, slot.begin());
+      }
+    }
+
+    auto &slot = m_slots[0][tick & MASK];
+    for (auto &timer : slot)
+      m_timers[timer.m_id].m_level = -1;
+    m_due.splice(m_due.end(), slot);
+  }
+
+  void TimerWheel::run()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (m_running)
+    {
+      auto now = uint64_t((Clock::now() - m_start) / m_tick);
+      auto next = nextTick();
+      if (next > now)
+      {
+        m_wakeup = next;
+        if (next == UINT64_MAX)
+          m_wake.wait(lock);
+        else
+          m_wake.wait_until(lock, toTime(next));
+        m_wakeup = 0;
+        continue;
+      }
+
+      for (; next <= now; next = nextTick())
+        advance(next);
+
+      if (m_due.empty())
+        continue;
+
+      m_wakeups++;
+      while (!m_due.empty())
+      {
+        auto timer = std::move(m_due.front());
+        m_due.pop_front();
+        m_timers.erase(timer.m_id);
+
+        m_firing = timer.m_id;
+        lock.unlock();
+        try
+        {
+          timer.m_callback();
+        }
+        catch (std::exception &e)
+        {
+          g_logger << dlib::LERROR << "Timer callback threw an exception: " << e.what();
+        }
+        catch (...)
+        {
+          g_logger << dlib::LERROR << "Timer callback threw an unknown exception";
+        }
+        lock.lock();
+        m_firing = 0;
+        m_fired.notify_all();
+      }
+    }
+  }
+}  // namespace mtconnect
@@ -0,0 +1,146 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace mtconnect
+{
+  // A hierarchical timer wheel on the steady clock serviced by a single thread.
+  // Deadlines are rounded up to the next tick, so timers due in the same tick are
+  // kept in the same slot and fired together in one wakeup. The service thread
+  // sleeps until the next occupied slot instead of ticking.
+  //
+  // Callbacks run on the service thread and must be short, they should only
+  // signal the thread that does the actual work.
+  class TimerWheel
+  {
+   public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+    using TimerId = uint64_t;
+
+    // 64 slots per level, 4 levels cover about 4.6 hours with a 1ms tick.
+    // Anything further out waits in an overflow list.
+    static constexpr int BITS = 6;
+    static constexpr int SLOTS = 1 << BITS;
+    static constexpr int LEVELS = 4;
+
+   public:
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds{1});
+    ~TimerWheel();
+
+    // The wheel shared by the agent
+    static TimerWheel &instance();
+
+    // Call back at or after the deadline. Never returns 0.
+    TimerId schedule(Clock::time_point deadline, Callback callback);
+
+    // Returns true if the timer was removed before it fired. If the callback is
+    // running, waits for it to complete, so the caller must not hold any lock the
+    // callback takes.
+    bool cancel(TimerId id);
+
+    // Block the calling thread until the deadline. Must not be called from a callback.
+    void sleepUntil(Clock::time_point deadline);
+
+    size_t size() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return m_timers.size();
+    }
+
+    // Number of times the service thread woke up and fired timers
+    uint64_t getWakeups() const
+    {
+      return m_wakeups;
+    }
+
+   protected:
+    struct Timer
+    {
+      TimerId m_id;
+      uint64_t m_tick;
+      Callback m_callback;
+    };
+    using Bucket = std::list<Timer>;
+
+    // Where a pending timer lives. Level -1 means it is due and about to fire.
+    struct Location
+    {
+      int m_level;
+      int m_slot;
+      Bucket::iterator m_timer;
+    };
+
+    uint64_t toTick(Clock::time_point time) const
+    {
+      if (time <= m_start)
+        return 0;
+      return uint64_t((time - m_start + m_tick - Clock::duration{1}) / m_tick);
+    }
+    Clock::time_point toTime(uint64_t tick) const
+    {
+      return m_start + m_tick * tick;
+    }
+    Bucket &bucket(const Location &location)
+    {
+      if (location.m_level < 0)
+        return m_due;
+      else if (location.m_level == LEVELS)
+        return m_overflow;
+      else
+        return m_slots[location.m_level][location.m_slot];
+    }
+
+    void place(Bucket &from, Bucket::iterator timer);
+    uint64_t nextTick() const;
+    void advance(uint64_t tick);
+    void run();
+
+   protected:
+    const Clock::duration m_tick;
+    const Clock::time_point m_start;
+
+    // The last tick processed
+    uint64_t m_current = 0;
+    Bucket m_slots[LEVELS][SLOTS];
+    Bucket m_overflow;
+    Bucket m_due;
+    std::unordered_map<TimerId, Location> m_timers;
+    TimerId m_nextId = 1;
+    TimerId m_firing = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_fired;
+    // The tick the service thread sleeps until, 0 when it is awake
+    uint64_t m_wakeup = 0;
+    bool m_running = true;
+    std::thread m_thread;
+    std::atomic<uint64_t> m_wakeups{0};
+  };
+}  // namespace mtconnect
@@ -0,0 +1,505 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#include "web_socket.hpp"
+
+#include <dlib/logger.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+using namespace std;
+
+namespace mtconnect
+{
+  static dlib::logger g_logger("web.socket");
+
+  static const string g_webSocketGuid("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+
+  // SHA-1 is only used for the handshake accept key
+  static string sha1(const string &text)
+  {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    auto rotl = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+
+    string msg(text);
+    uint64_t bits = uint64_t(text.size()) * 8;
+    msg.push_back('\x80');
+    while (msg.size() % 64 != 56)
+      msg.push_back('\0');
+    for (int i = 7; i >= 0; i--)
+      msg.push_back(char((bits >> (i * 8)) & 0xFF));
+
+    for (size_t block = 0; block < msg.size(); block += 64)
+    {
+      uint32_t w[80];
+      for (int i = 0; i < 16; i++)
+      {
+        auto p = reinterpret_cast<const unsigned char *>(msg.data() + block + i * 4);
+        w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+      }
+      for (int i = 16; i < 80; i++)
+        w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+      uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+      for (int i = 0; i < 80; i++)
+      {
+        uint32_t f, k;
+        if (i < 20)
+        {
+          f = (b & c) | (~b & d);
+          k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+          f = b ^ c ^ d;
+          k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+          f = (b & c) | (b & d) | (c & d);
+          k = 0x8F1BBCDC;
+        }
+        else
+        {
+          f = b ^ c ^ d;
+          k = 0xCA62C1D6;
+        }
+
+        uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotl(b, 30);
+        b = a;
+        a = temp;
+      }
+
+      h[0] += a;
+      h[1] += b;
+      h[2] += c;
+      h[3] += d;
+      h[4] += e;
+    }
+
+    string digest;
+    for (auto v : h)
+      for (int i = 3; i >= 0; i--)
+        digest.push_back(char((v >> (i * 8)) & 0xFF));
+
+    return digest;
+  }
+
+  static string base64(const string &data)
+  {
+    static const char *chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    string out;
+    size_t i = 0;
+    for (; i + 2 < data.size(); i += 3)
+    {
+      uint32_t n = (uint32_t((unsigned char)data[i]) << 16) |
+                   (uint32_t((unsigned char)data[i + 1]) << 8) | (unsigned char)data[i + 2];
+      out.push_back(chars[(n >> 18) & 0x3F]);
+      out.push_back(chars[(n >> 12) & 0x3F]);
+      out.push_back(chars[(n >> 6) & 0x3F]);
+      out.push_back(chars[n & 0x3F]);
+    }
+
+    if (i < data.size())
+    {
+      uint32_t n = uint32_t((unsigned char)data[i]) << 16;
+      if (i + 1 < data.size())
+        n |= uint32_t((unsigned char)data[i + 1]) << 8;
+      out.push_back(chars[(n >> 18) & 0x3F]);
+      out.push_back(chars[(n >> 12) & 0x3F]);
+      out.push_back(i + 1 < data.size() ? chars[(n >> 6) & 0x3F] : '=');
+      out.push_back('=');
+    }
+
+    return out;
+  }
+
+  static string urlDecode(const string &text)
+  {
+    string out;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+      if (text[i] == '+')
+        out.push_back(' ');
+      else if (text[i] == '%' && i + 2 < text.size() && isxdigit(text[i + 1]) &&
+               isxdigit(text[i + 2]))
+      {
+        out.push_back(char(stoi(text.substr(i + 1, 2), nullptr, 16)));
+        i += 2;
+      }
+      else
+        out.push_back(text[i]);
+    }
+
+    return out;
+  }
+
+  WebSocket::~WebSocket()
+  {
+    close();
+  }
+
+  static string trim(const string &text)
+  {
+    auto first = text.find_first_not_of(" \t");
+    if (first == string::npos)
+      return "";
+    return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+  }
+
+  static string lower(string text)
+  {
+    transform(text.begin(), text.end(), text.begin(), ::tolower);
+    return text;
+  }
+
+  bool WebSocket::requestsUpgrade(const dlib::key_value_map_ci &headers)
+  {
+    auto upgrade = headers.find("Upgrade");
+    return upgrade != headers.end() && lower(trim(upgrade->second)) == "websocket";
+  }
+
+  bool WebSocket::isUpgrade(const dlib::key_value_map_ci &headers)
+  {
+    if (!requestsUpgrade(headers) || headers.find("Sec-WebSocket-Key") == headers.end())
+      return false;
+
+    auto version = headers.find("Sec-WebSocket-Version");
+    if (version == headers.end() || trim(version->second) != "13")
+      return false;
+
+    // Connection is a list of tokens, e.g. keep-alive, Upgrade
+    auto connection = headers.find("Connection");
+    if (connection == headers.end())
+      return false;
+
+    const auto &tokens = connection->second;
+    size_t pos = 0;
+    while (pos <= tokens.size())
+    {
+      auto end = tokens.find(',', pos);
+      if (end == string::npos)
+        end = tokens.size();
+      if (lower(trim(tokens.substr(pos, end - pos))) == "upgrade")
+        return true;
+      pos = end + 1;
+    }
+
+    return false;
+  }
+
+  string WebSocket::acceptKey(const string &key)
+  {
+    return base64(sha1(key + g_webSocketGuid));
+  }
+
+  string WebSocket::frame(Opcode opcode, const string &payload)
+  {
+    string frame;
+    frame.reserve(payload.size() + 10);
+    frame.push_back(char(0x80 | opcode));
+
+    auto length = payload.size();
+    if (length < 126)
+      frame.push_back(char(length));
+    else if (length <= 0xFFFF)
+    {
+      frame.push_back(char(126));
+      frame.push_back(char((length >> 8) & 0xFF));
+      frame.push_back(char(length & 0xFF));
+    }
+    else
+    {
+      frame.push_back(char(127));
+      for (int i = 7; i >= 0; i--)
+        frame.push_back(char((uint64_t(length) >> (i * 8)) & 0xFF));
+    }
+
+    frame.append(payload);
+    return frame;
+  }
+
+  bool WebSocket::readFrame(istream &in, Opcode &opcode, string &payload, bool &final,
+                            bool *masked, uint16_t *status)
+  {
+    auto invalid = [status](uint16_t code) {
+      if (status)
+        *status = code;
+      return false;
+    };
+
+    unsigned char header[2];
+    if (!in.read(reinterpret_cast<char *>(header), 2))
+      return false;
+
+    final = (header[0] & 0x80) != 0;
+    opcode = Opcode(header[0] & 0x0F);
+
+    // No extensions are negotiated, so the reserved bits must be clear (RFC 6455 5.2)
+    if ((header[0] & 0x70) != 0)
+    {
+      g_logger << dlib::LWARN << "WebSocket frame with reserved bits set";
+      return invalid(PROTOCOL_ERROR);
+    }
+
+    bool control = (opcode & 0x8) != 0;
+    if (opcode != CONTINUATION && opcode != TEXT && opcode != BINARY && opcode != CLOSE &&
+        opcode != PING && opcode != PONG)
+    {
+      g_logger << dlib::LWARN << "Unknown WebSocket opcode: " << int(opcode);
+      return invalid(PROTOCOL_ERROR);
+    }
+
+    bool isMasked = (header[1] & 0x80) != 0;
+    if (masked)
+      *masked = isMasked;
+    uint64_t length = header[1] & 0x7F;
+
+    int extra = length == 126 ? 2 : (length == 127 ? 8 : 0);
+    if (extra > 0)
+    {
+      unsigned char ext[8];
+      if (!in.read(reinterpret_cast<char *>(ext), extra))
+        return false;
+      length = 0;
+      for (int i = 0; i < extra; i++)
+        length = (length << 8) | ext[i];
+    }
+
+    // Control frames are never fragmented and carry at most 125 bytes (RFC 6455 5.5)
+    if (control && (!final || length > 125))
+    {
+      g_logger << dlib::LWARN << "Invalid WebSocket control frame";
+      return invalid(PROTOCOL_ERROR);
+    }
+
+    if (length > MAX_MESSAGE_SIZE)
+    {
+      g_logger << dlib::LWARN << "WebSocket frame too large: " << length;
+      return invalid(MESSAGE_TOO_BIG);
+    }
+
+    unsigned char mask[4] = {0, 0, 0, 0};
+    if (isMasked && !in.read(reinterpret_cast<char *>(mask), 4))
+      return false;
+
+    payload.resize(size_t(length));
+    if (length > 0 && !in.read(&payload[0], length))
+      return false;
+
+    if (isMasked)
+      for (size_t i = 0; i < payload.size(); i++)
+        payload[i] ^= mask[i % 4];
+
+    return true;
+  }
+
+  void WebSocket::accept(const string &key)
+  {
+    write("HTTP/1.1 101 Switching Protocols\r\n"
+          "Upgrade: websocket\r\n"
+          "Connection: Upgrade\r\n"
+          "Sec-WebSocket-Accept: " +
+          acceptKey(key) + "\r\n\r\n");
+
+    m_open = true;
+    m_reader = thread(&WebSocket::reader, this);
+  }
+
+  void WebSocket::close(uint16_t code)
+  {
+    if (m_open.exchange(false))
+      sendClose(closeReason(code));
+
+    // Unblock the reader if it is still waiting on the client
+    if (m_reader.joinable())
+    {
+      if (m_shutdown)
+        m_shutdown();
+      m_reader.join();
+    }
+  }
+
+  void WebSocket::write(const string &data)
+  {
+    std::lock_guard<std::mutex> lock(m_writeLock);
+
+    // Nothing may follow a close frame
+    if (!m_closeSent && m_out.good())
+    {
+      m_out.write(data.data(), data.size());
+      m_out.flush();
+    }
+  }
+
+  string WebSocket::closeReason(uint16_t code)
+  {
+    string reason;
+    reason.push_back(char((code >> 8) & 0xFF));
+    reason.push_back(char(code & 0xFF));
+    return reason;
+  }
+
+  void WebSocket::fail(uint16_t code, const char *reason)
+  {
+    g_logger << dlib::LWARN << reason << ", closing WebSocket with " << code;
+    if (m_open.exchange(false))
+      sendClose(closeReason(code));
+  }
+
+  void WebSocket::sendClose(const string &payload)
+  {
+    auto data = frame(CLOSE, payload);
+
+    std::lock_guard<std::mutex> lock(m_writeLock);
+    if (!m_closeSent && m_out.good())
+    {
+      m_out.write(data.data(), data.size());
+      m_out.flush();
+    }
+    m_closeSent = true;
+  }
+
+  bool WebSocket::takeRequest(dlib::key_value_map &request)
+  {
+    std::lock_guard<std::mutex> lock(m_requestLock);
+    if (!m_hasRequest)
+      return false;
+
+    request.swap(m_request);
+    m_request.clear();
+    m_hasRequest = false;
+    return true;
+  }
+
+  bool WebSocket::expectPong()
+  {
+    return !m_pongPending.exchange(true);
+  }
+
+  void WebSocket::parseRequest(const string &message)
+  {
+    std::lock_guard<std::mutex> lock(m_requestLock);
+
+    size_t pos = message.find('?');
+    pos = pos == string::npos ? 0 : pos + 1;
+    while (pos < message.size())
+    {
+      auto end = message.find('&', pos);
+      if (end == string::npos)
+        end = message.size();
+
+      auto param = message.substr(pos, end - pos);
+      auto eq = param.find('=');
+      if (eq != string::npos)
+        m_request[urlDecode(param.substr(0, eq))] = urlDecode(param.substr(eq + 1));
+      else if (!param.empty())
+        m_request[urlDecode(param)] = "";
+
+      pos = end + 1;
+    }
+
+    m_hasRequest = true;
+  }
+
+  void WebSocket::reader()
+  {
+    string message;
+    Opcode messageOpcode = TEXT;
+    bool fragmented = false;
+
+    while (m_open)
+    {
+      Opcode opcode;
+      string payload;
+      bool final, masked;
+      uint16_t status = 0;
+      if (!readFrame(m_in, opcode, payload, final, &masked, &status))
+      {
+        if (status != 0)
+          fail(status, "Invalid WebSocket frame");
+        break;
+      }
+
+      // Every frame from a client must be masked (RFC 6455 5.1)
+      if (!masked)
+      {
+        fail(PROTOCOL_ERROR, "Unmasked WebSocket frame from client");
+        return;
+      }
+
+      switch (opcode)
+      {
+        case PING:
+          write(frame(PONG, payload));
+          break;
+
+        case PONG:
+          m_pongPending = false;
+          break;
+
+        case CLOSE:
+          g_logger << dlib::LDEBUG << "WebSocket closed by client";
+          m_open = false;
+          sendClose(payload.substr(0, 2));
+          return;
+
+        case TEXT:
+        case BINARY:
+        case CONTINUATION:
+          // A continuation must follow an unfinished message and nothing else may
+          if ((opcode == CONTINUATION) != fragmented)
+          {
+            fail(PROTOCOL_ERROR, "Unexpected WebSocket continuation");
+            return;
+          }
+
+          if (opcode != CONTINUATION)
+          {
+            message.clear();
+            messageOpcode = opcode;
+          }
+          fragmented = !final;
+
+          message.append(payload);
+          if (message.size() > MAX_MESSAGE_SIZE)
+          {
+            fail(MESSAGE_TOO_BIG, "WebSocket message too large");
+            return;
+          }
+
+          if (final && messageOpcode == TEXT)
+          {
+            g_logger << dlib::LDEBUG << "WebSocket request: " << message;
+            parseRequest(message);
+          }
+          break;
+      }
+    }
+
+    m_open = false;
+  }
+}  // namespace mtconnect
@@ -0,0 +1,137 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+#pragma once
+
+#include <dlib/server.h>
+
+#include <atomic>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace mtconnect
+{
+  // Server side of a WebSocket (RFC 6455) connection upgraded from an HTTP request.
+  // Documents are sent as text frames. A reader thread answers pings, tracks pongs
+  // and collects text messages from the client as query strings.
+  class WebSocket
+  {
+   public:
+    enum Opcode : uint8_t
+    {
+      CONTINUATION = 0x0,
+      TEXT = 0x1,
+      BINARY = 0x2,
+      CLOSE = 0x8,
+      PING = 0x9,
+      PONG = 0xA
+    };
+
+    // Close status codes
+    static const uint16_t NORMAL_CLOSURE = 1000;
+    static const uint16_t PROTOCOL_ERROR = 1002;
+    static const uint16_t MESSAGE_TOO_BIG = 1009;
+
+    // Largest message accepted from a client
+    static const size_t MAX_MESSAGE_SIZE = 64 * 1024;
+
+   public:
+    WebSocket(std::istream &in, std::ostream &out, std::function<void()> shutdown = nullptr)
+        : m_in(in), m_out(out), m_shutdown(shutdown)
+    {
+    }
+    ~WebSocket();
+
+    // Check if the request asks for a WebSocket upgrade
+    static bool requestsUpgrade(const dlib::key_value_map_ci &headers);
+
+    // Check if the request is a valid opening handshake: an Upgrade: websocket and a
+    // Connection: Upgrade header, a key and Sec-WebSocket-Version 13
+    static bool isUpgrade(const dlib::key_value_map_ci &headers);
+
+    // Compute the Sec-WebSocket-Accept value for a Sec-WebSocket-Key
+    static std::string acceptKey(const std::string &key);
+
+    // Frame a payload from the server, server frames are never masked
+    static std::string frame(Opcode opcode, const std::string &payload);
+
+    // Read a single frame, unmasking the payload. Returns false on a
+    // malformed frame or when the stream ends. masked is set if the frame was masked.
+    // When the frame breaks the protocol, status is set to the close code to fail the
+    // connection with.
+    static bool readFrame(std::istream &in, Opcode &opcode, std::string &payload, bool &final,
+                          bool *masked = nullptr, uint16_t *status = nullptr);
+
+    // Write the 101 Switching Protocols response and start reading from the client
+    void accept(const std::string &key);
+
+    // Send a close frame and wait for the reader to finish
+    void close(uint16_t code = NORMAL_CLOSURE);
+
+    bool isOpen() const
+    {
+      return m_open;
+    }
+
+    // Write framed data to the client, safe to call from any thread
+    void write(const std::string &data);
+
+    // Get the parameters of the last message from the client. Parameters from
+    // multiple messages are merged with later values replacing earlier ones.
+    bool takeRequest(dlib::key_value_map &request);
+
+    // Called before a ping is sent. Returns false if the previous ping was not
+    // answered, in which case the client is considered gone.
+    bool expectPong();
+
+    // The device the streaming request is scoped to
+    void setDevice(const std::string &device)
+    {
+      m_device = device;
+    }
+    const std::string &getDevice() const
+    {
+      return m_device;
+    }
+
+   protected:
+    void reader();
+    void parseRequest(const std::string &message);
+    void sendClose(const std::string &payload);
+    void fail(uint16_t code, const char *reason);
+    static std::string closeReason(uint16_t code);
+
+   protected:
+    std::istream &m_in;
+    std::ostream &m_out;
+    std::function<void()> m_shutdown;
+    std::string m_device;
+
+    std::mutex m_writeLock;
+    bool m_closeSent{false};
+    std::thread m_reader;
+    std::atomic_bool m_open{false};
+    std::atomic_bool m_pongPending{false};
+
+    std::mutex m_requestLock;
+    dlib::key_value_map m_request;
+    bool m_hasRequest{false};
+  };
+}  // namespace mtconnect
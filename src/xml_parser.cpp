@@ -271,6 +271,7 @@ namespace mtconnect
       // Collect the Devices...
       for (int i = 0; i != nodeset->nodeNr; ++i)
         deviceList.emplace_back(static_cast<Device *>(handleNode(nodeset->nodeTab[i])));
+      orderDataItems(deviceList);
 
       xmlXPathFreeObject(devices);
       xmlXPathFreeContext(xpathCtx);
@@ -1184,6 +1185,13 @@ namespace mtconnect
         !xmlStrcmp(inputAsset->name, BAD_CAST "CuttingToolArchetype"))
     {
       asset = handleCuttingTool(inputAsset, doc);
+
+      // The serial number is required, it defaults to the asset id
+      const auto &identity = asset->getIdentity();
+      const auto serialNumber = identity.find("serialNumber");
+      if (serialNumber == identity.end() || serialNumber->second.empty())
+        asset->addIdentity("serialNumber",
+                           asset->getAssetId().empty() ? assetId : asset->getAssetId());
     }
     else
     {
@@ -1278,6 +1286,7 @@ namespace mtconnect
 
     xmlDocPtr document = nullptr;
     CuttingToolPtr ptr = (CuttingTool *)asset.getObject();
+    std::lock_guard<std::recursive_mutex> lock(ptr->getFragmentLock());
 
     try
     {
@@ -35,6 +35,7 @@
 #include <typeindex>
 #include <typeinfo>
 #include <utility>
+#include <vector>
 
 #define strfy(line) #line
 #define THROW_IF_XML2_ERROR(expr)                                           \
@@ -54,53 +55,112 @@ namespace mtconnect
 {
   static dlib::logger g_logger("xml.printer");
 
-  class XmlWriter
+  // The writers of the documents printed on this thread and their buffers. A writer that
+  // finished its document is given back with an empty buffer that already grew to the size
+  // of the earlier documents. Elements are printed with their own writer while a document
+  // is printed, so a few are kept.
+  class XmlWriterPool
   {
    public:
-    XmlWriter(bool pretty) : m_writer(nullptr), m_buf(nullptr)
+    struct Output
+    {
+      xmlTextWriterPtr m_writer;
+      xmlBufferPtr m_buf;
+    };
+
+    ~XmlWriterPool()
     {
-      THROW_IF_XML2_NULL(m_buf = xmlBufferCreate());
-      THROW_IF_XML2_NULL(m_writer = xmlNewTextWriterMemory(m_buf, 0));
-      if (pretty)
+      for (auto &output : m_free)
       {
-        THROW_IF_XML2_ERROR(xmlTextWriterSetIndent(m_writer, 1));
-        THROW_IF_XML2_ERROR(xmlTextWriterSetIndentString(m_writer, BAD_CAST "  "));
+        xmlFreeTextWriter(output.m_writer);
+        xmlBufferFree(output.m_buf);
       }
     }
 
-    ~XmlWriter()
+    Output take()
+    {
+      if (!m_free.empty())
+      {
+        auto output = m_free.back();
+        m_free.pop_back();
+        return output;
+      }
+
+      Output output;
+      THROW_IF_XML2_NULL(output.m_buf = xmlBufferCreate());
+      output.m_writer = xmlNewTextWriterMemory(output.m_buf, 0);
+      if (output.m_writer == nullptr ||
+          xmlTextWriterSetIndentString(output.m_writer, BAD_CAST "  ") < 0)
+      {
+        if (output.m_writer != nullptr)
+          xmlFreeTextWriter(output.m_writer);
+        xmlBufferFree(output.m_buf);
+        throw string("XML Error: cannot create a writer");
+      }
+      return output;
+    }
+
+    // Keep a writer that finished its document, otherwise it is freed
+    void give(const Output &output, bool finished)
     {
-      if (m_writer != nullptr)
+      if (finished && m_free.size() < MaxWriters && output.m_buf->size <= MaxBufferSize)
       {
-        xmlFreeTextWriter(m_writer);
-        m_writer = nullptr;
+        xmlBufferEmpty(output.m_buf);
+        m_free.push_back(output);
       }
-      if (m_buf != nullptr)
+      else
       {
-        xmlBufferFree(m_buf);
-        m_buf = nullptr;
+        xmlFreeTextWriter(output.m_writer);
+        xmlBufferFree(output.m_buf);
       }
     }
 
+   protected:
+    static const size_t MaxWriters = 4;
+    static const size_t MaxBufferSize = 4 * 1024 * 1024;
+
+    std::vector<Output> m_free;
+  };
+
+  static thread_local XmlWriterPool t_writers;
+
+  class XmlWriter
+  {
+   public:
+    XmlWriter(bool pretty) : m_output(t_writers.take())
+    {
+      if (xmlTextWriterSetIndent(m_output.m_writer, pretty ? 1 : 0) < 0)
+      {
+        t_writers.give(m_output, false);
+        throw string("XML Error: cannot set the indent");
+      }
+    }
+
+    XmlWriter(const XmlWriter &) = delete;
+    ~XmlWriter()
+    {
+      t_writers.give(m_output, m_finished);
+    }
+
     operator xmlTextWriterPtr()
     {
-      return m_writer;
+      return m_output.m_writer;
     }
 
     string getContent()
     {
-      if (m_writer != nullptr)
+      if (!m_finished)
       {
-        THROW_IF_XML2_ERROR(xmlTextWriterEndDocument(m_writer));
-        xmlFreeTextWriter(m_writer);
-        m_writer = nullptr;
+        THROW_IF_XML2_ERROR(xmlTextWriterEndDocument(m_output.m_writer));
+        THROW_IF_XML2_ERROR(xmlTextWriterFlush(m_output.m_writer));
+        m_finished = true;
       }
-      return string((char *)m_buf->content, m_buf->use);
+      return string((char *)m_output.m_buf->content, m_output.m_buf->use);
     }
 
    protected:
-    xmlTextWriterPtr m_writer;
-    xmlBufferPtr m_buf;
+    XmlWriterPool::Output m_output;
+    bool m_finished = false;
   };
 
   XmlPrinter::XmlPrinter(const string version, bool pretty)
@@ -821,7 +881,7 @@ namespace mtconnect
 
   string XmlPrinter::printSample(const unsigned int instanceId, const unsigned int bufferSize,
                                  const uint64_t nextSeq, const uint64_t firstSeq,
-                                 const uint64_t lastSeq, ObservationPtrArray &observations) const
+                                 const uint64_t lastSeq, ObservationList &observations) const
   {
     string ret;
 
@@ -833,12 +893,15 @@ namespace mtconnect
 
       AutoElement streams(writer, "Streams");
 
-      // Sort the vector by category.
-      if (observations.size() > 0)
-      {
-        dlib::qsort_array<ObservationPtrArray, ObservationComparer>(
-            observations, 0ul, observations.size() - 1ul, ObservationCompare);
+      // Group the observations by device, component and category
+      groupObservations(observations);
 
+      if (observations.size() > 0 && !m_pretty)
+      {
+        printCompactStreams(writer, observations);
+      }
+      else if (observations.size() > 0)
+      {
         AutoElement deviceElement(writer);
         {
           AutoElement componentStreamElement(writer);
@@ -912,18 +975,8 @@ namespace mtconnect
 
         for (const auto asset : assets)
         {
-          if (asset->getType() == "CuttingTool" || asset->getType() == "CuttingToolArchetype")
-          {
-            THROW_IF_XML2_ERROR(
-                xmlTextWriterWriteRaw(writer, BAD_CAST asset->getContent(this).c_str()));
-          }
-          else
-          {
-            AutoElement ele(writer, asset->getType());
-            printAssetNode(writer, asset);
-            THROW_IF_XML2_ERROR(
-                xmlTextWriterWriteRaw(writer, BAD_CAST asset->getContent(this).c_str()));
-          }
+          auto fragment = asset->getFragment(this);
+          THROW_IF_XML2_ERROR(xmlTextWriterWriteRaw(writer, BAD_CAST fragment->c_str()));
         }
       }
       closeElement(writer);  // MTConnectAssets
@@ -942,6 +995,66 @@ namespace mtconnect
     return ret;
   }
 
+  string XmlPrinter::printAsset(Asset *asset) const
+  {
+    string ret;
+
+    try
+    {
+      std::lock_guard<std::recursive_mutex> lock(asset->getFragmentLock());
+      XmlWriter writer(false);
+      printAssetElement(writer, asset);
+      ret = writer.getContent();
+    }
+    catch (string error)
+    {
+      g_logger << dlib::LERROR << "printAsset: " << error;
+    }
+    catch (...)
+    {
+      g_logger << dlib::LERROR << "printAsset: unknown error";
+    }
+
+    return ret;
+  }
+
+  string XmlPrinter::printAssetFragment(Asset *asset) const
+  {
+    string ret;
+
+    try
+    {
+      XmlWriter writer(m_pretty);
+      printAssetElement(writer, asset);
+      ret = writer.getContent();
+    }
+    catch (string error)
+    {
+      g_logger << dlib::LERROR << "printAssetFragment: " << error;
+    }
+    catch (...)
+    {
+      g_logger << dlib::LERROR << "printAssetFragment: unknown error";
+    }
+
+    return ret;
+  }
+
+  void XmlPrinter::printAssetElement(xmlTextWriterPtr writer, Asset *asset) const
+  {
+    if (asset->getType() == "CuttingTool" || asset->getType() == "CuttingToolArchetype")
+    {
+      auto content = printCuttingTool(static_cast<CuttingTool *>(asset));
+      THROW_IF_XML2_ERROR(xmlTextWriterWriteRaw(writer, BAD_CAST content.c_str()));
+    }
+    else
+    {
+      AutoElement ele(writer, asset->getType());
+      printAssetNode(writer, asset);
+      THROW_IF_XML2_ERROR(xmlTextWriterWriteRaw(writer, BAD_CAST asset->getContent(this).c_str()));
+    }
+  }
+
   void XmlPrinter::printAssetNode(xmlTextWriterPtr writer, Asset *asset) const
   {
     addAttributes(writer, asset->getIdentity());
@@ -964,88 +1077,89 @@ namespace mtconnect
     }
   }
 
-  void XmlPrinter::addObservation(xmlTextWriterPtr writer, Observation *result) const
+  static void addDataSet(xmlTextWriterPtr writer, const DataSet &set)
   {
-    auto dataItem = result->getDataItem();
-    string name;
-
-    if (dataItem->isCondition())
-    {
-      name = result->getLevelString();
-    }
-    else
+    for (auto &e : set)
     {
-      if (!dataItem->getPrefix().empty())
+      map<string, string> attrs = {{"key", e.m_key}};
+      if (e.m_removed)
       {
-        auto ns = m_streamsNamespaces.find(dataItem->getPrefix());
-        if (ns != m_streamsNamespaces.end())
-          name = dataItem->getPrefixedElementName();
+        attrs["removed"] = "true";
       }
+      visit(overloaded{[&writer, &attrs](const string &st) {
+                         addSimpleElement(writer, "Entry", st, attrs);
+                       },
+                       [&writer, &attrs](const int64_t &i) {
+                         addSimpleElement(writer, "Entry", to_string(i), attrs);
+                       },
+                       [&writer, &attrs](const double &d) {
+                         addSimpleElement(writer, "Entry", to_string(d), attrs);
+                       },
+                       [&writer, &attrs](const DataSet &row) {
+                         // Table
+                         AutoElement ele(writer, "Entry");
+                         addAttributes(writer, attrs);
+                         for (auto &c : row)
+                         {
+                           map<string, string> attrs = {{"key", c.m_key}};
+                           visit(overloaded{
+                                     [&writer, &attrs](const string &s) {
+                                       addSimpleElement(writer, "Cell", s, attrs);
+                                     },
+                                     [&writer, &attrs](const int64_t &i) {
+                                       addSimpleElement(writer, "Cell", to_string(i), attrs);
+                                     },
+                                     [&writer, &attrs](const double &d) {
+                                       addSimpleElement(writer, "Cell", floatToString(d), attrs);
+                                     },
+                                     [](auto &a) {
+                                       g_logger << dlib::LERROR
+                                                << "Invalid type for DataSetVariant cell";
+                                     }},
+                                 c.m_value);
+                         }
+                       }},
+            e.m_value);
+    }
+  }
 
-      if (name.empty())
-        name = dataItem->getElementName();
+  // The samples with six significant digits, as a stream writes them by default
+  static void appendTimeSeries(string &out, const Observation *result)
+  {
+    for (auto &e : result->getTimeSeries())
+    {
+      appendFloat(out, e, 6);
+      out += ' ';
     }
+  }
 
-    AutoElement ele(writer, name);
-    addAttributes(writer, result->getAttributes());
+  const string &XmlPrinter::observationElementName(const Observation *result) const
+  {
+    auto dataItem = result->getDataItem();
+    if (dataItem->isCondition())
+      return result->getLevelString();
 
-    if (result->isTimeSeries() && result->getValue() != "UNAVAILABLE")
-    {
-      ostringstream ostr;
-      ostr.precision(6);
-      const auto &v = result->getTimeSeries();
+    if (!dataItem->getPrefix().empty() &&
+        m_streamsNamespaces.find(dataItem->getPrefix()) != m_streamsNamespaces.end())
+      return dataItem->getPrefixedElementName();
 
-      for (auto &e : v)
-        ostr << e << ' ';
+    return dataItem->getElementName();
+  }
+
+  void XmlPrinter::addObservation(xmlTextWriterPtr writer, Observation *result) const
+  {
+    AutoElement ele(writer, observationElementName(result));
+    addAttributes(writer, result->getAttributes());
 
-      string str = ostr.str();
+    if (result->isTimeSeries() && !result->isUnavailable())
+    {
+      string str;
+      appendTimeSeries(str, result);
       THROW_IF_XML2_ERROR(xmlTextWriterWriteString(writer, BAD_CAST str.c_str()));
     }
-    else if (result->isDataSet() && result->getValue() != "UNAVAILABLE")
+    else if (result->isDataSet() && !result->isUnavailable())
     {
-      const DataSet &set = result->getDataSet();
-      for (auto &e : set)
-      {
-        map<string, string> attrs = {{"key", e.m_key}};
-        if (e.m_removed)
-        {
-          attrs["removed"] = "true";
-        }
-        visit(overloaded{[&writer, &attrs](const string &st) {
-                           addSimpleElement(writer, "Entry", st, attrs);
-                         },
-                         [&writer, &attrs](const int64_t &i) {
-                           addSimpleElement(writer, "Entry", to_string(i), attrs);
-                         },
-                         [&writer, &attrs](const double &d) {
-                           addSimpleElement(writer, "Entry", to_string(d), attrs);
-                         },
-                         [&writer, &attrs](const DataSet &row) {
-                           // Table
-                           AutoElement ele(writer, "Entry");
-                           addAttributes(writer, attrs);
-                           for (auto &c : row)
-                           {
-                             map<string, string> attrs = {{"key", c.m_key}};
-                             visit(overloaded{
-                                       [&writer, &attrs](const string &s) {
-                                         addSimpleElement(writer, "Cell", s, attrs);
-                                       },
-                                       [&writer, &attrs](const int64_t &i) {
-                                         addSimpleElement(writer, "Cell", to_string(i), attrs);
-                                       },
-                                       [&writer, &attrs](const double &d) {
-                                         addSimpleElement(writer, "Cell", floatToString(d), attrs);
-                                       },
-                                       [](auto &a) {
-                                         g_logger << dlib::LERROR
-                                                  << "Invalid type for DataSetVariant cell";
-                                       }},
-                                   c.m_value);
-                           }
-                         }},
-              e.m_value);
-      }
+      addDataSet(writer, result->getDataSet());
     }
     else if (!result->getValue().empty())
     {
@@ -1056,6 +1170,130 @@ namespace mtconnect
     }
   }
 
+  static inline void appendEndTag(string &out, const char *name)
+  {
+    out += "</";
+    out += name;
+    out += '>';
+  }
+
+  // Compact documents are written as text, copying the escaped attributes of the stream
+  // elements and data items and only escaping what changes with each observation. Data
+  // set entries are still written by the writer.
+  void XmlPrinter::printCompactStreams(xmlTextWriterPtr writer,
+                                       ObservationList &observations) const
+  {
+    string out;
+    out.reserve(observations.size() * 160);
+
+    const Device *device = nullptr;
+    const Component *component = nullptr;
+    const char *category = nullptr;
+
+    for (auto &observation : observations)
+    {
+      const auto dataItem = observation->getDataItem();
+      const auto itemComponent = dataItem->getComponent();
+      const auto itemDevice = itemComponent->getDevice();
+
+      if (itemDevice != device)
+      {
+        if (category)
+          appendEndTag(out, category);
+        if (component)
+          out += "</ComponentStream>";
+        if (device)
+          out += "</DeviceStream>";
+        category = nullptr;
+        component = nullptr;
+
+        device = itemDevice;
+        out += "<DeviceStream";
+        out += device->getDeviceStreamAttributes();
+        out += '>';
+      }
+
+      if (itemComponent != component)
+      {
+        if (category)
+          appendEndTag(out, category);
+        if (component)
+          out += "</ComponentStream>";
+        category = nullptr;
+
+        component = itemComponent;
+        out += "<ComponentStream";
+        out += component->getComponentStreamAttributes();
+        out += '>';
+      }
+
+      if (dataItem->getCategoryText() != category)
+      {
+        if (category)
+          appendEndTag(out, category);
+        category = dataItem->getCategoryText();
+        out += '<';
+        out += category;
+        out += '>';
+      }
+
+      const auto &name = observationElementName(observation);
+      out += '<';
+      out += name;
+      out += dataItem->getXmlAttributes();
+
+      const auto &attributes = observation->getAttributes();
+      for (auto i = observation->getDataItemAttributeCount(); i < attributes.size(); i++)
+      {
+        const auto &attr = attributes[i];
+        if (attr.second.empty() && attr.m_force)
+        {
+          out += ' ';
+          out += attr.first;
+          out += "=\"\"";
+        }
+        else
+          appendXmlAttribute(out, attr.first, attr.second);
+      }
+
+      if (observation->isTimeSeries() && !observation->isUnavailable())
+      {
+        out += '>';
+        appendTimeSeries(out, observation);
+      }
+      else if (observation->isDataSet() && !observation->isUnavailable())
+      {
+        if (observation->getDataSet().empty())
+        {
+          out += "/>";
+          continue;
+        }
+
+        out += '>';
+        THROW_IF_XML2_ERROR(xmlTextWriterWriteRaw(writer, BAD_CAST out.c_str()));
+        out.clear();
+        addDataSet(writer, observation->getDataSet());
+      }
+      else if (!observation->getValue().empty())
+      {
+        auto text = xmlEncodeEntitiesReentrant(nullptr, BAD_CAST observation->getValue().c_str());
+        out += '>';
+        out += (const char *)text;
+        xmlFree(text);
+      }
+      else
+      {
+        out += "/>";
+        continue;
+      }
+      appendEndTag(out, name.c_str());
+    }
+
+    appendEndTag(out, category);
+    out += "</ComponentStream></DeviceStream>";
+    THROW_IF_XML2_ERROR(xmlTextWriterWriteRaw(writer, BAD_CAST out.c_str()));
+  }
+
   void XmlPrinter::initXmlDoc(xmlTextWriterPtr writer, EDocumentType aType,
                               const unsigned int instanceId, const unsigned int bufferSize,
                               const unsigned int assetBufferSize, const unsigned int assetCount,
@@ -1202,7 +1440,23 @@ namespace mtconnect
   // Cutting tools
   void XmlPrinter::printCuttingToolValue(xmlTextWriterPtr writer, CuttingToolValuePtr value) const
   {
-    addSimpleElement(writer, value->m_key, value->m_value, value->m_properties, true);
+    // Indentation depends on where the element is printed, only compact elements are reused
+    if (m_pretty)
+    {
+      addSimpleElement(writer, value->m_key, value->m_value, value->m_properties, true);
+      return;
+    }
+
+    auto &fragment = value->m_fragments[this];
+    if (fragment.empty())
+    {
+      XmlWriter element(false);
+      addSimpleElement(element, value->m_key, value->m_value, value->m_properties, true);
+      fragment = element.getContent();
+      if (!fragment.empty() && fragment.back() == '\n')
+        fragment.pop_back();
+    }
+    THROW_IF_XML2_ERROR(xmlTextWriterWriteRaw(writer, BAD_CAST fragment.c_str()));
   }
 
   void XmlPrinter::printCuttingToolValue(xmlTextWriterPtr writer, CuttingToolPtr tool,
@@ -48,16 +48,21 @@ namespace mtconnect
                            const unsigned int assetCount, const std::vector<Device *> &devices,
                            const std::map<std::string, int> *count = nullptr) const override;
 
+    using Printer::printSample;
     std::string printSample(const unsigned int instanceId, const unsigned int bufferSize,
                             const uint64_t nextSeq, const uint64_t firstSeq, const uint64_t lastSeq,
-                            ObservationPtrArray &results) const override;
+                            ObservationList &results) const override;
 
     std::string printAssets(const unsigned int anInstanceId, const unsigned int bufferSize,
                             const unsigned int assetCount,
                             std::vector<AssetPtr> const &assets) const override;
 
+    std::string printAssetFragment(Asset *asset) const override;
     std::string printCuttingTool(CuttingToolPtr const tool) const override;
 
+    // A single asset element as it is printed in the assets document
+    std::string printAsset(Asset *asset) const;
+
     std::string mimeType() const override
     {
       return "text/xml";
@@ -127,6 +132,8 @@ namespace mtconnect
                               const std::set<CellDefinition> &definitions) const;
 
     void addObservation(xmlTextWriterPtr writer, Observation *result) const;
+    void printCompactStreams(xmlTextWriterPtr writer, ObservationList &observations) const;
+    const std::string &observationElementName(const Observation *result) const;
 
     // Asset printing
     void printCuttingToolValue(xmlTextWriterPtr writer, CuttingToolPtr tool, const char *value,
@@ -135,6 +142,7 @@ namespace mtconnect
                                std::set<std::string> *remaining = nullptr) const;
     void printCuttingToolValue(xmlTextWriterPtr writer, CuttingToolValuePtr value) const;
     void printCuttingToolItem(xmlTextWriterPtr writer, CuttingItemPtr item) const;
+    void printAssetElement(xmlTextWriterPtr writer, Asset *asset) const;
     void printAssetNode(xmlTextWriterPtr writer, Asset *asset) const;
 
     void printSensorConfiguration(xmlTextWriterPtr writer, const SensorConfiguration *sensor) const;
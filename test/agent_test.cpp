@@ -25,6 +25,7 @@
 #include "test_globals.hpp"
 #include "xml_printer.hpp"
 
+#include <dlib/dir_nav.h>
 #include <dlib/server.h>
 
 #include <chrono>
@@ -706,6 +707,481 @@ TEST_F(AgentTest, SampleLastCount)
   }
 }
 
+TEST_F(AgentTest, SampleSparseItemAfterEviction)
+{
+  key_value_map kvm;
+
+  m_adapter = m_agent->addAdapter("LinuxCNC", "server", 7878, false);
+  ASSERT_TRUE(m_adapter);
+
+  // Wrap the 256 slot buffer several times with an Xact every 50 observations
+  char line[80] = {0};
+  vector<uint64_t> positions;
+  for (int i = 0; i < 1000; i++)
+  {
+    if (i % 50 == 0)
+    {
+      positions.push_back(m_agent->getSequence());
+      sprintf(line, "TIME|Xact|%d", i);
+    }
+    else
+      sprintf(line, "TIME|line|%d", i);
+    m_adapter->processData(line);
+  }
+
+  // Only the positions still in the buffer are returned
+  uint64_t first = m_agent->getSequence() - 256;
+  vector<uint64_t> expected;
+  for (auto pos : positions)
+    if (pos >= first)
+      expected.push_back(pos);
+  ASSERT_EQ(5u, expected.size());
+
+  {
+    m_agentTestHelper->m_path = "/sample";
+    kvm["path"] = "//DataItem[@name='Xact']";
+    kvm["from"] = int64ToString(first);
+    kvm["count"] = "3";
+
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_COUNT(doc, "//m:DeviceStream//m:Position", 3);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Header@nextSequence", int64ToString(expected[2] + 1).c_str());
+    for (int j = 0; j < 3; j++)
+    {
+      sprintf(line, "//m:DeviceStream//m:Position[%d]@sequence", j + 1);
+      ASSERT_XML_PATH_EQUAL(doc, line, int64ToString(expected[j]).c_str());
+    }
+  }
+
+  {
+    kvm["count"] = "100";
+
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_COUNT(doc, "//m:DeviceStream//m:Position", 5);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Header@nextSequence",
+                          int64ToString(m_agent->getSequence()).c_str());
+  }
+
+  {
+    kvm.erase("from");
+    kvm["count"] = "-2";
+
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_COUNT(doc, "//m:DeviceStream//m:Position", 2);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Header@nextSequence", int64ToString(expected[3] - 1).c_str());
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Position[1]@sequence",
+                          int64ToString(expected[3]).c_str());
+  }
+}
+
+TEST_F(AgentTest, WarmRestartFromJournal)
+{
+  const string directory("agent_journal_test");
+  auto removeJournal = [&directory]() {
+    vector<dlib::file> files;
+    try
+    {
+      dlib::directory(directory).get_files(files);
+    }
+    catch (dlib::directory::dir_not_found &)
+    {
+    }
+    for (const auto &file : files)
+      std::remove(file.full_name().c_str());
+  };
+  removeJournal();
+
+  m_agent->openJournal(directory);
+  auto initial = m_agent->getSequence() - 1;
+  addAdapter();
+  m_adapter->processData("TIME|line|204");
+  m_adapter->processData("TIME|Xact|100");
+  auto instanceId = m_agent->getInstanceId();
+  auto sequence = m_agent->getSequence();
+
+  // A cold start would have a new instance id
+  this_thread::sleep_for(1s);
+  m_adapter = nullptr;
+  m_agent.reset();
+  m_agent = make_unique<Agent>(PROJECT_ROOT_DIR "/samples/test_config.xml", 8, 4, "1.3", 25ms);
+  m_agentTestHelper->m_agent = m_agent.get();
+  m_agent->openJournal(directory);
+
+  // The journal is restored and every data item is unavailable after it
+  ASSERT_EQ(instanceId, m_agent->getInstanceId());
+  ASSERT_EQ(sequence + initial, m_agent->getSequence());
+
+  key_value_map kvm;
+  m_agentTestHelper->m_path = "/sample";
+  kvm["path"] = "//DataItem[@name='line']";
+  kvm["from"] = int64ToString(sequence - 2);
+  kvm["count"] = "2";
+
+  {
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Header@instanceId", int64ToString(instanceId).c_str());
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[1]", "204");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[2]", "UNAVAILABLE");
+  }
+
+  {
+    m_agentTestHelper->m_path = "/current";
+    kvm.clear();
+    kvm["at"] = int64ToString(sequence - 1);
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line", "204");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Position[@name='Xact']", "100");
+  }
+
+  m_agent.reset();
+  removeJournal();
+}
+
+TEST_F(AgentTest, SampleFromColdStorage)
+{
+  const string directory("agent_cold_test");
+  auto removeSegments = [&directory]() {
+    vector<dlib::file> files;
+    try
+    {
+      dlib::directory(directory).get_files(files);
+    }
+    catch (dlib::directory::dir_not_found &)
+    {
+    }
+    for (const auto &file : files)
+      std::remove(file.full_name().c_str());
+  };
+  removeSegments();
+
+  m_agent->openColdStore(directory, 1024 * 1024);
+  addAdapter();
+
+  // Wrap the 256 observation buffer
+  auto first = m_agent->getSequence();
+  for (int i = 1; i <= 300; i++)
+    m_adapter->processData("TIME|line|" + to_string(i));
+  ASSERT_LT(first, m_agent->getFirstSequence());
+
+  key_value_map kvm;
+  m_agentTestHelper->m_path = "/sample";
+  kvm["path"] = "//DataItem[@name='line']";
+  kvm["from"] = int64ToString(first);
+  kvm["count"] = "3";
+
+  {
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Header@firstSequence", "1");
+    ASSERT_XML_PATH_COUNT(doc, "//m:DeviceStream//m:Line", 3);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[1]", "1");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[3]", "3");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Header@nextSequence", int64ToString(first + 3).c_str());
+  }
+
+  // A range spanning cold storage and the buffer
+  kvm["from"] = int64ToString(m_agent->getFirstSequence() - 2);
+  kvm["count"] = "4";
+  {
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_COUNT(doc, "//m:DeviceStream//m:Line", 4);
+  }
+
+  // Backward from the start of the buffer
+  kvm["from"] = int64ToString(first + 1);
+  kvm["count"] = "-2";
+  {
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_COUNT(doc, "//m:DeviceStream//m:Line", 2);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[1]", "1");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[2]", "2");
+  }
+
+  m_agent.reset();
+  removeSegments();
+}
+
+// Restarting refills the buffer from the journal and makes every data item unavailable,
+// the observations this evicts must continue the cold segments of the last run
+TEST_F(AgentTest, WarmRestartKeepsColdStorage)
+{
+  const string journal("agent_journal_cold_test"), cold("agent_cold_restart_test");
+  auto removeFiles = [&journal, &cold]() {
+    for (const auto &directory : {journal, cold})
+    {
+      vector<dlib::file> files;
+      try
+      {
+        dlib::directory(directory).get_files(files);
+      }
+      catch (dlib::directory::dir_not_found &)
+      {
+      }
+      for (const auto &file : files)
+        std::remove(file.full_name().c_str());
+    }
+  };
+  removeFiles();
+
+  m_agent->openJournal(journal, 64 * 1024 * 1024, 100ms, cold, 1024 * 1024);
+  addAdapter();
+
+  // Wrap the 256 observation buffer, line n has sequence base + n
+  auto base = m_agent->getSequence() - 1;
+  for (int i = 1; i <= 300; i++)
+    m_adapter->processData("TIME|line|" + to_string(i));
+  auto sequence = m_agent->getSequence();
+  auto restored = sequence - m_agent->getBufferSize();
+
+  m_adapter = nullptr;
+  m_agent.reset();
+  m_agent = make_unique<Agent>(PROJECT_ROOT_DIR "/samples/test_config.xml", 8, 4, "1.3", 25ms);
+  m_agentTestHelper->m_agent = m_agent.get();
+  m_agent->openJournal(journal, 64 * 1024 * 1024, 100ms, cold, 1024 * 1024);
+
+  // The unavailable observations evicted the oldest restored ones
+  auto evicted = m_agent->getFirstSequence() - restored;
+  ASSERT_LT(0u, evicted);
+
+  // Every line from the last run's cold segments through the buffer
+  key_value_map kvm;
+  m_agentTestHelper->m_path = "/sample";
+  kvm["path"] = "//DataItem[@name='line']";
+  kvm["from"] = int64ToString(restored - 2);
+  kvm["count"] = int64ToString(evicted + 4);
+  {
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_COUNT(doc, "//m:DeviceStream//m:Line", int(evicted + 4));
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[1]",
+                          int64ToString(restored - 2 - base).c_str());
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[last()]",
+                          int64ToString(restored + evicted + 1 - base).c_str());
+  }
+
+  m_agent.reset();
+  removeFiles();
+}
+
+TEST_F(AgentTest, ResizeBuffer)
+{
+  string body;
+  key_value_map kvm;
+  m_agent->enablePut();
+  addAdapter();
+
+  // Wrap the 256 observation buffer, line n has sequence base + n
+  for (int i = 1; i <= 300; i++)
+    m_adapter->processData("TIME|line|" + to_string(i));
+  auto base = m_agent->getSequence() - 301;
+  auto first = m_agent->getFirstSequence();
+  ASSERT_EQ(base + 45, first);
+
+  auto lineAt = [&](int line) {
+    key_value_map query;
+    query["at"] = int64ToString(base + line);
+    query["path"] = "//DataItem[@name='line']";
+    m_agentTestHelper->m_path = "/current";
+    PARSE_XML_RESPONSE_QUERY(query);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line", to_string(line).c_str());
+  };
+
+  // Grow to a size that is not a power of two, nothing is evicted
+  m_agentTestHelper->m_path = "/buffer";
+  kvm["size"] = "1000";
+  {
+    PARSE_XML_RESPONSE_PUT(body, kvm);
+  }
+  ASSERT_EQ(1000u, m_agent->getBufferSize());
+  ASSERT_EQ(first, m_agent->getFirstSequence());
+  lineAt(45);
+  lineAt(100);
+  lineAt(300);
+
+  for (int i = 301; i <= 800; i++)
+    m_adapter->processData("TIME|line|" + to_string(i));
+  ASSERT_EQ(first, m_agent->getFirstSequence());
+  lineAt(99);
+  lineAt(700);
+
+  // Shrink, the oldest observations are evicted and the sequences do not change
+  m_agentTestHelper->m_path = "/buffer";
+  kvm["size"] = "100";
+  {
+    PARSE_XML_RESPONSE_PUT(body, kvm);
+  }
+  ASSERT_EQ(100u, m_agent->getBufferSize());
+  ASSERT_EQ(base + 701, m_agent->getFirstSequence());
+  lineAt(701);
+  lineAt(742);
+  lineAt(800);
+
+  {
+    key_value_map query;
+    m_agentTestHelper->m_path = "/sample";
+    query["path"] = "//DataItem[@name='line']";
+    query["from"] = int64ToString(base + 701);
+    query["count"] = "3";
+    PARSE_XML_RESPONSE_QUERY(query);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Header@firstSequence", int64ToString(base + 701).c_str());
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[1]", "701");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[3]", "703");
+  }
+
+  {
+    key_value_map query;
+    m_agentTestHelper->m_path = "/sample";
+    query["from"] = int64ToString(base + 700);
+    PARSE_XML_RESPONSE_QUERY(query);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Error@errorCode", "OUT_OF_RANGE");
+  }
+
+  // Wrap the smaller buffer
+  for (int i = 801; i <= 950; i++)
+    m_adapter->processData("TIME|line|" + to_string(i));
+  ASSERT_EQ(base + 851, m_agent->getFirstSequence());
+  lineAt(851);
+  lineAt(900);
+  lineAt(950);
+
+  m_agentTestHelper->m_path = "/buffer";
+  kvm["size"] = "0";
+  {
+    PARSE_XML_RESPONSE_PUT(body, kvm);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Error@errorCode", "OUT_OF_RANGE");
+  }
+  ASSERT_EQ(100u, m_agent->getBufferSize());
+}
+
+TEST_F(AgentTest, BufferMemoryLimit)
+{
+  addAdapter();
+
+  for (int i = 1; i <= 100; i++)
+    m_adapter->processData("TIME|line|" + to_string(i));
+  auto base = m_agent->getSequence() - 101;
+  auto first = m_agent->getFirstSequence();
+  auto bytes = m_agent->getBufferBytes();
+
+  uint64_t total = 0;
+  auto byType = m_agent->getBufferBytesByType();
+  for (const auto &type : byType)
+    total += type.second;
+  ASSERT_EQ(bytes, total);
+  ASSERT_LT(0u, byType["LINE"]);
+
+  // The oldest observations are evicted before the buffer wraps
+  m_agent->setBufferMemoryLimit(byType["LINE"] / 2);
+  ASSERT_GE(m_agent->getBufferMemoryLimit(), m_agent->getBufferBytes());
+  auto limited = m_agent->getFirstSequence();
+  ASSERT_LT(first, limited);
+  ASSERT_GT(m_agent->getSequence(), limited);
+
+  key_value_map kvm;
+  m_agentTestHelper->m_path = "/sample";
+  kvm["path"] = "//DataItem[@name='line']";
+  kvm["count"] = "2";
+  {
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Header@firstSequence", int64ToString(limited).c_str());
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[1]",
+                          to_string(limited - base).c_str());
+  }
+
+  m_agentTestHelper->m_path = "/current";
+  kvm.clear();
+  kvm["at"] = int64ToString(limited + 1);
+  kvm["path"] = "//DataItem[@name='line']";
+  {
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line", to_string(limited + 1 - base).c_str());
+  }
+
+  // A large time series pushes out many small observations
+  string samples;
+  for (int i = 0; i < 1000; i++)
+    samples += to_string(i) + " ";
+  m_adapter->processData("TIME|Xts|1000||" + samples);
+  ASSERT_LT(limited, m_agent->getFirstSequence());
+  ASSERT_GE(m_agent->getBufferMemoryLimit(), m_agent->getBufferBytes());
+  ASSERT_LT(0u, m_agent->getBufferBytesByType()["POSITION"]);
+
+  for (int i = 101; i <= 200; i++)
+    m_adapter->processData("TIME|line|" + to_string(i));
+  ASSERT_GE(m_agent->getBufferMemoryLimit(), m_agent->getBufferBytes());
+  ASSERT_EQ(0u, m_agent->getBufferBytesByType()["POSITION"]);
+}
+
+TEST_F(AgentTest, SampleByTime)
+{
+  key_value_map kvm;
+
+  m_adapter = m_agent->addAdapter("LinuxCNC", "server", 7878, false);
+  ASSERT_TRUE(m_adapter);
+
+  // Three bursts of lines with a timestamp taken between them
+  m_adapter->processData("TIME|line|1");
+  m_adapter->processData("TIME|line|2");
+  this_thread::sleep_for(150ms);
+  auto first = getCurrentTime(GMT_UV_SEC);
+  this_thread::sleep_for(150ms);
+  auto second = m_agent->getSequence();
+  m_adapter->processData("TIME|line|3");
+  m_adapter->processData("TIME|line|4");
+  this_thread::sleep_for(150ms);
+  auto last = getCurrentTime(GMT_UV_SEC);
+  this_thread::sleep_for(150ms);
+  auto third = m_agent->getSequence();
+  m_adapter->processData("TIME|line|5");
+
+  m_agentTestHelper->m_path = "/sample";
+  kvm["path"] = "//DataItem[@name='line']";
+
+  {
+    kvm["fromTime"] = first;
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_COUNT(doc, "//m:DeviceStream//m:Line", 3);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[1]@sequence",
+                          int64ToString(second).c_str());
+  }
+
+  {
+    kvm["toTime"] = last;
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_COUNT(doc, "//m:DeviceStream//m:Line", 2);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line[2]", "4");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Header@nextSequence", int64ToString(third).c_str());
+  }
+
+  {
+    kvm.erase("fromTime");
+    kvm["count"] = "-1";
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_COUNT(doc, "//m:DeviceStream//m:Line", 1);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:DeviceStream//m:Line", "4");
+  }
+
+  {
+    kvm.erase("count");
+    kvm["fromTime"] = last;
+    kvm["toTime"] = first;
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Error@errorCode", "OUT_OF_RANGE");
+  }
+
+  {
+    kvm.erase("toTime");
+    kvm["from"] = int64ToString(second);
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Error@errorCode", "INVALID_REQUEST");
+  }
+
+  {
+    kvm.erase("from");
+    kvm["fromTime"] = "yesterday";
+    PARSE_XML_RESPONSE_QUERY(kvm);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Error@errorCode", "OUT_OF_RANGE");
+  }
+}
+
 
 TEST_F(AgentTest, AdapterCommands)
 {
@@ -1348,7 +1824,7 @@ TEST_F(AgentTest, AssetRefCounts)
 {
   addAdapter();
 
-  const auto assets = m_agent->getAssets();
+  const auto assets = m_agent->getAssetStore();
 
   m_adapter->parseBuffer(
       R"ASSET(2018-02-19T22:54:03.0738Z|@ASSET@|M8010N9172N:1.0|CuttingTool|--multiline--SMOOTH
@@ -1360,7 +1836,7 @@ TEST_F(AgentTest, AssetRefCounts)
   ASSERT_EQ((unsigned int)1, m_agent->getAssetCount());
 
   // Asset has two secondary indexes
-  AssetPtr first(*(assets->front()));
+  AssetPtr first(assets->getOldest());
   ASSERT_EQ((unsigned int)4, first.getObject()->refCount());
 
   m_adapter->parseBuffer(
@@ -1394,7 +1870,7 @@ TEST_F(AgentTest, AssetRefCounts)
   ASSERT_EQ((unsigned int)1, first.getObject()->refCount());
 
   // Check next asset
-  AssetPtr second(*(assets->front()));
+  AssetPtr second(assets->getOldest());
   ASSERT_EQ((unsigned int)2, second.getObject()->refCount());
   ASSERT_EQ(string("M8010N9172N:1.2"), second.getObject()->getAssetId());
 
@@ -1547,6 +2023,72 @@ TEST_F(AgentTest, AssetRemoval)
   }
 }
 
+TEST_F(AgentTest, AssetsAreRestoredFromLog)
+{
+  const string directory("agent_asset_test");
+  auto removeLog = [&directory]() {
+    vector<dlib::file> files;
+    try
+    {
+      dlib::directory(directory).get_files(files);
+    }
+    catch (dlib::directory::dir_not_found &)
+    {
+    }
+    for (const auto &file : files)
+      std::remove(file.full_name().c_str());
+  };
+  removeLog();
+
+  m_agent->openAssetLog(directory);
+  m_agent->enablePut();
+  key_value_map queries;
+  queries["device"] = "LinuxCNC";
+  queries["type"] = "Part";
+
+  for (auto i : {1, 2, 3})
+  {
+    m_agentTestHelper->m_path = "/asset/" + to_string(i);
+    string body = "<Part>TEST " + to_string(i) + "</Part>";
+    PARSE_XML_RESPONSE_PUT(body, queries);
+  }
+  ASSERT_TRUE(m_agent->removeAsset(m_agent->getDeviceByName("LinuxCNC"), "2",
+                                   "2020-01-01T00:00:00Z"));
+
+  // Use the first asset so it is no longer the oldest
+  m_agentTestHelper->m_path = "/asset/1";
+  {
+    string body = "<Part>TEST 4</Part>";
+    PARSE_XML_RESPONSE_PUT(body, queries);
+  }
+
+  m_agent.reset();
+  m_agent = make_unique<Agent>(PROJECT_ROOT_DIR "/samples/test_config.xml", 8, 4, "1.3", 25ms);
+  m_agentTestHelper->m_agent = m_agent.get();
+  m_agent->openAssetLog(directory);
+
+  // The assets, their order, the removed flags and the counts are restored
+  ASSERT_EQ((unsigned int)3, m_agent->getAssetCount());
+  ASSERT_EQ(3, m_agent->getAssetCount("Part"));
+  ASSERT_EQ("2", m_agent->getAssetStore()->getOldest()->getAssetId());
+
+  m_agentTestHelper->m_path = "/assets";
+  m_agentTestHelper->m_queries["removed"] = "true";
+  {
+    PARSE_XML_RESPONSE;
+    ASSERT_XML_PATH_COUNT(doc, "//m:Assets/*", 3);
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Assets/*[1]", "TEST 4");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Assets/*[1]@deviceUuid", "000");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Assets/*[2]", "TEST 3");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Assets/*[3]", "TEST 2");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Assets/*[3]@removed", "true");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:Assets/*[3]@timestamp", "2020-01-01T00:00:00Z");
+  }
+
+  m_agent.reset();
+  removeLog();
+}
+
 TEST_F(AgentTest, AssetRemovalByAdapter)
 {
   addAdapter();
@@ -2059,6 +2601,61 @@ TEST_F(AgentTest, StreamDataObserver)
   }
 }
 
+TEST_F(AgentTest, StreamDataWebSocket)
+{
+  m_adapter = m_agent->addAdapter("LinuxCNC", "server", 7878, false);
+  ASSERT_TRUE(m_adapter);
+
+  BlockingStreamBuf client;
+  istream in(&client);
+  m_agentTestHelper->m_in = &in;
+  m_agentTestHelper->m_incomingHeaders["Upgrade"] = "websocket";
+  m_agentTestHelper->m_incomingHeaders["Connection"] = "Upgrade";
+  m_agentTestHelper->m_incomingHeaders["Sec-WebSocket-Key"] = "dGhlIHNhbXBsZSBub25jZQ==";
+  m_agentTestHelper->m_incomingHeaders["Sec-WebSocket-Version"] = "13";
+  m_agentTestHelper->m_path = "/LinuxCNC/sample";
+
+  key_value_map query;
+  query["heartbeat"] = "200";
+  query["from"] = int64ToString(m_agent->getSequence());
+
+  // Send a line value and then have the client close the connection
+  auto clientThread = std::thread{[this, &client]() {
+    this_thread::sleep_for(50ms);
+    m_adapter->processData("TIME|line|204");
+    this_thread::sleep_for(50ms);
+    // Client frames are masked, an empty close with a zero mask
+    client.push(string("\x88\x80\0\0\0\0", 6));
+  }};
+
+  m_agentTestHelper->makeRequest(__FILE__, __LINE__, "GET", "", query);
+  clientThread.join();
+  client.close();
+
+  auto response = m_agentTestHelper->m_out.str();
+  ASSERT_EQ(0u, response.find("HTTP/1.1 101 Switching Protocols\r\n"));
+  ASSERT_NE(string::npos, response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"));
+
+  // Each document is a text frame
+  istringstream frames(response.substr(response.find("\r\n\r\n") + 4));
+  vector<string> documents;
+  WebSocket::Opcode opcode;
+  string payload;
+  bool final;
+  while (WebSocket::readFrame(frames, opcode, payload, final) && opcode != WebSocket::CLOSE)
+  {
+    if (opcode == WebSocket::TEXT)
+      documents.emplace_back(payload);
+  }
+
+  ASSERT_EQ(WebSocket::CLOSE, opcode);
+  ASSERT_EQ(2u, documents.size());
+  auto doc = xmlParseMemory(documents[1].c_str(), documents[1].length());
+  ASSERT_TRUE(doc);
+  ASSERT_XML_PATH_EQUAL(doc, "//m:Line", "204");
+  xmlFreeDoc(doc);
+}
+
 TEST_F(AgentTest, RelativeTime)
 {
   {
@@ -42,6 +42,7 @@ void AgentTestHelper::makeRequest(const char *file, int line, const char *reques
   incoming.foreign_ip = m_incomingIp;
 
   outgoing.m_out = &m_out;
+  outgoing.m_in = m_in;
 
   m_result = m_agent->httpRequest(incoming, outgoing);
 
@@ -42,6 +42,7 @@ class AgentTestHelper
 
   mtconnect::Agent *m_agent;
   std::ostringstream m_out;
+  std::istream *m_in = nullptr;
 
   std::string m_incomingIp;
 
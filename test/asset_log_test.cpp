@@ -0,0 +1,287 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "asset_log.hpp"
+#include "asset_store.hpp"
+
+#include <dlib/dir_nav.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace mtconnect;
+
+class AssetLogTest : public testing::Test
+{
+ protected:
+  void SetUp() override
+  {
+    removeFiles();
+  }
+
+  void TearDown() override
+  {
+    removeFiles();
+  }
+
+  void removeFiles()
+  {
+    vector<dlib::file> files;
+    try
+    {
+      dlib::directory(m_directory).get_files(files);
+    }
+    catch (dlib::directory::dir_not_found &)
+    {
+    }
+    for (const auto &file : files)
+      std::remove(file.full_name().c_str());
+  }
+
+  vector<string> files()
+  {
+    vector<string> names;
+    vector<dlib::file> files;
+    dlib::directory(m_directory).get_files(files);
+    for (const auto &file : files)
+      names.push_back(file.name());
+    sort(names.begin(), names.end());
+    return names;
+  }
+
+  static AssetLog::Record put(const string &id, const string &content, bool removed = false)
+  {
+    AssetLog::Record record;
+    record.m_kind = AssetLog::PUT;
+    record.m_assetId = id;
+    record.m_type = "Part";
+    record.m_deviceUuid = "000";
+    record.m_timestamp = "2020-01-01T00:00:00Z";
+    record.m_content = content;
+    record.m_removed = removed;
+    return record;
+  }
+
+  static AssetLog::Record remove(const string &id)
+  {
+    AssetLog::Record record;
+    record.m_kind = AssetLog::REMOVE;
+    record.m_assetId = id;
+    record.m_timestamp = "2020-01-02T00:00:00Z";
+    return record;
+  }
+
+  vector<AssetLog::Record> recover(AssetLog &log)
+  {
+    vector<AssetLog::Record> records;
+    log.recover([&records](const AssetLog::Record &record) { records.push_back(record); });
+    return records;
+  }
+
+  // Compact a snapshot of count cutting tools, every tenth one removed
+  void writeTools(int count)
+  {
+    string content =
+        "<CuttingTool assetId='TOOL' toolId='1' serialNumber='1' manufacturers='KMT'>"
+        "<CuttingToolLifeCycle><CutterStatus><Status>NEW</Status></CutterStatus>"
+        "<ToolLife type='MINUTES' countDirection='UP' initial='0' limit='300'>0</ToolLife>"
+        "<ProgramToolNumber>10</ProgramToolNumber>"
+        "<Measurements><BodyDiameterMax code='BDX'>73.25</BodyDiameterMax>"
+        "<OverallToolLength code='OAL' nominal='222.0'>222.0</OverallToolLength>"
+        "</Measurements></CuttingToolLifeCycle></CuttingTool>";
+
+    vector<AssetLog::Record> records;
+    for (int i = 0; i < count; i++)
+    {
+      auto record = put("T" + to_string(i), content, i % 10 == 0);
+      record.m_type = "CuttingTool";
+      records.push_back(record);
+    }
+
+    AssetLog log(m_directory);
+    recover(log);
+    ASSERT_TRUE(log.compact(records));
+  }
+
+  // Rebuild the assets the way the agent does when it starts
+  static void restore(AssetLog &log, AssetStore &store)
+  {
+    log.recover([&store](const AssetLog::Record &record) {
+      AssetPtr asset(
+          new Asset(record.m_assetId, record.m_type, record.m_content, record.m_removed), true);
+      asset->setTimestamp(record.m_timestamp);
+      asset->setDeviceUuid(record.m_deviceUuid);
+      store.add(asset);
+    });
+  }
+
+  string m_directory{"asset_log_test"};
+};
+
+TEST_F(AssetLogTest, ChangesAreReplayed)
+{
+  {
+    AssetLog log(m_directory);
+    ASSERT_TRUE(recover(log).empty());
+    log.append(put("P1", "<Part assetId='P1'>1</Part>"));
+    log.append(put("P2", "<Part assetId='P2'>2</Part>"));
+    log.append(remove("P1"));
+  }
+
+  AssetLog log(m_directory);
+  auto records = recover(log);
+  ASSERT_EQ(3, records.size());
+  ASSERT_EQ(AssetLog::PUT, records[0].m_kind);
+  ASSERT_EQ("P1", records[0].m_assetId);
+  ASSERT_EQ("Part", records[0].m_type);
+  ASSERT_EQ("000", records[0].m_deviceUuid);
+  ASSERT_EQ("<Part assetId='P1'>1</Part>", records[0].m_content);
+  ASSERT_EQ("P2", records[1].m_assetId);
+  ASSERT_EQ(AssetLog::REMOVE, records[2].m_kind);
+  ASSERT_EQ("P1", records[2].m_assetId);
+  ASSERT_EQ("2020-01-02T00:00:00Z", records[2].m_timestamp);
+}
+
+TEST_F(AssetLogTest, TornRecordIsDropped)
+{
+  string name;
+  {
+    AssetLog log(m_directory);
+    recover(log);
+    log.append(put("P1", "<Part assetId='P1'>1</Part>"));
+    log.append(put("P2", "<Part assetId='P2'>2</Part>"));
+    name = m_directory + "/" + files().back();
+  }
+
+  // Cut the last record in half as if the agent crashed while writing it
+  {
+    ifstream in(name, ios::binary);
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+    ofstream out(name, ios::binary | ios::trunc);
+    out.write(data.data(), data.size() - 10);
+  }
+
+  {
+    AssetLog log(m_directory);
+    auto records = recover(log);
+    ASSERT_EQ(1, records.size());
+    ASSERT_EQ("P1", records[0].m_assetId);
+
+    // New changes follow the last complete record
+    log.append(put("P3", "<Part assetId='P3'>3</Part>"));
+  }
+
+  AssetLog log(m_directory);
+  auto records = recover(log);
+  ASSERT_EQ(2, records.size());
+  ASSERT_EQ("P1", records[0].m_assetId);
+  ASSERT_EQ("P3", records[1].m_assetId);
+}
+
+TEST_F(AssetLogTest, CompactionWritesSnapshot)
+{
+  {
+    AssetLog log(m_directory, 256);
+    recover(log);
+    for (int i = 0; i < 10; i++)
+      log.append(put("P1", "<Part assetId='P1'>" + to_string(i) + "</Part>"));
+    ASSERT_TRUE(log.needsCompaction());
+
+    ASSERT_TRUE(log.compact({put("P1", "<Part assetId='P1'>9</Part>")}));
+    ASSERT_EQ(1, log.getGeneration());
+    ASSERT_FALSE(log.needsCompaction());
+    log.append(remove("P1"));
+  }
+
+  // The old generation is gone, the snapshot is read before its log
+  ASSERT_EQ(vector<string>({"assets-00000000000000000001.log",
+                            "assets-00000000000000000001.snap"}),
+            files());
+
+  AssetLog log(m_directory);
+  auto records = recover(log);
+  ASSERT_EQ(2, records.size());
+  ASSERT_EQ("<Part assetId='P1'>9</Part>", records[0].m_content);
+  ASSERT_EQ(AssetLog::REMOVE, records[1].m_kind);
+}
+
+TEST_F(AssetLogTest, CorruptSnapshotIsSkipped)
+{
+  {
+    AssetLog log(m_directory);
+    recover(log);
+    log.compact({put("P1", "1")});
+    log.compact({put("P1", "1"), put("P2", "2")});
+  }
+
+  // A snapshot that was not completely written falls back to nothing rather than
+  // partial assets
+  auto name = m_directory + "/assets-00000000000000000002.snap";
+  {
+    ofstream out(name, ios::binary | ios::in | ios::out);
+    out.seekp(20);
+    out.write("XXXX", 4);
+  }
+
+  AssetLog log(m_directory);
+  ASSERT_TRUE(recover(log).empty());
+}
+
+// Restart an agent with a store full of cutting tools: write the snapshot and read it back
+// into an asset store.
+TEST_F(AssetLogTest, SnapshotRestoresToolCrib)
+{
+  const int count = 500;
+  writeTools(count);
+
+  AssetStore store(count);
+  AssetLog log(m_directory);
+  restore(log, store);
+
+  ASSERT_EQ(count, store.size());
+  ASSERT_EQ(count, store.getCount("CuttingTool"));
+  ASSERT_EQ("T0", store.getOldest()->getAssetId());
+  ASSERT_EQ(count - count / 10, store.find("CuttingTool", "", false, count).size());
+}
+
+// Measures restoring a large tool crib, run it with --gtest_also_run_disabled_tests
+TEST_F(AssetLogTest, DISABLED_BenchmarkRecover50k)
+{
+  const int count = 50000;
+  writeTools(count);
+
+  auto begin = chrono::steady_clock::now();
+  AssetStore store(count);
+  AssetLog log(m_directory);
+  restore(log, store);
+  auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+  ASSERT_EQ(count, store.size());
+  cout << "Recovered " << count << " assets from " << log.getSnapshotSize() << " bytes in "
+       << elapsed * 1000.0 << "ms" << endl;
+}
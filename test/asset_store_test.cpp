@@ -0,0 +1,133 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "asset_store.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace mtconnect;
+
+static AssetPtr makeAsset(const string &id, const string &type, const string &device)
+{
+  AssetPtr asset(new Asset(id, type, "<" + type + "/>"), true);
+  asset->setDeviceUuid(device);
+  return asset;
+}
+
+static vector<string> ids(const vector<AssetPtr> &assets)
+{
+  vector<string> list;
+  for (const auto &asset : assets)
+    list.push_back(asset->getAssetId());
+  return list;
+}
+
+TEST(AssetStoreTest, LeastRecentlyUsed)
+{
+  AssetStore store(3);
+  ASSERT_FALSE(store.add(makeAsset("1", "Part", "d1")).getObject());
+  ASSERT_FALSE(store.add(makeAsset("2", "Part", "d1")).getObject());
+  ASSERT_FALSE(store.add(makeAsset("3", "CuttingTool", "d2")).getObject());
+  ASSERT_EQ(3u, store.size());
+  ASSERT_EQ((vector<string>{"3", "2", "1"}), ids(store.find("", "", false, 10)));
+
+  // Touching and replacing make an asset the most recent
+  store.touch("1");
+  ASSERT_EQ((vector<string>{"1", "3", "2"}), ids(store.find("", "", false, 10)));
+  ASSERT_FALSE(store.add(makeAsset("2", "Part", "d1")).getObject());
+  ASSERT_EQ((vector<string>{"2", "1", "3"}), ids(store.find("", "", false, 10)));
+  ASSERT_EQ(3u, store.size());
+
+  // The least recently used is evicted
+  auto evicted = store.add(makeAsset("4", "Part", "d2"));
+  ASSERT_TRUE(evicted.getObject());
+  ASSERT_EQ("3", evicted->getAssetId());
+  ASSERT_FALSE(store.get("3").getObject());
+  ASSERT_EQ("1", store.getOldest()->getAssetId());
+  ASSERT_EQ(3, store.getCount("Part"));
+  ASSERT_EQ(0, store.getCount("CuttingTool"));
+}
+
+TEST(AssetStoreTest, Indexes)
+{
+  AssetStore store(10);
+  store.add(makeAsset("1", "Part", "d1"));
+  store.add(makeAsset("2", "CuttingTool", "d1"));
+  store.add(makeAsset("3", "Part", "d2"));
+  store.add(makeAsset("4", "CuttingTool", "d2"));
+  store.add(makeAsset("5", "Part", "d1"));
+
+  ASSERT_EQ((vector<string>{"5", "3", "1"}), ids(store.find("Part", "", false, 10)));
+  ASSERT_EQ((vector<string>{"5", "3"}), ids(store.find("Part", "", false, 2)));
+  ASSERT_EQ((vector<string>{"5", "2", "1"}), ids(store.find("", "d1", false, 10)));
+  ASSERT_EQ((vector<string>{"5", "1"}), ids(store.find("Part", "d1", false, 10)));
+  ASSERT_TRUE(store.find("Fixture", "", false, 10).empty());
+
+  // Removed assets keep their place and are only found when asked for
+  store.remove("3");
+  ASSERT_TRUE(store.get("3")->isRemoved());
+  ASSERT_EQ((vector<string>{"5", "1"}), ids(store.find("Part", "", false, 10)));
+  ASSERT_EQ((vector<string>{"5", "3", "1"}), ids(store.find("Part", "", true, 10)));
+  ASSERT_EQ((vector<string>{"5", "4", "3", "2", "1"}), ids(store.find("", "", true, 10)));
+  ASSERT_EQ(3, store.getCount("Part"));
+
+  // A removed version of an asset also keeps its place
+  AssetPtr removed(new Asset("1", "Part", "<Part/>", true), true);
+  removed->setDeviceUuid("d1");
+  store.add(removed);
+  ASSERT_EQ((vector<string>{"5"}), ids(store.find("Part", "", false, 10)));
+  ASSERT_EQ((vector<string>{"5", "3", "1"}), ids(store.find("Part", "", true, 10)));
+
+  // A new version of a removed asset is active again
+  store.add(makeAsset("3", "Part", "d1"));
+  ASSERT_EQ((vector<string>{"3", "5"}), ids(store.find("Part", "", false, 10)));
+  ASSERT_EQ((vector<string>{"3", "5", "2"}), ids(store.find("", "d1", false, 10)));
+}
+
+TEST(AssetStoreTest, DISABLED_BenchmarkToolCrib)
+{
+  const int tools = 50000;
+  AssetStore store(tools);
+  for (int i = 0; i < tools; i++)
+    store.add(makeAsset("T" + to_string(i), i % 10 ? "CuttingTool" : "Part",
+                        "d" + to_string(i % 7)));
+
+  auto begin = chrono::steady_clock::now();
+  for (int i = 0; i < tools; i++)
+    store.touch("T" + to_string((i * 7919) % tools));
+  auto touched = chrono::steady_clock::now();
+
+  size_t found = 0;
+  for (int i = 0; i < 1000; i++)
+    found += store.find("Part", "", false, 10).size();
+  auto end = chrono::steady_clock::now();
+
+  ASSERT_EQ(10000u, found);
+  ASSERT_EQ(size_t(tools), store.size());
+  cout << "Touched " << tools << " assets in "
+       << chrono::duration_cast<chrono::milliseconds>(touched - begin).count()
+       << "ms, 1000 requests for 10 parts in "
+       << chrono::duration_cast<chrono::microseconds>(end - touched).count() << "us" << endl;
+}
@@ -182,4 +182,37 @@ namespace
       throw;
     }
   }
+
+  TEST_F(ChangeObserverTest, WaitUntilDeadlines)
+  {
+    using namespace std::chrono;
+    using namespace std::chrono_literals;
+    mtconnect::ChangeObserver changeObserver;
+
+    m_signaler->addObserver(&changeObserver);
+
+    // Nothing signaled, returns false at the latest deadline and not before
+    auto start = steady_clock::now();
+    ASSERT_FALSE(changeObserver.waitUntil(start, start + 100ms));
+    ASSERT_LE(start + 100ms, steady_clock::now());
+
+    // Signaled before the earliest deadline, wait for the earliest deadline. The latest
+    // deadline is far enough away that a loaded machine does not reach it.
+    auto workerThread = std::thread{[this]() {
+      std::this_thread::sleep_for(20ms);
+      m_signaler->signalObservers(uint64_t{10});
+    }};
+    start = steady_clock::now();
+    ASSERT_TRUE(changeObserver.waitUntil(start + 100ms, start + 10s));
+    auto delta = steady_clock::now() - start;
+    workerThread.join();
+    ASSERT_LE(100ms, delta);
+    ASSERT_GT(10s, delta);
+    ASSERT_EQ(uint64_t{10}, changeObserver.getSequence());
+
+    // Already signaled, returns without waiting for the latest deadline
+    start = steady_clock::now();
+    ASSERT_TRUE(changeObserver.waitUntil(start, start + 10s));
+    ASSERT_GT(10s, steady_clock::now() - start);
+  }
 }  // namespace
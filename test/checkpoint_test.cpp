@@ -81,27 +81,29 @@ TEST_F(CheckpointTest, AddObservations)
 
   ASSERT_EQ(1, (int)p1->refCount());
   m_checkpoint->addObservation(p1);
-  ASSERT_EQ(2, (int)p1->refCount());
+  ASSERT_EQ(3, (int)p1->refCount());
+  ASSERT_EQ(1U, m_checkpoint->getActiveConditions("1")->size());
 
   p2 = new Observation(*m_dataItem1, 2, time, warning2);
   p2->unrefer();
 
   m_checkpoint->addObservation(p2);
-  ASSERT_TRUE(p1.getObject() == p2->getPrev());
+  ASSERT_EQ(2U, m_checkpoint->getActiveConditions("1")->size());
+  ASSERT_EQ(2, (int)p1->refCount());
 
   p3 = new Observation(*m_dataItem1, 2, time, normal);
   p3->unrefer();
 
   m_checkpoint->addObservation(p3);
-  ASSERT_TRUE(nullptr == p3->getPrev());
-  ASSERT_EQ(2, (int)p1->refCount());
+  ASSERT_TRUE(nullptr == m_checkpoint->getActiveConditions("1"));
+  ASSERT_EQ(1, (int)p1->refCount());
   ASSERT_EQ(1, (int)p2->refCount());
 
   p4 = new Observation(*m_dataItem1, 2, time, warning1);
   p4->unrefer();
 
   m_checkpoint->addObservation(p4);
-  ASSERT_TRUE(nullptr == p4->getPrev());
+  ASSERT_EQ(1U, m_checkpoint->getActiveConditions("1")->size());
   ASSERT_EQ(1, (int)p3->refCount());
 
   // Test non condition
@@ -116,7 +118,7 @@ TEST_F(CheckpointTest, AddObservations)
   m_checkpoint->addObservation(p4);
   ASSERT_EQ(2, (int)p4->refCount());
 
-  ASSERT_TRUE(nullptr == p4->getPrev());
+  ASSERT_TRUE(nullptr == m_checkpoint->getActiveConditions("3"));
   ASSERT_EQ(1, (int)p3->refCount());
 }
 
@@ -129,20 +131,33 @@ TEST_F(CheckpointTest, Copy)
   p1 = new Observation(*m_dataItem1, 2, time, warning1);
   p1->unrefer();
   m_checkpoint->addObservation(p1);
-  ASSERT_EQ(2, (int)p1->refCount());
+  ASSERT_EQ(3, (int)p1->refCount());
 
   p2 = new Observation(*m_dataItem1, 2, time, warning2);
   p2->unrefer();
   m_checkpoint->addObservation(p2);
-  ASSERT_TRUE(p1.getObject() == p2->getPrev());
-  ASSERT_EQ(2, (int)p2->refCount());
+  ASSERT_EQ(2U, m_checkpoint->getActiveConditions("1")->size());
+  ASSERT_EQ(3, (int)p2->refCount());
 
+  // The copy shares the active conditions
   auto copy = new Checkpoint(*m_checkpoint);
   ASSERT_EQ(2, (int)p1->refCount());
+  ASSERT_EQ(4, (int)p2->refCount());
+  ASSERT_EQ(m_checkpoint->getActiveConditions("1"), copy->getActiveConditions("1"));
+
+  // Until one of them changes
+  p3 = new Observation(*m_dataItem1, 2, time, normal);
+  p3->unrefer();
+  m_checkpoint->addObservation(p3);
+  ASSERT_TRUE(nullptr == m_checkpoint->getActiveConditions("1"));
+  ASSERT_EQ(2U, copy->getActiveConditions("1")->size());
+  ASSERT_EQ(2, (int)p1->refCount());
   ASSERT_EQ(3, (int)p2->refCount());
+
   delete copy;
   copy = nullptr;
-  ASSERT_EQ(2, (int)p2->refCount());
+  ASSERT_EQ(1, (int)p1->refCount());
+  ASSERT_EQ(1, (int)p2->refCount());
 }
 
 TEST_F(CheckpointTest, GetObservations)
@@ -331,7 +346,7 @@ TEST_F(CheckpointTest, ConditionChaining)
   p2->unrefer();
 
   m_checkpoint->addObservation(p2);
-  ASSERT_TRUE(p1.getObject() == p2->getPrev());
+  ASSERT_EQ(2U, m_checkpoint->getActiveConditions("1")->size());
 
   m_checkpoint->getObservations(list);
   ASSERT_EQ(2, (int)list.size());
@@ -341,9 +356,11 @@ TEST_F(CheckpointTest, ConditionChaining)
   p3->unrefer();
 
   m_checkpoint->addObservation(p3);
-  ASSERT_TRUE(p2.getObject() == p3->getPrev());
-  ASSERT_TRUE(p1.getObject() == p2->getPrev());
-  ASSERT_TRUE(nullptr == p1->getPrev());
+  auto active = m_checkpoint->getActiveConditions("1");
+  ASSERT_EQ(3U, active->size());
+  ASSERT_TRUE(active->hasCode("CODE1"));
+  ASSERT_TRUE(active->hasCode("CODE2"));
+  ASSERT_TRUE(active->hasCode("CODE3"));
 
   m_checkpoint->getObservations(list);
   ASSERT_EQ(3, (int)list.size());
@@ -354,20 +371,17 @@ TEST_F(CheckpointTest, ConditionChaining)
   p4->unrefer();
 
   m_checkpoint->addObservation(p4);
-  ASSERT_EQ(2, (int)p4->refCount());
-  ASSERT_EQ(1, (int)p3->refCount());
-  ASSERT_EQ(2, (int)p2->refCount());
+  ASSERT_EQ(3, (int)p4->refCount());
+  ASSERT_EQ(2, (int)p3->refCount());
+  ASSERT_EQ(1, (int)p2->refCount());
   ASSERT_EQ(2, (int)p1->refCount());
 
-  // Should have been deep copyied
-  ASSERT_TRUE(p3.getObject() != p4->getPrev());
-
-  // Codes should still match
-  ASSERT_EQ(p3->getCode(), p4->getPrev()->getCode());
-  ASSERT_EQ(1, (int)p4->getPrev()->refCount());
-  ASSERT_EQ(p1->getCode(), p4->getPrev()->getPrev()->getCode());
-  ASSERT_EQ(1, (int)p4->getPrev()->getPrev()->refCount());
-  ASSERT_TRUE(nullptr == p4->getPrev()->getPrev()->getPrev());
+  // The fault replaced the warning in place, the others are not copied
+  active = m_checkpoint->getActiveConditions("1");
+  ASSERT_EQ(3U, active->size());
+  ASSERT_EQ(p1.getObject(), active->getObservations()[0].getObject());
+  ASSERT_EQ(p4.getObject(), active->getObservations()[1].getObject());
+  ASSERT_EQ(p3.getObject(), active->getObservations()[2].getObject());
 
   m_checkpoint->getObservations(list);
   ASSERT_EQ(3, (int)list.size());
@@ -378,17 +392,20 @@ TEST_F(CheckpointTest, ConditionChaining)
   p5->unrefer();
 
   m_checkpoint->addObservation(p5);
-  ASSERT_TRUE(nullptr == p5->getPrev());
+  ASSERT_EQ(1, (int)p4->refCount());
 
   // Check cleanup
   ObservationPtr *p7 = m_checkpoint->getEvents().at(std::string("1"));
-  ASSERT_EQ(1, (int)(*p7)->refCount());
-
   ASSERT_TRUE(p7);
   ASSERT_TRUE(p5.getObject() != (*p7).getObject());
   ASSERT_EQ(std::string("CODE3"), (*p7)->getCode());
-  ASSERT_EQ(std::string("CODE1"), (*p7)->getPrev()->getCode());
-  ASSERT_TRUE(nullptr == (*p7)->getPrev()->getPrev());
+  ASSERT_EQ(3, (int)(*p7)->refCount());
+
+  active = m_checkpoint->getActiveConditions("1");
+  ASSERT_EQ(2U, active->size());
+  ASSERT_TRUE(active->hasCode("CODE1"));
+  ASSERT_FALSE(active->hasCode("CODE2"));
+  ASSERT_TRUE(active->hasCode("CODE3"));
 
   m_checkpoint->getObservations(list);
   ASSERT_EQ(2, (int)list.size());
@@ -399,7 +416,7 @@ TEST_F(CheckpointTest, ConditionChaining)
   p6->unrefer();
 
   m_checkpoint->addObservation(p6);
-  ASSERT_TRUE(nullptr == p6->getPrev());
+  ASSERT_TRUE(nullptr == m_checkpoint->getActiveConditions("1"));
 
   m_checkpoint->getObservations(list);
   ASSERT_EQ(1, (int)list.size());
@@ -435,3 +452,43 @@ TEST_F(CheckpointTest, LastConditionNormal)
   ASSERT_EQ(Observation::NORMAL, p3->getLevel());
   ASSERT_EQ(string(""), p3->getCode());
 }
+
+TEST_F(CheckpointTest, ManyActiveConditions)
+{
+  const int count = 500;
+  string time("NOW");
+  ObservationPtrArray list;
+
+  for (int i = 0; i < count; i++)
+  {
+    ObservationPtr p(new Observation(*m_dataItem1, i + 1, time,
+                                     "WARNING|CODE" + to_string(i) + "|HIGH|Over..."),
+                     true);
+    m_checkpoint->addObservation(p);
+  }
+  ASSERT_EQ(size_t(count), m_checkpoint->getActiveConditions("1")->size());
+
+  // A snapshot keeps the conditions active when it was taken
+  Checkpoint snapshot(*m_checkpoint);
+
+  // Clear every other code
+  for (int i = 0; i < count; i += 2)
+  {
+    ObservationPtr p(
+        new Observation(*m_dataItem1, count + i + 1, time, "NORMAL|CODE" + to_string(i) + "||"),
+        true);
+    m_checkpoint->addObservation(p);
+  }
+
+  auto active = m_checkpoint->getActiveConditions("1");
+  ASSERT_EQ(size_t(count / 2), active->size());
+  for (int i = 0; i < count; i++)
+    ASSERT_EQ(i % 2 == 1, active->hasCode("CODE" + to_string(i))) << i;
+
+  m_checkpoint->getObservations(list);
+  ASSERT_EQ(size_t(count / 2), list.size());
+  list.clear();
+
+  snapshot.getObservations(list);
+  ASSERT_EQ(size_t(count), list.size());
+}
@@ -0,0 +1,242 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "cold_store.hpp"
+#include "data_item.hpp"
+#include "observation.hpp"
+
+#include <dlib/dir_nav.h>
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace mtconnect;
+
+class ColdStoreTest : public testing::Test
+{
+ protected:
+  void SetUp() override
+  {
+    removeSegments();
+
+    std::map<string, string> attributes;
+    attributes["id"] = "x";
+    attributes["name"] = "x";
+    attributes["type"] = "POSITION";
+    attributes["category"] = "SAMPLE";
+    m_x = make_unique<DataItem>(attributes);
+
+    attributes["id"] = "line";
+    attributes["name"] = "line";
+    attributes["type"] = "LINE";
+    attributes["category"] = "EVENT";
+    m_line = make_unique<DataItem>(attributes);
+
+    attributes["id"] = "vars";
+    attributes["name"] = "vars";
+    attributes["type"] = "VARIABLE";
+    attributes["representation"] = "DATA_SET";
+    m_vars = make_unique<DataItem>(attributes);
+  }
+
+  void TearDown() override
+  {
+    removeSegments();
+  }
+
+  void removeSegments()
+  {
+    vector<dlib::file> files;
+    try
+    {
+      dlib::directory(m_directory).get_files(files);
+    }
+    catch (dlib::directory::dir_not_found &)
+    {
+    }
+    for (const auto &file : files)
+      std::remove(file.full_name().c_str());
+  }
+
+  unique_ptr<ColdStore> open(uint64_t instanceId = 1, uint64_t budget = 1024 * 1024)
+  {
+    return make_unique<ColdStore>(
+        m_directory, instanceId, budget,
+        [this](const string &id) -> DataItem * {
+          if (id == "x")
+            return m_x.get();
+          if (id == "line")
+            return m_line.get();
+          if (id == "vars")
+            return m_vars.get();
+          return nullptr;
+        },
+        256);
+  }
+
+  // Every odd sequence is an x and every even sequence a line, received a millisecond apart
+  void fill(ColdStore &store, uint64_t first, uint64_t last)
+  {
+    for (auto seq = first; seq <= last; seq++)
+    {
+      ObservationPtr obs(new Observation(seq % 2 ? *m_x : *m_line, seq, "2020-01-01T00:00:00Z",
+                                         to_string(seq)),
+                         true);
+      store.add(obs, seq * 1000);
+    }
+  }
+
+  vector<uint64_t> fetch(ColdStore &store, uint64_t start, uint64_t bound, bool forward,
+                         const set<string> &filter, size_t limit, uint64_t &next)
+  {
+    vector<uint64_t> sequences;
+    next = store.fetch(start, bound, forward, filter, [&](ObservationPtr &obs) {
+      EXPECT_EQ(to_string(obs->getSequence()), obs->getValue());
+      sequences.push_back(obs->getSequence());
+      return sequences.size() < limit;
+    });
+    return sequences;
+  }
+
+  string m_directory{"cold_store_test"};
+  unique_ptr<DataItem> m_x;
+  unique_ptr<DataItem> m_line;
+  unique_ptr<DataItem> m_vars;
+};
+
+TEST_F(ColdStoreTest, FetchForwardAndBackward)
+{
+  auto store = open();
+  fill(*store, 1, 100);
+  ASSERT_EQ(1u, store->getFirstSequence());
+  ASSERT_EQ(100u, store->getLastSequence());
+
+  // Some segments are still being written, the rest are read from disk
+  uint64_t next;
+  auto lines = fetch(*store, 10, 101, true, {"line"}, 5, next);
+  ASSERT_EQ((vector<uint64_t>{10, 12, 14, 16, 18}), lines);
+  ASSERT_EQ(19u, next);
+
+  store->flush();
+  ASSERT_LT(1u, store->getSegmentCount());
+
+  auto both = fetch(*store, 95, 101, true, {"line", "x"}, 100, next);
+  ASSERT_EQ((vector<uint64_t>{95, 96, 97, 98, 99, 100}), both);
+  ASSERT_EQ(101u, next);
+
+  auto xs = fetch(*store, 90, 1, false, {"x"}, 3, next);
+  ASSERT_EQ((vector<uint64_t>{89, 87, 85}), xs);
+  ASSERT_EQ(84u, next);
+
+  auto first = fetch(*store, 3, 1, false, {"x"}, 100, next);
+  ASSERT_EQ((vector<uint64_t>{3, 1}), first);
+  ASSERT_EQ(0u, next);
+
+  auto none = fetch(*store, 1, 101, true, {"other"}, 100, next);
+  ASSERT_TRUE(none.empty());
+  ASSERT_EQ(101u, next);
+}
+
+TEST_F(ColdStoreTest, DataSetsAreRestored)
+{
+  auto store = open();
+  ObservationPtr obs(
+      new Observation(*m_vars, 1, "2020-01-01T00:00:00Z", ":MANUAL a=1 b=2.5 c=text d"), true);
+  store->add(obs, 1000);
+  store->flush();
+
+  ObservationPtr restored;
+  uint64_t next;
+  next = store->fetch(1, 2, true, {"vars"}, [&](ObservationPtr &o) {
+    restored = o;
+    return true;
+  });
+  ASSERT_EQ(2u, next);
+  ASSERT_TRUE(restored);
+  ASSERT_EQ("MANUAL", restored->getResetTriggered());
+  ASSERT_EQ(obs->getDataSet().size(), restored->getDataSet().size());
+  for (auto a = obs->getDataSet().begin(), b = restored->getDataSet().begin();
+       a != obs->getDataSet().end(); a++, b++)
+    ASSERT_TRUE(a->same(*b));
+}
+
+TEST_F(ColdStoreTest, DiskBudgetRemovesOldestSegments)
+{
+  auto store = open(1, 2048);
+  fill(*store, 1, 1000);
+  store->flush();
+
+  ASSERT_GE(2048u, store->getDiskSize());
+  ASSERT_LT(1u, store->getFirstSequence());
+
+  uint64_t next;
+  auto xs = fetch(*store, 1, 1001, true, {"x"}, 1, next);
+  ASSERT_EQ(1u, xs.size());
+  ASSERT_LE(store->getFirstSequence(), xs[0]);
+}
+
+TEST_F(ColdStoreTest, SegmentsAreReloaded)
+{
+  {
+    auto store = open(7);
+    fill(*store, 1, 100);
+  }
+
+  {
+    auto store = open(7);
+    ASSERT_EQ(1u, store->getFirstSequence());
+    ASSERT_EQ(100u, store->getLastSequence());
+
+    // Observations that are already stored are ignored
+    fill(*store, 90, 110);
+    uint64_t next;
+    auto lines = fetch(*store, 96, 111, true, {"line"}, 100, next);
+    ASSERT_EQ((vector<uint64_t>{96, 98, 100, 102, 104, 106, 108, 110}), lines);
+  }
+
+  // Another instance does not continue the sequences
+  auto store = open(8);
+  ASSERT_EQ(0u, store->getFirstSequence());
+  ASSERT_EQ(0u, store->getSegmentCount());
+}
+
+TEST_F(ColdStoreTest, TimeRanges)
+{
+  auto store = open();
+  fill(*store, 1, 100);
+  store->flush();
+
+  // Times resolve to the first sequence of the segments covering them
+  auto from = store->from(50000, 101);
+  ASSERT_LE(from, 50u);
+  ASSERT_LT(40u, from);
+  ASSERT_EQ(101u, store->from(200000, 101));
+  ASSERT_EQ(1u, store->from(0, 101));
+
+  auto to = store->to(50000, 101);
+  ASSERT_LT(50u, to);
+  ASSERT_GE(60u, to);
+  ASSERT_EQ(101u, store->to(200000, 101));
+}
@@ -0,0 +1,224 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "epoch_reclaimer.hpp"
+#include "ref_counted.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace mtconnect;
+
+// Counts the live objects and retires itself when the last reference is dropped
+class Tracked : public RefCounted
+{
+ public:
+  Tracked(EpochReclaimer *reclaimer, int value) : m_reclaimer(reclaimer), m_value(value)
+  {
+    s_live++;
+  }
+  ~Tracked() override
+  {
+    m_value = -1;
+    s_live--;
+  }
+
+  static atomic<int> s_live;
+
+ protected:
+  void release() override
+  {
+    if (m_reclaimer)
+      m_reclaimer->retire(this);
+    else
+      delete this;
+  }
+
+  EpochReclaimer *m_reclaimer;
+
+ public:
+  int m_value;
+};
+
+atomic<int> Tracked::s_live{0};
+
+TEST(EpochReclaimerTest, DefersWhilePinned)
+{
+  EpochReclaimer reclaimer(4, 1000);
+  {
+    RefCountedPtr<Tracked> shared(new Tracked(&reclaimer, 1), true);
+    Tracked *borrowed;
+    {
+      EpochReclaimer::Guard guard(&reclaimer);
+      borrowed = shared.getObject();
+
+      // Dropping the last reference only retires it while the reader is pinned
+      shared = nullptr;
+      reclaimer.reclaim();
+      ASSERT_EQ(1, Tracked::s_live);
+      ASSERT_EQ(1U, reclaimer.getRetiredCount());
+      ASSERT_EQ(1, borrowed->m_value);
+    }
+
+    reclaimer.reclaim();
+    ASSERT_EQ(0, Tracked::s_live);
+    ASSERT_EQ(0U, reclaimer.getRetiredCount());
+  }
+
+  // A reader that pins after the epoch advanced does not hold it back
+  {
+    auto older = make_unique<EpochReclaimer::Guard>(&reclaimer);
+    RefCountedPtr<Tracked> shared(new Tracked(&reclaimer, 2), true);
+    shared = nullptr;
+    reclaimer.reclaim();
+    ASSERT_EQ(1, Tracked::s_live);
+
+    EpochReclaimer::Guard newer(&reclaimer);
+    older.reset();
+    reclaimer.reclaim();
+    ASSERT_EQ(0, Tracked::s_live);
+  }
+
+  // The destructor deletes what is left
+  {
+    EpochReclaimer other(4, 1000);
+    RefCountedPtr<Tracked> last(new Tracked(&other, 3), true);
+    last = nullptr;
+    ASSERT_EQ(1, Tracked::s_live);
+  }
+  ASSERT_EQ(0, Tracked::s_live);
+
+  // A guard without a reclaimer does nothing
+  EpochReclaimer::Guard none(nullptr);
+}
+
+TEST(EpochReclaimerTest, ReclaimsInBatches)
+{
+  EpochReclaimer reclaimer(4, 16);
+  for (int i = 0; i < 100; i++)
+    RefCountedPtr<Tracked> object(new Tracked(&reclaimer, i), true);
+
+  ASSERT_GT(16, Tracked::s_live);
+  ASSERT_EQ(size_t(Tracked::s_live), reclaimer.getRetiredCount());
+}
+
+// Readers borrow the object in a shared slot that a writer keeps replacing, a reader
+// must never see a deleted object
+TEST(EpochReclaimerTest, ConcurrentReaders)
+{
+  const int readers = 4, writes = 100000;
+  {
+    EpochReclaimer reclaimer(8, 64);
+    mutex lock;
+    RefCountedPtr<Tracked> shared(new Tracked(&reclaimer, 0), true);
+    atomic<bool> done{false};
+    atomic<int> failures{0};
+
+    vector<thread> threads;
+    for (int r = 0; r < readers; r++)
+    {
+      threads.emplace_back([&]() {
+        while (!done)
+        {
+          EpochReclaimer::Guard guard(&reclaimer);
+          Tracked *borrowed;
+          {
+            lock_guard<mutex> guard(lock);
+            borrowed = shared.getObject();
+          }
+          auto value = borrowed->m_value;
+          this_thread::yield();
+          if (value < 0 || borrowed->m_value != value)
+            failures++;
+        }
+      });
+    }
+
+    for (int i = 1; i <= writes; i++)
+    {
+      lock_guard<mutex> guard(lock);
+      shared.setObject(new Tracked(&reclaimer, i), true);
+    }
+    done = true;
+    for (auto &t : threads)
+      t.join();
+
+    ASSERT_EQ(0, failures);
+    shared = nullptr;
+  }
+  ASSERT_EQ(0, Tracked::s_live);
+}
+
+// Compares borrowing a shared object by reference and by pinning an epoch
+TEST(EpochReclaimerTest, DISABLED_BenchmarkBorrow)
+{
+  const int readers = 4, reads = 200000, batch = 64;
+  EpochReclaimer reclaimer;
+  vector<RefCountedPtr<Tracked>> objects;
+  for (int i = 0; i < batch; i++)
+    objects.emplace_back(new Tracked(&reclaimer, i), true);
+
+  auto run = [&](bool pinned) {
+    atomic<long> sum{0};
+    auto begin = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int r = 0; r < readers; r++)
+    {
+      threads.emplace_back([&]() {
+        long total = 0;
+        for (int i = 0; i < reads / batch; i++)
+        {
+          if (pinned)
+          {
+            EpochReclaimer::Guard guard(&reclaimer);
+            vector<Tracked *> borrowed(objects.begin(), objects.end());
+            for (auto object : borrowed)
+              total += object->m_value;
+          }
+          else
+          {
+            vector<RefCountedPtr<Tracked>> borrowed(objects.begin(), objects.end());
+            for (auto &object : borrowed)
+              total += object->m_value;
+          }
+        }
+        sum += total;
+      });
+    }
+    for (auto &t : threads)
+      t.join();
+    EXPECT_EQ(long(readers) * (reads / batch) * (batch * (batch - 1) / 2), sum.load());
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+  };
+
+  auto counted = run(false);
+  auto pinned = run(true);
+  cout << "Borrowed " << readers * (reads / batch) * batch << " objects on " << readers
+       << " threads, " << counted * 1000.0 << "ms with references, " << pinned * 1000.0
+       << "ms pinned" << endl;
+
+  objects.clear();
+}
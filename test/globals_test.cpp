@@ -23,7 +23,15 @@
 
 #include <date/date.h>
 
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
 #include <thread>
+#include <vector>
 
 using namespace std;
 using namespace mtconnect;
@@ -210,3 +218,125 @@ TEST(GlobalsTest, Int64ToString)
 {
   ASSERT_EQ((string) "8805345009", int64ToString(8805345009ULL));
 }
+
+// The values a stream or printf writes
+static string printed(const char *format, double value)
+{
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), format, value);
+  return buffer;
+}
+
+TEST(GlobalsTest, FormatNumbers)
+{
+  ASSERT_EQ((string) "-2147483648", int32ToString(INT32_MIN));
+  ASSERT_EQ((string) "4294967295", intToString(UINT32_MAX));
+  ASSERT_EQ((string) "18446744073709551615", int64ToString(UINT64_MAX));
+
+  string integers;
+  appendInteger(integers, INT64_MIN);
+  integers += ' ';
+  appendInteger(integers, 0);
+  integers += ' ';
+  appendInteger(integers, size_t(10));
+  ASSERT_EQ((string) "-9223372036854775808 0 10", integers);
+
+  string out("x=");
+  appendInteger(out, -42);
+  out += ' ';
+  appendFloat(out, 1.5e-10);
+  out += ' ';
+  appendFloat(out, 3.14159265, 6);
+  ASSERT_EQ((string) "x=-42 1.5e-10 3.14159", out);
+
+  // Floats print the same as %.7g, including the values where it switches to exponents
+  vector<double> values = {0.0,    -0.0,     1.0,        -1.0,     0.1,       1e-5,
+                           1e-4,   123456.7, 1234567.0,  12345678.0, 9999999.5, 0.00012345675,
+                           1e300,  -1e-300,  5e-324,     INFINITY,   -INFINITY, NAN};
+  mt19937_64 random(7);
+  uniform_real_distribution<double> mantissa(-10.0, 10.0);
+  uniform_int_distribution<int> exponent(-12, 12);
+  for (int i = 0; i < 100000; i++)
+    values.push_back(mantissa(random) * pow(10.0, exponent(random)));
+
+  for (auto value : values)
+  {
+    ASSERT_EQ(printed("%.7g", value), floatToString(value)) << value;
+
+    string six;
+    appendFloat(six, value, 6);
+    ASSERT_EQ(printed("%g", value), six) << value;
+  }
+
+  // Time series samples are floats written with a stream's default precision
+  ostringstream stream;
+  stream.precision(6);
+  stream << float(2.7182818f);
+  string sample;
+  appendFloat(sample, float(2.7182818f), 6);
+  ASSERT_EQ(stream.str(), sample);
+}
+
+TEST(GlobalsTest, DISABLED_BenchmarkFormatNumbers)
+{
+  const int count = 200000;
+  vector<double> values;
+  mt19937_64 random(11);
+  uniform_real_distribution<double> position(-500.0, 500.0);
+  for (int i = 0; i < count; i++)
+    values.push_back(position(random));
+
+  auto time = [](const char *name, const function<size_t()> &run) {
+    auto begin = chrono::steady_clock::now();
+    auto bytes = run();
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    cout << name << ": " << elapsed * 1000.0 << "ms (" << bytes << " bytes)" << endl;
+  };
+
+  time("sprintf %.7g", [&]() {
+    size_t bytes = 0;
+    char buffer[32];
+    for (auto v : values)
+      bytes += sprintf(buffer, "%.7g", v);
+    return bytes;
+  });
+  time("formatFloat", [&]() {
+    size_t bytes = 0;
+    char buffer[NumberBufferSize];
+    for (auto v : values)
+      bytes += formatFloat(buffer, v) - buffer;
+    return bytes;
+  });
+  time("ostringstream sequence", [&]() {
+    size_t bytes = 0;
+    for (uint64_t i = 0; i < count; i++)
+    {
+      ostringstream stm;
+      stm << (i * 7919);
+      bytes += stm.str().size();
+    }
+    return bytes;
+  });
+  time("int64ToString", [&]() {
+    size_t bytes = 0;
+    for (uint64_t i = 0; i < count; i++)
+      bytes += int64ToString(i * 7919).size();
+    return bytes;
+  });
+  time("ostringstream time series", [&]() {
+    ostringstream stm;
+    stm.precision(6);
+    for (auto v : values)
+      stm << float(v) << ' ';
+    return stm.str().size();
+  });
+  time("appendFloat time series", [&]() {
+    string out;
+    for (auto v : values)
+    {
+      appendFloat(out, float(v), 6);
+      out += ' ';
+    }
+    return out.size();
+  });
+}
@@ -0,0 +1,231 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "journal.hpp"
+
+#include <dlib/dir_nav.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace mtconnect;
+
+class JournalTest : public testing::Test
+{
+ protected:
+  void SetUp() override
+  {
+    removeSegments();
+  }
+
+  void TearDown() override
+  {
+    removeSegments();
+  }
+
+  void removeSegments()
+  {
+    for (const auto &file : segments())
+      std::remove(file.c_str());
+  }
+
+  vector<string> segments()
+  {
+    vector<dlib::file> files;
+    vector<string> names;
+    try
+    {
+      dlib::directory(m_directory).get_files(files);
+    }
+    catch (dlib::directory::dir_not_found &)
+    {
+    }
+    for (const auto &file : files)
+      names.push_back(file.full_name());
+    sort(names.begin(), names.end());
+    return names;
+  }
+
+  Journal::Record record(uint64_t sequence, const string &id, const string &value)
+  {
+    return {sequence, sequence * 1000, id, "2020-01-01T00:00:00.000000Z", value};
+  }
+
+  string m_directory{"journal_test"};
+};
+
+TEST_F(JournalTest, AppendAndRecover)
+{
+  {
+    Journal journal(m_directory, 1024);
+    journal.start(1234, 1);
+    for (uint64_t seq = 1; seq <= 10; seq++)
+      journal.append(record(seq, seq % 2 ? "a" : "b", to_string(seq)), false);
+  }
+
+  Journal journal(m_directory, 1024);
+  uint64_t instanceId = 0, sequence = 0;
+  vector<Journal::Record> records;
+  ASSERT_TRUE(journal.recover(instanceId, sequence, [&](const Journal::Record &r, bool snapshot) {
+    ASSERT_FALSE(snapshot);
+    records.push_back(r);
+  }));
+
+  ASSERT_EQ(1234u, instanceId);
+  ASSERT_EQ(11u, sequence);
+  ASSERT_EQ(10u, records.size());
+  for (uint64_t seq = 1; seq <= 10; seq++)
+  {
+    const auto &r = records[seq - 1];
+    ASSERT_EQ(seq, r.m_sequence);
+    ASSERT_EQ(seq * 1000, r.m_received);
+    ASSERT_EQ(seq % 2 ? "a" : "b", r.m_dataItemId);
+    ASSERT_EQ(to_string(seq), r.m_value);
+  }
+}
+
+TEST_F(JournalTest, NothingToRecover)
+{
+  Journal journal(m_directory, 1024);
+  uint64_t instanceId = 0, sequence = 0;
+  ASSERT_FALSE(journal.recover(instanceId, sequence, [](const Journal::Record &, bool) {}));
+}
+
+TEST_F(JournalTest, SegmentsStartWithTheStateAndAreRemoved)
+{
+  {
+    // Small segments and a buffer of 8 observations
+    Journal journal(m_directory, 8, 1024);
+    journal.start(1, 1);
+    journal.append(record(1, "cond", "fault|A||"), true);
+    journal.append(record(2, "cond", "fault|B||"), true);
+    for (uint64_t seq = 3; seq <= 200; seq++)
+      journal.append(record(seq, "x", to_string(seq)), false);
+
+    ASSERT_LT(1u, journal.getSegmentCount());
+    ASSERT_GE(3u, journal.getSegmentCount());
+  }
+  ASSERT_GE(3u, segments().size());
+
+  Journal journal(m_directory, 8);
+  uint64_t instanceId = 0, sequence = 0;
+  vector<Journal::Record> snapshot, records;
+  ASSERT_TRUE(journal.recover(instanceId, sequence, [&](const Journal::Record &r, bool snap) {
+    (snap ? snapshot : records).push_back(r);
+  }));
+  ASSERT_EQ(201u, sequence);
+
+  // Both active conditions and the last x before the first segment
+  ASSERT_EQ(3u, snapshot.size());
+  ASSERT_EQ("fault|A||", snapshot[0].m_value);
+  ASSERT_EQ("fault|B||", snapshot[1].m_value);
+  ASSERT_EQ(records.front().m_sequence - 1, snapshot[2].m_sequence);
+
+  // The recovered records cover the buffer
+  ASSERT_LE(records.size(), 200u);
+  ASSERT_LE(records.front().m_sequence, 200u - 8u);
+  ASSERT_EQ(200u, records.back().m_sequence);
+}
+
+TEST_F(JournalTest, StopsAtDamagedRecord)
+{
+  {
+    Journal journal(m_directory, 1024);
+    journal.start(1, 1);
+    for (uint64_t seq = 1; seq <= 5; seq++)
+      journal.append(record(seq, "x", "value"), false);
+  }
+
+  // Damage the value of the last record
+  auto files = segments();
+  ASSERT_EQ(1u, files.size());
+  {
+    fstream file(files[0], ios::in | ios::out | ios::binary);
+    file.seekp(-2, ios::end);
+    file.put('?');
+  }
+
+  Journal journal(m_directory, 1024);
+  uint64_t instanceId = 0, sequence = 0;
+  size_t count = 0;
+  ASSERT_TRUE(journal.recover(instanceId, sequence,
+                              [&](const Journal::Record &, bool) { count++; }));
+  ASSERT_EQ(4u, count);
+  ASSERT_EQ(5u, sequence);
+
+  // Restarting at the recovered sequence replaces the damaged segment
+  journal.start(instanceId, sequence);
+  journal.append(record(5, "x", "again"), false);
+  journal.close();
+
+  count = 0;
+  ASSERT_TRUE(journal.recover(instanceId, sequence,
+                              [&](const Journal::Record &, bool) { count++; }));
+  ASSERT_EQ(6u, sequence);
+}
+
+TEST_F(JournalTest, GroupCommit)
+{
+  Journal journal(m_directory, 1024, 1024 * 1024, 50ms);
+  journal.start(1, 1);
+  for (uint64_t seq = 1; seq <= 1000; seq++)
+    journal.append(record(seq, "x", to_string(seq)), false);
+  journal.close();
+
+  // The appends are covered by a few syncs, not one each
+  ASSERT_LE(1u, journal.getSyncs());
+  ASSERT_GT(10u, journal.getSyncs());
+}
+
+// Measures journaling and recovering a large buffer, run it with --gtest_also_run_disabled_tests
+TEST_F(JournalTest, DISABLED_RecoverMillionObservations)
+{
+  const uint64_t count = 1000000;
+  {
+    Journal journal(m_directory, count);
+    journal.start(1, 1);
+    auto begin = chrono::steady_clock::now();
+    for (uint64_t seq = 1; seq <= count; seq++)
+      journal.append(record(seq, "item" + to_string(seq % 100), to_string(seq * 7)), false);
+    journal.close();
+    cout << "Journaled " << count << " observations in "
+         << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - begin).count()
+         << "ms" << endl;
+  }
+
+  Journal journal(m_directory, count);
+  uint64_t instanceId = 0, sequence = 0, recovered = 0;
+  auto begin = chrono::steady_clock::now();
+  ASSERT_TRUE(journal.recover(instanceId, sequence,
+                              [&](const Journal::Record &, bool) { recovered++; }));
+  cout << "Recovered " << recovered << " observations in "
+       << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - begin).count()
+       << "ms" << endl;
+
+  ASSERT_EQ(count, recovered);
+  ASSERT_EQ(count + 1, sequence);
+}
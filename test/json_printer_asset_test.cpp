@@ -252,3 +252,52 @@ TEST_F(JsonPrinterAssetTest, UnknownAssetType)
   ASSERT_EQ("7800f530-34a9"_S, bar.at("/deviceUuid"_json_pointer).get<string>());
   ASSERT_EQ("Some Random Stuff"_S, bar.at("/text"_json_pointer).get<string>());
 }
+
+TEST_F(JsonPrinterAssetTest, AssetsPrintedOnceForEachPrinter)
+{
+  auto xml = getFile("asset1.xml");
+  AssetPtr asset = m_parser->parseAsset("KSSP300R4SD43L240.1", "CuttingTool", xml);
+  auto tool = static_cast<CuttingTool *>(asset.getObject());
+  AssetPtr part;
+  part.setObject(new Asset("P1", "Part", "Some Random Stuff"), true);
+  part->setTimestamp("2001-12-17T09:30:47Z");
+  vector<AssetPtr> assetList = {asset, part};
+
+  XmlPrinter xmlPrinter("1.5", true);
+  JsonPrinter compact("1.5", false);
+
+  // Printing with one printer does not change what the others print
+  auto xmlDoc = xmlPrinter.printAssets(123, 1024, 10, assetList);
+  auto jdoc = json::parse(m_printer->printAssets(123, 1024, 10, assetList));
+  ASSERT_EQ(jdoc, json::parse(compact.printAssets(123, 1024, 10, assetList)));
+  ASSERT_EQ(xmlDoc, xmlPrinter.printAssets(123, 1024, 10, assetList));
+  ASSERT_EQ(2_S, jdoc.at("/MTConnectAssets/Assets"_json_pointer).size());
+  ASSERT_EQ(200, jdoc.at("/MTConnectAssets/Assets/0/CuttingTool/CuttingToolLifeCycle/ToolLife/0/"
+                         "value"_json_pointer)
+                     .get<int32_t>());
+  ASSERT_EQ("Some Random Stuff"_S,
+            jdoc.at("/MTConnectAssets/Assets/1/Part/text"_json_pointer).get<string>());
+
+  // The assets keep what each printer printed until they change
+  auto fragment = asset->getFragment(m_printer.get());
+  ASSERT_EQ(fragment, asset->getFragment(m_printer.get()));
+  ASSERT_NE(fragment, asset->getFragment(&compact));
+  ASSERT_EQ('<', asset->getFragment(&xmlPrinter)->front());
+
+  tool->updateValue("ToolLife@type=PART_COUNT", "199");
+  tool->changed();
+  part->setTimestamp("2002-12-17T09:30:47Z");
+  ASSERT_NE(fragment, asset->getFragment(m_printer.get()));
+
+  jdoc = json::parse(compact.printAssets(123, 1024, 10, assetList));
+  ASSERT_EQ(199, jdoc.at("/MTConnectAssets/Assets/0/CuttingTool/CuttingToolLifeCycle/ToolLife/0/"
+                         "value"_json_pointer)
+                     .get<int32_t>());
+  ASSERT_EQ("2002-12-17T09:30:47Z"_S,
+            jdoc.at("/MTConnectAssets/Assets/1/Part/timestamp"_json_pointer).get<string>());
+  ASSERT_EQ(jdoc, json::parse(m_printer->printAssets(123, 1024, 10, assetList)));
+
+  auto updated = xmlPrinter.printAssets(123, 1024, 10, assetList);
+  ASSERT_NE(string::npos, updated.find(">199</ToolLife>"));
+  ASSERT_NE(string::npos, updated.find("2002-12-17T09:30:47Z"));
+}
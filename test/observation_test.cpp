@@ -23,7 +23,11 @@
 #include "observation.hpp"
 #include "test_globals.hpp"
 
+#include <chrono>
+#include <iostream>
 #include <list>
+#include <thread>
+#include <vector>
 
 using namespace std;
 using namespace mtconnect;
@@ -237,6 +241,26 @@ TEST_F(ObservationTest, RefCounts)
     ASSERT_TRUE(prt->refCount() == 2);
   }
   ASSERT_TRUE(event->refCount() == 1);
+
+  // Moving hands the reference over
+  {
+    ObservationPtr first(event);
+    ObservationPtr second(std::move(first));
+    ASSERT_TRUE(event->refCount() == 2);
+    ASSERT_FALSE(first.getObject());
+
+    ObservationPtr third;
+    third = std::move(second);
+    ASSERT_TRUE(event->refCount() == 2);
+    ASSERT_FALSE(second.getObject());
+
+    ObservationPtrArray list;
+    list.emplace_back(std::move(third));
+    list.emplace_back(event);
+    list.reserve(100);
+    ASSERT_TRUE(event->refCount() == 3);
+  }
+  ASSERT_TRUE(event->refCount() == 1);
 }
 
 TEST_F(ObservationTest, StlLists)
@@ -255,38 +279,6 @@ TEST_F(ObservationTest, StlLists)
   ASSERT_EQ(3, (int)event->refCount());
 }
 
-TEST_F(ObservationTest, EventChaining)
-{
-  string time("NOW"), value("111");
-  ObservationPtr event1(new Observation(*m_dataItem1, 123, time, value), true);
-  ObservationPtr event2(new Observation(*m_dataItem1, 123, time, value), true);
-  ObservationPtr event3(new Observation(*m_dataItem1, 123, time, value), true);
-
-  ASSERT_TRUE(event1.getObject() == event1->getFirst());
-
-  event1->appendTo(event2);
-  ASSERT_TRUE(event1->getFirst() == event2.getObject());
-
-  event2->appendTo(event3);
-  ASSERT_TRUE(event1->getFirst() == event3.getObject());
-
-  ASSERT_EQ(1, (int)event1->refCount());
-  ASSERT_EQ(2, (int)event2->refCount());
-  ASSERT_EQ(2, (int)event3->refCount());
-
-  std::list<ObservationPtr> list;
-  event1->getList(list);
-  ASSERT_EQ(3, (int)list.size());
-  ASSERT_TRUE(list.front().getObject() == event3.getObject());
-  ASSERT_TRUE(list.back().getObject() == event1.getObject());
-
-  std::list<ObservationPtr> list2;
-  event2->getList(list2);
-  ASSERT_EQ(2, (int)list2.size());
-  ASSERT_TRUE(list2.front().getObject() == event3.getObject());
-  ASSERT_TRUE(list2.back().getObject() == event2.getObject());
-}
-
 TEST_F(ObservationTest, Condition)
 {
   string time("NOW");
@@ -442,3 +434,97 @@ TEST_F(ObservationTest, AssetChanged)
 
   d.reset();
 }
+
+TEST_F(ObservationTest, MemorySize)
+{
+  string time("NOW");
+  std::map<string, string> attributes1;
+  attributes1["id"] = "1";
+  attributes1["name"] = "test";
+  attributes1["type"] = "TEMPERATURE";
+  attributes1["category"] = "SAMPLE";
+  attributes1["representation"] = "TIME_SERIES";
+  auto d = make_unique<DataItem>(attributes1);
+
+  string samples;
+  for (int i = 0; i < 1000; i++)
+    samples += to_string(i) + " ";
+  ObservationPtr series(new Observation(*d, 123, time, "1000||" + samples), true);
+
+  // The samples are counted and the size does not change once it is known
+  auto size = series->getMemorySize();
+  ASSERT_LE(sizeof(Observation) + 1000 * sizeof(float), size);
+  series->getAttributes();
+  ASSERT_EQ(size, series->getMemorySize());
+
+  ASSERT_LE(sizeof(Observation), m_compEventA->getMemorySize());
+  ASSERT_GT(size, m_compEventA->getMemorySize() + 1000 * sizeof(float) / 2);
+
+  d.reset();
+}
+
+// Printer threads read the attributes of observations that were never printed before.
+// The attributes are built when the observation is created, so the threads share nothing.
+TEST_F(ObservationTest, DISABLED_BenchmarkConcurrentPrinting)
+{
+  std::map<string, string> attributes;
+  attributes["id"] = "c1";
+  attributes["name"] = "temp";
+  attributes["type"] = "TEMPERATURE";
+  attributes["category"] = "CONDITION";
+  auto condition = make_unique<DataItem>(attributes);
+
+  const int count = 200000;
+  vector<ObservationPtr> observations;
+  observations.reserve(count);
+  for (int i = 0; i < count; i++)
+  {
+    Observation *obs;
+    if (i % 3 == 0)
+      obs = new Observation(*m_dataItem1, i, "NOW", "CODE|NATIVE|CRITICAL|ACTIVE|DESCRIPTION");
+    else if (i % 3 == 1)
+      obs = new Observation(*m_dataItem2, i, "NOW", to_string(i) + ".5");
+    else
+      obs = new Observation(*condition, i, "NOW", "FAULT|" + to_string(i) + "|1|HIGH|Overtemp");
+    observations.emplace_back(obs, true);
+  }
+
+  // Write the attributes the way the printers do
+  auto print = [&observations](size_t first, size_t last, size_t &bytes) {
+    string out;
+    size_t written = 0;
+    for (auto i = first; i < last; i++)
+    {
+      out.clear();
+      for (const auto &attr : observations[i]->getAttributes())
+        out.append(attr.first).append("=\"").append(attr.second).append("\" ");
+      written += out.size();
+    }
+    bytes = written;
+  };
+
+  size_t expected = 0;
+  auto begin = chrono::steady_clock::now();
+  print(0, count, expected);
+  auto single = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+  const int threads = 4;
+  vector<size_t> bytes(threads, 0);
+  vector<thread> workers;
+  begin = chrono::steady_clock::now();
+  for (int t = 0; t < threads; t++)
+    workers.emplace_back(print, count * t / threads, count * (t + 1) / threads, ref(bytes[t]));
+  for (auto &worker : workers)
+    worker.join();
+  auto parallel = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+  size_t total = 0;
+  for (auto b : bytes)
+    total += b;
+  ASSERT_EQ(expected, total);
+
+  cout << "Printed " << count << " observations in " << single * 1000.0 << "ms on one thread, "
+       << parallel * 1000.0 << "ms on " << threads << " threads" << endl;
+
+  condition.reset();
+}
@@ -0,0 +1,228 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "globals.hpp"
+#include "series_codec.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace mtconnect;
+
+struct Sample
+{
+  uint64_t m_sequence;
+  int64_t m_time;
+  double m_value;
+};
+
+static void roundTrip(const vector<Sample> &samples)
+{
+  SeriesEncoder encoder;
+  for (const auto &s : samples)
+    encoder.add(s.m_sequence, s.m_time, s.m_value);
+  ASSERT_EQ(samples.size(), encoder.getCount());
+
+  SeriesDecoder decoder(encoder.getData().data(), encoder.getData().size(), encoder.getCount());
+  Sample decoded;
+  for (const auto &s : samples)
+  {
+    ASSERT_TRUE(decoder.next(decoded.m_sequence, decoded.m_time, decoded.m_value));
+    ASSERT_EQ(s.m_sequence, decoded.m_sequence);
+    ASSERT_EQ(s.m_time, decoded.m_time);
+    // Compare the bits so NaN and -0.0 are restored exactly
+    ASSERT_EQ(0, memcmp(&s.m_value, &decoded.m_value, sizeof(double)));
+  }
+  ASSERT_FALSE(decoder.next(decoded.m_sequence, decoded.m_time, decoded.m_value));
+}
+
+TEST(SeriesCodecTest, RoundTrip)
+{
+  roundTrip({{1, 1000, 1.0}});
+  roundTrip({{1, 1000, 1.0}, {2, 2000, 1.0}, {3, 3000, 1.0}});
+
+  // Irregular sequences, times that step back and jump, and values of every magnitude
+  roundTrip({{10, 1577836800000000, 0.0},
+             {17, 1577836800010000, -0.0},
+             {18, 1577836800009000, 123.4567},
+             {1000000, 1577836900000000, -1e300},
+             {1000001, 1577836900000001, 1e-300},
+             {1000002, 1, NAN},
+             {5000000000ull, INT64_MAX / 2, INFINITY},
+             {5000000001ull, INT64_MAX / 2 + 10, 3.14159}});
+
+  vector<Sample> ramp;
+  for (uint64_t i = 0; i < 10000; i++)
+    ramp.push_back({i * 7 + (i % 3), int64_t(i * 10000 + (i % 5)), sin(double(i) / 100.0)});
+  roundTrip(ramp);
+}
+
+TEST(SeriesCodecTest, Timestamps)
+{
+  for (const auto &text :
+       {"2020-01-01T00:00:00Z", "2020-01-01T00:00:00.5Z", "1999-12-31T23:59:59.999Z",
+        "2024-02-29T12:34:56.123456Z", "1970-01-01T00:00:00.000001Z", "2038-01-19T03:14:08.010Z"})
+  {
+    int64_t micros;
+    int digits;
+    ASSERT_TRUE(parseTimestamp(text, micros, digits)) << text;
+    ASSERT_EQ(text, formatTimestamp(micros, digits));
+  }
+
+  int64_t micros;
+  int digits;
+  ASSERT_TRUE(parseTimestamp("2020-01-01T00:00:01.25Z", micros, digits));
+  ASSERT_EQ(1577836801250000, micros);
+  ASSERT_EQ(2, digits);
+
+  // Everything that would not print back the same is rejected
+  for (const auto &text : {"2020-01-01T00:00:00", "2020-01-01 00:00:00Z", "2020-02-30T00:00:00Z",
+                           "2020-01-01T00:00:00.1234567Z", "2020-01-01T00:00:00.Z", "TIME", ""})
+    ASSERT_FALSE(parseTimestamp(text, micros, digits)) << text;
+}
+
+TEST(SeriesCodecTest, SampleValues)
+{
+  double value;
+  ASSERT_TRUE(parseSampleValue("1.5", value));
+  ASSERT_EQ(1.5, value);
+  ASSERT_TRUE(parseSampleValue("-123.4567", value));
+  ASSERT_TRUE(parseSampleValue("100", value));
+
+  ASSERT_FALSE(parseSampleValue("1.50", value));
+  ASSERT_FALSE(parseSampleValue("1.123456789", value));
+  ASSERT_FALSE(parseSampleValue("UNAVAILABLE", value));
+  ASSERT_FALSE(parseSampleValue("", value));
+}
+
+// A capture shaped like the samples of simulator/VMC-3Axis.xml: the actual and commanded
+// axis positions following a toolpath, axis and spindle loads, spindle speed and feedrate
+// reported every 10ms. textBytes is the size of the values and timestamps printed the way
+// the agent prints them.
+static map<string, vector<Sample>> vmcCapture(int samples, size_t &textBytes)
+{
+  const int64_t start = 1577836800000000;
+  const vector<string> ids = {"x2", "x3", "n3", "y2", "y3", "y4",
+                              "z2", "z3", "z4", "c2", "cl3", "Frt"};
+
+  auto quantize = [](double value, double step) {
+    return stod(floatToString(round(value / step) * step));
+  };
+
+  map<string, vector<Sample>> capture;
+  uint64_t sequence = 1;
+  textBytes = 0;
+  for (int i = 0; i < samples; i++)
+  {
+    int64_t time = start + int64_t(i) * 10000 + (i % 7) * 13;
+    double t = double(i) / 100.0;
+
+    // Circular pockets stepping down in Z
+    double x = 50.0 * cos(t / 4.0), y = 50.0 * sin(t / 4.0), z = -0.5 * floor(t / 60.0);
+    double values[] = {quantize(x, 0.001),
+                       quantize(x + 0.002 * sin(t * 3.0), 0.001),
+                       quantize(20.0 + 5.0 * fabs(sin(t / 4.0)), 1.0),
+                       quantize(y, 0.001),
+                       quantize(y + 0.002 * cos(t * 3.0), 0.001),
+                       quantize(20.0 + 5.0 * fabs(cos(t / 4.0)), 1.0),
+                       quantize(z, 0.001),
+                       quantize(z, 0.001),
+                       quantize(10.0, 1.0),
+                       quantize(8000.0 + 20.0 * sin(t), 1.0),
+                       quantize(35.0 + 3.0 * sin(t / 2.0), 0.1),
+                       quantize(200.0 * fabs(sin(t / 8.0)) + 50.0, 0.01)};
+
+    for (size_t j = 0; j < ids.size(); j++)
+    {
+      capture[ids[j]].push_back({sequence++, time, values[j]});
+      textBytes += formatTimestamp(time, 6).size() + floatToString(values[j]).size();
+    }
+  }
+
+  return capture;
+}
+
+TEST(SeriesCodecTest, VmcCapture)
+{
+  size_t textBytes;
+  auto capture = vmcCapture(2000, textBytes);
+
+  size_t points = 0, bytes = 0;
+  for (const auto &series : capture)
+  {
+    roundTrip(series.second);
+
+    SeriesEncoder encoder;
+    for (const auto &s : series.second)
+      encoder.add(s.m_sequence, s.m_time, s.m_value);
+    points += encoder.getCount();
+    bytes += encoder.getData().size();
+  }
+
+  ASSERT_GT(double(textBytes) / points, 4.0 * double(bytes) / points);
+}
+
+// Decoding speed of an hour and a half of capture
+TEST(SeriesCodecTest, DISABLED_BenchmarkVmcCapture)
+{
+  size_t textBytes;
+  auto capture = vmcCapture(100000, textBytes);
+
+  size_t points = 0, bytes = 0;
+  map<string, SeriesEncoder> encoders;
+  for (const auto &series : capture)
+  {
+    auto &encoder = encoders[series.first];
+    for (const auto &s : series.second)
+      encoder.add(s.m_sequence, s.m_time, s.m_value);
+    points += encoder.getCount();
+    bytes += encoder.getData().size();
+  }
+
+  auto begin = chrono::steady_clock::now();
+  size_t decoded = 0;
+  double sum = 0.0;
+  for (const auto &encoder : encoders)
+  {
+    SeriesDecoder decoder(encoder.second.getData().data(), encoder.second.getData().size(),
+                          encoder.second.getCount());
+    Sample s;
+    while (decoder.next(s.m_sequence, s.m_time, s.m_value))
+    {
+      sum += s.m_value;
+      decoded++;
+    }
+  }
+  auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+  ASSERT_EQ(points, decoded);
+  cout << "Encoded " << points << " samples in " << bytes << " bytes, "
+       << double(bytes) / points << " bytes/point ("
+       << double(textBytes) / points << " bytes/point as text)" << endl;
+  cout << "Decoded " << size_t(decoded / elapsed) << " points/second (checksum " << sum << ")"
+       << endl;
+}
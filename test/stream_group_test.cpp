@@ -0,0 +1,137 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "stream_group.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace mtconnect;
+
+namespace
+{
+  class StreamGroupTest : public testing::Test
+  {
+   protected:
+    void SetUp() override
+    {
+      StreamGroup::Key key{nullptr, {"a", "b"}, 10, false, 100, 10000ms, false};
+      m_group = make_unique<StreamGroup>(key, "boundary");
+      m_fetches = 0;
+    }
+
+    void TearDown() override
+    {
+      m_group.reset();
+    }
+
+    StreamGroup::Chunk fetch(uint64_t start)
+    {
+      m_fetches++;
+      StreamGroup::Chunk chunk;
+      chunk.m_end = start + 10;
+      chunk.m_data = make_shared<string>("chunk " + to_string(start));
+      return chunk;
+    }
+
+    std::unique_ptr<StreamGroup> m_group;
+    std::atomic_int m_fetches;
+  };
+}  // namespace
+
+TEST_F(StreamGroupTest, JoinRequiresSamePosition)
+{
+  StreamGroup::Chunk first;
+  first.m_end = 10;
+  ASSERT_TRUE(m_group->join(first));
+  ASSERT_EQ(1, m_group->getMemberCount());
+
+  StreamGroup::Chunk behind;
+  behind.m_end = 5;
+  ASSERT_FALSE(m_group->join(behind));
+
+  StreamGroup::Chunk replaying;
+  replaying.m_end = 10;
+  replaying.m_endOfBuffer = false;
+  ASSERT_FALSE(m_group->join(replaying));
+
+  StreamGroup::Chunk same;
+  same.m_end = 10;
+  ASSERT_TRUE(m_group->join(same));
+  ASSERT_EQ(2, m_group->getMemberCount());
+
+  m_group->leave();
+  m_group->leave();
+  ASSERT_EQ(0, m_group->getMemberCount());
+
+  // An empty group adopts the position of the next session
+  ASSERT_TRUE(m_group->join(behind));
+}
+
+TEST_F(StreamGroupTest, MembersShareOneFetch)
+{
+  StreamGroup::Chunk p1, p2;
+  p1.m_end = p2.m_end = 10;
+  ASSERT_TRUE(m_group->join(p1));
+  ASSERT_TRUE(m_group->join(p2));
+
+  auto waiter = [](const StreamGroup::Chunk &last) {
+    this_thread::sleep_for(20ms);
+    return last.m_end;
+  };
+  auto fetcher = [this](uint64_t start) { return fetch(start); };
+
+  StreamGroup::Chunk c2;
+  auto other =
+      std::thread{[&]() { c2 = m_group->next(p2.m_generation, waiter, fetcher); }};
+  auto c1 = m_group->next(p1.m_generation, waiter, fetcher);
+  other.join();
+
+  ASSERT_EQ(1, m_fetches);
+  ASSERT_EQ(1u, c1.m_generation);
+  ASSERT_EQ(c1.m_data, c2.m_data);
+  ASSERT_EQ(string("chunk 10"), *c1.m_data);
+  ASSERT_EQ(20u, c1.m_end);
+}
+
+TEST_F(StreamGroupTest, SlowMemberSeesSkippedGeneration)
+{
+  StreamGroup::Chunk fast, slow;
+  fast.m_end = slow.m_end = 10;
+  ASSERT_TRUE(m_group->join(fast));
+  ASSERT_TRUE(m_group->join(slow));
+
+  auto waiter = [](const StreamGroup::Chunk &last) { return last.m_end; };
+  auto fetcher = [this](uint64_t start) { return fetch(start); };
+
+  fast = m_group->next(fast.m_generation, waiter, fetcher);
+  fast = m_group->next(fast.m_generation, waiter, fetcher);
+  ASSERT_EQ(2, m_fetches);
+
+  // The slow member did not consume generation 1 and must leave the group
+  auto chunk = m_group->next(slow.m_generation, waiter, fetcher);
+  ASSERT_EQ(2u, chunk.m_generation);
+  ASSERT_GT(chunk.m_generation, slow.m_generation + 1);
+  ASSERT_EQ(2, m_fetches);
+}
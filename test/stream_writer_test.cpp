@@ -0,0 +1,140 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "stream_writer.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace mtconnect;
+
+namespace
+{
+  // A client that only reads when it is released
+  class SlowClient
+  {
+   public:
+    bool write(const string &data)
+    {
+      unique_lock<mutex> lock(m_mutex);
+      m_cond.wait(lock, [this]() { return m_released || m_gone; });
+      if (m_gone)
+        return false;
+      m_received += data;
+      return true;
+    }
+
+    void release()
+    {
+      lock_guard<mutex> lock(m_mutex);
+      m_released = true;
+      m_cond.notify_all();
+    }
+
+    void shutdown()
+    {
+      lock_guard<mutex> lock(m_mutex);
+      m_gone = true;
+      m_cond.notify_all();
+    }
+
+    string received()
+    {
+      lock_guard<mutex> lock(m_mutex);
+      return m_received;
+    }
+
+    mutex m_mutex;
+    condition_variable m_cond;
+    bool m_released = false;
+    bool m_gone = false;
+    string m_received;
+  };
+
+  shared_ptr<const string> data(size_t size, char c)
+  {
+    return make_shared<const string>(size, c);
+  }
+}  // namespace
+
+TEST(StreamWriterTest, QueueIsBounded)
+{
+  SlowClient client;
+  StreamWriter writer([&client](const string &d) { return client.write(d); });
+
+  // The first chunk is accepted even though it is over the limit, the writer
+  // thread is now blocked writing it
+  ASSERT_TRUE(writer.push(data(150, 'a'), 1, 3, 100));
+  ASSERT_TRUE(writer.push(data(10, 'b'), 4, 2, 200));
+  ASSERT_EQ(160u, writer.getQueuedBytes());
+  ASSERT_FALSE(writer.push(data(50, 'c'), 6, 5, 200));
+
+  // Queued data is dropped, the chunk being written is not
+  this_thread::sleep_for(20ms);
+  uint64_t start = 0;
+  ASSERT_EQ(2u, writer.clear(start));
+  ASSERT_EQ(4u, start);
+  ASSERT_EQ(150u, writer.getQueuedBytes());
+
+  ASSERT_TRUE(writer.push(data(50, 'c'), 6, 5, 200));
+  client.release();
+  writer.close(1000ms);
+
+  ASSERT_EQ(string(150, 'a') + string(50, 'c'), client.received());
+  ASSERT_EQ(0u, writer.getQueuedBytes());
+}
+
+TEST(StreamWriterTest, CloseShutsDownSlowClient)
+{
+  SlowClient client;
+  StreamWriter writer([&client](const string &d) { return client.write(d); },
+                      [&client]() { client.shutdown(); });
+
+  ASSERT_TRUE(writer.push(data(10, 'a'), 1, 1, 100));
+  ASSERT_TRUE(writer.push(data(10, 'b'), 2, 1, 100));
+
+  auto begin = chrono::steady_clock::now();
+  writer.close(50ms);
+  ASSERT_LE(50ms, chrono::steady_clock::now() - begin);
+  ASSERT_FALSE(writer.isOpen());
+  ASSERT_EQ(string(), client.received());
+}
+
+TEST(StreamWriterTest, ClientGone)
+{
+  SlowClient client;
+  client.shutdown();
+  StreamWriter writer([&client](const string &d) { return client.write(d); });
+
+  ASSERT_TRUE(writer.push(data(10, 'a'), 1, 1, 100));
+  for (int i = 0; i < 100 && writer.isOpen(); i++)
+    this_thread::sleep_for(5ms);
+  ASSERT_FALSE(writer.isOpen());
+
+  // Everything pushed after the client is gone is discarded
+  ASSERT_TRUE(writer.push(data(10, 'b'), 2, 1, 100));
+  ASSERT_EQ(0u, writer.getQueuedBytes());
+}
@@ -0,0 +1,188 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "data_item.hpp"
+#include "observation.hpp"
+#include "string_pool.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace mtconnect;
+
+static unique_ptr<DataItem> makeDataItem(const string &id, const string &type,
+                                         const string &category)
+{
+  std::map<string, string> attributes;
+  attributes["id"] = id;
+  attributes["name"] = id;
+  attributes["type"] = type;
+  attributes["category"] = category;
+  return make_unique<DataItem>(attributes);
+}
+
+TEST(StringPoolTest, Intern)
+{
+  ASSERT_EQ(StringPool::UNAVAILABLE, StringPool::find("UNAVAILABLE"));
+  ASSERT_EQ("UNAVAILABLE", StringPool::get(StringPool::UNAVAILABLE));
+
+  bool added;
+  auto id = StringPool::intern("STRING_POOL_TEST_VALUE", &added);
+  ASSERT_NE(StringPool::NONE, id);
+  ASSERT_TRUE(added);
+  ASSERT_EQ(id, StringPool::intern("STRING_POOL_TEST_VALUE", &added));
+  ASSERT_FALSE(added);
+  ASSERT_EQ(id, StringPool::find("STRING_POOL_TEST_VALUE"));
+  ASSERT_EQ("STRING_POOL_TEST_VALUE", StringPool::get(id));
+
+  ASSERT_EQ(StringPool::NONE, StringPool::find("STRING_POOL_TEST_MISSING"));
+  ASSERT_EQ(StringPool::NONE, StringPool::intern(string(StringPool::MaxLength + 1, 'x')));
+}
+
+// Threads interning the same strings all get the same ids
+TEST(StringPoolTest, Concurrent)
+{
+  const int threads = 4, values = 1000;
+  vector<vector<uint32_t>> ids(threads, vector<uint32_t>(values));
+  vector<thread> workers;
+  for (int t = 0; t < threads; t++)
+  {
+    workers.emplace_back([t, &ids]() {
+      for (int i = 0; i < values; i++)
+        ids[t][i] = StringPool::intern("CONCURRENT_" + to_string(i));
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+
+  for (int i = 0; i < values; i++)
+  {
+    ASSERT_NE(StringPool::NONE, ids[0][i]);
+    ASSERT_EQ("CONCURRENT_" + to_string(i), StringPool::get(ids[0][i]));
+    for (int t = 1; t < threads; t++)
+      ASSERT_EQ(ids[0][i], ids[t][i]) << i;
+  }
+}
+
+TEST(StringPoolTest, DataItemValues)
+{
+  auto execution = makeDataItem("exec", "EXECUTION", "EVENT");
+  execution->addConstrainedValue("ACTIVE");
+  execution->addConstrainedValue("READY");
+  auto message = makeDataItem("msg", "MESSAGE", "EVENT");
+  auto position = makeDataItem("pos", "POSITION", "SAMPLE");
+  auto count = makeDataItem("count", "PART_COUNT", "EVENT");
+
+  ASSERT_EQ(StringPool::find("ACTIVE"), execution->internValue("ACTIVE"));
+  ASSERT_EQ(StringPool::UNAVAILABLE, execution->internValue("UNAVAILABLE"));
+  ASSERT_EQ(StringPool::UNAVAILABLE, position->internValue("UNAVAILABLE"));
+  ASSERT_EQ(StringPool::NONE, message->internValue("Coolant low"));
+  ASSERT_EQ(StringPool::NONE, position->internValue("1.0"));
+
+  // A data item only adds a limited number of strings
+  for (unsigned int i = 0; i < DataItem::MaxInternedValues; i++)
+    ASSERT_NE(StringPool::NONE, count->internValue("PART_" + to_string(i)));
+  ASSERT_EQ(StringPool::NONE, count->internValue("PART_NEXT"));
+  ASSERT_NE(StringPool::NONE, count->internValue("PART_0"));
+
+  ObservationPtr active(new Observation(*execution, 1, "TIME", "ACTIVE"), true);
+  ASSERT_EQ(StringPool::find("ACTIVE"), active->getValueId());
+  ASSERT_EQ("ACTIVE", active->getValue());
+  ASSERT_FALSE(active->isUnavailable());
+
+  ObservationPtr unavailable(new Observation(*position, 2, "TIME", "UNAVAILABLE"), true);
+  ASSERT_TRUE(unavailable->isUnavailable());
+  ASSERT_EQ("UNAVAILABLE", unavailable->getValue());
+
+  ObservationPtr text(new Observation(*message, 3, "TIME", "Coolant low"), true);
+  ASSERT_EQ(StringPool::NONE, text->getValueId());
+  ASSERT_EQ("Coolant low", text->getValue());
+}
+
+// Fills a 131072 slot buffer with the events of a machining center: execution, controller
+// mode and program names of a few jobs, and reports the value storage interning saves.
+TEST(StringPoolTest, DISABLED_BenchmarkBufferMemory)
+{
+  const size_t slots = 131072;
+  auto execution = makeDataItem("bench_exec", "EXECUTION", "EVENT");
+  for (auto value : {"ACTIVE", "READY", "INTERRUPTED", "FEED_HOLD", "STOPPED"})
+    execution->addConstrainedValue(value);
+  auto mode = makeDataItem("bench_mode", "CONTROLLER_MODE", "EVENT");
+  for (auto value : {"AUTOMATIC", "MANUAL", "MANUAL_DATA_INPUT", "SEMI_AUTOMATIC", "EDIT"})
+    mode->addConstrainedValue(value);
+  auto program = makeDataItem("bench_program", "PROGRAM", "EVENT");
+  auto block = makeDataItem("bench_block", "BLOCK", "EVENT");
+
+  const vector<string> executions = {"ACTIVE", "READY", "INTERRUPTED", "FEED_HOLD", "STOPPED"};
+  const vector<string> modes = {"AUTOMATIC", "MANUAL", "MANUAL_DATA_INPUT", "SEMI_AUTOMATIC"};
+  const vector<string> programs = {"O1001_HOUSING_ROUGH_OP10.NC", "O1002_HOUSING_FINISH_OP20.NC",
+                                   "O2040_BRACKET_DRILL_TAP.NC", "UNAVAILABLE"};
+
+  vector<ObservationPtr> buffer;
+  buffer.reserve(slots);
+  size_t interned = 0, saved = 0, total = 0;
+  for (size_t i = 0; i < slots; i++)
+  {
+    Observation *observation;
+    switch (i % 4)
+    {
+      case 0:
+        observation = new Observation(*execution, i + 1, "2020-01-01T00:00:00.000000Z",
+                                      executions[(i / 4) % executions.size()]);
+        break;
+      case 1:
+        observation = new Observation(*mode, i + 1, "2020-01-01T00:00:00.000000Z",
+                                      modes[(i / 4) % modes.size()]);
+        break;
+      case 2:
+        observation = new Observation(*program, i + 1, "2020-01-01T00:00:00.000000Z",
+                                      programs[(i / 400) % programs.size()]);
+        break;
+      default:
+        // Free text, never repeated, only the first are interned
+        observation = new Observation(*block, i + 1, "2020-01-01T00:00:00.000000Z",
+                                      "G01 X" + to_string(i) + " Y" + to_string(i * 2) + " F1200");
+        break;
+    }
+    buffer.emplace_back(observation, true);
+
+    // The value would need its own allocation when it does not fit in the string
+    auto &value = observation->getValue();
+    if (observation->getValueId() != StringPool::NONE)
+    {
+      interned++;
+      if (value.size() >= sizeof(string) / 2)
+        saved += value.size() + 1;
+    }
+    total += observation->getMemorySize();
+  }
+
+  ASSERT_EQ(slots / 4 * 3 + DataItem::MaxInternedValues, interned);
+  cout << "Interned " << interned << " of " << slots << " values, saved " << saved
+       << " bytes of value storage (" << double(saved) / slots << " bytes/observation, "
+       << total / slots << " bytes/observation in the buffer)" << endl;
+}
@@ -21,8 +21,11 @@
 #include <libxml/tree.h>
 #include <libxml/xpath.h>
 
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
 #include <sstream>
+#include <streambuf>
 #include <string>
 
 // Retrieve a sample file, open it, and return it as a string
@@ -62,3 +65,43 @@ void failNotEqualIf(bool condition, const std::string &expected, const std::stri
                     const std::string &message, const std::string &file, int line);
 
 void assertIf(bool condition, const std::string &message, const std::string &file, int line);
+
+// Input stream buffer that blocks until data is pushed or it is closed. Used
+// to simulate the client side of a connection.
+class BlockingStreamBuf : public std::streambuf
+{
+ public:
+  void push(const std::string &data)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_data.append(data);
+    m_cond.notify_all();
+  }
+
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_cond.notify_all();
+  }
+
+ protected:
+  int_type underflow() override
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this]() { return !m_data.empty() || m_closed; });
+    if (m_data.empty())
+      return traits_type::eof();
+
+    m_current.swap(m_data);
+    m_data.clear();
+    setg(&m_current[0], &m_current[0], &m_current[0] + m_current.size());
+    return traits_type::to_int_type(m_current[0]);
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::string m_data;
+  std::string m_current;
+  bool m_closed = false;
+};
@@ -0,0 +1,83 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "time_index.hpp"
+
+using namespace std;
+using namespace mtconnect;
+
+TEST(TimeIndexTest, BlocksByTimeAndSize)
+{
+  TimeIndex index(100, 4);
+
+  // Sequences 1-4 at time 1000-1003 fill a block, 5-6 start the next
+  for (uint64_t seq = 1; seq <= 6; seq++)
+    index.add(seq, 999 + seq);
+  ASSERT_EQ(2u, index.size());
+
+  // A gap in time starts a new block
+  index.add(7, 2000);
+  index.add(8, 2050);
+  ASSERT_EQ(3u, index.size());
+
+  ASSERT_EQ(1u, index.from(0, 9));
+  ASSERT_EQ(5u, index.from(1004, 9));
+  ASSERT_EQ(7u, index.from(1500, 9));
+  ASSERT_EQ(7u, index.from(2050, 9));
+  ASSERT_EQ(9u, index.from(2051, 9));
+
+  ASSERT_EQ(1u, index.to(999, 9));
+  ASSERT_EQ(5u, index.to(1003, 9));
+  ASSERT_EQ(7u, index.to(1500, 9));
+  ASSERT_EQ(9u, index.to(2000, 9));
+}
+
+TEST(TimeIndexTest, ClockStepsBack)
+{
+  TimeIndex index(100, 1024);
+
+  index.add(1, 1000);
+  index.add(2, 1200);
+  index.add(3, 500);
+  ASSERT_EQ(2u, index.size());
+
+  // The observation added when the clock was behind is kept with the one before it
+  ASSERT_EQ(2u, index.from(1100, 4));
+  ASSERT_EQ(4u, index.to(1200, 4));
+}
+
+TEST(TimeIndexTest, Trim)
+{
+  TimeIndex index(100, 2);
+
+  for (uint64_t seq = 1; seq <= 8; seq++)
+    index.add(seq, seq);
+  ASSERT_EQ(4u, index.size());
+
+  // The block holding the first sequence is kept
+  index.trim(4);
+  ASSERT_EQ(3u, index.size());
+  ASSERT_EQ(3u, index.from(0, 9));
+
+  index.trim(5);
+  ASSERT_EQ(2u, index.size());
+  ASSERT_EQ(5u, index.from(0, 9));
+}
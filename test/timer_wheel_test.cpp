@@ -0,0 +1,179 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "timer_wheel.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+using namespace mtconnect;
+
+namespace
+{
+  template <typename Pred>
+  bool waitFor(Pred pred, milliseconds timeout = 2000ms)
+  {
+    auto end = steady_clock::now() + timeout;
+    while (steady_clock::now() < end)
+    {
+      if (pred())
+        return true;
+      this_thread::sleep_for(1ms);
+    }
+    return pred();
+  }
+
+  // Moves the wheel by hand to reach ticks that are hours away
+  class TestTimerWheel : public TimerWheel
+  {
+   public:
+    void advanceTo(uint64_t tick)
+    {
+      lock_guard<mutex> lock(m_mutex);
+      advance(tick);
+    }
+
+    int getLevel(TimerId id)
+    {
+      lock_guard<mutex> lock(m_mutex);
+      return m_timers.at(id).m_level;
+    }
+  };
+}  // namespace
+
+TEST(TimerWheelTest, FiresInDeadlineOrderAndNeverEarly)
+{
+  TimerWheel wheel;
+  mutex lock;
+  vector<int> order;
+  vector<steady_clock::time_point> fired(3);
+  vector<steady_clock::time_point> deadlines;
+
+  auto start = steady_clock::now();
+  for (auto delay : {150ms, 10ms, 80ms})
+    deadlines.push_back(start + delay);
+
+  for (int i = 0; i < 3; i++)
+    wheel.schedule(deadlines[i], [&, i]() {
+      lock_guard<mutex> guard(lock);
+      fired[i] = steady_clock::now();
+      order.push_back(i);
+    });
+  ASSERT_EQ(3u, wheel.size());
+
+  ASSERT_TRUE(waitFor([&]() {
+    lock_guard<mutex> guard(lock);
+    return order.size() == 3;
+  }));
+  ASSERT_EQ((vector<int>{1, 2, 0}), order);
+  for (int i = 0; i < 3; i++)
+    ASSERT_LE(deadlines[i], fired[i]);
+  ASSERT_EQ(0u, wheel.size());
+}
+
+TEST(TimerWheelTest, SameDeadlineIsOneWakeup)
+{
+  TimerWheel wheel;
+  atomic_int count{0};
+
+  auto deadline = steady_clock::now() + 50ms;
+  for (int i = 0; i < 100; i++)
+    wheel.schedule(deadline, [&count]() { count++; });
+
+  ASSERT_TRUE(waitFor([&count]() { return count == 100; }));
+  ASSERT_EQ(1u, wheel.getWakeups());
+}
+
+TEST(TimerWheelTest, Cancel)
+{
+  TimerWheel wheel;
+  atomic_bool fired{false};
+
+  auto id = wheel.schedule(steady_clock::now() + 30ms, [&fired]() { fired = true; });
+  ASSERT_TRUE(wheel.cancel(id));
+  ASSERT_FALSE(wheel.cancel(id));
+  ASSERT_EQ(0u, wheel.size());
+
+  this_thread::sleep_for(60ms);
+  ASSERT_FALSE(fired);
+}
+
+TEST(TimerWheelTest, CascadesFromHigherLevels)
+{
+  // With a 1ms tick, these land on the second and third levels
+  TimerWheel wheel;
+  atomic_int count{0};
+
+  auto start = steady_clock::now();
+  steady_clock::time_point first, second;
+  wheel.schedule(start + 200ms, [&]() {
+    first = steady_clock::now();
+    count++;
+  });
+  wheel.schedule(start + 4200ms, [&]() {
+    second = steady_clock::now();
+    count++;
+  });
+
+  ASSERT_TRUE(waitFor([&count]() { return count == 2; }, 6000ms));
+  ASSERT_LE(start + 200ms, first);
+  ASSERT_GT(start + 400ms, first);
+  ASSERT_LE(start + 4200ms, second);
+  ASSERT_GT(start + 4400ms, second);
+}
+
+TEST(TimerWheelTest, OverflowKeepsTimersThatAreStillFarAway)
+{
+  TestTimerWheel wheel;
+  const uint64_t span = uint64_t(1) << (TimerWheel::BITS * TimerWheel::LEVELS);
+
+  auto id = wheel.schedule(steady_clock::now() + milliseconds(2 * span + 5), []() {});
+  ASSERT_EQ(TimerWheel::LEVELS, wheel.getLevel(id));
+
+  // One span later the timer is still more than a span away
+  wheel.advanceTo(span);
+  ASSERT_EQ(TimerWheel::LEVELS, wheel.getLevel(id));
+
+  wheel.advanceTo(2 * span);
+  ASSERT_EQ(0, wheel.getLevel(id));
+  ASSERT_EQ(1u, wheel.size());
+  ASSERT_TRUE(wheel.cancel(id));
+}
+
+TEST(TimerWheelTest, SleepUntil)
+{
+  TimerWheel wheel;
+
+  auto deadline = steady_clock::now() + 40ms;
+  wheel.sleepUntil(deadline);
+  ASSERT_LE(deadline, steady_clock::now());
+
+  // A deadline in the past returns immediately
+  auto start = steady_clock::now();
+  wheel.sleepUntil(start - 10ms);
+  ASSERT_GT(20ms, steady_clock::now() - start);
+}
@@ -0,0 +1,293 @@
+//
+// Copyright Copyright 2009-2019, AMT – The Association For Manufacturing Technology (“AMT”)
+// All rights reserved.
+//
+//    Licensed under the Apache License, Version 2.0 (the "License");
+//    you may not use this file except in compliance with the License.
+//    You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+//    Unless required by applicable law or agreed to in writing, software
+//    distributed under the License is distributed on an "AS IS" BASIS,
+//    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//    See the License for the specific language governing permissions and
+//    limitations under the License.
+//
+
+// Ensure that gtest is the first header otherwise Windows raises an error
+#include <gtest/gtest.h>
+// Keep this comment to keep gtest.h above. (clang-format off/on is not working here!)
+
+#include "test_globals.hpp"
+#include "web_socket.hpp"
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace mtconnect;
+
+namespace
+{
+  // A masked frame with any first byte and length
+  string maskedFrame(unsigned char first, const string &payload)
+  {
+    const unsigned char mask[4] = {0x12, 0x34, 0x56, 0x78};
+
+    string frame;
+    frame.push_back(char(first));
+    if (payload.size() < 126)
+      frame.push_back(char(0x80 | payload.size()));
+    else if (payload.size() <= 0xFFFF)
+    {
+      frame.push_back(char(0x80 | 126));
+      frame.push_back(char(payload.size() >> 8));
+      frame.push_back(char(payload.size() & 0xFF));
+    }
+    else
+    {
+      frame.push_back(char(0x80 | 127));
+      for (int i = 7; i >= 0; i--)
+        frame.push_back(char((uint64_t(payload.size()) >> (i * 8)) & 0xFF));
+    }
+    frame.append(reinterpret_cast<const char *>(mask), 4);
+    for (size_t i = 0; i < payload.size(); i++)
+      frame.push_back(char(payload[i] ^ mask[i % 4]));
+
+    return frame;
+  }
+
+  // Clients must mask their frames
+  string clientFrame(WebSocket::Opcode opcode, const string &payload, bool final = true,
+                     bool masked = true)
+  {
+    unsigned char first = (final ? 0x80 : 0x00) | opcode;
+    if (!masked)
+      return string(1, char(first)) + char(payload.size()) + payload;
+
+    return maskedFrame(first, payload);
+  }
+
+  class WebSocketTest : public testing::Test
+  {
+   protected:
+    void SetUp() override
+    {
+      m_in = make_unique<istream>(&m_client);
+      m_socket = make_unique<WebSocket>(*m_in, m_out, [this]() { m_client.close(); });
+    }
+
+    void TearDown() override
+    {
+      m_socket.reset();
+      m_in.reset();
+    }
+
+    // Wait for the reader thread to process what the client sent
+    template <typename Pred>
+    bool waitFor(Pred pred)
+    {
+      for (int i = 0; i < 100; i++)
+      {
+        if (pred())
+          return true;
+        this_thread::sleep_for(5ms);
+      }
+      return false;
+    }
+
+    // The client sends frames breaking the protocol, the server closes with the code
+    void expectFailure(const string &frames, uint16_t code)
+    {
+      m_socket->accept("dGhlIHNhbXBsZSBub25jZQ==");
+      m_out.str("");
+
+      m_client.push(frames);
+      ASSERT_TRUE(waitFor([&]() { return !m_socket->isOpen(); }));
+      string reason{char(code >> 8), char(code & 0xFF)};
+      ASSERT_EQ(WebSocket::frame(WebSocket::CLOSE, reason), m_out.str());
+    }
+
+    BlockingStreamBuf m_client;
+    unique_ptr<istream> m_in;
+    ostringstream m_out;
+    unique_ptr<WebSocket> m_socket;
+  };
+}  // namespace
+
+TEST_F(WebSocketTest, AcceptKey)
+{
+  // Example from RFC 6455
+  ASSERT_EQ(string("s3pPLMBiTxaQ9kYGzzhZRbK+xOo="),
+            WebSocket::acceptKey("dGhlIHNhbXBsZSBub25jZQ=="));
+}
+
+TEST_F(WebSocketTest, IsUpgrade)
+{
+  dlib::key_value_map_ci headers;
+  ASSERT_FALSE(WebSocket::requestsUpgrade(headers));
+  ASSERT_FALSE(WebSocket::isUpgrade(headers));
+  headers["Upgrade"] = "WebSocket";
+  ASSERT_TRUE(WebSocket::requestsUpgrade(headers));
+  ASSERT_FALSE(WebSocket::isUpgrade(headers));
+  headers["Sec-WebSocket-Key"] = "dGhlIHNhbXBsZSBub25jZQ==";
+  ASSERT_FALSE(WebSocket::isUpgrade(headers));
+  headers["Sec-WebSocket-Version"] = "13";
+  ASSERT_FALSE(WebSocket::isUpgrade(headers));
+  headers["Connection"] = "keep-alive, Upgrade";
+  ASSERT_TRUE(WebSocket::isUpgrade(headers));
+}
+
+TEST_F(WebSocketTest, UpgradeNeedsConnectionAndVersion)
+{
+  dlib::key_value_map_ci headers;
+  headers["Upgrade"] = "websocket";
+  headers["Sec-WebSocket-Key"] = "dGhlIHNhbXBsZSBub25jZQ==";
+  headers["Sec-WebSocket-Version"] = "13";
+
+  headers["Connection"] = "keep-alive";
+  ASSERT_FALSE(WebSocket::isUpgrade(headers));
+  headers["Connection"] = "upgraded";
+  ASSERT_FALSE(WebSocket::isUpgrade(headers));
+  headers["Connection"] = "upgrade";
+  ASSERT_TRUE(WebSocket::isUpgrade(headers));
+
+  for (auto version : {"8", "12", "", "13, 8"})
+  {
+    headers["Sec-WebSocket-Version"] = version;
+    ASSERT_FALSE(WebSocket::isUpgrade(headers)) << "version " << version;
+  }
+}
+
+TEST_F(WebSocketTest, FrameLengths)
+{
+  for (auto size : {0, 125, 126, 1000, 70000})
+  {
+    string payload(size, 'x');
+    istringstream in(WebSocket::frame(WebSocket::TEXT, payload));
+
+    WebSocket::Opcode opcode;
+    string read;
+    bool final;
+    if (size <= int(WebSocket::MAX_MESSAGE_SIZE))
+    {
+      ASSERT_TRUE(WebSocket::readFrame(in, opcode, read, final));
+      ASSERT_EQ(WebSocket::TEXT, opcode);
+      ASSERT_TRUE(final);
+      ASSERT_EQ(payload, read);
+    }
+    else
+      ASSERT_FALSE(WebSocket::readFrame(in, opcode, read, final));
+  }
+}
+
+TEST_F(WebSocketTest, HandshakeAndRequest)
+{
+  m_socket->accept("dGhlIHNhbXBsZSBub25jZQ==");
+  ASSERT_TRUE(m_socket->isOpen());
+  ASSERT_EQ(string("HTTP/1.1 101 Switching Protocols\r\n"
+                   "Upgrade: websocket\r\n"
+                   "Connection: Upgrade\r\n"
+                   "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n"),
+            m_out.str());
+
+  // A fragmented message with url encoding
+  m_client.push(clientFrame(WebSocket::TEXT, "interval=500&pa", false));
+  m_client.push(clientFrame(WebSocket::CONTINUATION, "th=%2F%2FAxes"));
+
+  dlib::key_value_map request;
+  ASSERT_TRUE(waitFor([&]() { return m_socket->takeRequest(request); }));
+  ASSERT_EQ(string("500"), request["interval"]);
+  ASSERT_EQ(string("//Axes"), request["path"]);
+  ASSERT_FALSE(m_socket->takeRequest(request));
+
+  m_socket->close();
+  ASSERT_FALSE(m_socket->isOpen());
+}
+
+TEST_F(WebSocketTest, PingPong)
+{
+  m_socket->accept("dGhlIHNhbXBsZSBub25jZQ==");
+  m_out.str("");
+
+  // Client ping is answered with a pong
+  m_client.push(clientFrame(WebSocket::PING, "hi"));
+  ASSERT_TRUE(waitFor([&]() { return !m_out.str().empty(); }));
+  ASSERT_EQ(WebSocket::frame(WebSocket::PONG, "hi"), m_out.str());
+
+  // The server expects a pong before the next ping
+  ASSERT_TRUE(m_socket->expectPong());
+  ASSERT_FALSE(m_socket->expectPong());
+  m_client.push(clientFrame(WebSocket::PONG, ""));
+  ASSERT_TRUE(waitFor([&]() { return m_socket->expectPong(); }));
+}
+
+TEST_F(WebSocketTest, ClientClose)
+{
+  m_socket->accept("dGhlIHNhbXBsZSBub25jZQ==");
+  m_out.str("");
+
+  m_client.push(clientFrame(WebSocket::CLOSE, "\x03\xe8"));
+  ASSERT_TRUE(waitFor([&]() { return !m_socket->isOpen(); }));
+  ASSERT_EQ(WebSocket::frame(WebSocket::CLOSE, "\x03\xe8"), m_out.str());
+
+  // Nothing is sent after the close
+  m_socket->write(WebSocket::frame(WebSocket::TEXT, "data"));
+  ASSERT_EQ(WebSocket::frame(WebSocket::CLOSE, "\x03\xe8"), m_out.str());
+}
+
+TEST_F(WebSocketTest, UnmaskedFrameIsProtocolError)
+{
+  m_socket->accept("dGhlIHNhbXBsZSBub25jZQ==");
+  m_out.str("");
+
+  m_client.push(clientFrame(WebSocket::TEXT, "interval=500", true, false));
+  ASSERT_TRUE(waitFor([&]() { return !m_socket->isOpen(); }));
+  ASSERT_EQ(WebSocket::frame(WebSocket::CLOSE, "\x03\xea"), m_out.str());
+
+  dlib::key_value_map request;
+  ASSERT_FALSE(m_socket->takeRequest(request));
+}
+
+TEST_F(WebSocketTest, ReservedBitsAreProtocolError)
+{
+  expectFailure(maskedFrame(0x80 | 0x40 | WebSocket::TEXT, "interval=500"),
+                WebSocket::PROTOCOL_ERROR);
+}
+
+TEST_F(WebSocketTest, UnknownOpcodeIsProtocolError)
+{
+  expectFailure(maskedFrame(0x80 | 0x3, ""), WebSocket::PROTOCOL_ERROR);
+}
+
+TEST_F(WebSocketTest, FragmentedControlFrameIsProtocolError)
+{
+  expectFailure(clientFrame(WebSocket::PING, "hi", false), WebSocket::PROTOCOL_ERROR);
+}
+
+TEST_F(WebSocketTest, LongControlFrameIsProtocolError)
+{
+  expectFailure(clientFrame(WebSocket::PING, string(126, 'x')), WebSocket::PROTOCOL_ERROR);
+}
+
+TEST_F(WebSocketTest, ContinuationWithoutMessageIsProtocolError)
+{
+  expectFailure(clientFrame(WebSocket::CONTINUATION, "interval=500"), WebSocket::PROTOCOL_ERROR);
+}
+
+TEST_F(WebSocketTest, LargeFrameIsTooBig)
+{
+  expectFailure(clientFrame(WebSocket::TEXT, string(WebSocket::MAX_MESSAGE_SIZE + 1, 'x')),
+                WebSocket::MESSAGE_TOO_BIG);
+}
+
+TEST_F(WebSocketTest, LargeMessageIsTooBig)
+{
+  string half(WebSocket::MAX_MESSAGE_SIZE / 2 + 1, 'x');
+  expectFailure(clientFrame(WebSocket::TEXT, half, false) +
+                    clientFrame(WebSocket::CONTINUATION, half),
+                WebSocket::MESSAGE_TOO_BIG);
+}
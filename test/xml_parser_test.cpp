@@ -563,3 +563,15 @@ TEST_F(XmlParserTest, ExtendedAssetFragment)
 
   ASSERT_EQ(((size_t)1), tool->m_values.count("x:Color"));
 }
+
+TEST_F(XmlParserTest, CuttingToolSerialNumberDefaultsToAssetId)
+{
+  auto document =
+      "<CuttingTool toolId=\"T1\" assetId=\"T1.1\"><Description>Tool</Description>"
+      "</CuttingTool>";
+  AssetPtr asset = m_xmlParser->parseAsset("T1.1", "CuttingTool", document);
+  ASSERT_EQ((string) "T1.1", asset->getIdentity().at("serialNumber"));
+
+  asset = m_xmlParser->parseAsset("T1.1", "CuttingTool", getFile("asset2.xml"));
+  ASSERT_EQ((string) "1", asset->getIdentity().at("serialNumber"));
+}
@@ -29,6 +29,10 @@
 #include "xml_parser.hpp"
 #include "xml_printer.hpp"
 
+#include <chrono>
+#include <iostream>
+#include <random>
+
 using namespace std;
 using namespace mtconnect;
 
@@ -568,6 +572,117 @@ TEST_F(XmlPrinterTest, EscapedXMLCharacters)
                         "A duck > a foul & < cat '");
 }
 
+TEST_F(XmlPrinterTest, GroupObservations)
+{
+  vector<DataItem *> items;
+  for (const auto &dataItem : m_devices.front()->getDeviceDataItems())
+    items.emplace_back(dataItem.second);
+
+  // Several observations of each data item, in sequence order like a sample request
+  const size_t count = 50000;
+  ObservationPtrArray grouped, sorted;
+  mt19937 random(42);
+  for (size_t i = 0; i < count; i++)
+  {
+    ObservationPtr event(new Observation(*items[random() % items.size()], i + 1, "TIME", "1"),
+                         true);
+    grouped.push_back(event);
+    sorted.push_back(event);
+  }
+
+  // A checkpoint can hold the observations of a data item out of sequence order
+  grouped[0].swap(grouped[count - 1]);
+  sorted[0].swap(sorted[count - 1]);
+
+  auto begin = chrono::steady_clock::now();
+  sort(sorted.begin(), sorted.end(), ObservationCompare);
+  auto sortTime = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+  ObservationList list(grouped.begin(), grouped.end());
+  begin = chrono::steady_clock::now();
+  groupObservations(list);
+  auto groupTime = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+  for (size_t i = 0; i < count; i++)
+    ASSERT_EQ(sorted[i].getObject(), list[i]) << i;
+
+  cout << "Sorted " << count << " observations in " << sortTime * 1000.0 << "ms, grouped in "
+       << groupTime * 1000.0 << "ms" << endl;
+}
+
+TEST_F(XmlPrinterTest, DISABLED_BenchmarkFetchAndPrint)
+{
+  vector<DataItem *> items;
+  for (const auto &dataItem : m_devices.front()->getDeviceDataItems())
+    items.emplace_back(dataItem.second);
+
+  // A buffer holding the only reference to each observation
+  const size_t count = 50000;
+  vector<ObservationPtr> buffer;
+  buffer.reserve(count);
+  for (size_t i = 0; i < count; i++)
+    buffer.emplace_back(new Observation(*items[i % items.size()], i + 1, "TIME", "1.5"), true);
+
+  double fetchTime = 0.0, printTime = 0.0;
+  size_t bytes = 0;
+  for (int round = 0; round < 5; round++)
+  {
+    auto begin = chrono::steady_clock::now();
+    ObservationPtrArray results;
+    for (auto &event : buffer)
+      results.push_back(event);
+    auto fetched = chrono::steady_clock::now();
+    bytes += m_printer->printSample(123, 131072, count + 1, 1, count, results).size();
+    auto printed = chrono::steady_clock::now();
+
+    fetchTime += chrono::duration<double>(fetched - begin).count();
+    printTime += chrono::duration<double>(printed - fetched).count();
+  }
+
+  for (auto &event : buffer)
+    ASSERT_EQ(1u, event->refCount());
+
+  cout << "Fetched " << count << " observations in " << fetchTime * 1000.0 / 5.0
+       << "ms and printed them in " << printTime * 1000.0 / 5.0 << "ms (" << bytes / 5
+       << " bytes)" << endl;
+}
+
+TEST_F(XmlPrinterTest, CompactSampleMatchesPretty)
+{
+  // Compact documents copy the escaped attributes of the data items and streams, they must
+  // have the same content as the documents the writer indents
+  XmlPrinter pretty(m_printer->getSchemaVersion(), true);
+
+  auto canonical = [](const string &text) {
+    auto doc = xmlReadMemory(text.c_str(), int(text.size()), "sample.xml", nullptr,
+                             XML_PARSE_NOBLANKS);
+    EXPECT_TRUE(doc);
+    xmlChar *content;
+    int size;
+    xmlDocDumpMemory(doc, &content, &size);
+    string result((const char *)content, size);
+    xmlFree(content);
+    xmlFreeDoc(doc);
+    return result;
+  };
+
+  for (const auto value : {"", "UNAVAILABLE", "1.5", "fault|500|\"A\" & <B>\t|HIGH",
+                           "CODE|NATIVE|CRITICAL|ACTIVE", "A duck > a foul & < cat '"})
+  {
+    ObservationPtrArray events;
+    uint64_t sequence = 1;
+    for (const auto &dataItem : m_devices.front()->getDeviceDataItems())
+    {
+      ObservationPtr event(new Observation(*dataItem.second, sequence++, "TIME", value), true);
+      events.push_back(event);
+    }
+
+    auto compact = m_printer->printSample(123, 131072, sequence, 1, sequence - 1, events);
+    auto indented = pretty.printSample(123, 131072, sequence, 1, sequence - 1, events);
+    ASSERT_EQ(canonical(indented), canonical(compact)) << value;
+  }
+}
+
 TEST_F(XmlPrinterTest, PrintAsset)
 {
   // Add the xml to the agent...
@@ -851,6 +966,46 @@ TEST_F(XmlPrinterTest, PrintRemovedCuttingTool)
   }
 }
 
+TEST_F(XmlPrinterTest, PrintUpdatedCuttingTool)
+{
+  auto document = getFile("asset1.xml");
+  auto asset = m_config->parseAsset("KSSP300R4SD43L240.1", "CuttingTool", document);
+  CuttingToolPtr tool = (CuttingTool *)asset.getObject();
+
+  vector<AssetPtr> assets;
+  assets.emplace_back(asset);
+  auto before = m_printer->printAssets(123, 4, 2, assets);
+
+  auto life = tool->m_lives[0];
+  auto length = tool->m_measurements["OverallToolLength"];
+  auto diameter = tool->m_measurements["CuttingDiameterMax"];
+  ASSERT_FALSE(life->m_fragments.empty());
+  ASSERT_FALSE(diameter->m_fragments.empty());
+
+  // Only the values that changed are printed again
+  tool->updateValue("ToolLife@type=PART_COUNT", "199");
+  tool->updateValue("OverallToolLength", "222.1");
+  tool->changed();
+  ASSERT_TRUE(life->m_fragments.empty());
+  ASSERT_TRUE(length->m_fragments.empty());
+  ASSERT_FALSE(diameter->m_fragments.empty());
+
+  {
+    PARSE_XML(m_printer->printAssets(123, 4, 2, assets));
+    ASSERT_XML_PATH_EQUAL(doc, "//m:CuttingTool//m:ToolLife", "199");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:CuttingTool/m:CuttingToolLifeCycle/m:Measurements/"
+                          "m:OverallToolLength", "222.1");
+    ASSERT_XML_PATH_EQUAL(doc, "//m:CuttingTool/m:CuttingToolLifeCycle/m:Measurements/"
+                          "m:CuttingDiameterMax", "76.2");
+  }
+
+  // The assembled tool is the same as printing it from scratch
+  tool->updateValue("ToolLife@type=PART_COUNT", "200");
+  tool->updateValue("OverallToolLength", "222.25");
+  tool->changed();
+  ASSERT_EQ(before, m_printer->printAssets(123, 4, 2, assets));
+}
+
 // CuttingTool tests
 TEST_F(XmlPrinterTest, PrintExtendedCuttingTool)
 {
@@ -871,3 +1026,28 @@ TEST_F(XmlPrinterTest, PrintExtendedCuttingTool)
 
   m_printer->clearAssetsNamespaces();
 }
+
+TEST_F(XmlPrinterTest, ReusesWritersOnThread)
+{
+  // Documents and the elements printed inside them reuse the writers kept by the thread
+  auto document = getFile("asset1.xml");
+  auto asset = m_config->parseAsset("KSSP300R4SD43L240.1", "CuttingTool", document);
+  vector<AssetPtr> assets;
+  assets.emplace_back(asset);
+
+  XmlPrinter pretty("1.5", true);
+  auto probe = m_printer->printProbe(123, 9999, 1, 1024, 10, m_devices);
+  auto error = pretty.printError(123, 9999, 1, "ERROR_CODE", "ERROR TEXT!");
+  auto printed = m_printer->printAssets(123, 4, 2, assets);
+
+  for (int i = 0; i < 3; i++)
+  {
+    asset->changed();
+    ASSERT_EQ(printed, m_printer->printAssets(123, 4, 2, assets));
+    ASSERT_EQ(error, pretty.printError(123, 9999, 1, "ERROR_CODE", "ERROR TEXT!"));
+    ASSERT_EQ(probe, m_printer->printProbe(123, 9999, 1, 1024, 10, m_devices));
+  }
+
+  PARSE_XML(error);
+  ASSERT_XML_PATH_EQUAL(doc, "//m:Error@errorCode", "ERROR_CODE");
+}